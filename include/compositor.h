@@ -0,0 +1,46 @@
+#ifndef COMPOSITOR_H
+
+#include "core.h"
+#include "damage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Colours are RGBA with red in the low byte, so a frame is RGBA bytes in
+// memory order, as stbi_write_png and glDrawPixels with GL_RGBA take them
+#define COMPOSITOR_RGBA(r, g, b, a) ((u32)(r) | (u32)(g) << 8 | (u32)(b) << 16 | (u32)(a) << 24)
+
+// Software compositor. Coverage masks, such as a text view's framebuffer or
+// cached glyphs, are blended into an RGBA frame between a foreground and a
+// background colour; rectangles such as selections and the cursor are solid
+// fills. Needs no GPU. The kernels are picked by raster_simd_get_level and
+// all produce the same bytes: each channel is
+// (coverage * fg + (255 - coverage) * bg) / 255, rounded to nearest.
+typedef struct {
+    u32 *pixels; // width * height, rows are width pixels apart
+    s32 width;
+    s32 height;
+} compositor_frame;
+
+void compositor_frame_init(compositor_frame *frame, s32 width, s32 height);
+void compositor_frame_free(compositor_frame *frame);
+
+// Fills the rectangle, clipped to the frame
+void compositor_fill(compositor_frame *frame, s32 x0, s32 y0, s32 x1, s32 y1, u32 color);
+
+// Blends a width * height mask with its top left corner at (x, y) over the
+// frame in the given colour
+void compositor_blend_mask(compositor_frame *frame, s32 x, s32 y, const u8 *mask, s32 width, s32 height, s32 stride,
+                           u32 color);
+
+// Colours a rectangle from a coverage buffer the size of the frame, rows
+// stride bytes apart: fg where it is fully covered, bg where it is empty
+void compositor_compose(compositor_frame *frame, const u8 *coverage, s32 stride, damage_rect rect, u32 fg, u32 bg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define COMPOSITOR_H
+#endif
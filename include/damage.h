@@ -0,0 +1,51 @@
+#ifndef DAMAGE_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Past this many rectangles the closest ones are merged, so a frame with
+// damage all over the screen costs no more than redrawing it whole
+#define DAMAGE_MAX_RECTS 32
+
+// Half open, in pixels
+typedef struct {
+    s32 x0;
+    s32 y0;
+    s32 x1;
+    s32 y1;
+} damage_rect;
+
+// Parts of a framebuffer that changed since they were last drawn or
+// presented. Rectangles are kept sorted by top edge and never overlap;
+// rectangles that share rows are merged, so with rows snapped to text lines
+// there is at most one rectangle per line, as wide as what changed on it.
+typedef struct {
+    s32 width;
+    s32 height;
+    damage_rect rects[DAMAGE_MAX_RECTS + 1]; // One spare while adding
+    u32 count;
+} damage_region;
+
+void damage_init(damage_region *region, s32 width, s32 height);
+
+// Adds a rectangle, clipped to the framebuffer
+void damage_add(damage_region *region, s32 x0, s32 y0, s32 x1, s32 y1);
+void damage_add_all(damage_region *region);
+
+// Adds every rectangle of other
+void damage_add_region(damage_region *region, const damage_region *other);
+
+void damage_clear(damage_region *region);
+
+// Pixels covered by the rectangles
+u64 damage_area(const damage_region *region);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define DAMAGE_H
+#endif
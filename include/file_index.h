@@ -0,0 +1,97 @@
+#ifndef FILE_INDEX_H
+
+#include "core.h"
+#include "line_index.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes indexed at a time. The lock is held for one slice, so readers never
+// wait for more than a fraction of a millisecond.
+#define FILE_INDEX_SLICE_SIZE (1024 * 1024)
+
+// Lines up to this many bytes past the indexed part of the file are still
+// found exactly, by scanning for them.
+#define FILE_INDEX_EXACT_SCAN_SIZE (1024 * 1024)
+
+#define FILE_INDEX_NONE UINT64_MAX
+
+// Line index of a mapped file that is built in the background, so a file of
+// any size opens in constant time. Until indexing is done, lines far past
+// the indexed part are estimated from the average line length so far and
+// reported as inexact.
+//
+// Each slice is also checked for well-formed UTF-8 and its codepoints are
+// counted, so text is validated once at load instead of on every layout.
+typedef struct {
+    mapped_file file;
+    thread_pool *pool;
+    thread_pool_group group;
+
+    pthread_mutex_t mutex;
+    line_index lines;   // Guarded by mutex
+    u64 codepoints;     // Guarded by mutex
+    u64 validated;      // Guarded by mutex, bytes known to be well-formed
+    u64 invalid_offset; // Guarded by mutex, FILE_INDEX_NONE while valid
+    b32 done;           // Guarded by mutex
+    b32 cancelled;      // Guarded by mutex
+
+    // Lines of the exact scan window past the indexed part, indexed once per
+    // slice instead of scanned again on every lookup
+    line_index window;  // Guarded by mutex
+    u64 window_scanned; // Guarded by mutex, lines.scanned it was built at
+
+    thread_pool_notify_fn notify; // Guarded by mutex
+    void *notify_arg;
+} file_index;
+
+// Maps the file and starts indexing it on the pool. With a NULL pool nothing
+// is indexed until file_index_slice is called.
+b32 file_index_open(file_index *index, const char *path, thread_pool *pool);
+
+// Calls fn after every slice indexed from now on, from whichever thread
+// indexed it
+void file_index_set_notify(file_index *index, thread_pool_notify_fn fn, void *arg);
+
+// Stops indexing and unmaps the file
+void file_index_close(file_index *index);
+
+// Indexes the next slice of the file. Returns false once the whole file is
+// indexed.
+b32 file_index_slice(file_index *index);
+
+// Blocks until the whole file is indexed
+void file_index_wait(file_index *index);
+
+b32 file_index_done(file_index *index);
+
+// Fraction of the file indexed so far, from 0 to 1
+f32 file_index_progress(file_index *index);
+
+// exact, which may be NULL, is set to whether the result is exact. Estimated
+// line starts are still the start of some line.
+u64 file_index_line_count(file_index *index, b32 *exact);
+u64 file_index_line_start(file_index *index, u64 line, b32 *exact);
+u64 file_index_line_of(file_index *index, u64 offset, b32 *exact);
+u64 file_index_codepoint_count(file_index *index, b32 *exact);
+
+// Sets text and length to a line without its line break, '\r' included,
+// and clamped to UINT32_MAX bytes. Returns false past the last line. Takes
+// the index as arg, to be a text_view_line_fn.
+b32 file_index_line_text(void *arg, u64 line, const u8 **text, u32 *length);
+
+// Offset of the first ill-formed UTF-8 sequence found so far, or
+// FILE_INDEX_NONE
+u64 file_index_invalid_offset(file_index *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FILE_INDEX_H
+#endif
@@ -0,0 +1,96 @@
+#ifndef FILE_SAVE_H
+
+#include "core.h"
+#include "piece_table.h"
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes written at a time. Progress is updated and cancellation checked
+// between slices.
+#define FILE_SAVE_SLICE_SIZE (8 * 1024 * 1024)
+
+// Most runs of text handed to one pwritev call
+#define FILE_SAVE_MAX_IOVECS 1024
+
+typedef enum {
+    FILE_SAVE_WRITING,
+    FILE_SAVE_DONE,
+    FILE_SAVE_FAILED,
+    FILE_SAVE_CANCELLED,
+} file_save_state;
+
+// Writes a document to a temporary file next to the target, syncs it and
+// renames it over the target, so the target holds either the old or the new
+// text whenever the editor or the machine stops. The target is never opened
+// for writing, which also keeps a mapping of it, as piece_table_open makes,
+// valid.
+//
+// The text is taken from a snapshot of the pieces when the save starts.
+// Pieces point into the mapped file and the append-only add blocks, neither
+// of which edits change, so the document can be edited while the snapshot is
+// written, as long as the table is not freed. Runs that follow each other in
+// memory are joined, so a mostly unedited file is written in a few large
+// pwritev calls without copying it.
+typedef struct {
+    char *path;      // Target, with symbolic links resolved
+    char *temp_path;
+    int fd;
+    FILE *stream;    // Instead of fd where there is no POSIX I/O
+
+    piece_span *spans;
+    u64 span_count;
+    u64 span_capacity;
+    u64 length;
+    u64 span;        // Next run to write and how much of it is written
+    u64 span_offset;
+
+    thread_pool *pool;
+    thread_pool_group group;
+
+    pthread_mutex_t mutex;
+    u64 written;           // Guarded by mutex
+    file_save_state state; // Guarded by mutex
+    b32 cancelled;         // Guarded by mutex
+
+    thread_pool_notify_fn notify; // Guarded by mutex
+    void *notify_arg;
+} file_save;
+
+// Takes a snapshot of the table, creates the temporary file and starts
+// writing it on the pool. With a NULL pool nothing is written until
+// file_save_slice is called. Returns false if the temporary file could not be
+// created, in which case nothing needs closing.
+b32 file_save_start(file_save *save, const piece_table *table, const char *path, thread_pool *pool);
+
+// Calls fn after every slice written from now on and once the save ends,
+// from whichever thread wrote it
+void file_save_set_notify(file_save *save, thread_pool_notify_fn fn, void *arg);
+
+// Cancels the save if it is still writing, removing the temporary file, and
+// frees the snapshot
+void file_save_close(file_save *save);
+
+// Writes the next slice, and commits the file after the last one. Returns
+// false once the save is done, failed or was cancelled.
+b32 file_save_slice(file_save *save);
+
+// Blocks until the save is done, failed or was cancelled
+void file_save_wait(file_save *save);
+
+file_save_state file_save_get_state(file_save *save);
+
+// Fraction of the document written so far, from 0 to 1
+f32 file_save_progress(file_save *save);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FILE_SAVE_H
+#endif
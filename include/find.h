@@ -0,0 +1,68 @@
+#ifndef FIND_H
+
+#include "core.h"
+#include "piece_table.h"
+#include "rope.h"
+#include "thread_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ranges longer than this are split across the pool
+#define FIND_PARALLEL_THRESHOLD (16 * 1024 * 1024)
+
+// Smallest range one job searches
+#define FIND_PART_SIZE (4 * 1024 * 1024)
+
+// Literal string to search for. Candidates are found by comparing two of its
+// bytes, the rarest ones in typical text, against a vector of positions at a
+// time; only positions where both match are compared in full.
+typedef struct {
+    const u8 *needle; // Not copied, must outlive the pattern
+    u64 length;
+    u64 rare_index[2];
+    u8 rare_byte[2];
+} find_pattern;
+
+// Called with every run of a document range in order, as the piece table and
+// rope visitors do. Returning false stops the walk.
+typedef b32 (*find_chunk_fn)(const u8 *data, u64 length, void *arg);
+typedef void (*find_visit_fn)(const void *document, u64 offset, u64 length, find_chunk_fn fn, void *arg);
+
+// Text to search, which is never copied into one buffer. Searching from
+// several threads only reads the document, which must not change meanwhile.
+typedef struct {
+    const void *document;
+    u64 length;
+    find_visit_fn visit;
+} find_source;
+
+typedef struct {
+    u64 *offsets;
+    u64 count;
+    u64 capacity;
+} find_matches;
+
+void find_pattern_init(find_pattern *pattern, const u8 *needle, u64 length);
+
+find_source find_source_memory(const u8 *data, u64 length);
+find_source find_source_piece_table(const piece_table *table);
+find_source find_source_rope(const rope *rope);
+
+void find_matches_free(find_matches *matches);
+
+// Appends the offsets of all matches within [offset, offset + length) that do
+// not overlap an earlier one, in order. pool may be NULL.
+void find_all(const find_pattern *pattern, const find_source *source, u64 offset, u64 length,
+              thread_pool *pool, find_matches *matches);
+
+// Finds the first match that starts at or after offset
+b32 find_next(const find_pattern *pattern, const find_source *source, u64 offset, u64 *match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FIND_H
+#endif
@@ -0,0 +1,93 @@
+#ifndef FONT_H
+
+#include "core.h"
+#include "mapped_file.h"
+
+#include "stb/stb_truetype.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A font file mapped into memory. Every font loaded from the same path shares
+// one mapping, which is unmapped when the last of them is unloaded.
+typedef struct font_file font_file;
+struct font_file {
+    char *path;
+    mapped_file file;
+    u32 references;
+    font_file *next;
+};
+
+#define FONT_MAX_CODEPOINT 0x10FFFF
+#define FONT_CMAP_PAGE_BITS 8
+#define FONT_CMAP_PAGE_SIZE (1 << FONT_CMAP_PAGE_BITS)
+#define FONT_CMAP_PAGE_COUNT ((FONT_MAX_CODEPOINT + 1) >> FONT_CMAP_PAGE_BITS)
+
+// Codepoint to glyph index lookup flattened out of the font's cmap subtable.
+// page_index maps the high bits of a codepoint to one of the pages of glyph
+// indices, where page 0 is shared by every codepoint range without glyphs.
+// coverage holds one bit per codepoint of each page.
+typedef struct {
+    u16 *page_index; // FONT_CMAP_PAGE_COUNT entries
+    u16 *glyphs;     // page_count * FONT_CMAP_PAGE_SIZE entries
+    u64 *coverage;   // page_count * FONT_CMAP_PAGE_SIZE / 64 entries
+    u32 page_count;
+    u32 glyph_count; // Number of codepoints with a glyph
+} font_cmap;
+
+// Codepoints below this (ASCII and Latin-1) have their kerning pairs read
+// once, when the font is loaded
+#define FONT_KERNING_RANGE 256
+
+// Unscaled kerning between codepoints of the kerning range, in font units.
+// Every codepoint that takes part in at least one kerning pair gets its own
+// class, everything else shares class 0, whose row and column are all zero.
+typedef struct {
+    u16 class_of[FONT_KERNING_RANGE];
+    u32 class_count;
+    s16 *pairs; // class_count * class_count, row is the left codepoint
+} font_kerning;
+
+typedef struct {
+    stbtt_fontinfo info;
+    font_file *file;
+    s32 index; // Index of the font within a collection (.ttc) file
+    font_cmap cmap;
+    font_kerning kerning;
+} font;
+
+// map_flags are MAPPED_FILE_* hints, applied when the file is first mapped
+b32 font_load(font *font, const char *path, s32 index, u32 map_flags);
+void font_unload(font *font);
+
+// Glyph index for the codepoint, 0 (the missing glyph) if the font has none.
+// Use this rather than stbtt_FindGlyphIndex, which searches the cmap subtable
+// on every call.
+static inline s32
+font_glyph_index(const font *font, u32 codepoint)
+{
+    if (codepoint > FONT_MAX_CODEPOINT) return 0;
+    u32 page = font->cmap.page_index[codepoint >> FONT_CMAP_PAGE_BITS];
+    return font->cmap.glyphs[(page << FONT_CMAP_PAGE_BITS) | (codepoint & (FONT_CMAP_PAGE_SIZE - 1))];
+}
+
+static inline b32
+font_has_codepoint(const font *font, u32 codepoint)
+{
+    if (codepoint > FONT_MAX_CODEPOINT) return false;
+    u32 page = font->cmap.page_index[codepoint >> FONT_CMAP_PAGE_BITS];
+    u32 bit = (page << FONT_CMAP_PAGE_BITS) | (codepoint & (FONT_CMAP_PAGE_SIZE - 1));
+    return (font->cmap.coverage[bit >> 6] >> (bit & 63)) & 1;
+}
+
+// Number of leading codepoints the font has glyphs for, for picking a
+// fallback font for the rest of a run.
+size_t font_covered_prefix(const font *font, const u32 *codepoints, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FONT_H
+#endif
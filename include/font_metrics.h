@@ -0,0 +1,72 @@
+#ifndef FONT_METRICS_H
+
+#include "core.h"
+#include "font.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Codepoints below this (ASCII and Latin-1) get dense, precomputed tables
+#define FONT_METRICS_DENSE_RANGE FONT_KERNING_RANGE
+
+// Scaled horizontal metrics of one font at one pixel height.
+//
+// Kerning is the font's kerning matrix scaled to the pixel height, over the
+// same kerning classes.
+typedef struct {
+    const font *font;
+    f32 pixel_height;
+    f32 scale;
+
+    f32 ascent;
+    f32 descent;
+    f32 line_gap;
+
+    s32 glyph_index[FONT_METRICS_DENSE_RANGE];
+    f32 advance[FONT_METRICS_DENSE_RANGE];
+
+    u16 kerning_class[FONT_METRICS_DENSE_RANGE];
+    u32 kerning_class_count;
+    f32 *kerning; // kerning_class_count * kerning_class_count, row is the left glyph
+} font_metrics;
+
+void font_metrics_init(font_metrics *metrics, const font *font, f32 pixel_height);
+void font_metrics_free(font_metrics *metrics);
+
+// Slow paths for codepoints outside the dense range
+s32 font_metrics_glyph_index_slow(const font_metrics *metrics, u32 codepoint);
+f32 font_metrics_advance_slow(const font_metrics *metrics, u32 codepoint);
+f32 font_metrics_kerning_slow(const font_metrics *metrics, u32 left, u32 right);
+
+static inline s32
+font_metrics_glyph_index(const font_metrics *metrics, u32 codepoint)
+{
+    if (codepoint < FONT_METRICS_DENSE_RANGE) return metrics->glyph_index[codepoint];
+    return font_metrics_glyph_index_slow(metrics, codepoint);
+}
+
+static inline f32
+font_metrics_advance(const font_metrics *metrics, u32 codepoint)
+{
+    if (codepoint < FONT_METRICS_DENSE_RANGE) return metrics->advance[codepoint];
+    return font_metrics_advance_slow(metrics, codepoint);
+}
+
+static inline f32
+font_metrics_kerning(const font_metrics *metrics, u32 left, u32 right)
+{
+    if (left < FONT_METRICS_DENSE_RANGE && right < FONT_METRICS_DENSE_RANGE) {
+        u32 row = metrics->kerning_class[left];
+        u32 column = metrics->kerning_class[right];
+        return metrics->kerning[row * metrics->kerning_class_count + column];
+    }
+    return font_metrics_kerning_slow(metrics, left, right);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FONT_METRICS_H
+#endif
@@ -0,0 +1,74 @@
+#ifndef FRAME_SCHEDULER_H
+
+#include "core.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seconds between cursor blinks
+#define FRAME_BLINK_INTERVAL 0.53
+
+// The cursor stops blinking, and stays shown, this long after the last input,
+// so an idle window has no timers left
+#define FRAME_BLINK_TIMEOUT 10.0
+
+// Why a frame is drawn
+#define FRAME_DIRTY_INPUT  (1 << 0)
+#define FRAME_DIRTY_RESIZE (1 << 1)
+#define FRAME_DIRTY_BLINK  (1 << 2)
+#define FRAME_DIRTY_JOB    (1 << 3) // A background job made progress
+
+// Wakes the main loop from any thread, as glfwPostEmptyEvent does
+typedef void (*frame_wake_fn)(void *arg);
+
+// Decides when the main loop draws. Input, timers and background jobs mark
+// the view dirty; in between the loop sleeps in the event queue for as long
+// as frame_scheduler_timeout says, which is forever once nothing is blinking.
+// Jobs only wake the loop when no frame is pending, so a worker reporting
+// progress in a tight loop costs one frame per frame drawn, not one per call.
+typedef struct {
+    pthread_mutex_t mutex;
+    u32 dirty; // Guarded by mutex
+
+    frame_wake_fn wake;
+    void *wake_arg;
+
+    // Main thread only
+    f64 blink_interval;
+    f64 blink_timeout;
+    f64 next_blink;   // Negative when the cursor is not blinking
+    f64 blink_until;
+    b32 cursor_visible;
+
+    u64 frames;
+    u64 wakeups;      // Guarded by mutex
+} frame_scheduler;
+
+void frame_scheduler_init(frame_scheduler *scheduler, frame_wake_fn wake, void *arg);
+void frame_scheduler_free(frame_scheduler *scheduler);
+
+// May be called from any thread. Wakes the loop unless a frame is already
+// pending.
+void frame_scheduler_mark_dirty(frame_scheduler *scheduler, u32 reasons);
+
+// Marks the view dirty for input at time now, showing the cursor and
+// restarting its blink
+void frame_scheduler_input(frame_scheduler *scheduler, f64 now);
+
+// Seconds the loop may wait for events before the next frame is due: 0 when
+// one is due now, negative when there is nothing to wait for
+f64 frame_scheduler_timeout(frame_scheduler *scheduler, f64 now);
+
+// Fires the timers that are due and returns why a frame should be drawn,
+// clearing it. Returns 0 when nothing changed since the last frame.
+u32 frame_scheduler_begin_frame(frame_scheduler *scheduler, f64 now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FRAME_SCHEDULER_H
+#endif
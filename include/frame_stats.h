@@ -0,0 +1,82 @@
+#ifndef FRAME_STATS_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Percentiles are taken over this many of the most recent samples
+#define FRAME_STATS_HISTORY 1024
+
+typedef enum {
+    FRAME_STAGE_INPUT,   // From the first input event to the frame starting
+    FRAME_STAGE_LAYOUT,  // Laying out lines the view draws
+    FRAME_STAGE_RASTER,  // Rasterizing missed glyphs and drawing coverage
+    FRAME_STAGE_COMPOSE, // Colouring coverage into the RGBA frame
+    FRAME_STAGE_OVERLAY, // Drawing the frame stats over the frame
+    FRAME_STAGE_PRESENT, // Copying the frame to the window
+    FRAME_STAGE_FRAME,   // Start to end of the whole frame
+    FRAME_STAGE_COUNT
+} frame_stage;
+
+// Most recent samples, oldest first from next once full
+typedef struct {
+    f64 samples[FRAME_STATS_HISTORY];
+    u32 count;
+    u32 next;
+} frame_stats_ring;
+
+typedef struct {
+    u32 count;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 max;
+} frame_stats_summary;
+
+// Where the time of each frame went, stage by stage, and how many glyphs it
+// had to rasterize. A stage only gets a sample in frames that ran it, so
+// input latency is taken over frames that had input.
+typedef struct {
+    frame_stats_ring stages[FRAME_STAGE_COUNT]; // Seconds
+    frame_stats_ring glyph_misses;
+
+    // Frame in progress
+    f64 frame_start;
+    f64 current[FRAME_STAGE_COUNT];
+    u32 current_stages; // Bit per stage that ran
+    u64 current_misses;
+
+    u64 frames;
+    u64 total_glyph_misses;
+} frame_stats;
+
+// Monotonic seconds, for timing stages
+f64 frame_stats_now(void);
+
+const char *frame_stage_name(frame_stage stage);
+
+void frame_stats_init(frame_stats *stats);
+
+void frame_stats_begin_frame(frame_stats *stats, f64 now);
+
+// Adds to the time of a stage in the current frame
+void frame_stats_add(frame_stats *stats, frame_stage stage, f64 seconds);
+void frame_stats_add_glyph_misses(frame_stats *stats, u64 misses);
+
+// Records the current frame's samples and its time since begin_frame
+void frame_stats_end_frame(frame_stats *stats, f64 now);
+
+frame_stats_summary frame_stats_summarize(const frame_stats *stats, frame_stage stage);
+frame_stats_summary frame_stats_summarize_glyph_misses(const frame_stats *stats);
+
+// Writes the summaries as JSON, times in milliseconds
+b32 frame_stats_write_json(const frame_stats *stats, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define FRAME_STATS_H
+#endif
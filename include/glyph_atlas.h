@@ -0,0 +1,74 @@
+#ifndef GLYPH_ATLAS_H
+
+#include "core.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    u32 page;
+    u32 x;
+    u32 y;
+    u32 width;
+    u32 height;
+} atlas_region;
+
+// A horizontal strip of a page. Glyphs of similar height are packed left to
+// right into the same shelf.
+typedef struct {
+    u32 y;
+    u32 height;
+    u32 x; // Next free column
+} atlas_shelf;
+
+typedef struct {
+    u8 *pixels; // page_width * page_height 8-bit coverage
+    atlas_shelf *shelves;
+    u32 shelf_count;
+    u32 shelf_capacity;
+    u32 bottom; // First row not covered by a shelf
+    u32 region_count;
+    u64 last_used;
+} atlas_page;
+
+typedef struct {
+    u32 page_width;
+    u32 page_height;
+    u32 padding;
+    u32 max_pages;
+
+    atlas_page *pages;
+    u32 page_count;
+} glyph_atlas;
+
+void glyph_atlas_init(glyph_atlas *atlas, u32 page_width, u32 page_height, u32 padding, u32 max_pages);
+void glyph_atlas_free(glyph_atlas *atlas);
+void glyph_atlas_clear(glyph_atlas *atlas);
+
+// Packs a width x height region into existing shelf space, opening new shelves
+// and pages as needed. Returns false when every page is full; the caller is
+// expected to evict a page and retry.
+b32 glyph_atlas_alloc(glyph_atlas *atlas, u32 width, u32 height, u64 frame, atlas_region *region);
+
+// Returns true if a region of the given size can ever be stored in a page.
+b32 glyph_atlas_fits(const glyph_atlas *atlas, u32 width, u32 height);
+
+void glyph_atlas_touch(glyph_atlas *atlas, u32 page, u64 frame);
+
+// Page whose most recently used region is the oldest
+u32 glyph_atlas_lru_page(const glyph_atlas *atlas);
+
+// Forgets every region on the page and clears its pixels
+void glyph_atlas_reset_page(glyph_atlas *atlas, u32 page);
+
+u8 *glyph_atlas_region_pixels(const glyph_atlas *atlas, const atlas_region *region);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define GLYPH_ATLAS_H
+#endif
@@ -0,0 +1,114 @@
+#ifndef GLYPH_CACHE_H
+
+#include "core.h"
+#include "glyph_atlas.h"
+#include "thread_pool.h"
+
+#include "stb/stb_truetype.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of horizontal subpixel positions a glyph is rasterized at. Pen
+// positions are quantized to 1/GLYPH_CACHE_SUBPIXEL_STEPS of a pixel.
+#define GLYPH_CACHE_SUBPIXEL_STEPS 4
+
+#define GLYPH_CACHE_DEFAULT_PAGE_SIZE 1024
+#define GLYPH_CACHE_DEFAULT_MAX_PAGES 8
+
+// Signed distance field glyphs are generated once at this size and scaled to
+// whatever size they are drawn at. The encoding is the one sdf_draw expects:
+// GLYPH_CACHE_SDF_ONEDGE_VALUE on the outline, falling to 0 at
+// GLYPH_CACHE_SDF_PADDING pixels outside of it.
+#define GLYPH_CACHE_SDF_PIXEL_HEIGHT 48.0f
+#define GLYPH_CACHE_SDF_PADDING 4
+#define GLYPH_CACHE_SDF_ONEDGE_VALUE 128
+#define GLYPH_CACHE_SDF_PIXEL_DIST_SCALE ((f32)GLYPH_CACHE_SDF_ONEDGE_VALUE / GLYPH_CACHE_SDF_PADDING)
+
+typedef enum {
+    GLYPH_MODE_COVERAGE,
+    GLYPH_MODE_SDF,
+} glyph_mode;
+
+typedef struct {
+    const stbtt_fontinfo *font;
+    s32 glyph_index;
+    f32 pixel_height;
+    u32 subpixel_phase;
+    glyph_mode mode;
+} glyph_key;
+
+typedef struct {
+    s32 width;
+    s32 height;
+    s32 x_offset;          // Left edge of coverage relative to the pen position
+    s32 y_offset;          // Top edge of coverage relative to the baseline
+    s32 advance;           // Unscaled advance width, in font units
+    s32 left_side_bearing; // Unscaled, in font units
+    f32 scale;
+    u8 *coverage;          // width * height bytes, rows are stride bytes apart. Distances in SDF mode.
+    s32 stride;
+    atlas_region region;   // Location in the atlas, unless the glyph is oversized
+} cached_glyph;
+
+typedef struct {
+    glyph_key key;
+    cached_glyph glyph;
+    u64 last_used;
+    b32 occupied;
+    b32 oversized; // Too large for an atlas page, coverage is heap allocated
+} glyph_cache_slot;
+
+typedef struct {
+    glyph_cache_slot *slots;
+    u32 capacity; // Always a power of two
+    u32 count;
+
+    glyph_atlas atlas;
+    u64 frame;
+
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+} glyph_cache;
+
+// Coverage lives in an atlas of at most atlas_max_pages square pages of
+// atlas_page_size pixels. When the atlas is full the least recently used page
+// is evicted.
+void glyph_cache_init(glyph_cache *cache, u32 initial_capacity, u32 atlas_page_size, u32 atlas_max_pages);
+void glyph_cache_free(glyph_cache *cache);
+void glyph_cache_clear(glyph_cache *cache);
+
+// Marks the start of a new frame. Glyphs used during the current frame survive
+// the eviction of their page.
+void glyph_cache_begin_frame(glyph_cache *cache);
+
+u32 glyph_cache_subpixel_phase(f32 x);
+
+// Returns the rasterized glyph for the given key, rasterizing and storing it
+// on first use. The returned pointer is valid until the next call that
+// inserts into the cache, or until the cache is cleared.
+const cached_glyph *glyph_cache_get(glyph_cache *cache, const stbtt_fontinfo *font,
+                                    s32 glyph_index, f32 pixel_height, u32 subpixel_phase);
+
+// Rasterizes every listed glyph that is not cached yet. Storage for all of
+// them is packed on the calling thread, then the glyphs are rasterized into
+// their disjoint atlas regions on the pool. subpixel_phases may be NULL.
+void glyph_cache_warm(glyph_cache *cache, thread_pool *pool, const stbtt_fontinfo *font, f32 pixel_height,
+                      const s32 *glyph_indices, const u32 *subpixel_phases, u32 count);
+
+// Same as glyph_cache_get and glyph_cache_warm for distance field glyphs. The
+// metrics of the returned glyph, padding included, are those at
+// GLYPH_CACHE_SDF_PIXEL_HEIGHT; scale them by the ratio of the drawn size to
+// that height.
+const cached_glyph *glyph_cache_get_sdf(glyph_cache *cache, const stbtt_fontinfo *font, s32 glyph_index);
+void glyph_cache_warm_sdf(glyph_cache *cache, thread_pool *pool, const stbtt_fontinfo *font,
+                          const s32 *glyph_indices, u32 count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define GLYPH_CACHE_H
+#endif
@@ -0,0 +1,57 @@
+#ifndef HEADLESS_H
+
+#include "core.h"
+#include "thread_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest frame that can be rendered, in either direction
+#define HEADLESS_MAX_SIZE 16384
+
+typedef struct {
+    const char *path;     // File whose first screen is rendered
+    const char *out_path; // PNG to write, RGBA
+    const char *font_path;
+    s32 width;
+    s32 height;
+    f32 pixel_height;
+    b32 sdf_glyphs;
+    u32 foreground;       // COMPOSITOR_RGBA colours
+    u32 background;
+    u32 cursor;           // At the start of the file, none if 0
+} headless_options;
+
+typedef enum {
+    HEADLESS_STAGE_OPEN,    // Mapping and indexing the file
+    HEADLESS_STAGE_FONT,    // Loading the font and its metrics
+    HEADLESS_STAGE_LAYOUT,  // Laying out the visible lines
+    HEADLESS_STAGE_RASTER,  // Rasterizing their glyphs into the cache
+    HEADLESS_STAGE_DRAW,    // Drawing the glyphs into the text view
+    HEADLESS_STAGE_COMPOSE, // Colouring the coverage into an RGBA frame
+    HEADLESS_STAGE_ENCODE,  // Writing the PNG
+    HEADLESS_STAGE_COUNT
+} headless_stage;
+
+typedef struct {
+    f64 seconds[HEADLESS_STAGE_COUNT];
+    u64 lines;        // Laid out
+    u64 glyphs;       // Laid out and reaching into the frame
+    u64 glyph_misses; // Rasterized
+} headless_report;
+
+const char *headless_stage_name(headless_stage stage);
+
+// Renders one frame through the same layout, raster and compose stages as
+// the window, without creating one, and times each stage. pool may be NULL,
+// then glyphs are rasterized on the calling thread. Returns false if the
+// file, the font or the PNG could not be opened.
+b32 headless_render(const headless_options *options, thread_pool *pool, headless_report *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define HEADLESS_H
+#endif
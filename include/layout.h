@@ -0,0 +1,100 @@
+#ifndef LAYOUT_H
+
+#include "core.h"
+#include "font_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    s32 glyph_index;
+    f32 x;      // Pen position relative to the start of the line
+    u32 offset; // Byte offset of the glyph's codepoint within the line
+} layout_glyph;
+
+// Positioned glyph run of one line of text. Tabs and line terminators take
+// up space but have no glyph.
+typedef struct {
+    layout_glyph *glyphs;
+    u32 glyph_count;
+    u32 glyph_capacity;
+    f32 width;
+} layout_line;
+
+// Lays out length bytes of UTF-8 text, without a line terminator. Tab stops
+// are tab_width spaces apart. Reuses the line's glyph storage.
+void layout_line_build(layout_line *line, const font_metrics *metrics, u32 tab_width, const u8 *text, u32 length);
+void layout_line_free(layout_line *line);
+
+#define LAYOUT_CACHE_NONE 0xFFFFFFFFu
+
+typedef struct {
+    u64 key;        // Hash of the line's bytes and the layout settings
+    u64 settings;
+    u8 *text;       // Copy of the line's bytes, compared on a hash match
+    u32 length;
+    u32 text_capacity;
+    u32 generation; // Bumped every time the entry is reused
+    u32 bucket_next;
+    u32 lru_prev;   // Towards the most recently used entry
+    u32 lru_next;
+    b32 occupied;
+    layout_line line;
+} layout_cache_entry;
+
+// What a line number was last laid out as
+typedef struct {
+    u32 entry;
+    u32 generation;
+    u64 settings;
+} layout_line_ref;
+
+// Laid out lines, found by their bytes and settings, so identical
+// lines share one layout and a line that moves keeps it. Lines that have not
+// been edited since they were last drawn are found by line number without
+// hashing them again, within a window of line numbers that follows the
+// lines looked up. At most capacity lines are kept, least recently used ones
+// are reused first.
+typedef struct {
+    layout_cache_entry *entries;
+    u32 capacity;
+    u32 count;
+    u32 *buckets;
+    u32 bucket_mask;
+    u32 lru_head;
+    u32 lru_tail;
+
+    layout_line_ref *lines; // Lines line_base to line_base + line_capacity
+    u64 line_base;
+    u32 line_capacity;
+
+    u64 hits;      // Found by content hash
+    u64 line_hits; // Found by line number
+    u64 misses;
+    u64 evictions;
+} layout_cache;
+
+void layout_cache_init(layout_cache *cache, u32 capacity);
+void layout_cache_free(layout_cache *cache);
+void layout_cache_clear(layout_cache *cache);
+
+// Returns the layout of the given line, laying it out if neither the line
+// number nor its contents are cached. The returned line is valid until the
+// next call to layout_cache_get.
+const layout_line *layout_cache_get(layout_cache *cache, const font_metrics *metrics, u32 tab_width,
+                                    u64 line_number, const u8 *text, u32 length);
+
+// Every edit must be reported here before the next layout_cache_get: lines
+// [first_line, first_line + removed_lines) were replaced by inserted_lines
+// new lines. Changing text within a single line is one line removed and one
+// inserted. Only the replaced lines are looked up again; the lines after them
+// are renumbered.
+void layout_cache_edit(layout_cache *cache, u64 first_line, u64 removed_lines, u64 inserted_lines);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define LAYOUT_H
+#endif
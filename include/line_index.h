@@ -0,0 +1,72 @@
+#ifndef LINE_INDEX_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Every LINE_INDEX_SAMPLE_LINES-th line start is recorded, as an offset from
+// the start of its block of LINE_INDEX_BLOCK_SAMPLES samples. Only blocks
+// store absolute offsets. Lines between samples are found by scanning from
+// the sample before them.
+#define LINE_INDEX_SAMPLE_LINES 64
+#define LINE_INDEX_BLOCK_SAMPLES 64
+
+// Marks a sample more than 4 GiB past its block start, whose offset is kept
+// in the overflow table instead.
+#define LINE_INDEX_OVERFLOW 0xFFFFFFFFu
+
+typedef struct {
+    u64 sample;
+    u64 offset;
+} line_index_overflow;
+
+// Line start index of a text, built by scanning it front to back with the
+// vector kernel selected by raster_simd_set_level. It takes about 4 bytes per
+// LINE_INDEX_SAMPLE_LINES lines, which stays under 1% of the text as long as
+// lines average 16 bytes or more.
+typedef struct {
+    u64 *blocks;
+    u32 *samples;
+    u64 block_capacity;
+    u64 sample_capacity;
+    u64 sample_count;
+
+    line_index_overflow *overflow; // Ordered by sample
+    u64 overflow_count;
+    u64 overflow_capacity;
+
+    u64 line_breaks; // Found so far
+    u64 scanned;     // Bytes indexed so far
+} line_index;
+
+void line_index_init(line_index *index);
+void line_index_free(line_index *index);
+
+// Indexes the next length bytes of the text. data points at the first byte
+// after those indexed so far.
+void line_index_append(line_index *index, const u8 *data, u64 length);
+
+u64 line_index_line_count(const line_index *index);
+
+// Both take the indexed text. Lines past the last one start at the end of
+// the indexed bytes.
+u64 line_index_line_start(const line_index *index, const u8 *text, u64 line);
+u64 line_index_line_of(const line_index *index, const u8 *text, u64 offset);
+
+// Bytes allocated for the index
+u64 line_index_memory(const line_index *index);
+
+u64 line_index_count_line_breaks(const u8 *data, u64 length);
+
+// Offset just past the count-th line break, or length if there are fewer.
+// count must be at least 1.
+u64 line_index_find_line_break(const u8 *data, u64 length, u64 count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define LINE_INDEX_H
+#endif
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+
+#include "core.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hints for how the mapping will be accessed
+#define MAPPED_FILE_POPULATE   (1 << 0) // Prefault every page when mapping (MAP_POPULATE)
+#define MAPPED_FILE_RANDOM     (1 << 1) // Disable readahead, for scattered table lookups
+#define MAPPED_FILE_SEQUENTIAL (1 << 2) // Aggressive readahead, pages can be dropped after use
+#define MAPPED_FILE_WILLNEED   (1 << 3) // Start reading the whole file in the background
+
+typedef struct {
+    const u8 *data;
+    size_t size;
+    b32 mapped; // False when the platform has no mmap and data is a heap copy
+} mapped_file;
+
+// Maps the file read-only. Returns false if the file could not be opened or
+// mapped. An empty file maps successfully with data == NULL.
+b32 mapped_file_open(mapped_file *file, const char *path, u32 flags);
+void mapped_file_close(mapped_file *file);
+
+// Applies MAPPED_FILE_RANDOM, _SEQUENTIAL or _WILLNEED to part of the mapping
+void mapped_file_advise(const mapped_file *file, size_t offset, size_t size, u32 flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define MAPPED_FILE_H
+#endif
@@ -0,0 +1,160 @@
+#ifndef PIECE_TABLE_H
+
+#include "core.h"
+#include "mapped_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIECE_TABLE_NONE 0xFFFFFFFFu
+
+// Line break count of pieces of the original file that have not been counted
+// yet, and of every subtree holding one
+#define PIECE_LINE_BREAKS_UNKNOWN UINT64_MAX
+
+// The original file is split into pieces of at most this many bytes, so
+// splitting a piece only ever recounts the line breaks of a small range.
+#define PIECE_TABLE_MAX_PIECE_LENGTH (64 * 1024)
+
+// Inserted text is appended to blocks of at least this size. Blocks are
+// never moved or freed before the table, so pieces can point into them.
+#define PIECE_TABLE_ADD_BLOCK_SIZE (64 * 1024)
+
+// Batches with fewer edits than pieces / PIECE_TABLE_BATCH_RATIO are applied
+// one edit at a time, as rebuilding the tree would cost more
+#define PIECE_TABLE_BATCH_RATIO 16
+
+// A run of document text, in either the original file or an add block
+typedef struct {
+    const u8 *data;
+    u64 length;
+    u64 line_breaks; // PIECE_LINE_BREAKS_UNKNOWN until counted
+} piece;
+
+// Treap node, ordered by document position and heap ordered by priority.
+// subtree_* include the node's own piece.
+typedef struct {
+    piece piece;
+    u64 subtree_length;
+    u64 subtree_line_breaks;
+    u32 left;
+    u32 right;
+    u32 priority;
+} piece_node;
+
+typedef struct {
+    u8 *data;
+    u64 length;
+    u64 capacity;
+} piece_add_block;
+
+// Document text as a sequence of pieces. Edits never copy or modify the
+// original file; inserted text goes to append-only add blocks. Byte and line
+// break counts are cached in every subtree, so converting between offsets and
+// lines takes O(log pieces).
+//
+// The line breaks of the original file are unknown until a line lookup needs
+// them or piece_table_count_lines fills them in, so opening a file does not
+// read it.
+//
+// Lines are separated by '\n'. A document with n line breaks has n + 1
+// lines, the last of which may be empty.
+typedef struct {
+    mapped_file file;
+
+    piece_node *nodes;
+    u32 node_capacity;
+    u32 node_count; // Nodes handed out so far, freed ones included
+    u32 free_node;  // Freed nodes are chained through left
+    u32 root;
+    u32 random_state;
+
+    piece_add_block *add_blocks;
+    u32 add_block_count;
+    u32 add_block_capacity;
+
+    u32 piece_count;
+} piece_table;
+
+// Text that already belongs to the table, in the original file or an add
+// block
+typedef struct {
+    const u8 *data;
+    u64 length;
+} piece_span;
+
+// One replacement of a batch: length bytes at offset, in the document as it
+// was before the batch, become the text of the spans
+typedef struct {
+    u64 offset;
+    u64 length;
+    const piece_span *spans;
+    u32 span_count;
+} piece_edit;
+
+// Called with each run of text a batch removes, in document order
+typedef void (*piece_erased_fn)(u64 edit, const u8 *data, u64 length, void *arg);
+
+// Maps the file and takes it as the original text, without reading it.
+// Returns false if the file could not be mapped.
+b32 piece_table_open(piece_table *table, const char *path);
+
+// Starts a document with a copy of length bytes of text
+void piece_table_init(piece_table *table, const u8 *text, u64 length);
+void piece_table_free(piece_table *table);
+
+u64 piece_table_length(const piece_table *table);
+
+// Counts the line breaks of the first piece whose count is unknown. Returns
+// false once every piece is counted.
+b32 piece_table_count_lines(piece_table *table);
+
+// Line lookups count whatever pieces of the original file they need first.
+// The line count needs all of them.
+u64 piece_table_line_count(piece_table *table);
+
+// Offsets past the end of the document are clamped to it. Insert returns
+// where the copy of the text is kept, which stays valid until the table is
+// freed.
+const u8 *piece_table_insert(piece_table *table, u64 offset, const u8 *text, u64 length);
+void piece_table_erase(piece_table *table, u64 offset, u64 length);
+
+// Inserts text that already belongs to the table, in the original file or an
+// add block, without copying it. Used to put erased text back.
+void piece_table_insert_shared(piece_table *table, u64 offset, const u8 *data, u64 length);
+
+// Copies text to an add block without inserting it, for piece_table_apply
+const u8 *piece_table_add_text(piece_table *table, const u8 *text, u64 length);
+
+// Applies edits sorted by offset that do not overlap; several may insert at
+// the same offset, in order. The pieces between the first and the last edit
+// are walked once and rebuilt into a tree in linear time, rather than
+// splitting and merging the tree for every edit. fn may be NULL.
+void piece_table_apply(piece_table *table, const piece_edit *edits, u64 count, piece_erased_fn fn, void *arg);
+
+// Offset of the first byte of a line. Lines past the last one start at the
+// end of the document.
+u64 piece_table_line_start(piece_table *table, u64 line);
+
+// Line that contains the byte at offset
+u64 piece_table_line_of(piece_table *table, u64 offset);
+
+// Copies up to length bytes starting at offset and returns how many were
+// copied.
+u64 piece_table_read(const piece_table *table, u64 offset, u64 length, u8 *out);
+
+// Called with every run of text of a range, in document order. Returning
+// false stops the walk.
+typedef b32 (*piece_table_visit_fn)(const u8 *data, u64 length, void *arg);
+
+void piece_table_visit(const piece_table *table, u64 offset, u64 length, piece_table_visit_fn fn, void *arg);
+
+u64 piece_count_line_breaks(const u8 *data, u64 length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PIECE_TABLE_H
+#endif
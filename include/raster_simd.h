@@ -0,0 +1,44 @@
+#ifndef RASTER_SIMD_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vectorized finish step of stb_truetype's v2 rasterizer. For each pixel of a
+// scanline it adds the running sum of the edge deltas to the coverage,
+// converts the result to an 8-bit value and clears both float buffers for the
+// next scanline. stb_impl.c routes STBTT_accumulate_scanline here.
+
+typedef enum {
+    RASTER_SIMD_SCALAR,
+    RASTER_SIMD_SSE2,
+    RASTER_SIMD_AVX2,
+} raster_simd_level;
+
+// Best level the CPU supports, detected at runtime
+raster_simd_level raster_simd_detect(void);
+
+// Selects the kernel used by raster_accumulate_scanline and the other SIMD
+// dispatchers. Requests for a level the CPU does not support fall back to the
+// best one it does. Safe to call from any thread; the level is detected once.
+void raster_simd_set_level(raster_simd_level level);
+raster_simd_level raster_simd_get_level(void);
+
+// In bit-exact mode the running sum is accumulated in the same order as the
+// scalar loop, so output is byte-for-byte identical to stb_truetype's. The
+// default computes the sum with a parallel prefix, which can round the last
+// bit of a float differently and change a pixel by at most one step.
+void raster_simd_set_bit_exact(b32 bit_exact);
+
+// coverage holds width floats and deltas width + 1; both are zeroed on return
+void raster_accumulate_scanline(u8 *pixels, f32 *coverage, f32 *deltas, s32 width);
+void raster_accumulate_scanline_scalar(u8 *pixels, f32 *coverage, f32 *deltas, s32 width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define RASTER_SIMD_H
+#endif
@@ -0,0 +1,130 @@
+#ifndef REGEX_DFA_H
+
+#include "core.h"
+#include "find.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memory each of the two state caches of a regex may use by default
+#define REGEX_DEFAULT_CACHE_SIZE (2 * 1024 * 1024)
+
+// Patterns that compile to more NFA states than this are rejected
+#define REGEX_MAX_STATES 200000
+
+// Largest count allowed in {m,n}
+#define REGEX_MAX_REPEAT 1000
+
+// Case-insensitive matching, for ASCII letters only
+#define REGEX_IGNORE_CASE (1 << 0)
+
+typedef enum {
+    REGEX_STATE_RANGE,      // Consumes one byte in [low, high]
+    REGEX_STATE_SPLIT,      // Goes to out, or with lower priority to out1
+    REGEX_STATE_EMPTY,
+    REGEX_STATE_LINE_START, // Previous byte is a line break or there is none
+    REGEX_STATE_LINE_END,   // Next byte is a line break or there is none
+    REGEX_STATE_MATCH,
+} regex_state_kind;
+
+typedef struct {
+    u8 kind;
+    u8 low;
+    u8 high;
+    u32 out;
+    u32 out1;
+} regex_state;
+
+typedef struct {
+    regex_state *states;
+    u32 count;
+    u32 capacity;
+    u32 start;
+} regex_nfa;
+
+// DFA built one transition at a time while searching. A DFA state is an
+// ordered set of NFA states, with the ordering giving thread priority, plus
+// whether the previous byte ended a line. Once the cache outgrows its budget
+// it is cleared and rebuilt from the state being searched from, so memory
+// stays bounded whatever the pattern; in the worst case each byte costs one
+// step of the NFA, never more.
+typedef struct {
+    b32 leftmost_first; // Matches cut off lower priority threads
+
+    // Bytes that no NFA state tells apart share a class and a column
+    u8 classes[256];
+    u8 class_bytes[257]; // First byte of each class
+    u32 class_count;
+    u32 stride;          // class_count plus a column for the end of input
+
+    u32 *transitions;    // stride entries per state
+    u32 *keys;           // Flags followed by the NFA states of each state
+    u32 *key_offsets;
+    u32 *key_lengths;
+    u8 *flags;
+    u32 state_count;
+    u32 state_capacity;
+    u32 key_count;
+    u32 key_capacity;
+
+    u32 *buckets;        // Open addressing over state indices
+    u32 bucket_count;
+
+    u32 start[2];        // Indexed by whether the search starts a line
+
+    u64 budget;
+    u64 clears;          // Times the cache filled up
+
+    // Scratch for computing transitions: two sparse sets of NFA states, a
+    // stack for following empty transitions and two keys
+    u32 *sparse[2];
+    u32 *dense[2];
+    u32 *stack;
+    u32 *scratch[2];
+} regex_dfa;
+
+// Compiled pattern. Supported syntax: literals, ., [...] and [^...] with
+// ranges, the escapes \d \w \s \D \W \S \n \t \r \f \v \xHH, ^ and $ at line
+// boundaries, ( ), (?: ), | and the quantifiers * + ? {m} {m,} {m,n}, each
+// optionally lazy with a trailing ?. Groups do not capture. Patterns and
+// text are UTF-8, so . and classes match whole codepoints.
+//
+// Matches are leftmost-first, as in Perl and RE2. A forward DFA with the
+// pattern's priorities finds where the match ends, then a DFA of the
+// reversed pattern scans back from there to where it starts.
+typedef struct {
+    regex_nfa forward;
+    regex_nfa reverse;
+    regex_dfa forward_dfa;
+    regex_dfa reverse_dfa;
+
+    // Set when compiling fails
+    const char *error;
+    u64 error_offset;
+} regex;
+
+// Returns false if the pattern is malformed or too large, with error and
+// error_offset describing why.
+b32 regex_compile(regex *re, const u8 *pattern, u64 length, u32 flags, u64 cache_size);
+void regex_free(regex *re);
+
+// Called with each match as soon as it is found. Returning false stops the
+// search.
+typedef b32 (*regex_match_fn)(u64 start, u64 end, void *arg);
+
+// Reports the matches within [offset, offset + length) in order. The text is
+// streamed chunk by chunk, so matches come while the rest is unsearched. An
+// empty match right after the previous match is skipped. Searching changes
+// the caches of re, so one regex may be used from one thread at a time.
+void regex_search(regex *re, const find_source *source, u64 offset, u64 length, regex_match_fn fn, void *arg);
+
+// Finds the first match that starts at or after offset
+b32 regex_find_next(regex *re, const find_source *source, u64 offset, u64 *start, u64 *end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define REGEX_DFA_H
+#endif
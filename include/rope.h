@@ -0,0 +1,76 @@
+#ifndef ROPE_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Leaves hold up to this many bytes, branches up to ROPE_MAX_CHILDREN
+// children. Except for the root, nodes are kept at least half full.
+#define ROPE_CHUNK_SIZE 1024
+#define ROPE_MAX_CHILDREN 16
+
+typedef struct {
+    u64 bytes;
+    u64 line_breaks;
+    u64 codepoints; // Bytes that are not UTF-8 continuation bytes
+} rope_metrics;
+
+typedef struct rope_node rope_node;
+
+// Text in a B-tree of chunks, where every node caches the metrics of its
+// subtree. Nodes are reference counted and shared between snapshots; an edit
+// copies the nodes on its path that are shared and modifies the rest in
+// place.
+//
+// Lines are separated by '\n', as in the piece table.
+typedef struct {
+    rope_node *root;
+} rope;
+
+// Starts a rope with a copy of length bytes of text
+void rope_init(rope *rope, const u8 *text, u64 length);
+void rope_free(rope *rope);
+
+// Makes snapshot share the current text of source in O(1). Either can be
+// edited or freed independently afterwards, and read from another thread
+// while the other is edited.
+void rope_snapshot(rope *snapshot, const rope *source);
+
+rope_metrics rope_get_metrics(const rope *rope);
+u64 rope_length(const rope *rope);
+u64 rope_line_count(const rope *rope);
+
+// Metrics of the text before offset: its line is line_breaks, its codepoint
+// index codepoints.
+rope_metrics rope_metrics_before(const rope *rope, u64 offset);
+
+// Offsets past the end of the rope are clamped to it
+void rope_insert(rope *rope, u64 offset, const u8 *text, u64 length);
+void rope_erase(rope *rope, u64 offset, u64 length);
+
+// Offset of the first byte of a line. Lines past the last one start at the
+// end of the rope.
+u64 rope_line_start(const rope *rope, u64 line);
+u64 rope_line_of(const rope *rope, u64 offset);
+
+// Conversions between byte offsets and lines with a column in codepoints.
+// Columns past the end of a line are clamped to it.
+void rope_line_column(const rope *rope, u64 offset, u64 *line, u64 *column);
+u64 rope_offset_at(const rope *rope, u64 line, u64 column);
+
+u64 rope_read(const rope *rope, u64 offset, u64 length, u8 *out);
+
+// Called with every run of text of a range, in order, one chunk at a time.
+// Returning false stops the walk.
+typedef b32 (*rope_visit_fn)(const u8 *data, u64 length, void *arg);
+
+void rope_visit(const rope *rope, u64 offset, u64 length, rope_visit_fn fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ROPE_H
+#endif
@@ -0,0 +1,49 @@
+#ifndef SDF_H
+
+#include "core.h"
+
+#include "stb/stb_truetype.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Signed distance fields of glyph outlines, with the same parameters and
+// output encoding as stbtt_GetGlyphSDF. The outline is flattened into line
+// segments that are binned into a grid, so each pixel only measures the
+// segments near it. Inside/outside comes from one nonzero-winding sweep per
+// row instead of a ray cast per pixel.
+
+// Maximum distance between a curve and the segments it is flattened into, in
+// SDF pixels
+#define SDF_FLATNESS (1.0f / 64.0f)
+
+// Writes width * height distance values for the pixels starting at (x0, y0)
+// in the glyph's y-down bitmap space at the given scale. A pixel's value is
+// onedge_value + pixel_dist_scale * distance, clamped to 0..255, where the
+// distance is negative outside the glyph.
+void sdf_render_glyph(const stbtt_fontinfo *font, f32 scale, s32 glyph_index,
+                      u8 onedge_value, f32 pixel_dist_scale,
+                      s32 x0, s32 y0, s32 width, s32 height, u8 *output, s32 stride);
+
+// Drop-in replacement for stbtt_GetGlyphSDF. Returns NULL for empty glyphs;
+// the result is released with free().
+u8 *sdf_get_glyph(const stbtt_fontinfo *font, f32 scale, s32 glyph_index, s32 padding,
+                  u8 onedge_value, f32 pixel_dist_scale,
+                  s32 *width, s32 *height, s32 *x_offset, s32 *y_offset);
+
+// Resamples an SDF to coverage at scale destination pixels per SDF pixel,
+// with the SDF's top left corner at (x, y) in the destination. Coverage ramps
+// over one destination pixel around the edge and is combined with what is
+// already in the destination by taking the maximum, so the padding of
+// neighbouring glyphs can overlap.
+void sdf_draw(u8 *dest, s32 dest_width, s32 dest_height, s32 dest_stride, f32 x, f32 y, f32 scale,
+              const u8 *sdf, s32 width, s32 height, s32 stride,
+              u8 onedge_value, f32 pixel_dist_scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define SDF_H
+#endif
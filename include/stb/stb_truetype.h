@@ -487,6 +487,11 @@ int main(int arg, char **argv)
    #define STBTT_memcpy       memcpy
    #define STBTT_memset       memset
    #endif
+
+   // #define your own "STBTT_accumulate_scanline(pixels, scanline, scanline2, w)"
+   // to replace the per-scanline finish loop of the v2 rasterizer. It must
+   // produce the same bytes as the loop below and leave scanline[0..w) and
+   // scanline2[0..w] zeroed, which saves clearing them for every scanline.
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3310,6 +3315,10 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
 
    scanline2 = scanline + result->w;
 
+#ifdef STBTT_accumulate_scanline
+   STBTT_memset(scanline, 0, (result->w*2+1)*sizeof(scanline[0]));
+#endif
+
    y = off_y;
    e[n].y0 = (float) (off_y + result->h) + 1;
 
@@ -3319,8 +3328,10 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       float scan_y_bottom = y + 1.0f;
       stbtt__active_edge **step = &active;
 
+#ifndef STBTT_accumulate_scanline
       STBTT_memset(scanline , 0, result->w*sizeof(scanline[0]));
       STBTT_memset(scanline2, 0, (result->w+1)*sizeof(scanline[0]));
+#endif
 
       // update all active edges;
       // remove all active edges that terminate before the top of this scanline
@@ -3360,6 +3371,10 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       if (active)
          stbtt__fill_active_edges_new(scanline, scanline2+1, result->w, active, scan_y_top);
 
+#ifdef STBTT_accumulate_scanline
+      STBTT_accumulate_scanline(result->pixels + j*result->stride, scanline, scanline2, result->w);
+      STBTT__NOTUSED(i);
+#else
       {
          float sum = 0;
          for (i=0; i < result->w; ++i) {
@@ -3373,6 +3388,7 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
             result->pixels[j*result->stride + i] = (unsigned char) m;
          }
       }
+#endif
       // advance all the edges
       step = &active;
       while (*step) {
@@ -0,0 +1,107 @@
+#ifndef TEXT_VIEW_H
+
+#include "core.h"
+#include "damage.h"
+#include "font_metrics.h"
+#include "frame_stats.h"
+#include "glyph_cache.h"
+#include "layout.h"
+#include "thread_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Only the start of a long line can be on screen
+#define TEXT_VIEW_MAX_LINE_LENGTH 4096
+
+// Width of the cursor bar, in pixels
+#define TEXT_VIEW_CURSOR_WIDTH 2
+
+// Tab stops are this many spaces apart
+#define TEXT_VIEW_TAB_WIDTH 4
+
+// Sets text and length to a line of the document, without its line break.
+// Returns false past the last line.
+typedef b32 (*text_view_line_fn)(void *arg, u64 line, const u8 **text, u32 *length);
+
+// Lines of text drawn as 8-bit coverage into a framebuffer of their own.
+// Changes are recorded as damage at line granularity: an edited line
+// damages its row of the screen, the cursor only its own cell. Rendering
+// redraws nothing but the damage, and hands it on to whatever presents the
+// framebuffer. The cursor is not drawn into the coverage; whatever presents
+// the framebuffer draws it on top, in a colour of its own.
+typedef struct {
+    u8 *pixels; // width * height, rows are width bytes apart
+    s32 width;
+    s32 height;
+
+    const font_metrics *metrics;
+    glyph_cache *glyphs;
+    layout_cache *layouts;
+    thread_pool *pool;
+    b32 sdf_glyphs;
+
+    text_view_line_fn line_fn;
+    void *line_arg;
+
+    // Glyphs of the lines being drawn, kept between lines and frames
+    s32 *glyph_indices;
+    u32 *subpixel_phases;
+    u32 glyph_capacity;
+
+    u64 top_line;
+    f32 line_advance;
+    s32 ascent;
+
+    u64 cursor_line;
+    u32 cursor_column; // Byte offset within the line
+    s32 cursor_x;      // Left edge of the cursor's cell
+    b32 cursor_visible;
+
+    damage_region damage;
+    u64 pixels_drawn;  // Cleared and redrawn so far
+
+    frame_stats *stats; // Layout, raster and glyph misses are added here if set
+} text_view;
+
+// Starts with everything damaged. pool may be NULL.
+void text_view_init(text_view *view, s32 width, s32 height, const font_metrics *metrics, glyph_cache *glyphs,
+                    layout_cache *layouts, thread_pool *pool, b32 sdf_glyphs, text_view_line_fn line_fn, void *arg);
+void text_view_free(text_view *view);
+
+// Damages the rows of count lines starting at first_line, counted from the
+// start of the document. Lines off screen are ignored.
+void text_view_damage_lines(text_view *view, u64 first_line, u64 count);
+
+void text_view_scroll(text_view *view, u64 top_line);
+
+// Damages the cells the cursor leaves and enters, or blinks in
+void text_view_set_cursor(text_view *view, u64 line, u32 column, b32 visible);
+
+// Sets rect to the cursor's cell. Returns false while the cursor is hidden
+// or off screen.
+b32 text_view_cursor_rect(const text_view *view, damage_rect *rect);
+
+// Lays out a line of the document, clamped to TEXT_VIEW_MAX_LINE_LENGTH.
+// Returns NULL past the last line.
+const layout_line *text_view_layout_line(text_view *view, u64 line);
+
+// Appends the glyphs of line that can reach left of x1 to the view's glyph
+// arrays, after the count already there. Returns the new count.
+u32 text_view_collect_glyphs(text_view *view, const layout_line *line, s32 x1, u32 count);
+
+// Rasterizes the first count collected glyphs the cache is missing, on the
+// pool if the view has one
+void text_view_warm_glyphs(text_view *view, u32 count);
+
+// Redraws the damaged parts of the framebuffer. The damage is added to
+// presented, if it is not NULL, for presenting, and cleared.
+void text_view_render(text_view *view, damage_region *presented);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define TEXT_VIEW_H
+#endif
@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+
+#include "core.h"
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*thread_pool_fn)(void *arg);
+
+// Called on a worker when a background job has made progress, so whatever
+// shows it can be woken
+typedef void (*thread_pool_notify_fn)(void *arg);
+
+// Jobs submitted with the same group can be waited on together, independent
+// of other work running on the pool.
+typedef struct {
+    u32 pending;
+} thread_pool_group;
+
+typedef struct {
+    thread_pool_fn fn;
+    void *arg;
+    thread_pool_group *group;
+} thread_pool_job;
+
+typedef struct {
+    pthread_t *threads;
+    u32 thread_count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t job_available;
+    pthread_cond_t job_finished;
+
+    // Ring buffer of queued jobs
+    thread_pool_job *jobs;
+    u32 job_capacity;
+    u32 job_head;
+    u32 job_count;
+
+    u32 running;
+    b32 stopping;
+} thread_pool;
+
+u32 thread_pool_default_thread_count(void);
+
+void thread_pool_init(thread_pool *pool, u32 thread_count);
+// Finishes all queued jobs, then joins the worker threads
+void thread_pool_free(thread_pool *pool);
+
+void thread_pool_submit(thread_pool *pool, thread_pool_group *group, thread_pool_fn fn, void *arg);
+
+// Blocks until every job of the group has finished. With a NULL group, waits
+// until the pool is idle.
+void thread_pool_wait(thread_pool *pool, thread_pool_group *group);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define THREAD_POOL_H
+#endif
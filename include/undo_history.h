@@ -0,0 +1,131 @@
+#ifndef UNDO_HISTORY_H
+
+#include "core.h"
+#include "piece_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNDO_HISTORY_NONE 0xFFFFFFFFu
+
+// Deltas are packed into blocks of at least this size, so recording an edit
+// almost never allocates.
+#define UNDO_HISTORY_BLOCK_SIZE (64 * 1024)
+
+#define UNDO_HISTORY_DEFAULT_BUDGET (128 * 1024 * 1024)
+
+// Transactions with at least this many deltas, in order of offset, are undone
+// and redone as one batch
+#define UNDO_HISTORY_BATCH_THRESHOLD 16
+
+// Text that is still owned by the piece table. The table never modifies or
+// frees its original file or add blocks, so erased text does not have to be
+// copied to be put back.
+typedef piece_span undo_span;
+
+// One replacement of a batch: length bytes at offset, in the document as it
+// was before the batch, become text
+typedef struct {
+    u64 offset;
+    u64 length;
+    const u8 *text;
+    u64 text_length;
+} undo_edit;
+
+// Arena block, holding a run of variable sized delta records
+typedef struct undo_block undo_block;
+
+// An edit undone and redone as one step. Its deltas are stored back to back,
+// from the first to the last record.
+typedef struct {
+    undo_block *first_block;
+    u32 first_record;
+    undo_block *last_block;
+    u32 last_record;
+    u64 delta_count;
+} undo_transaction;
+
+typedef enum {
+    UNDO_HISTORY_RUN_NONE,
+    UNDO_HISTORY_RUN_INSERT,
+    UNDO_HISTORY_RUN_ERASE,
+} undo_history_run;
+
+// Undo and redo for a piece table. Edits are made through the history, which
+// records each as a delta: the offset, the erased text and the inserted text,
+// both as spans of the table's own buffers. A transaction costs a few dozen
+// bytes per delta and no allocations of its own, so a replace-all over a
+// million matches is a single cheap step.
+//
+// Consecutive typing or erasing is coalesced into one transaction until
+// undo_history_break is called. Once the deltas take more than the budget,
+// the oldest transactions are dropped.
+typedef struct {
+    piece_table *table;
+    u64 budget;
+    u64 memory; // Bytes held by blocks
+
+    undo_block *first_block;
+    undo_block *last_block;
+
+    // transactions[first, applied) can be undone, [applied, count) redone
+    undo_transaction *transactions;
+    u32 transaction_first;
+    u32 transaction_count;
+    u32 transaction_capacity;
+    u32 applied;
+
+    u32 depth;          // Nesting of undo_history_begin
+    b32 group_started;  // The outermost group has recorded a transaction
+    undo_history_run run;
+
+    // Erased spans are gathered here before their delta is written
+    undo_span *scratch;
+    u32 scratch_count;
+    u32 scratch_capacity;
+
+    // Batches are staged here
+    piece_edit *edits;
+    u64 edit_capacity;
+    undo_span *edit_spans;
+    u64 *erased_first; // Index of the first erased span of each edit
+    u64 *erased_counts;
+} undo_history;
+
+// budget is in bytes; 0 means UNDO_HISTORY_DEFAULT_BUDGET
+void undo_history_init(undo_history *history, piece_table *table, u64 budget);
+void undo_history_free(undo_history *history);
+
+// Edits between begin and end, which nest, become one transaction
+void undo_history_begin(undo_history *history);
+void undo_history_end(undo_history *history);
+
+// Ends the current run of typing, for example when the cursor moves
+void undo_history_break(undo_history *history);
+
+void undo_history_insert(undo_history *history, u64 offset, const u8 *text, u64 length);
+void undo_history_erase(undo_history *history, u64 offset, u64 length);
+
+// Applies edits sorted by offset that do not overlap, such as one per cursor,
+// in a single pass over the table and records them as one transaction.
+// positions, sorted as well, are the cursors and selection ends to move along:
+// one before an edit stays, one after it shifts, and one inside or at either
+// end of the replaced range moves to the end of the new text.
+void undo_history_apply(undo_history *history, const undo_edit *edits, u64 count, u64 *positions,
+                        u64 position_count);
+
+// Return false when there is nothing to undo or redo. cursor, which may be
+// NULL, is set to the end of the text the step put back.
+b32 undo_history_undo(undo_history *history, u64 *cursor);
+b32 undo_history_redo(undo_history *history, u64 *cursor);
+
+u32 undo_history_undo_count(const undo_history *history);
+u32 undo_history_redo_count(const undo_history *history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define UNDO_HISTORY_H
+#endif
@@ -0,0 +1,46 @@
+#ifndef UTF8_H
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UTF8_REPLACEMENT_CHARACTER 0xFFFD
+
+// Length of the longest prefix of data that is well-formed UTF-8, so length
+// itself when all of it is. A sequence cut off by the end of data counts as
+// ill-formed. With AVX2 this checks 32 bytes per step without branching on
+// the content, after the lookup method of Keiser and Lemire; runs of ASCII
+// are skipped 16 or 32 bytes at a time with every kernel but the scalar one.
+u64 utf8_validate(const u8 *data, u64 length);
+
+// Bytes that are not continuation bytes, which is the number of codepoints
+// when data is well-formed.
+u64 utf8_count_codepoints(const u8 *data, u64 length);
+
+// Length of the run of ASCII bytes at the start of data
+u64 utf8_ascii_length(const u8 *data, u64 length);
+
+// Slow path of utf8_decode for everything but ASCII
+u32 utf8_decode_slow(const u8 *text, u64 length, u64 *offset);
+
+// Decodes the codepoint at *offset and moves *offset past it. Anything that
+// is not well-formed UTF-8 consumes a single byte and decodes to U+FFFD.
+static inline u32
+utf8_decode(const u8 *text, u64 length, u64 *offset)
+{
+    u8 lead = text[*offset];
+    if (lead < 0x80) {
+        ++*offset;
+        return lead;
+    }
+    return utf8_decode_slow(text, length, offset);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define UTF8_H
+#endif
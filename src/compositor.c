@@ -0,0 +1,265 @@
+#include "compositor.h"
+#include "log.h"
+#include "raster_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define COMPOSITOR_X86
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define COMPOSITOR_HAS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+void
+compositor_frame_init(compositor_frame *frame, s32 width, s32 height)
+{
+    frame->pixels = (u32 *)calloc((size_t)width * (size_t)height, sizeof(u32));
+    if (!frame->pixels) LOG_FATAL("Could not allocate a %dx%d frame.", width, height);
+    frame->width = width;
+    frame->height = height;
+}
+
+void
+compositor_frame_free(compositor_frame *frame)
+{
+    free(frame->pixels);
+    memset(frame, 0, sizeof(*frame));
+}
+
+// x / 255 rounded to nearest, exact for x up to 255 * 255
+static inline u32
+compositor_div255(u32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline u32
+compositor_lerp(u32 coverage, u32 fg, u32 bg)
+{
+    if (coverage == 0) return bg;
+    if (coverage == 255) return fg;
+    u32 result = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 f = (fg >> shift) & 0xFF;
+        u32 b = (bg >> shift) & 0xFF;
+        result |= compositor_div255(coverage * f + (255 - coverage) * b) << shift;
+    }
+    return result;
+}
+
+// Each row kernel blends count pixels of dest towards fg by coverage, from
+// bg, or from what dest holds when over is set
+
+static void
+compositor_fill_row_scalar(u32 *dest, u32 count, u32 color)
+{
+    for (u32 i = 0; i < count; ++i) dest[i] = color;
+}
+
+static void
+compositor_blend_row_scalar(u32 *dest, const u8 *coverage, u32 count, u32 fg, u32 bg, b32 over)
+{
+    for (u32 i = 0; i < count; ++i) dest[i] = compositor_lerp(coverage[i], fg, over ? dest[i] : bg);
+}
+
+#if defined(COMPOSITOR_X86)
+static void
+compositor_fill_row_sse2(u32 *dest, u32 count, u32 color)
+{
+    __m128i value = _mm_set1_epi32((s32)color);
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i *)(dest + i), value);
+    compositor_fill_row_scalar(dest + i, count - i, color);
+}
+
+// Blends four pixels whose coverage is repeated over their four channels
+static inline __m128i
+compositor_blend4_sse2(__m128i coverage, __m128i fg, __m128i bg)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i max = _mm_set1_epi16(255);
+    __m128i half = _mm_set1_epi16(128);
+    __m128i fg16 = _mm_unpacklo_epi8(fg, zero);
+
+    __m128i a_lo = _mm_unpacklo_epi8(coverage, zero);
+    __m128i a_hi = _mm_unpackhi_epi8(coverage, zero);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(a_lo, fg16),
+                               _mm_mullo_epi16(_mm_sub_epi16(max, a_lo), _mm_unpacklo_epi8(bg, zero)));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(a_hi, fg16),
+                               _mm_mullo_epi16(_mm_sub_epi16(max, a_hi), _mm_unpackhi_epi8(bg, zero)));
+    lo = _mm_add_epi16(lo, half);
+    hi = _mm_add_epi16(hi, half);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+static void
+compositor_blend_row_sse2(u32 *dest, const u8 *coverage, u32 count, u32 fg, u32 bg, b32 over)
+{
+    __m128i fg4 = _mm_set1_epi32((s32)fg);
+    __m128i bg4 = _mm_set1_epi32((s32)bg);
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        u32 quad;
+        memcpy(&quad, coverage + i, 4);
+        // Runs of background and solid glyph stems are common
+        if (quad == 0) {
+            if (!over) _mm_storeu_si128((__m128i *)(dest + i), bg4);
+            continue;
+        }
+        if (quad == 0xFFFFFFFFu) {
+            _mm_storeu_si128((__m128i *)(dest + i), fg4);
+            continue;
+        }
+        __m128i a = _mm_cvtsi32_si128((s32)quad);
+        a = _mm_unpacklo_epi8(a, a);
+        a = _mm_unpacklo_epi16(a, a);
+        __m128i from = over ? _mm_loadu_si128((const __m128i *)(dest + i)) : bg4;
+        _mm_storeu_si128((__m128i *)(dest + i), compositor_blend4_sse2(a, fg4, from));
+    }
+    compositor_blend_row_scalar(dest + i, coverage + i, count - i, fg, bg, over);
+}
+#endif
+
+#if defined(COMPOSITOR_HAS_AVX2)
+__attribute__((target("avx2")))
+static void
+compositor_fill_row_avx2(u32 *dest, u32 count, u32 color)
+{
+    __m256i value = _mm256_set1_epi32((s32)color);
+    u32 i = 0;
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i *)(dest + i), value);
+    compositor_fill_row_scalar(dest + i, count - i, color);
+}
+
+__attribute__((target("avx2")))
+static void
+compositor_blend_row_avx2(u32 *dest, const u8 *coverage, u32 count, u32 fg, u32 bg, b32 over)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i max = _mm256_set1_epi16(255);
+    __m256i half = _mm256_set1_epi16(128);
+    __m256i fg8 = _mm256_set1_epi32((s32)fg);
+    __m256i bg8 = _mm256_set1_epi32((s32)bg);
+    __m256i fg16 = _mm256_unpacklo_epi8(fg8, zero);
+    // Spreads each of eight coverage bytes over a pixel's four channels
+    __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+    u32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        u64 octet;
+        memcpy(&octet, coverage + i, 8);
+        if (octet == 0) {
+            if (!over) _mm256_storeu_si256((__m256i *)(dest + i), bg8);
+            continue;
+        }
+        if (octet == UINT64_MAX) {
+            _mm256_storeu_si256((__m256i *)(dest + i), fg8);
+            continue;
+        }
+        __m256i a = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_cvtsi64_si128((long long)octet)), spread);
+        __m256i from = over ? _mm256_loadu_si256((const __m256i *)(dest + i)) : bg8;
+
+        // Unpacking and packing stay within 128-bit lanes, so the pixels
+        // come back in order
+        __m256i a_lo = _mm256_unpacklo_epi8(a, zero);
+        __m256i a_hi = _mm256_unpackhi_epi8(a, zero);
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(a_lo, fg16),
+                                      _mm256_mullo_epi16(_mm256_sub_epi16(max, a_lo), _mm256_unpacklo_epi8(from, zero)));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(a_hi, fg16),
+                                      _mm256_mullo_epi16(_mm256_sub_epi16(max, a_hi), _mm256_unpackhi_epi8(from, zero)));
+        lo = _mm256_add_epi16(lo, half);
+        hi = _mm256_add_epi16(hi, half);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_packus_epi16(lo, hi));
+    }
+    compositor_blend_row_scalar(dest + i, coverage + i, count - i, fg, bg, over);
+}
+#endif
+
+static void
+compositor_fill_row(u32 *dest, u32 count, u32 color)
+{
+    switch (raster_simd_get_level()) {
+#if defined(COMPOSITOR_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        compositor_fill_row_avx2(dest, count, color);
+        break;
+#endif
+#if defined(COMPOSITOR_X86)
+    case RASTER_SIMD_SSE2:
+        compositor_fill_row_sse2(dest, count, color);
+        break;
+#endif
+    default:
+        compositor_fill_row_scalar(dest, count, color);
+        break;
+    }
+}
+
+static void
+compositor_blend_row(u32 *dest, const u8 *coverage, u32 count, u32 fg, u32 bg, b32 over)
+{
+    switch (raster_simd_get_level()) {
+#if defined(COMPOSITOR_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        compositor_blend_row_avx2(dest, coverage, count, fg, bg, over);
+        break;
+#endif
+#if defined(COMPOSITOR_X86)
+    case RASTER_SIMD_SSE2:
+        compositor_blend_row_sse2(dest, coverage, count, fg, bg, over);
+        break;
+#endif
+    default:
+        compositor_blend_row_scalar(dest, coverage, count, fg, bg, over);
+        break;
+    }
+}
+
+void
+compositor_fill(compositor_frame *frame, s32 x0, s32 y0, s32 x1, s32 y1, u32 color)
+{
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > frame->width) x1 = frame->width;
+    if (y1 > frame->height) y1 = frame->height;
+    if (x0 >= x1) return;
+    for (s32 y = y0; y < y1; ++y) compositor_fill_row(frame->pixels + (size_t)y * frame->width + x0, x1 - x0, color);
+}
+
+void
+compositor_blend_mask(compositor_frame *frame, s32 x, s32 y, const u8 *mask, s32 width, s32 height, s32 stride,
+                      u32 color)
+{
+    s32 col_start = x < 0 ? -x : 0;
+    s32 row_start = y < 0 ? -y : 0;
+    s32 col_end = frame->width - x < width ? frame->width - x : width;
+    s32 row_end = frame->height - y < height ? frame->height - y : height;
+    if (col_start >= col_end) return;
+    for (s32 row = row_start; row < row_end; ++row) {
+        compositor_blend_row(frame->pixels + (size_t)(y + row) * frame->width + x + col_start,
+                             mask + (size_t)row * stride + col_start, col_end - col_start, color, 0, true);
+    }
+}
+
+void
+compositor_compose(compositor_frame *frame, const u8 *coverage, s32 stride, damage_rect rect, u32 fg, u32 bg)
+{
+    if (rect.x0 < 0) rect.x0 = 0;
+    if (rect.y0 < 0) rect.y0 = 0;
+    if (rect.x1 > frame->width) rect.x1 = frame->width;
+    if (rect.y1 > frame->height) rect.y1 = frame->height;
+    if (rect.x0 >= rect.x1) return;
+    for (s32 y = rect.y0; y < rect.y1; ++y) {
+        compositor_blend_row(frame->pixels + (size_t)y * frame->width + rect.x0,
+                             coverage + (size_t)y * stride + rect.x0, rect.x1 - rect.x0, fg, bg, false);
+    }
+}
@@ -0,0 +1,108 @@
+#include "damage.h"
+
+#include <string.h>
+
+void
+damage_init(damage_region *region, s32 width, s32 height)
+{
+    memset(region, 0, sizeof(*region));
+    region->width = width;
+    region->height = height;
+}
+
+static u64
+damage_rect_area(damage_rect rect)
+{
+    return (u64)(rect.x1 - rect.x0) * (u64)(rect.y1 - rect.y0);
+}
+
+static damage_rect
+damage_rect_union(damage_rect a, damage_rect b)
+{
+    return (damage_rect){
+        a.x0 < b.x0 ? a.x0 : b.x0,
+        a.y0 < b.y0 ? a.y0 : b.y0,
+        a.x1 > b.x1 ? a.x1 : b.x1,
+        a.y1 > b.y1 ? a.y1 : b.y1,
+    };
+}
+
+void
+damage_add(damage_region *region, s32 x0, s32 y0, s32 x1, s32 y1)
+{
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > region->width) x1 = region->width;
+    if (y1 > region->height) y1 = region->height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // Takes in every rectangle that shares rows with it, which may make it
+    // reach more
+    damage_rect rect = {x0, y0, x1, y1};
+    for (u32 i = 0; i < region->count;) {
+        damage_rect other = region->rects[i];
+        if (other.y0 < rect.y1 && rect.y0 < other.y1) {
+            rect = damage_rect_union(rect, other);
+            memmove(&region->rects[i], &region->rects[i + 1], (region->count - i - 1) * sizeof(damage_rect));
+            --region->count;
+            i = 0;
+            continue;
+        }
+        ++i;
+    }
+
+    u32 position = 0;
+    while (position < region->count && region->rects[position].y0 < rect.y0) ++position;
+    memmove(&region->rects[position + 1], &region->rects[position],
+            (region->count - position) * sizeof(damage_rect));
+    region->rects[position] = rect;
+    ++region->count;
+    if (region->count <= DAMAGE_MAX_RECTS) return;
+
+    // Merges the neighbours whose union adds the fewest undamaged pixels.
+    // Neighbours in row order do not share rows with any other rectangle, nor
+    // does their union.
+    u32 best = 0;
+    u64 best_waste = UINT64_MAX;
+    for (u32 i = 0; i + 1 < region->count; ++i) {
+        damage_rect a = region->rects[i], b = region->rects[i + 1];
+        u64 waste = damage_rect_area(damage_rect_union(a, b)) - damage_rect_area(a) - damage_rect_area(b);
+        if (waste < best_waste) {
+            best_waste = waste;
+            best = i;
+        }
+    }
+    region->rects[best] = damage_rect_union(region->rects[best], region->rects[best + 1]);
+    memmove(&region->rects[best + 1], &region->rects[best + 2], (region->count - best - 2) * sizeof(damage_rect));
+    --region->count;
+}
+
+void
+damage_add_all(damage_region *region)
+{
+    region->count = 0;
+    damage_add(region, 0, 0, region->width, region->height);
+}
+
+void
+damage_add_region(damage_region *region, const damage_region *other)
+{
+    for (u32 i = 0; i < other->count; ++i) {
+        const damage_rect *rect = &other->rects[i];
+        damage_add(region, rect->x0, rect->y0, rect->x1, rect->y1);
+    }
+}
+
+void
+damage_clear(damage_region *region)
+{
+    region->count = 0;
+}
+
+u64
+damage_area(const damage_region *region)
+{
+    u64 area = 0;
+    for (u32 i = 0; i < region->count; ++i) area += damage_rect_area(region->rects[i]);
+    return area;
+}
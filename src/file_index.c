@@ -0,0 +1,252 @@
+#include "file_index.h"
+#include "log.h"
+#include "utf8.h"
+
+#include <string.h>
+
+// Indexes one slice and queues the next behind whatever else was submitted
+// meanwhile, so a large file never holds a worker that other work, such as
+// rasterizing the first screen, is waiting for
+static void
+file_index_job(void *arg)
+{
+    file_index *index = (file_index *)arg;
+    if (file_index_slice(index)) thread_pool_submit(index->pool, &index->group, file_index_job, index);
+}
+
+b32
+file_index_open(file_index *index, const char *path, thread_pool *pool)
+{
+    memset(index, 0, sizeof(*index));
+    if (!mapped_file_open(&index->file, path, 0)) {
+        LOG_ERROR("Could not open %s.", path);
+        return false;
+    }
+    pthread_mutex_init(&index->mutex, NULL);
+    line_index_init(&index->lines);
+    line_index_init(&index->window);
+    index->window_scanned = FILE_INDEX_NONE;
+    index->invalid_offset = FILE_INDEX_NONE;
+    index->done = index->file.size == 0;
+
+    index->pool = pool;
+    if (pool && !index->done) thread_pool_submit(pool, &index->group, file_index_job, index);
+    return true;
+}
+
+void
+file_index_close(file_index *index)
+{
+    pthread_mutex_lock(&index->mutex);
+    index->cancelled = true;
+    pthread_mutex_unlock(&index->mutex);
+    if (index->pool) thread_pool_wait(index->pool, &index->group);
+
+    pthread_mutex_destroy(&index->mutex);
+    line_index_free(&index->lines);
+    line_index_free(&index->window);
+    mapped_file_close(&index->file);
+    memset(index, 0, sizeof(*index));
+}
+
+void
+file_index_set_notify(file_index *index, thread_pool_notify_fn fn, void *arg)
+{
+    pthread_mutex_lock(&index->mutex);
+    index->notify = fn;
+    index->notify_arg = arg;
+    pthread_mutex_unlock(&index->mutex);
+}
+
+// Checks the text up to end. A sequence cut off at the end of a slice is
+// checked again with the next one.
+static void
+file_index_validate(file_index *index, u64 end)
+{
+    if (index->invalid_offset != FILE_INDEX_NONE) return;
+    u64 valid = index->validated + utf8_validate(index->file.data + index->validated, end - index->validated);
+    if (valid < end && (end == index->file.size || end - valid > 3)) {
+        index->invalid_offset = valid;
+        LOG_ERROR("File is not valid UTF-8 at offset %llu, ill-formed sequences are shown as U+FFFD.",
+                  (unsigned long long)valid);
+        return;
+    }
+    index->validated = valid;
+}
+
+b32
+file_index_slice(file_index *index)
+{
+    pthread_mutex_lock(&index->mutex);
+    b32 more = !index->done && !index->cancelled;
+    thread_pool_notify_fn notify = more ? index->notify : NULL;
+    void *notify_arg = index->notify_arg;
+    if (more) {
+        u64 offset = index->lines.scanned;
+        u64 length = index->file.size - offset;
+        if (length > FILE_INDEX_SLICE_SIZE) length = FILE_INDEX_SLICE_SIZE;
+        line_index_append(&index->lines, index->file.data + offset, length);
+        index->codepoints += utf8_count_codepoints(index->file.data + offset, length);
+        file_index_validate(index, offset + length);
+        if (index->lines.scanned == index->file.size) {
+            index->done = true;
+            more = false;
+            line_index_free(&index->window);
+            LOG_TRACE("Indexed %llu lines.", (unsigned long long)line_index_line_count(&index->lines));
+        }
+    }
+    pthread_mutex_unlock(&index->mutex);
+    if (notify) notify(notify_arg);
+    return more;
+}
+
+void
+file_index_wait(file_index *index)
+{
+    if (index->pool) thread_pool_wait(index->pool, &index->group);
+    while (file_index_slice(index)) {
+    }
+}
+
+b32
+file_index_done(file_index *index)
+{
+    pthread_mutex_lock(&index->mutex);
+    b32 done = index->done;
+    pthread_mutex_unlock(&index->mutex);
+    return done;
+}
+
+f32
+file_index_progress(file_index *index)
+{
+    if (index->file.size == 0) return 1.0f;
+    pthread_mutex_lock(&index->mutex);
+    f32 progress = (f32)((f64)index->lines.scanned / (f64)index->file.size);
+    pthread_mutex_unlock(&index->mutex);
+    return progress;
+}
+
+u64
+file_index_line_count(file_index *index, b32 *exact)
+{
+    pthread_mutex_lock(&index->mutex);
+    u64 line_breaks = index->lines.line_breaks;
+    u64 scanned = index->lines.scanned;
+    b32 done = index->done;
+    pthread_mutex_unlock(&index->mutex);
+
+    if (exact) *exact = done;
+    if (done || line_breaks == 0) return line_breaks + 1;
+    return line_breaks + 1 + (u64)((f64)(index->file.size - scanned) * line_breaks / scanned);
+}
+
+u64
+file_index_line_start(file_index *index, u64 line, b32 *exact)
+{
+    const u8 *data = index->file.data;
+    u64 size = index->file.size;
+
+    pthread_mutex_lock(&index->mutex);
+    u64 line_breaks = index->lines.line_breaks;
+    if (index->done || line <= line_breaks) {
+        u64 start = line_index_line_start(&index->lines, data, line);
+        pthread_mutex_unlock(&index->mutex);
+        if (exact) *exact = true;
+        return start;
+    }
+    // Start of the line the indexer is in the middle of
+    u64 last_start = line_index_line_start(&index->lines, data, line_breaks);
+
+    // Lines shortly past the indexed part are found in a window indexed
+    // ahead, rebuilt only once the indexer has moved on
+    u64 window = size - last_start;
+    if (window > FILE_INDEX_EXACT_SCAN_SIZE) window = FILE_INDEX_EXACT_SCAN_SIZE;
+    if (index->window_scanned != index->lines.scanned) {
+        line_index_free(&index->window);
+        line_index_init(&index->window);
+        line_index_append(&index->window, data + last_start, window);
+        index->window_scanned = index->lines.scanned;
+    }
+    u64 remaining = line - line_breaks;
+    u64 window_line_breaks = index->window.line_breaks;
+    if (remaining <= window_line_breaks || last_start + window == size) {
+        u64 start = last_start + line_index_line_start(&index->window, data + last_start, remaining);
+        pthread_mutex_unlock(&index->mutex);
+        if (exact) *exact = true;
+        return start;
+    }
+    pthread_mutex_unlock(&index->mutex);
+
+    // Estimate the rest from the average line length so far, then move to
+    // the start of the next line
+    u64 known_size = last_start + window;
+    u64 known_line_breaks = line_breaks + window_line_breaks;
+    f64 line_length = (f64)known_size / (f64)(known_line_breaks > 0 ? known_line_breaks : 1);
+    u64 estimate = known_size + (u64)((f64)(remaining - window_line_breaks) * line_length);
+    if (estimate >= size) {
+        estimate = size;
+    } else if (data[estimate - 1] != '\n') {
+        estimate += line_index_find_line_break(data + estimate, size - estimate, 1);
+    }
+    if (exact) *exact = false;
+    return estimate;
+}
+
+b32
+file_index_line_text(void *arg, u64 line, const u8 **text, u32 *length)
+{
+    file_index *index = (file_index *)arg;
+    u64 start = file_index_line_start(index, line, NULL);
+    if (start == index->file.size) return false;
+    u64 end = file_index_line_start(index, line + 1, NULL);
+    if (end > start && index->file.data[end - 1] == '\n') --end;
+    if (end > start && index->file.data[end - 1] == '\r') --end;
+    *text = index->file.data + start;
+    *length = end - start < UINT32_MAX ? (u32)(end - start) : UINT32_MAX;
+    return true;
+}
+
+u64
+file_index_line_of(file_index *index, u64 offset, b32 *exact)
+{
+    if (offset > index->file.size) offset = index->file.size;
+
+    pthread_mutex_lock(&index->mutex);
+    u64 line_breaks = index->lines.line_breaks;
+    u64 scanned = index->lines.scanned;
+    if (index->done || offset <= scanned) {
+        u64 line = line_index_line_of(&index->lines, index->file.data, offset);
+        pthread_mutex_unlock(&index->mutex);
+        if (exact) *exact = true;
+        return line;
+    }
+    pthread_mutex_unlock(&index->mutex);
+
+    if (exact) *exact = false;
+    if (scanned == 0) return 0;
+    return line_breaks + (u64)((f64)(offset - scanned) * line_breaks / scanned);
+}
+
+u64
+file_index_codepoint_count(file_index *index, b32 *exact)
+{
+    pthread_mutex_lock(&index->mutex);
+    u64 codepoints = index->codepoints;
+    u64 scanned = index->lines.scanned;
+    b32 done = index->done;
+    pthread_mutex_unlock(&index->mutex);
+
+    if (exact) *exact = done;
+    if (done || scanned == 0) return codepoints;
+    return codepoints + (u64)((f64)(index->file.size - scanned) * codepoints / scanned);
+}
+
+u64
+file_index_invalid_offset(file_index *index)
+{
+    pthread_mutex_lock(&index->mutex);
+    u64 offset = index->invalid_offset;
+    pthread_mutex_unlock(&index->mutex);
+    return offset;
+}
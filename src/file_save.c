@@ -0,0 +1,384 @@
+#include "file_save.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Any POSIX system, where rename replaces the target atomically
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Replacing a symbolic link would turn it into a file
+static char *
+file_save_resolve(const char *path)
+{
+    char resolved[PATH_MAX];
+    return strdup(realpath(path, resolved) ? resolved : path);
+}
+
+// Creates the temporary file with the permissions and, where allowed, the
+// owner of the file it replaces
+static b32
+file_save_create(file_save *save)
+{
+    u64 path_length = strlen(save->path);
+    save->temp_path = (char *)malloc(path_length + 16);
+    if (!save->temp_path) LOG_FATAL("Could not allocate save paths for %s.", save->path);
+    snprintf(save->temp_path, path_length + 16, "%s.save-XXXXXX", save->path);
+    save->fd = mkstemp(save->temp_path);
+    if (save->fd < 0) return false;
+
+    // Changing the owner can clear the setuid and setgid bits, so the mode
+    // is set after it
+    struct stat st;
+    if (stat(save->path, &st) == 0) {
+        if (fchown(save->fd, st.st_uid, st.st_gid) < 0) LOG_TRACE("Could not keep the owner of %s.", save->path);
+        fchmod(save->fd, st.st_mode & 07777);
+    } else {
+        fchmod(save->fd, 0644);
+    }
+    return true;
+}
+
+// Reserving the space up front reports a full disk before anything is
+// written
+static b32
+file_save_reserve(file_save *save)
+{
+#if defined(__APPLE__)
+    UNUSED(save);
+    return true;
+#else
+    return save->length == 0 || posix_fallocate(save->fd, 0, (off_t)save->length) != ENOSPC;
+#endif
+}
+
+// Writes runs from the current one on, up to end, in one pwritev call.
+// Returns the bytes written, which may be fewer, or -1 with errno set.
+static s64
+file_save_write(file_save *save, u64 written, u64 end)
+{
+    struct iovec iovecs[FILE_SAVE_MAX_IOVECS];
+    u32 count = 0;
+    u64 batch = 0;
+    for (u64 i = save->span; i < save->span_count && count < FILE_SAVE_MAX_IOVECS && written + batch < end; ++i) {
+        u64 offset = i == save->span ? save->span_offset : 0;
+        u64 length = save->spans[i].length - offset;
+        if (length > end - written - batch) length = end - written - batch;
+        iovecs[count++] = (struct iovec){(void *)(save->spans[i].data + offset), length};
+        batch += length;
+    }
+    for (;;) {
+        ssize_t result = pwritev(save->fd, iovecs, (int)count, (off_t)written);
+        if (result >= 0 || errno != EINTR) return result;
+    }
+}
+
+// Makes the file durable under its final name. The rename only replaces the
+// target once the data is on disk, and syncing the directory keeps the
+// rename itself. Returns what failed, or NULL.
+static const char *
+file_save_replace(file_save *save)
+{
+#if defined(__APPLE__)
+    // fsync leaves the data in the drive's cache there
+    if (fcntl(save->fd, F_FULLFSYNC) < 0 && fsync(save->fd) < 0) return "sync";
+#else
+    if (fsync(save->fd) < 0) return "sync";
+#endif
+    int fd = save->fd;
+    save->fd = -1;
+    if (close(fd) < 0) return "close";
+    if (rename(save->temp_path, save->path) < 0) return "rename";
+
+    char *slash = strrchr(save->path, '/');
+    if (slash) *slash = '\0';
+    int directory = open(slash ? (slash == save->path ? "/" : save->path) : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (slash) *slash = '/';
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+    return NULL;
+}
+
+// Closes the temporary file, and removes it unless it was renamed
+static void
+file_save_discard(file_save *save, b32 remove_file)
+{
+    if (save->fd >= 0) close(save->fd);
+    save->fd = -1;
+    if (remove_file) unlink(save->temp_path);
+}
+#else
+static char *
+file_save_resolve(const char *path)
+{
+    return strdup(path);
+}
+
+static b32
+file_save_create(file_save *save)
+{
+    u64 path_length = strlen(save->path);
+    save->temp_path = (char *)malloc(path_length + 16);
+    if (!save->temp_path) LOG_FATAL("Could not allocate save paths for %s.", save->path);
+    snprintf(save->temp_path, path_length + 16, "%s.save-tmp", save->path);
+    save->stream = fopen(save->temp_path, "wb");
+    return save->stream != NULL;
+}
+
+static b32
+file_save_reserve(file_save *save)
+{
+    UNUSED(save);
+    return true;
+}
+
+// Writes what is left of the current run, up to end
+static s64
+file_save_write(file_save *save, u64 written, u64 end)
+{
+    const piece_span *span = &save->spans[save->span];
+    u64 length = span->length - save->span_offset;
+    if (length > end - written) length = end - written;
+    size_t result = fwrite(span->data + save->span_offset, 1, length, save->stream);
+    return result > 0 ? (s64)result : -1;
+}
+
+static const char *
+file_save_replace(file_save *save)
+{
+    FILE *stream = save->stream;
+    save->stream = NULL;
+    if (fclose(stream) != 0) return "close";
+#if defined(_WIN32)
+    // rename does not replace an existing file on Windows, so the target is
+    // removed first and a crash in between loses it.
+    // Todo: Use ReplaceFileW.
+    remove(save->path);
+#endif
+    if (rename(save->temp_path, save->path) != 0) return "rename";
+    return NULL;
+}
+
+static void
+file_save_discard(file_save *save, b32 remove_file)
+{
+    if (save->stream) fclose(save->stream);
+    save->stream = NULL;
+    if (remove_file) remove(save->temp_path);
+}
+#endif
+
+// Writes one slice and queues the next behind whatever else was submitted
+// meanwhile, so a save never holds a worker that rendering waits for
+static void
+file_save_job(void *arg)
+{
+    file_save *save = (file_save *)arg;
+    if (file_save_slice(save)) thread_pool_submit(save->pool, &save->group, file_save_job, save);
+}
+
+static b32
+file_save_collect(const u8 *data, u64 length, void *arg)
+{
+    file_save *save = (file_save *)arg;
+    if (save->span_count > 0) {
+        piece_span *last = &save->spans[save->span_count - 1];
+        if (last->data + last->length == data) {
+            last->length += length;
+            return true;
+        }
+    }
+    if (save->span_count == save->span_capacity) {
+        save->span_capacity = save->span_capacity ? save->span_capacity * 2 : 64;
+        save->spans = (piece_span *)realloc(save->spans, save->span_capacity * sizeof(piece_span));
+        if (!save->spans) LOG_FATAL("Could not allocate %llu save spans.", (unsigned long long)save->span_capacity);
+    }
+    save->spans[save->span_count++] = (piece_span){data, length};
+    return true;
+}
+
+b32
+file_save_start(file_save *save, const piece_table *table, const char *path, thread_pool *pool)
+{
+    memset(save, 0, sizeof(*save));
+    save->fd = -1;
+    save->path = file_save_resolve(path);
+    if (!save->path) LOG_FATAL("Could not allocate save paths for %s.", path);
+
+    if (!file_save_create(save)) {
+        LOG_ERROR("Could not create %s: %s.", save->temp_path, strerror(errno));
+        free(save->path);
+        free(save->temp_path);
+        memset(save, 0, sizeof(*save));
+        return false;
+    }
+
+    save->length = piece_table_length(table);
+    if (!file_save_reserve(save)) {
+        LOG_ERROR("Not enough space to save %s.", save->path);
+        file_save_discard(save, true);
+        free(save->path);
+        free(save->temp_path);
+        memset(save, 0, sizeof(*save));
+        return false;
+    }
+    piece_table_visit(table, 0, save->length, file_save_collect, save);
+
+    pthread_mutex_init(&save->mutex, NULL);
+    save->state = FILE_SAVE_WRITING;
+    save->pool = pool;
+    if (pool) thread_pool_submit(pool, &save->group, file_save_job, save);
+    return true;
+}
+
+void
+file_save_close(file_save *save)
+{
+    pthread_mutex_lock(&save->mutex);
+    save->cancelled = true;
+    pthread_mutex_unlock(&save->mutex);
+    if (save->pool) thread_pool_wait(save->pool, &save->group);
+    // Runs the slice that notices the cancel when there is no pool
+    file_save_slice(save);
+
+    pthread_mutex_destroy(&save->mutex);
+    free(save->path);
+    free(save->temp_path);
+    free(save->spans);
+    memset(save, 0, sizeof(*save));
+}
+
+void
+file_save_set_notify(file_save *save, thread_pool_notify_fn fn, void *arg)
+{
+    pthread_mutex_lock(&save->mutex);
+    save->notify = fn;
+    save->notify_arg = arg;
+    pthread_mutex_unlock(&save->mutex);
+}
+
+// Publishes progress or the end of the save
+static void
+file_save_update(file_save *save, u64 written, file_save_state state)
+{
+    pthread_mutex_lock(&save->mutex);
+    save->written = written;
+    save->state = state;
+    thread_pool_notify_fn notify = save->notify;
+    void *notify_arg = save->notify_arg;
+    pthread_mutex_unlock(&save->mutex);
+    if (notify) notify(notify_arg);
+}
+
+// Ends the save, removing the temporary file unless it was committed
+static void
+file_save_end(file_save *save, file_save_state state)
+{
+    file_save_discard(save, state != FILE_SAVE_DONE);
+    pthread_mutex_lock(&save->mutex);
+    u64 written = save->written;
+    pthread_mutex_unlock(&save->mutex);
+    file_save_update(save, written, state);
+}
+
+static b32
+file_save_fail(file_save *save, const char *action)
+{
+    LOG_ERROR("Could not %s %s: %s.", action, save->temp_path, strerror(errno));
+    file_save_end(save, FILE_SAVE_FAILED);
+    return false;
+}
+
+static b32
+file_save_commit(file_save *save)
+{
+    const char *failed = file_save_replace(save);
+    if (failed) return file_save_fail(save, failed);
+    LOG_TRACE("Saved %llu bytes to %s.", (unsigned long long)save->length, save->path);
+    file_save_end(save, FILE_SAVE_DONE);
+    return false;
+}
+
+b32
+file_save_slice(file_save *save)
+{
+    pthread_mutex_lock(&save->mutex);
+    file_save_state state = save->state;
+    b32 cancelled = save->cancelled;
+    u64 written = save->written;
+    pthread_mutex_unlock(&save->mutex);
+    if (state != FILE_SAVE_WRITING) return false;
+    if (cancelled) {
+        file_save_end(save, FILE_SAVE_CANCELLED);
+        return false;
+    }
+
+    u64 slice_end = written + FILE_SAVE_SLICE_SIZE < save->length ? written + FILE_SAVE_SLICE_SIZE : save->length;
+    while (written < slice_end) {
+        s64 result = file_save_write(save, written, slice_end);
+        if (result < 0) return file_save_fail(save, "write");
+        if (result == 0) {
+            errno = EIO;
+            return file_save_fail(save, "write");
+        }
+
+        // Short writes leave the position in the middle of a run
+        u64 advance = (u64)result;
+        written += advance;
+        while (advance > 0) {
+            u64 left = save->spans[save->span].length - save->span_offset;
+            if (advance < left) {
+                save->span_offset += advance;
+                break;
+            }
+            advance -= left;
+            ++save->span;
+            save->span_offset = 0;
+        }
+    }
+
+    if (written < save->length) {
+        file_save_update(save, written, FILE_SAVE_WRITING);
+        return true;
+    }
+    pthread_mutex_lock(&save->mutex);
+    save->written = written;
+    pthread_mutex_unlock(&save->mutex);
+    return file_save_commit(save);
+}
+
+void
+file_save_wait(file_save *save)
+{
+    if (save->pool) thread_pool_wait(save->pool, &save->group);
+    while (file_save_slice(save)) {
+    }
+}
+
+file_save_state
+file_save_get_state(file_save *save)
+{
+    pthread_mutex_lock(&save->mutex);
+    file_save_state state = save->state;
+    pthread_mutex_unlock(&save->mutex);
+    return state;
+}
+
+f32
+file_save_progress(file_save *save)
+{
+    if (save->length == 0) return 1.0f;
+    pthread_mutex_lock(&save->mutex);
+    f32 progress = (f32)((f64)save->written / (f64)save->length);
+    pthread_mutex_unlock(&save->mutex);
+    return progress;
+}
@@ -0,0 +1,378 @@
+#include "find.h"
+#include "log.h"
+#include "raster_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define FIND_X86
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define FIND_HAS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+static inline u32
+find_lowest_bit(u32 mask)
+{
+#if defined(__GNUC__)
+    return (u32)__builtin_ctz(mask);
+#else
+    u32 bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Bytes of source code and logs, from the most common down
+static const char find_common_bytes[] = " etaoinsrlcdhu\nmp_f.g(y)b,=w;v\"-0k12/:*x{}>";
+
+// Rough frequency of a byte in typical text, higher is more common
+static u32
+find_byte_frequency(u8 byte)
+{
+    const char *common = byte ? strchr(find_common_bytes, byte) : NULL;
+    if (common) return 255 - (u32)(common - find_common_bytes);
+    if (byte == '\t') return 200;
+    if (byte >= '0' && byte <= '9') return 160;
+    if (byte >= 'A' && byte <= 'Z') return 128;
+    if (byte >= 0x80) return 96;
+    return 64;
+}
+
+void
+find_pattern_init(find_pattern *pattern, const u8 *needle, u64 length)
+{
+    memset(pattern, 0, sizeof(*pattern));
+    pattern->needle = needle;
+    pattern->length = length;
+    if (length == 0) return;
+
+    // Later bytes win ties, they tell apart more prefixes of the text
+    u64 rarest = 0;
+    for (u64 i = 1; i < length; ++i) {
+        if (find_byte_frequency(needle[i]) <= find_byte_frequency(needle[rarest])) rarest = i;
+    }
+    u64 second = rarest;
+    for (u64 i = 0; i < length; ++i) {
+        if (i == rarest) continue;
+        if (second == rarest || find_byte_frequency(needle[i]) <= find_byte_frequency(needle[second])) second = i;
+    }
+    pattern->rare_index[0] = rarest;
+    pattern->rare_index[1] = second;
+    pattern->rare_byte[0] = needle[rarest];
+    pattern->rare_byte[1] = needle[second];
+}
+
+static void
+find_visit_memory(const void *document, u64 offset, u64 length, find_chunk_fn fn, void *arg)
+{
+    fn((const u8 *)document + offset, length, arg);
+}
+
+static void
+find_visit_piece_table(const void *document, u64 offset, u64 length, find_chunk_fn fn, void *arg)
+{
+    piece_table_visit((const piece_table *)document, offset, length, fn, arg);
+}
+
+static void
+find_visit_rope(const void *document, u64 offset, u64 length, find_chunk_fn fn, void *arg)
+{
+    rope_visit((const rope *)document, offset, length, fn, arg);
+}
+
+find_source
+find_source_memory(const u8 *data, u64 length)
+{
+    find_source source = {data, length, find_visit_memory};
+    return source;
+}
+
+find_source
+find_source_piece_table(const piece_table *table)
+{
+    find_source source = {table, piece_table_length(table), find_visit_piece_table};
+    return source;
+}
+
+find_source
+find_source_rope(const rope *rope)
+{
+    find_source source = {rope, rope_length(rope), find_visit_rope};
+    return source;
+}
+
+void
+find_matches_free(find_matches *matches)
+{
+    free(matches->offsets);
+    memset(matches, 0, sizeof(*matches));
+}
+
+static void
+find_matches_push(find_matches *matches, u64 offset)
+{
+    if (matches->count == matches->capacity) {
+        matches->capacity = matches->capacity ? matches->capacity * 2 : 256;
+        matches->offsets = (u64 *)realloc(matches->offsets, matches->capacity * sizeof(u64));
+        if (!matches->offsets) LOG_FATAL("Could not allocate %llu find matches.", (unsigned long long)matches->capacity);
+    }
+    matches->offsets[matches->count++] = offset;
+}
+
+// Search of one range of the document, one chunk at a time
+typedef struct {
+    const find_pattern *pattern;
+    find_matches *matches;
+    b32 first_only;
+    u64 base;       // Document offset of the next chunk
+    u64 next_start; // Matches before this overlap the last one
+
+    // The last length - 1 bytes seen, for matches that span chunks
+    u8 *carry;
+    u64 carry_length;
+} find_scan;
+
+// Returns false to stop the search
+static b32
+find_report(find_scan *scan, u64 offset)
+{
+    if (offset < scan->next_start) return true;
+    find_matches_push(scan->matches, offset);
+    scan->next_start = offset + scan->pattern->length;
+    return !scan->first_only;
+}
+
+// The kernels report every match in data, starting with candidate position i
+static b32
+find_buffer_scalar(find_scan *scan, const u8 *data, u64 length, u64 base, u64 i)
+{
+    const find_pattern *pattern = scan->pattern;
+    if (length < pattern->length) return true;
+    u64 count = length - pattern->length + 1;
+    const u8 *rare = data + pattern->rare_index[0];
+    while (i < count) {
+        const u8 *hit = (const u8 *)memchr(rare + i, pattern->rare_byte[0], count - i);
+        if (!hit) break;
+        u64 start = (u64)(hit - rare);
+        if (data[start + pattern->rare_index[1]] == pattern->rare_byte[1] &&
+            memcmp(data + start, pattern->needle, pattern->length) == 0 &&
+            !find_report(scan, base + start)) {
+            return false;
+        }
+        i = start + 1;
+    }
+    return true;
+}
+
+#if defined(FIND_X86)
+static b32
+find_buffer_sse2(find_scan *scan, const u8 *data, u64 length, u64 base)
+{
+    const find_pattern *pattern = scan->pattern;
+    if (length < pattern->length) return true;
+    u64 count = length - pattern->length + 1;
+    const u8 *first = data + pattern->rare_index[0];
+    const u8 *second = data + pattern->rare_index[1];
+    const __m128i first_byte = _mm_set1_epi8((char)pattern->rare_byte[0]);
+    const __m128i second_byte = _mm_set1_epi8((char)pattern->rare_byte[1]);
+
+    u64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(first + i)), first_byte);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(second + i)), second_byte);
+        u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(a, b));
+        while (mask) {
+            u64 start = i + find_lowest_bit(mask);
+            if (memcmp(data + start, pattern->needle, pattern->length) == 0 && !find_report(scan, base + start)) {
+                return false;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_buffer_scalar(scan, data, length, base, i);
+}
+#endif
+
+#if defined(FIND_HAS_AVX2)
+__attribute__((target("avx2")))
+static b32
+find_buffer_avx2(find_scan *scan, const u8 *data, u64 length, u64 base)
+{
+    const find_pattern *pattern = scan->pattern;
+    if (length < pattern->length) return true;
+    u64 count = length - pattern->length + 1;
+    const u8 *first = data + pattern->rare_index[0];
+    const u8 *second = data + pattern->rare_index[1];
+    const __m256i first_byte = _mm256_set1_epi8((char)pattern->rare_byte[0]);
+    const __m256i second_byte = _mm256_set1_epi8((char)pattern->rare_byte[1]);
+
+    u64 i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(first + i)), first_byte);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(second + i)), second_byte);
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(a, b));
+        while (mask) {
+            u64 start = i + find_lowest_bit(mask);
+            if (memcmp(data + start, pattern->needle, pattern->length) == 0 && !find_report(scan, base + start)) {
+                return false;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_buffer_scalar(scan, data, length, base, i);
+}
+#endif
+
+static b32
+find_buffer(find_scan *scan, const u8 *data, u64 length, u64 base)
+{
+    switch (raster_simd_get_level()) {
+#if defined(FIND_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        return find_buffer_avx2(scan, data, length, base);
+#endif
+#if defined(FIND_X86)
+    case RASTER_SIMD_SSE2:
+        return find_buffer_sse2(scan, data, length, base);
+#endif
+    default:
+        return find_buffer_scalar(scan, data, length, base, 0);
+    }
+}
+
+static b32
+find_scan_chunk(const u8 *data, u64 length, void *arg)
+{
+    find_scan *scan = (find_scan *)arg;
+    u64 keep = scan->pattern->length - 1;
+
+    // Matches that start in earlier chunks and end in this one. Only the
+    // bytes they can reach are joined.
+    if (scan->carry_length > 0) {
+        u64 take = length < keep ? length : keep;
+        memcpy(scan->carry + scan->carry_length, data, take);
+        if (!find_buffer_scalar(scan, scan->carry, scan->carry_length + take, scan->base - scan->carry_length, 0)) {
+            return false;
+        }
+        if (length < keep) {
+            // A short chunk leaves part of the carry in place
+            u64 total = scan->carry_length + length;
+            u64 kept = total < keep ? total : keep;
+            memmove(scan->carry, scan->carry + total - kept, kept);
+            scan->carry_length = kept;
+            scan->base += length;
+            return true;
+        }
+    }
+
+    if (!find_buffer(scan, data, length, scan->base)) return false;
+
+    u64 kept = length < keep ? length : keep;
+    memcpy(scan->carry, data + length - kept, kept);
+    scan->carry_length = kept;
+    scan->base += length;
+    return true;
+}
+
+static void
+find_range(const find_pattern *pattern, const find_source *source, u64 start, u64 end, u64 next_start,
+           b32 first_only, find_matches *matches)
+{
+    find_scan scan = {0};
+    scan.pattern = pattern;
+    scan.matches = matches;
+    scan.first_only = first_only;
+    scan.base = start;
+    scan.next_start = next_start;
+
+    u8 carry[256];
+    u64 carry_capacity = 2 * (pattern->length - 1);
+    scan.carry = carry_capacity <= sizeof(carry) ? carry : (u8 *)malloc(carry_capacity);
+    if (!scan.carry) LOG_FATAL("Could not allocate %llu bytes to find a string.", (unsigned long long)carry_capacity);
+
+    source->visit(source->document, start, end - start, find_scan_chunk, &scan);
+    if (scan.carry != carry) free(scan.carry);
+}
+
+typedef struct {
+    const find_pattern *pattern;
+    const find_source *source;
+    u64 start; // Matches start in [start, end)
+    u64 end;
+    u64 visit_end;
+    find_matches matches;
+} find_part;
+
+static void
+find_part_job(void *arg)
+{
+    find_part *part = (find_part *)arg;
+    find_range(part->pattern, part->source, part->start, part->visit_end, part->start, false, &part->matches);
+}
+
+void
+find_all(const find_pattern *pattern, const find_source *source, u64 offset, u64 length,
+         thread_pool *pool, find_matches *matches)
+{
+    if (offset > source->length) offset = source->length;
+    if (length > source->length - offset) length = source->length - offset;
+    if (pattern->length == 0 || length < pattern->length) return;
+
+    u64 end = offset + length;
+    if (!pool || length <= FIND_PARALLEL_THRESHOLD) {
+        find_range(pattern, source, offset, end, offset, false, matches);
+        return;
+    }
+
+    u64 part_count = (u64)pool->thread_count * 4;
+    if (part_count > length / FIND_PART_SIZE) part_count = length / FIND_PART_SIZE;
+    find_part *parts = (find_part *)calloc(part_count, sizeof(find_part));
+    if (!parts) LOG_FATAL("Could not allocate %llu find jobs.", (unsigned long long)part_count);
+
+    thread_pool_group group = {0};
+    for (u64 i = 0; i < part_count; ++i) {
+        find_part *part = &parts[i];
+        part->pattern = pattern;
+        part->source = source;
+        part->start = offset + length / part_count * i;
+        part->end = i + 1 == part_count ? end : offset + length / part_count * (i + 1);
+        part->visit_end = part->end + pattern->length - 1 < end ? part->end + pattern->length - 1 : end;
+        thread_pool_submit(pool, &group, find_part_job, part);
+    }
+    thread_pool_wait(pool, &group);
+
+    u64 next_start = offset;
+    for (u64 i = 0; i < part_count; ++i) {
+        find_part *part = &parts[i];
+        if (part->matches.count > 0 && part->matches.offsets[0] < next_start) {
+            // A match ran into this part, so its matches may not be the ones
+            // a single pass would have picked. Search it again after it.
+            part->matches.count = 0;
+            find_range(pattern, source, next_start, part->visit_end, next_start, false, &part->matches);
+        }
+        for (u64 k = 0; k < part->matches.count; ++k) find_matches_push(matches, part->matches.offsets[k]);
+        if (part->matches.count > 0) next_start = part->matches.offsets[part->matches.count - 1] + pattern->length;
+        find_matches_free(&part->matches);
+    }
+    free(parts);
+}
+
+b32
+find_next(const find_pattern *pattern, const find_source *source, u64 offset, u64 *match)
+{
+    if (pattern->length == 0 || offset >= source->length) return false;
+
+    find_matches found = {0};
+    find_range(pattern, source, offset, source->length, offset, true, &found);
+    b32 any = found.count > 0;
+    if (any) *match = found.offsets[0];
+    find_matches_free(&found);
+    return any;
+}
@@ -0,0 +1,282 @@
+#include "font.h"
+#include "log.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fonts are loaded and unloaded from the main thread only
+static font_file *font_files = NULL;
+
+static char *
+font_canonical_path(const char *path)
+{
+#if defined(linux)
+    char *resolved = realpath(path, NULL);
+    if (resolved) return resolved;
+#endif
+    size_t length = strlen(path);
+    char *copy = (char *)malloc(length + 1);
+    if (copy) memcpy(copy, path, length + 1);
+    return copy;
+}
+
+static font_file *
+font_file_acquire(const char *path, u32 map_flags)
+{
+    char *canonical_path = font_canonical_path(path);
+    if (!canonical_path) return NULL;
+
+    for (font_file *file = font_files; file; file = file->next) {
+        if (strcmp(file->path, canonical_path) == 0) {
+            free(canonical_path);
+            ++file->references;
+            return file;
+        }
+    }
+
+    font_file *file = (font_file *)calloc(1, sizeof(font_file));
+    if (!file) {
+        free(canonical_path);
+        return NULL;
+    }
+
+    if (!mapped_file_open(&file->file, canonical_path, map_flags)) {
+        LOG_ERROR("Could not map font file %s.", path);
+        free(canonical_path);
+        free(file);
+        return NULL;
+    }
+    LOG_TRACE("Mapped font file %s (%zu bytes).", canonical_path, file->file.size);
+
+    file->path = canonical_path;
+    file->references = 1;
+    file->next = font_files;
+    font_files = file;
+    return file;
+}
+
+static void
+font_file_release(font_file *file)
+{
+    if (--file->references > 0) return;
+
+    for (font_file **link = &font_files; *link; link = &(*link)->next) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+    }
+
+    LOG_TRACE("Unmapped font file %s.", file->path);
+    mapped_file_close(&file->file);
+    free(file->path);
+    free(file);
+}
+
+static u16
+font_read_u16(const font_file *file, size_t offset)
+{
+    if (offset + 2 > file->file.size) return 0;
+    const u8 *p = file->file.data + offset;
+    return (u16)((p[0] << 8) | p[1]);
+}
+
+static u32
+font_read_u32(const font_file *file, size_t offset)
+{
+    if (offset + 4 > file->file.size) return 0;
+    const u8 *p = file->file.data + offset;
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static void
+font_cmap_set(font_cmap *cmap, u32 codepoint, u32 glyph_index)
+{
+    if (codepoint > FONT_MAX_CODEPOINT || glyph_index == 0 || glyph_index > 0xFFFF) return;
+
+    u32 high = codepoint >> FONT_CMAP_PAGE_BITS;
+    if (cmap->page_index[high] == 0) {
+        u32 page = cmap->page_count++;
+        cmap->glyphs = (u16 *)realloc(cmap->glyphs, (size_t)cmap->page_count * FONT_CMAP_PAGE_SIZE * sizeof(u16));
+        cmap->coverage = (u64 *)realloc(cmap->coverage, (size_t)cmap->page_count * (FONT_CMAP_PAGE_SIZE / 64) * sizeof(u64));
+        if (!cmap->glyphs || !cmap->coverage) LOG_FATAL("Could not grow font cmap to %u pages.", cmap->page_count);
+        memset(cmap->glyphs + (size_t)page * FONT_CMAP_PAGE_SIZE, 0, FONT_CMAP_PAGE_SIZE * sizeof(u16));
+        memset(cmap->coverage + (size_t)page * (FONT_CMAP_PAGE_SIZE / 64), 0, (FONT_CMAP_PAGE_SIZE / 64) * sizeof(u64));
+        cmap->page_index[high] = (u16)page;
+    }
+
+    u32 bit = ((u32)cmap->page_index[high] << FONT_CMAP_PAGE_BITS) | (codepoint & (FONT_CMAP_PAGE_SIZE - 1));
+    if (!cmap->glyphs[bit]) ++cmap->glyph_count;
+    cmap->glyphs[bit] = (u16)glyph_index;
+    cmap->coverage[bit >> 6] |= (u64)1 << (bit & 63);
+}
+
+// Enumerates the cmap subtable stb_truetype picked for the font, with the same
+// interpretation as stbtt_FindGlyphIndex.
+static void
+font_build_cmap(font *font)
+{
+    font_cmap *cmap = &font->cmap;
+    cmap->page_index = (u16 *)calloc(FONT_CMAP_PAGE_COUNT, sizeof(u16));
+    // Page 0 is the shared empty page
+    cmap->page_count = 1;
+    cmap->glyphs = (u16 *)calloc(FONT_CMAP_PAGE_SIZE, sizeof(u16));
+    cmap->coverage = (u64 *)calloc(FONT_CMAP_PAGE_SIZE / 64, sizeof(u64));
+    if (!cmap->page_index || !cmap->glyphs || !cmap->coverage) LOG_FATAL("Could not allocate font cmap.");
+
+    const font_file *file = font->file;
+    size_t index_map = (size_t)font->info.index_map;
+    u16 format = font_read_u16(file, index_map);
+
+    if (format == 0) {
+        u32 bytes = font_read_u16(file, index_map + 2);
+        for (u32 codepoint = 0; codepoint + 6 < bytes && codepoint < 256; ++codepoint) {
+            if (index_map + 6 + codepoint >= file->file.size) break;
+            font_cmap_set(cmap, codepoint, file->file.data[index_map + 6 + codepoint]);
+        }
+    } else if (format == 6) {
+        u32 first = font_read_u16(file, index_map + 6);
+        u32 count = font_read_u16(file, index_map + 8);
+        for (u32 i = 0; i < count; ++i) {
+            font_cmap_set(cmap, first + i, font_read_u16(file, index_map + 10 + i * 2));
+        }
+    } else if (format == 4) {
+        u32 segment_count = font_read_u16(file, index_map + 6) >> 1;
+        size_t end_codes = index_map + 14;
+        size_t start_codes = end_codes + segment_count * 2 + 2;
+        size_t id_deltas = start_codes + segment_count * 2;
+        size_t id_range_offsets = id_deltas + segment_count * 2;
+        for (u32 segment = 0; segment < segment_count; ++segment) {
+            u32 start = font_read_u16(file, start_codes + segment * 2);
+            u32 end = font_read_u16(file, end_codes + segment * 2);
+            u16 id_delta = font_read_u16(file, id_deltas + segment * 2);
+            u16 id_range_offset = font_read_u16(file, id_range_offsets + segment * 2);
+            for (u32 codepoint = start; codepoint <= end; ++codepoint) {
+                if (id_range_offset == 0) {
+                    font_cmap_set(cmap, codepoint, (u16)(codepoint + id_delta));
+                } else {
+                    size_t offset = id_range_offsets + segment * 2 + id_range_offset + (codepoint - start) * 2;
+                    font_cmap_set(cmap, codepoint, font_read_u16(file, offset));
+                }
+            }
+        }
+    } else if (format == 12 || format == 13) {
+        u32 group_count = font_read_u32(file, index_map + 12);
+        for (u32 group = 0; group < group_count; ++group) {
+            size_t record = index_map + 16 + (size_t)group * 12;
+            if (record + 12 > file->file.size) break;
+            u32 start = font_read_u32(file, record);
+            u32 end = font_read_u32(file, record + 4);
+            u32 start_glyph = font_read_u32(file, record + 8);
+            if (end > FONT_MAX_CODEPOINT) end = FONT_MAX_CODEPOINT;
+            for (u32 codepoint = start; codepoint <= end; ++codepoint) {
+                font_cmap_set(cmap, codepoint, format == 12 ? start_glyph + (codepoint - start) : start_glyph);
+            }
+        }
+    } else {
+        LOG_WARNING("Unsupported cmap format %u in %s, font has no glyphs.", format, file->path);
+    }
+
+    LOG_TRACE("Built cmap for %s: %u codepoints on %u pages.", file->path, cmap->glyph_count, cmap->page_count);
+}
+
+static void
+font_free_cmap(font *font)
+{
+    free(font->cmap.page_index);
+    free(font->cmap.glyphs);
+    free(font->cmap.coverage);
+    memset(&font->cmap, 0, sizeof(font->cmap));
+}
+
+// Walking kern/GPOS for every pair is the expensive part, so it is done once
+// per font and only for codepoints the font actually has glyphs for. Sizes
+// only scale the result.
+static void
+font_build_kerning(font *font)
+{
+    font_kerning *kerning = &font->kerning;
+    s16 *pairs = (s16 *)calloc(FONT_KERNING_RANGE * FONT_KERNING_RANGE, sizeof(s16));
+    if (!pairs) LOG_FATAL("Could not allocate kerning pair table.");
+
+    b32 kerns[FONT_KERNING_RANGE] = {0};
+    if (font->info.kern || font->info.gpos) {
+        for (u32 left = 0; left < FONT_KERNING_RANGE; ++left) {
+            s32 left_glyph = font_glyph_index(font, left);
+            if (!left_glyph) continue;
+            for (u32 right = 0; right < FONT_KERNING_RANGE; ++right) {
+                s32 right_glyph = font_glyph_index(font, right);
+                if (!right_glyph) continue;
+                s32 advance = stbtt_GetGlyphKernAdvance(&font->info, left_glyph, right_glyph);
+                if (advance) {
+                    pairs[left * FONT_KERNING_RANGE + right] = (s16)advance;
+                    kerns[left] = true;
+                    kerns[right] = true;
+                }
+            }
+        }
+    }
+
+    kerning->class_count = 1;
+    for (u32 codepoint = 0; codepoint < FONT_KERNING_RANGE; ++codepoint) {
+        kerning->class_of[codepoint] = kerns[codepoint] ? kerning->class_count++ : 0;
+    }
+
+    u32 classes = kerning->class_count;
+    kerning->pairs = (s16 *)calloc((size_t)classes * classes, sizeof(s16));
+    if (!kerning->pairs) LOG_FATAL("Could not allocate %ux%u kerning matrix.", classes, classes);
+
+    for (u32 left = 0; left < FONT_KERNING_RANGE; ++left) {
+        if (!kerns[left]) continue;
+        for (u32 right = 0; right < FONT_KERNING_RANGE; ++right) {
+            if (!kerns[right]) continue;
+            u32 row = kerning->class_of[left];
+            u32 column = kerning->class_of[right];
+            kerning->pairs[row * classes + column] = pairs[left * FONT_KERNING_RANGE + right];
+        }
+    }
+    free(pairs);
+}
+
+b32
+font_load(font *font, const char *path, s32 index, u32 map_flags)
+{
+    memset(font, 0, sizeof(*font));
+
+    font_file *file = font_file_acquire(path, map_flags);
+    if (!file) return false;
+
+    // Anything shorter than an offset table is not a font
+    s32 offset = file->file.size >= 12 ? stbtt_GetFontOffsetForIndex(file->file.data, index) : -1;
+    if (offset < 0 || !stbtt_InitFont(&font->info, file->file.data, offset)) {
+        LOG_ERROR("Could not initialize font %d in %s.", index, path);
+        font_file_release(file);
+        return false;
+    }
+
+    font->file = file;
+    font->index = index;
+    font_build_cmap(font);
+    font_build_kerning(font);
+    return true;
+}
+
+void
+font_unload(font *font)
+{
+    if (font->file) {
+        font_free_cmap(font);
+        free(font->kerning.pairs);
+        font_file_release(font->file);
+    }
+    memset(font, 0, sizeof(*font));
+}
+
+size_t
+font_covered_prefix(const font *font, const u32 *codepoints, size_t count)
+{
+    size_t i = 0;
+    while (i < count && font_has_codepoint(font, codepoints[i])) ++i;
+    return i;
+}
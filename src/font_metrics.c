@@ -0,0 +1,66 @@
+#include "font_metrics.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void
+font_metrics_init(font_metrics *metrics, const font *font, f32 pixel_height)
+{
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->font = font;
+    metrics->pixel_height = pixel_height;
+    metrics->scale = stbtt_ScaleForPixelHeight(&font->info, pixel_height);
+
+    s32 ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &line_gap);
+    metrics->ascent = ascent * metrics->scale;
+    metrics->descent = descent * metrics->scale;
+    metrics->line_gap = line_gap * metrics->scale;
+
+    for (u32 codepoint = 0; codepoint < FONT_METRICS_DENSE_RANGE; ++codepoint) {
+        s32 glyph_index = font_glyph_index(font, codepoint);
+        s32 advance, left_side_bearing;
+        stbtt_GetGlyphHMetrics(&font->info, glyph_index, &advance, &left_side_bearing);
+        metrics->glyph_index[codepoint] = glyph_index;
+        metrics->advance[codepoint] = advance * metrics->scale;
+    }
+
+    // The font reads its kerning pairs once, every size only scales them
+    const font_kerning *kerning = &font->kerning;
+    memcpy(metrics->kerning_class, kerning->class_of, sizeof(metrics->kerning_class));
+    u32 classes = metrics->kerning_class_count = kerning->class_count;
+    metrics->kerning = (f32 *)malloc((size_t)classes * classes * sizeof(f32));
+    if (!metrics->kerning) LOG_FATAL("Could not allocate %ux%u kerning matrix.", classes, classes);
+    for (u32 i = 0; i < classes * classes; ++i) {
+        metrics->kerning[i] = kerning->pairs[i] * metrics->scale;
+    }
+}
+
+void
+font_metrics_free(font_metrics *metrics)
+{
+    free(metrics->kerning);
+    memset(metrics, 0, sizeof(*metrics));
+}
+
+s32
+font_metrics_glyph_index_slow(const font_metrics *metrics, u32 codepoint)
+{
+    return font_glyph_index(metrics->font, codepoint);
+}
+
+f32
+font_metrics_advance_slow(const font_metrics *metrics, u32 codepoint)
+{
+    s32 advance, left_side_bearing;
+    stbtt_GetGlyphHMetrics(&metrics->font->info, font_glyph_index(metrics->font, codepoint), &advance, &left_side_bearing);
+    return advance * metrics->scale;
+}
+
+f32
+font_metrics_kerning_slow(const font_metrics *metrics, u32 left, u32 right)
+{
+    const font *font = metrics->font;
+    return stbtt_GetGlyphKernAdvance(&font->info, font_glyph_index(font, left), font_glyph_index(font, right)) * metrics->scale;
+}
@@ -0,0 +1,83 @@
+#include "frame_scheduler.h"
+
+#include <string.h>
+
+void
+frame_scheduler_init(frame_scheduler *scheduler, frame_wake_fn wake, void *arg)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    pthread_mutex_init(&scheduler->mutex, NULL);
+    scheduler->wake = wake;
+    scheduler->wake_arg = arg;
+    scheduler->blink_interval = FRAME_BLINK_INTERVAL;
+    scheduler->blink_timeout = FRAME_BLINK_TIMEOUT;
+    scheduler->next_blink = -1.0;
+    scheduler->cursor_visible = true;
+    // The first frame is drawn without waiting for anything
+    scheduler->dirty = FRAME_DIRTY_RESIZE;
+}
+
+void
+frame_scheduler_free(frame_scheduler *scheduler)
+{
+    pthread_mutex_destroy(&scheduler->mutex);
+    memset(scheduler, 0, sizeof(*scheduler));
+}
+
+void
+frame_scheduler_mark_dirty(frame_scheduler *scheduler, u32 reasons)
+{
+    pthread_mutex_lock(&scheduler->mutex);
+    b32 pending = scheduler->dirty != 0;
+    scheduler->dirty |= reasons;
+    if (!pending) ++scheduler->wakeups;
+    pthread_mutex_unlock(&scheduler->mutex);
+    if (!pending && scheduler->wake) scheduler->wake(scheduler->wake_arg);
+}
+
+void
+frame_scheduler_input(frame_scheduler *scheduler, f64 now)
+{
+    scheduler->cursor_visible = true;
+    scheduler->next_blink = now + scheduler->blink_interval;
+    scheduler->blink_until = now + scheduler->blink_timeout;
+    frame_scheduler_mark_dirty(scheduler, FRAME_DIRTY_INPUT);
+}
+
+f64
+frame_scheduler_timeout(frame_scheduler *scheduler, f64 now)
+{
+    pthread_mutex_lock(&scheduler->mutex);
+    u32 dirty = scheduler->dirty;
+    pthread_mutex_unlock(&scheduler->mutex);
+    if (dirty) return 0.0;
+    if (scheduler->next_blink < 0.0) return -1.0;
+    return scheduler->next_blink > now ? scheduler->next_blink - now : 0.0;
+}
+
+u32
+frame_scheduler_begin_frame(frame_scheduler *scheduler, f64 now)
+{
+    u32 blink = 0;
+    if (scheduler->next_blink >= 0.0 && now >= scheduler->next_blink) {
+        if (now >= scheduler->blink_until) {
+            // Stops with the cursor shown
+            if (!scheduler->cursor_visible) blink = FRAME_DIRTY_BLINK;
+            scheduler->cursor_visible = true;
+            scheduler->next_blink = -1.0;
+        } else {
+            scheduler->cursor_visible = !scheduler->cursor_visible;
+            blink = FRAME_DIRTY_BLINK;
+            // A late wakeup does not make up for the blinks it missed
+            scheduler->next_blink += scheduler->blink_interval;
+            if (scheduler->next_blink <= now) scheduler->next_blink = now + scheduler->blink_interval;
+        }
+    }
+
+    pthread_mutex_lock(&scheduler->mutex);
+    u32 dirty = scheduler->dirty | blink;
+    scheduler->dirty = 0;
+    pthread_mutex_unlock(&scheduler->mutex);
+    if (dirty) ++scheduler->frames;
+    return dirty;
+}
@@ -0,0 +1,148 @@
+#include "frame_stats.h"
+#include "log.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+f64
+frame_stats_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
+}
+
+const char *
+frame_stage_name(frame_stage stage)
+{
+    switch (stage) {
+    case FRAME_STAGE_INPUT: return "input";
+    case FRAME_STAGE_LAYOUT: return "layout";
+    case FRAME_STAGE_RASTER: return "raster";
+    case FRAME_STAGE_COMPOSE: return "compose";
+    case FRAME_STAGE_OVERLAY: return "overlay";
+    case FRAME_STAGE_PRESENT: return "present";
+    case FRAME_STAGE_FRAME: return "frame";
+    default: return "unknown";
+    }
+}
+
+void
+frame_stats_init(frame_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void
+frame_stats_begin_frame(frame_stats *stats, f64 now)
+{
+    stats->frame_start = now;
+    memset(stats->current, 0, sizeof(stats->current));
+    stats->current_stages = 0;
+    stats->current_misses = 0;
+}
+
+void
+frame_stats_add(frame_stats *stats, frame_stage stage, f64 seconds)
+{
+    stats->current[stage] += seconds;
+    stats->current_stages |= 1u << stage;
+}
+
+void
+frame_stats_add_glyph_misses(frame_stats *stats, u64 misses)
+{
+    stats->current_misses += misses;
+}
+
+static void
+frame_stats_push(frame_stats_ring *ring, f64 sample)
+{
+    ring->samples[ring->next] = sample;
+    ring->next = (ring->next + 1) % FRAME_STATS_HISTORY;
+    if (ring->count < FRAME_STATS_HISTORY) ++ring->count;
+}
+
+void
+frame_stats_end_frame(frame_stats *stats, f64 now)
+{
+    frame_stats_add(stats, FRAME_STAGE_FRAME, now - stats->frame_start);
+    for (u32 stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+        if (stats->current_stages & (1u << stage)) frame_stats_push(&stats->stages[stage], stats->current[stage]);
+    }
+    frame_stats_push(&stats->glyph_misses, (f64)stats->current_misses);
+    stats->total_glyph_misses += stats->current_misses;
+    ++stats->frames;
+}
+
+static int
+frame_stats_compare(const void *a, const void *b)
+{
+    f64 x = *(const f64 *)a;
+    f64 y = *(const f64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentiles of the samples
+static frame_stats_summary
+frame_stats_summarize_ring(const frame_stats_ring *ring)
+{
+    frame_stats_summary summary = {0};
+    summary.count = ring->count;
+    if (ring->count == 0) return summary;
+
+    f64 sorted[FRAME_STATS_HISTORY];
+    memcpy(sorted, ring->samples, ring->count * sizeof(f64));
+    qsort(sorted, ring->count, sizeof(f64), frame_stats_compare);
+    summary.p50 = sorted[(u32)ceil(0.50 * ring->count) - 1];
+    summary.p95 = sorted[(u32)ceil(0.95 * ring->count) - 1];
+    summary.p99 = sorted[(u32)ceil(0.99 * ring->count) - 1];
+    summary.max = sorted[ring->count - 1];
+    return summary;
+}
+
+frame_stats_summary
+frame_stats_summarize(const frame_stats *stats, frame_stage stage)
+{
+    return frame_stats_summarize_ring(&stats->stages[stage]);
+}
+
+frame_stats_summary
+frame_stats_summarize_glyph_misses(const frame_stats *stats)
+{
+    return frame_stats_summarize_ring(&stats->glyph_misses);
+}
+
+b32
+frame_stats_write_json(const frame_stats *stats, const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        LOG_ERROR("Could not open %s.", path);
+        return false;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long)stats->frames);
+    fprintf(out, "  \"history\": %u,\n", FRAME_STATS_HISTORY);
+    fprintf(out, "  \"stages\": {\n");
+    for (u32 stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+        frame_stats_summary summary = frame_stats_summarize(stats, (frame_stage)stage);
+        fprintf(out, "    \"%s\": {\"samples\": %u, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, "
+                "\"max_ms\": %.4f}%s\n", frame_stage_name((frame_stage)stage), summary.count,
+                summary.p50 * 1000.0, summary.p95 * 1000.0, summary.p99 * 1000.0, summary.max * 1000.0,
+                stage + 1 < FRAME_STAGE_COUNT ? "," : "");
+    }
+    fprintf(out, "  },\n");
+    frame_stats_summary misses = frame_stats_summarize_glyph_misses(stats);
+    fprintf(out, "  \"glyph_misses\": {\"samples\": %u, \"p50\": %.0f, \"p95\": %.0f, \"p99\": %.0f, "
+            "\"max\": %.0f, \"total\": %llu}\n", misses.count, misses.p50, misses.p95, misses.p99, misses.max,
+            (unsigned long long)stats->total_glyph_misses);
+    fprintf(out, "}\n");
+    b32 written = !ferror(out);
+    if (fclose(out) != 0) written = false;
+    if (!written) LOG_ERROR("Could not write %s.", path);
+    return written;
+}
@@ -0,0 +1,155 @@
+#include "glyph_atlas.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void
+atlas_page_init(glyph_atlas *atlas, atlas_page *page)
+{
+    memset(page, 0, sizeof(*page));
+    page->pixels = (u8 *)calloc((size_t)atlas->page_width * atlas->page_height, 1);
+    if (!page->pixels) LOG_FATAL("Could not allocate %ux%u glyph atlas page.", atlas->page_width, atlas->page_height);
+}
+
+static b32
+atlas_page_alloc(glyph_atlas *atlas, atlas_page *page, u32 width, u32 height, atlas_region *region)
+{
+    // Best fit: the lowest shelf that is tall enough without wasting more than
+    // a quarter of its height on this glyph.
+    atlas_shelf *best = NULL;
+    for (u32 i = 0; i < page->shelf_count; ++i) {
+        atlas_shelf *shelf = &page->shelves[i];
+        if (shelf->height < height || shelf->height > height + height / 4 + 1) continue;
+        if (shelf->x + width > atlas->page_width) continue;
+        if (!best || shelf->height < best->height) best = shelf;
+    }
+
+    if (!best) {
+        if (page->bottom + height > atlas->page_height) return false;
+
+        if (page->shelf_count == page->shelf_capacity) {
+            page->shelf_capacity = page->shelf_capacity ? page->shelf_capacity * 2 : 16;
+            page->shelves = (atlas_shelf *)realloc(page->shelves, page->shelf_capacity * sizeof(atlas_shelf));
+            if (!page->shelves) LOG_FATAL("Could not grow glyph atlas shelves.");
+        }
+        best = &page->shelves[page->shelf_count++];
+        best->y = page->bottom;
+        best->height = height;
+        best->x = 0;
+        page->bottom += height;
+    }
+
+    region->x = best->x;
+    region->y = best->y;
+    best->x += width;
+    ++page->region_count;
+    return true;
+}
+
+void
+glyph_atlas_init(glyph_atlas *atlas, u32 page_width, u32 page_height, u32 padding, u32 max_pages)
+{
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->page_width = page_width;
+    atlas->page_height = page_height;
+    atlas->padding = padding;
+    atlas->max_pages = max_pages > 0 ? max_pages : 1;
+    atlas->pages = (atlas_page *)calloc(atlas->max_pages, sizeof(atlas_page));
+    if (!atlas->pages) LOG_FATAL("Could not allocate glyph atlas with %u pages.", atlas->max_pages);
+}
+
+void
+glyph_atlas_free(glyph_atlas *atlas)
+{
+    for (u32 i = 0; i < atlas->page_count; ++i) {
+        free(atlas->pages[i].pixels);
+        free(atlas->pages[i].shelves);
+    }
+    free(atlas->pages);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+void
+glyph_atlas_clear(glyph_atlas *atlas)
+{
+    for (u32 i = 0; i < atlas->page_count; ++i) {
+        glyph_atlas_reset_page(atlas, i);
+    }
+}
+
+b32
+glyph_atlas_fits(const glyph_atlas *atlas, u32 width, u32 height)
+{
+    return width + atlas->padding <= atlas->page_width && height + atlas->padding <= atlas->page_height;
+}
+
+b32
+glyph_atlas_alloc(glyph_atlas *atlas, u32 width, u32 height, u64 frame, atlas_region *region)
+{
+    if (!glyph_atlas_fits(atlas, width, height)) return false;
+
+    // Padding goes to the right of and below each region so neighbouring
+    // glyphs never bleed into each other when sampled with filtering.
+    u32 padded_width = width + atlas->padding;
+    u32 padded_height = height + atlas->padding;
+
+    region->width = width;
+    region->height = height;
+
+    for (u32 i = 0; i < atlas->page_count; ++i) {
+        if (atlas_page_alloc(atlas, &atlas->pages[i], padded_width, padded_height, region)) {
+            region->page = i;
+            glyph_atlas_touch(atlas, i, frame);
+            return true;
+        }
+    }
+
+    if (atlas->page_count < atlas->max_pages) {
+        u32 index = atlas->page_count++;
+        atlas_page_init(atlas, &atlas->pages[index]);
+        LOG_TRACE("Glyph atlas grew to %u pages.", atlas->page_count);
+        if (atlas_page_alloc(atlas, &atlas->pages[index], padded_width, padded_height, region)) {
+            region->page = index;
+            glyph_atlas_touch(atlas, index, frame);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+glyph_atlas_touch(glyph_atlas *atlas, u32 page, u64 frame)
+{
+    if (atlas->pages[page].last_used < frame) {
+        atlas->pages[page].last_used = frame;
+    }
+}
+
+u32
+glyph_atlas_lru_page(const glyph_atlas *atlas)
+{
+    u32 lru = 0;
+    for (u32 i = 1; i < atlas->page_count; ++i) {
+        if (atlas->pages[i].last_used < atlas->pages[lru].last_used) lru = i;
+    }
+    return lru;
+}
+
+void
+glyph_atlas_reset_page(glyph_atlas *atlas, u32 page_index)
+{
+    atlas_page *page = &atlas->pages[page_index];
+    memset(page->pixels, 0, (size_t)atlas->page_width * atlas->page_height);
+    page->shelf_count = 0;
+    page->bottom = 0;
+    page->region_count = 0;
+    page->last_used = 0;
+}
+
+u8 *
+glyph_atlas_region_pixels(const glyph_atlas *atlas, const atlas_region *region)
+{
+    return atlas->pages[region->page].pixels + (size_t)region->y * atlas->page_width + region->x;
+}
@@ -0,0 +1,440 @@
+#include "glyph_cache.h"
+#include "log.h"
+#include "sdf.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLYPH_CACHE_MIN_CAPACITY 64
+#define GLYPH_CACHE_ATLAS_PADDING 1
+
+static u32
+hash_glyph_key(const glyph_key *key)
+{
+    // FNV-1a over the individual key fields, so struct padding never
+    // influences the hash.
+    u32 hash = 2166136261u;
+    u8 bytes[sizeof(key->font) + sizeof(key->glyph_index) + sizeof(key->pixel_height) +
+             sizeof(key->subpixel_phase) + sizeof(key->mode)];
+    size_t n = 0;
+    memcpy(bytes + n, &key->font, sizeof(key->font));                     n += sizeof(key->font);
+    memcpy(bytes + n, &key->glyph_index, sizeof(key->glyph_index));       n += sizeof(key->glyph_index);
+    memcpy(bytes + n, &key->pixel_height, sizeof(key->pixel_height));     n += sizeof(key->pixel_height);
+    memcpy(bytes + n, &key->subpixel_phase, sizeof(key->subpixel_phase)); n += sizeof(key->subpixel_phase);
+    memcpy(bytes + n, &key->mode, sizeof(key->mode));                     n += sizeof(key->mode);
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static b32
+glyph_keys_equal(const glyph_key *a, const glyph_key *b)
+{
+    return a->font == b->font &&
+        a->glyph_index == b->glyph_index &&
+        a->pixel_height == b->pixel_height &&
+        a->subpixel_phase == b->subpixel_phase &&
+        a->mode == b->mode;
+}
+
+static glyph_cache_slot *
+glyph_cache_find_slot(glyph_cache_slot *slots, u32 capacity, const glyph_key *key)
+{
+    u32 mask = capacity - 1;
+    u32 index = hash_glyph_key(key) & mask;
+    while (slots[index].occupied && !glyph_keys_equal(&slots[index].key, key)) {
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+static void
+glyph_cache_rehash(glyph_cache *cache, u32 new_capacity, s64 dropped_page)
+{
+    glyph_cache_slot *new_slots = (glyph_cache_slot *)calloc(new_capacity, sizeof(glyph_cache_slot));
+    if (!new_slots) LOG_FATAL("Could not resize glyph cache to %u slots.", new_capacity);
+
+    u32 count = 0;
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        glyph_cache_slot *slot = &cache->slots[i];
+        if (!slot->occupied) continue;
+        if (!slot->oversized && (s64)slot->glyph.region.page == dropped_page) continue;
+        *glyph_cache_find_slot(new_slots, new_capacity, &slot->key) = *slot;
+        ++count;
+    }
+
+    free(cache->slots);
+    cache->slots = new_slots;
+    cache->capacity = new_capacity;
+    cache->count = count;
+}
+
+static void
+glyph_cache_free_oversized(glyph_cache *cache)
+{
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        if (cache->slots[i].occupied && cache->slots[i].oversized) {
+            free(cache->slots[i].glyph.coverage);
+        }
+    }
+}
+
+static void
+glyph_cache_insert(glyph_cache *cache, const glyph_cache_slot *slot)
+{
+    // Keep the load factor below 3/4 so probe sequences stay short.
+    if ((cache->count + 1) * 4 > cache->capacity * 3) {
+        glyph_cache_rehash(cache, cache->capacity * 2, -1);
+    }
+    *glyph_cache_find_slot(cache->slots, cache->capacity, &slot->key) = *slot;
+    ++cache->count;
+}
+
+// Evicts the least recently used atlas page. Glyphs on it that were used in
+// the current frame are compacted back into the emptied page, so the frame
+// being drawn does not have to rasterize them again.
+static void
+glyph_cache_evict_page(glyph_cache *cache)
+{
+    glyph_atlas *atlas = &cache->atlas;
+    u32 page = glyph_atlas_lru_page(atlas);
+
+    glyph_cache_slot *hot = NULL;
+    u8 **hot_pixels = NULL;
+    u32 hot_count = 0;
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        glyph_cache_slot *slot = &cache->slots[i];
+        if (!slot->occupied || slot->oversized || slot->glyph.region.page != page) continue;
+        if (slot->last_used != cache->frame) continue;
+
+        hot = (glyph_cache_slot *)realloc(hot, (hot_count + 1) * sizeof(glyph_cache_slot));
+        hot_pixels = (u8 **)realloc(hot_pixels, (hot_count + 1) * sizeof(u8 *));
+        if (!hot || !hot_pixels) LOG_FATAL("Could not allocate glyph cache compaction buffer.");
+
+        const cached_glyph *glyph = &slot->glyph;
+        u8 *pixels = (u8 *)malloc((size_t)glyph->width * glyph->height);
+        if (!pixels) LOG_FATAL("Could not allocate glyph cache compaction buffer.");
+        for (s32 row = 0; row < glyph->height; ++row) {
+            memcpy(pixels + row * glyph->width, glyph->coverage + row * glyph->stride, glyph->width);
+        }
+        hot[hot_count] = *slot;
+        hot_pixels[hot_count] = pixels;
+        ++hot_count;
+    }
+
+    glyph_cache_rehash(cache, cache->capacity, page);
+    glyph_atlas_reset_page(atlas, page);
+    ++cache->evictions;
+
+    u32 kept = 0;
+    for (u32 i = 0; i < hot_count; ++i) {
+        cached_glyph *glyph = &hot[i].glyph;
+        // Usually lands in the page that was just reset. The other pages had
+        // no room for the glyph that forced the eviction, but may still fit
+        // a smaller one, and any page will do. A glyph that fits nowhere is
+        // dropped and rasterized again when it is next drawn.
+        if (glyph_atlas_alloc(atlas, glyph->width, glyph->height, cache->frame, &glyph->region)) {
+            glyph->coverage = glyph_atlas_region_pixels(atlas, &glyph->region);
+            glyph->stride = atlas->page_width;
+            for (s32 row = 0; row < glyph->height; ++row) {
+                memcpy(glyph->coverage + row * glyph->stride, hot_pixels[i] + row * glyph->width, glyph->width);
+            }
+            glyph_cache_insert(cache, &hot[i]);
+            ++kept;
+        }
+        free(hot_pixels[i]);
+    }
+    free(hot);
+    free(hot_pixels);
+
+    LOG_TRACE("Evicted glyph atlas page %u, kept %u of its glyphs.", page, kept);
+}
+
+static b32
+glyph_cache_alloc_region(glyph_cache *cache, u32 width, u32 height, atlas_region *region)
+{
+    glyph_atlas *atlas = &cache->atlas;
+    if (glyph_atlas_alloc(atlas, width, height, cache->frame, region)) return true;
+
+    glyph_cache_evict_page(cache);
+    if (glyph_atlas_alloc(atlas, width, height, cache->frame, region)) return true;
+
+    // The working set of this frame is larger than the atlas. Drop the page
+    // outright; glyphs handed out earlier in the frame have already been drawn.
+    u32 page = glyph_atlas_lru_page(atlas);
+    glyph_cache_rehash(cache, cache->capacity, page);
+    glyph_atlas_reset_page(atlas, page);
+    ++cache->evictions;
+    return glyph_atlas_alloc(atlas, width, height, cache->frame, region);
+}
+
+void
+glyph_cache_init(glyph_cache *cache, u32 initial_capacity, u32 atlas_page_size, u32 atlas_max_pages)
+{
+    u32 capacity = GLYPH_CACHE_MIN_CAPACITY;
+    while (capacity < initial_capacity) capacity *= 2;
+
+    memset(cache, 0, sizeof(*cache));
+    cache->capacity = capacity;
+    cache->slots = (glyph_cache_slot *)calloc(capacity, sizeof(glyph_cache_slot));
+    if (!cache->slots) LOG_FATAL("Could not allocate glyph cache with %u slots.", capacity);
+
+    glyph_atlas_init(&cache->atlas, atlas_page_size, atlas_page_size, GLYPH_CACHE_ATLAS_PADDING, atlas_max_pages);
+    cache->frame = 1;
+}
+
+void
+glyph_cache_free(glyph_cache *cache)
+{
+    glyph_cache_free_oversized(cache);
+    glyph_atlas_free(&cache->atlas);
+    free(cache->slots);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void
+glyph_cache_clear(glyph_cache *cache)
+{
+    glyph_cache_free_oversized(cache);
+    glyph_atlas_clear(&cache->atlas);
+    memset(cache->slots, 0, cache->capacity * sizeof(glyph_cache_slot));
+    cache->count = 0;
+}
+
+void
+glyph_cache_begin_frame(glyph_cache *cache)
+{
+    ++cache->frame;
+}
+
+u32
+glyph_cache_subpixel_phase(f32 x)
+{
+    // Truncating keeps the glyph inside the pixel given by floorf(x), which is
+    // where callers place it.
+    f32 fraction = x - floorf(x);
+    u32 phase = (u32)(fraction * GLYPH_CACHE_SUBPIXEL_STEPS);
+    return phase < GLYPH_CACHE_SUBPIXEL_STEPS ? phase : GLYPH_CACHE_SUBPIXEL_STEPS - 1;
+}
+
+static glyph_key
+glyph_cache_make_key(const stbtt_fontinfo *font, s32 glyph_index, f32 pixel_height, u32 subpixel_phase,
+                     glyph_mode mode)
+{
+    glyph_key key;
+    memset(&key, 0, sizeof(key));
+    key.font = font;
+    key.glyph_index = glyph_index;
+    key.pixel_height = pixel_height;
+    key.subpixel_phase = subpixel_phase;
+    key.mode = mode;
+    return key;
+}
+
+static void
+glyph_cache_touch(glyph_cache *cache, glyph_cache_slot *slot)
+{
+    slot->last_used = cache->frame;
+    if (!slot->oversized) glyph_atlas_touch(&cache->atlas, slot->glyph.region.page, cache->frame);
+}
+
+// Fills in the metrics of a glyph that is not cached yet and reserves storage
+// for its coverage, leaving rasterization to the caller. Without may_evict,
+// returns false instead of evicting when the atlas is full.
+static b32
+glyph_cache_prepare(glyph_cache *cache, const glyph_key *key, b32 may_evict, glyph_cache_slot *slot)
+{
+    memset(slot, 0, sizeof(*slot));
+    slot->key = *key;
+    slot->last_used = cache->frame;
+    slot->occupied = true;
+
+    cached_glyph *glyph = &slot->glyph;
+    const stbtt_fontinfo *font = key->font;
+    f32 scale = stbtt_ScaleForPixelHeight(font, key->pixel_height);
+    f32 shift_x = (f32)key->subpixel_phase / GLYPH_CACHE_SUBPIXEL_STEPS;
+
+    stbtt_GetGlyphHMetrics(font, key->glyph_index, &glyph->advance, &glyph->left_side_bearing);
+
+    s32 x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(font, key->glyph_index, scale, scale, shift_x, 0.0f, &x0, &y0, &x1, &y1);
+    if (key->mode == GLYPH_MODE_SDF && x0 != x1 && y0 != y1) {
+        x0 -= GLYPH_CACHE_SDF_PADDING;
+        y0 -= GLYPH_CACHE_SDF_PADDING;
+        x1 += GLYPH_CACHE_SDF_PADDING;
+        y1 += GLYPH_CACHE_SDF_PADDING;
+    }
+    glyph->width = x1 - x0;
+    glyph->height = y1 - y0;
+    glyph->x_offset = x0;
+    glyph->y_offset = y0;
+    glyph->scale = scale;
+
+    if (glyph->width <= 0 || glyph->height <= 0) return true;
+
+    if (glyph_atlas_fits(&cache->atlas, glyph->width, glyph->height)) {
+        if (glyph_atlas_alloc(&cache->atlas, glyph->width, glyph->height, cache->frame, &glyph->region) ||
+            (may_evict && glyph_cache_alloc_region(cache, glyph->width, glyph->height, &glyph->region))) {
+            glyph->coverage = glyph_atlas_region_pixels(&cache->atlas, &glyph->region);
+            glyph->stride = cache->atlas.page_width;
+            return true;
+        }
+        if (!may_evict) return false;
+    }
+
+    glyph->coverage = (u8 *)calloc((size_t)glyph->width * glyph->height, 1);
+    if (!glyph->coverage) LOG_FATAL("Could not allocate %dx%d glyph.", glyph->width, glyph->height);
+    glyph->stride = glyph->width;
+    slot->oversized = true;
+    return true;
+}
+
+// Only reads the font and writes the glyph's own coverage, so different
+// glyphs can be rasterized on different threads.
+static void
+glyph_cache_rasterize(const glyph_cache_slot *slot)
+{
+    const cached_glyph *glyph = &slot->glyph;
+    if (!glyph->coverage) return;
+
+    if (slot->key.mode == GLYPH_MODE_SDF) {
+        sdf_render_glyph(slot->key.font, glyph->scale, slot->key.glyph_index,
+                         GLYPH_CACHE_SDF_ONEDGE_VALUE, GLYPH_CACHE_SDF_PIXEL_DIST_SCALE,
+                         glyph->x_offset, glyph->y_offset, glyph->width, glyph->height,
+                         glyph->coverage, glyph->stride);
+        return;
+    }
+
+    f32 shift_x = (f32)slot->key.subpixel_phase / GLYPH_CACHE_SUBPIXEL_STEPS;
+    stbtt_MakeGlyphBitmapSubpixel(slot->key.font, glyph->coverage, glyph->width, glyph->height, glyph->stride,
+                                  glyph->scale, glyph->scale, shift_x, 0.0f, slot->key.glyph_index);
+}
+
+static const cached_glyph *
+glyph_cache_lookup(glyph_cache *cache, const glyph_key *key)
+{
+    glyph_cache_slot *slot = glyph_cache_find_slot(cache->slots, cache->capacity, key);
+    if (slot->occupied) {
+        ++cache->hits;
+        glyph_cache_touch(cache, slot);
+        return &slot->glyph;
+    }
+    ++cache->misses;
+
+    glyph_cache_slot new_slot;
+    glyph_cache_prepare(cache, key, true, &new_slot);
+    glyph_cache_rasterize(&new_slot);
+
+    glyph_cache_insert(cache, &new_slot);
+    return &glyph_cache_find_slot(cache->slots, cache->capacity, key)->glyph;
+}
+
+const cached_glyph *
+glyph_cache_get(glyph_cache *cache, const stbtt_fontinfo *font,
+                s32 glyph_index, f32 pixel_height, u32 subpixel_phase)
+{
+    glyph_key key = glyph_cache_make_key(font, glyph_index, pixel_height, subpixel_phase, GLYPH_MODE_COVERAGE);
+    return glyph_cache_lookup(cache, &key);
+}
+
+const cached_glyph *
+glyph_cache_get_sdf(glyph_cache *cache, const stbtt_fontinfo *font, s32 glyph_index)
+{
+    glyph_key key = glyph_cache_make_key(font, glyph_index, GLYPH_CACHE_SDF_PIXEL_HEIGHT, 0, GLYPH_MODE_SDF);
+    return glyph_cache_lookup(cache, &key);
+}
+
+typedef struct {
+    const glyph_cache_slot *slots;
+    u32 count;
+} glyph_raster_job;
+
+static void
+glyph_raster_job_run(void *arg)
+{
+    glyph_raster_job *job = (glyph_raster_job *)arg;
+    for (u32 i = 0; i < job->count; ++i) {
+        glyph_cache_rasterize(&job->slots[i]);
+    }
+}
+
+static void
+glyph_cache_rasterize_parallel(thread_pool *pool, const glyph_cache_slot *slots, u32 count)
+{
+    if (count == 0) return;
+
+    // A few jobs per worker, so a run of unusually large glyphs does not
+    // leave the other workers idle.
+    u32 job_count = pool->thread_count * 4;
+    if (job_count > count) job_count = count;
+
+    glyph_raster_job *jobs = (glyph_raster_job *)calloc(job_count, sizeof(glyph_raster_job));
+    if (!jobs) LOG_FATAL("Could not allocate %u glyph rasterization jobs.", job_count);
+
+    thread_pool_group group = {0};
+    u32 first = 0;
+    for (u32 i = 0; i < job_count; ++i) {
+        u32 last = (u32)(((u64)count * (i + 1)) / job_count);
+        jobs[i].slots = slots + first;
+        jobs[i].count = last - first;
+        thread_pool_submit(pool, &group, glyph_raster_job_run, &jobs[i]);
+        first = last;
+    }
+    thread_pool_wait(pool, &group);
+    free(jobs);
+}
+
+static void
+glyph_cache_warm_mode(glyph_cache *cache, thread_pool *pool, const stbtt_fontinfo *font, f32 pixel_height,
+                      const s32 *glyph_indices, const u32 *subpixel_phases, u32 count, glyph_mode mode)
+{
+    glyph_cache_slot *pending = (glyph_cache_slot *)malloc((size_t)count * sizeof(glyph_cache_slot));
+    if (count > 0 && !pending) LOG_FATAL("Could not allocate glyph warm-up list of %u glyphs.", count);
+    u32 pending_count = 0;
+
+    for (u32 i = 0; i < count; ++i) {
+        glyph_key key = glyph_cache_make_key(font, glyph_indices[i], pixel_height,
+                                             subpixel_phases ? subpixel_phases[i] : 0, mode);
+        glyph_cache_slot *slot = glyph_cache_find_slot(cache->slots, cache->capacity, &key);
+        if (slot->occupied) {
+            glyph_cache_touch(cache, slot);
+            continue;
+        }
+        ++cache->misses;
+
+        glyph_cache_slot new_slot;
+        if (!glyph_cache_prepare(cache, &key, false, &new_slot)) {
+            // Eviction may compact glyphs of this warm-up into a new place,
+            // so everything packed so far has to be rasterized first.
+            glyph_cache_rasterize_parallel(pool, pending, pending_count);
+            pending_count = 0;
+            glyph_cache_prepare(cache, &key, true, &new_slot);
+        }
+
+        glyph_cache_insert(cache, &new_slot);
+        pending[pending_count++] = new_slot;
+    }
+
+    glyph_cache_rasterize_parallel(pool, pending, pending_count);
+    free(pending);
+}
+
+void
+glyph_cache_warm(glyph_cache *cache, thread_pool *pool, const stbtt_fontinfo *font, f32 pixel_height,
+                 const s32 *glyph_indices, const u32 *subpixel_phases, u32 count)
+{
+    glyph_cache_warm_mode(cache, pool, font, pixel_height, glyph_indices, subpixel_phases, count,
+                          GLYPH_MODE_COVERAGE);
+}
+
+void
+glyph_cache_warm_sdf(glyph_cache *cache, thread_pool *pool, const stbtt_fontinfo *font,
+                     const s32 *glyph_indices, u32 count)
+{
+    glyph_cache_warm_mode(cache, pool, font, GLYPH_CACHE_SDF_PIXEL_HEIGHT, glyph_indices, NULL, count,
+                          GLYPH_MODE_SDF);
+}
@@ -0,0 +1,128 @@
+#include "headless.h"
+#include "compositor.h"
+#include "file_index.h"
+#include "font.h"
+#include "font_metrics.h"
+#include "frame_stats.h"
+#include "glyph_cache.h"
+#include "layout.h"
+#include "log.h"
+#include "text_view.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "stb/stb_image_write.h"
+
+const char *
+headless_stage_name(headless_stage stage)
+{
+    switch (stage) {
+    case HEADLESS_STAGE_OPEN: return "open";
+    case HEADLESS_STAGE_FONT: return "font";
+    case HEADLESS_STAGE_LAYOUT: return "layout";
+    case HEADLESS_STAGE_RASTER: return "raster";
+    case HEADLESS_STAGE_DRAW: return "draw";
+    case HEADLESS_STAGE_COMPOSE: return "compose";
+    case HEADLESS_STAGE_ENCODE: return "encode";
+    default: return "unknown";
+    }
+}
+
+b32
+headless_render(const headless_options *options, thread_pool *pool, headless_report *report)
+{
+    memset(report, 0, sizeof(*report));
+    f64 start = frame_stats_now();
+
+    // Indexed before anything is drawn, so every run draws the same lines
+    file_index file;
+    if (!file_index_open(&file, options->path, pool)) {
+        LOG_ERROR("Could not open file %s.", options->path);
+        return false;
+    }
+    if (pool) {
+        file_index_wait(&file);
+    } else {
+        while (file_index_slice(&file)) {}
+    }
+    f64 end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_OPEN] = end - start;
+
+    start = end;
+    font main_font;
+    if (!font_load(&main_font, options->font_path, 0, MAPPED_FILE_WILLNEED)) {
+        LOG_ERROR("Could not load font %s.", options->font_path);
+        file_index_close(&file);
+        return false;
+    }
+    font_metrics metrics;
+    font_metrics_init(&metrics, &main_font, options->pixel_height);
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_FONT] = end - start;
+
+    // The view finds every visible line laid out and every glyph cached, so
+    // drawing is timed on its own
+    text_view view;
+    u32 visible_lines = (u32)ceilf((f32)options->height / (metrics.ascent - metrics.descent + metrics.line_gap)) + 1;
+    layout_cache layout;
+    layout_cache_init(&layout, visible_lines > 1024 ? visible_lines : 1024);
+    glyph_cache cache;
+    glyph_cache_init(&cache, 1024, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+    text_view_init(&view, options->width, options->height, &metrics, &cache, &layout, pool, options->sdf_glyphs,
+                   file_index_line_text, &file);
+    text_view_set_cursor(&view, 0, 0, options->cursor != 0);
+
+    // Glyphs are collected with the view's own clip, so drawing rasterizes
+    // none of them
+    start = frame_stats_now();
+    u32 glyph_count = 0;
+    for (u64 line = 0; line < visible_lines; ++line) {
+        const layout_line *laid_out = text_view_layout_line(&view, line);
+        if (!laid_out) break;
+        ++report->lines;
+        glyph_count = text_view_collect_glyphs(&view, laid_out, view.width, glyph_count);
+    }
+    report->glyphs = glyph_count;
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_LAYOUT] = end - start;
+
+    start = end;
+    text_view_warm_glyphs(&view, glyph_count);
+    report->glyph_misses = cache.misses;
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_RASTER] = end - start;
+
+    start = end;
+    text_view_render(&view, NULL);
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_DRAW] = end - start;
+
+    start = end;
+    compositor_frame frame;
+    compositor_frame_init(&frame, options->width, options->height);
+    damage_rect all = {0, 0, options->width, options->height};
+    compositor_compose(&frame, view.pixels, view.width, all, options->foreground, options->background);
+    damage_rect cursor;
+    if (text_view_cursor_rect(&view, &cursor)) {
+        compositor_fill(&frame, cursor.x0, cursor.y0, cursor.x1, cursor.y1, options->cursor);
+    }
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_COMPOSE] = end - start;
+
+    start = end;
+    b32 written = stbi_write_png(options->out_path, frame.width, frame.height, 4, frame.pixels,
+                                 frame.width * (s32)sizeof(u32)) != 0;
+    if (!written) LOG_ERROR("Could not write %s.", options->out_path);
+    end = frame_stats_now();
+    report->seconds[HEADLESS_STAGE_ENCODE] = end - start;
+
+    compositor_frame_free(&frame);
+    text_view_free(&view);
+    glyph_cache_free(&cache);
+    layout_cache_free(&layout);
+    font_metrics_free(&metrics);
+    font_unload(&main_font);
+    file_index_close(&file);
+    return written;
+}
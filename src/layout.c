@@ -0,0 +1,331 @@
+#include "layout.h"
+#include "log.h"
+#include "utf8.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    f32 tab_advance;
+    f32 x;
+    u32 previous;
+} layout_pen;
+
+static inline void
+layout_place(layout_line *line, const font_metrics *metrics, layout_pen *pen, u32 codepoint, u32 offset)
+{
+    if (codepoint == '\t') {
+        if (pen->tab_advance > 0.0f) pen->x = (floorf(pen->x / pen->tab_advance + 0.001f) + 1.0f) * pen->tab_advance;
+        pen->previous = 0;
+        return;
+    }
+    if (codepoint == '\r' || codepoint == '\n') {
+        pen->previous = 0;
+        return;
+    }
+
+    if (pen->previous) pen->x += font_metrics_kerning(metrics, pen->previous, codepoint);
+
+    layout_glyph *glyph = &line->glyphs[line->glyph_count++];
+    glyph->glyph_index = font_metrics_glyph_index(metrics, codepoint);
+    glyph->x = pen->x;
+    glyph->offset = offset;
+
+    pen->x += font_metrics_advance(metrics, codepoint);
+    pen->previous = codepoint;
+}
+
+void
+layout_line_build(layout_line *line, const font_metrics *metrics, u32 tab_width, const u8 *text, u32 length)
+{
+    // A line never has more glyphs than bytes
+    if (line->glyph_capacity < length) {
+        line->glyph_capacity = length;
+        line->glyphs = (layout_glyph *)realloc(line->glyphs, (size_t)length * sizeof(layout_glyph));
+        if (!line->glyphs) LOG_FATAL("Could not allocate layout for a line of %u bytes.", length);
+    }
+    line->glyph_count = 0;
+
+    layout_pen pen = {tab_width * font_metrics_advance(metrics, ' '), 0.0f, 0};
+    u64 offset = 0;
+    while (offset < length) {
+        if (text[offset] < 0x80) {
+            // Runs of ASCII are measured a vector at a time and need no decoding
+            u64 ascii_end = offset + utf8_ascii_length(text + offset, length - offset);
+            for (; offset < ascii_end; ++offset) layout_place(line, metrics, &pen, text[offset], (u32)offset);
+            continue;
+        }
+        u32 start = (u32)offset;
+        u32 codepoint = utf8_decode_slow(text, length, &offset);
+        layout_place(line, metrics, &pen, codepoint, start);
+    }
+    line->width = pen.x;
+}
+
+void
+layout_line_free(layout_line *line)
+{
+    free(line->glyphs);
+    memset(line, 0, sizeof(*line));
+}
+
+static u64
+layout_mix(u64 hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Eight bytes per step, which keeps hashing well below the cost of decoding
+// the line again.
+static u64
+layout_hash_bytes(const u8 *bytes, u32 length, u64 seed)
+{
+    u64 hash = seed ^ ((u64)length * 0x9E3779B97F4A7C15ull);
+    u32 i = 0;
+    for (; i + 8 <= length; i += 8) {
+        u64 chunk;
+        memcpy(&chunk, bytes + i, sizeof(chunk));
+        hash = (hash ^ chunk) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    u64 tail = 0;
+    if (i < length) memcpy(&tail, bytes + i, length - i);
+    return layout_mix(hash ^ tail);
+}
+
+static u64
+layout_settings_hash(const font_metrics *metrics, u32 tab_width)
+{
+    u32 pixel_height;
+    memcpy(&pixel_height, &metrics->pixel_height, sizeof(pixel_height));
+    u64 hash = layout_mix((u64)(uintptr_t)metrics->font);
+    hash = layout_mix(hash ^ pixel_height);
+    return layout_mix(hash ^ tab_width);
+}
+
+void
+layout_cache_init(layout_cache *cache, u32 capacity)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->capacity = capacity > 0 ? capacity : 1;
+
+    u32 bucket_count = 16;
+    while (bucket_count < cache->capacity * 2) bucket_count *= 2;
+    cache->bucket_mask = bucket_count - 1;
+
+    // Room for a few screens of line numbers, however far into the file
+    cache->line_capacity = cache->capacity * 2 > 1024 ? cache->capacity * 2 : 1024;
+
+    cache->entries = (layout_cache_entry *)calloc(cache->capacity, sizeof(layout_cache_entry));
+    cache->buckets = (u32 *)malloc(bucket_count * sizeof(u32));
+    cache->lines = (layout_line_ref *)malloc(cache->line_capacity * sizeof(layout_line_ref));
+    if (!cache->entries || !cache->buckets || !cache->lines) {
+        LOG_FATAL("Could not allocate layout cache of %u lines.", capacity);
+    }
+
+    layout_cache_clear(cache);
+}
+
+void
+layout_cache_free(layout_cache *cache)
+{
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        layout_line_free(&cache->entries[i].line);
+        free(cache->entries[i].text);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->lines);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void
+layout_cache_clear(layout_cache *cache)
+{
+    memset(cache->buckets, 0xFF, (cache->bucket_mask + 1) * sizeof(u32));
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        layout_cache_entry *entry = &cache->entries[i];
+        entry->occupied = false;
+        ++entry->generation;
+        entry->bucket_next = LAYOUT_CACHE_NONE;
+        // Unused entries are chained in index order behind the used ones
+        entry->lru_prev = i > 0 ? i - 1 : LAYOUT_CACHE_NONE;
+        entry->lru_next = i + 1 < cache->capacity ? i + 1 : LAYOUT_CACHE_NONE;
+    }
+    cache->lru_head = 0;
+    cache->lru_tail = cache->capacity - 1;
+    cache->count = 0;
+    memset(cache->lines, 0, cache->line_capacity * sizeof(layout_line_ref));
+}
+
+static void
+layout_cache_unlink(layout_cache *cache, u32 index)
+{
+    layout_cache_entry *entry = &cache->entries[index];
+    if (entry->lru_prev != LAYOUT_CACHE_NONE) {
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != LAYOUT_CACHE_NONE) {
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+}
+
+static void
+layout_cache_touch(layout_cache *cache, u32 index)
+{
+    if (cache->lru_head == index) return;
+    layout_cache_unlink(cache, index);
+
+    layout_cache_entry *entry = &cache->entries[index];
+    entry->lru_prev = LAYOUT_CACHE_NONE;
+    entry->lru_next = cache->lru_head;
+    cache->entries[cache->lru_head].lru_prev = index;
+    cache->lru_head = index;
+}
+
+static void
+layout_cache_remove_from_bucket(layout_cache *cache, u32 index)
+{
+    layout_cache_entry *entry = &cache->entries[index];
+    u32 *link = &cache->buckets[entry->key & cache->bucket_mask];
+    while (*link != index) link = &cache->entries[*link].bucket_next;
+    *link = entry->bucket_next;
+    entry->bucket_next = LAYOUT_CACHE_NONE;
+}
+
+// Moves the window of line numbers to start at base, keeping the references
+// it still covers
+static void
+layout_cache_move_lines(layout_cache *cache, u64 base)
+{
+    u64 capacity = cache->line_capacity;
+    if (base > cache->line_base) {
+        u64 shift = base - cache->line_base < capacity ? base - cache->line_base : capacity;
+        memmove(cache->lines, cache->lines + shift, (capacity - shift) * sizeof(layout_line_ref));
+        memset(cache->lines + capacity - shift, 0, shift * sizeof(layout_line_ref));
+    } else {
+        u64 shift = cache->line_base - base < capacity ? cache->line_base - base : capacity;
+        memmove(cache->lines + shift, cache->lines, (capacity - shift) * sizeof(layout_line_ref));
+        memset(cache->lines, 0, shift * sizeof(layout_line_ref));
+    }
+    cache->line_base = base;
+}
+
+static layout_line_ref *
+layout_cache_line_ref(layout_cache *cache, u64 line_number)
+{
+    // Centred on the line, so scrolling either way moves it rarely
+    if (line_number < cache->line_base || line_number - cache->line_base >= cache->line_capacity) {
+        u64 half = cache->line_capacity / 2;
+        layout_cache_move_lines(cache, line_number > half ? line_number - half : 0);
+    }
+    return &cache->lines[line_number - cache->line_base];
+}
+
+const layout_line *
+layout_cache_get(layout_cache *cache, const font_metrics *metrics, u32 tab_width,
+                 u64 line_number, const u8 *text, u32 length)
+{
+    u64 settings = layout_settings_hash(metrics, tab_width);
+
+    layout_line_ref *ref = layout_cache_line_ref(cache, line_number);
+    if (ref->generation != 0 && ref->settings == settings) {
+        layout_cache_entry *entry = &cache->entries[ref->entry];
+        if (entry->occupied && entry->generation == ref->generation) {
+            ++cache->line_hits;
+            layout_cache_touch(cache, ref->entry);
+            return &entry->line;
+        }
+    }
+
+    u64 key = layout_hash_bytes(text, length, settings);
+    u32 index = cache->buckets[key & cache->bucket_mask];
+    while (index != LAYOUT_CACHE_NONE) {
+        layout_cache_entry *entry = &cache->entries[index];
+        // Lines that only share a hash are told apart by their bytes
+        if (entry->key == key && entry->settings == settings && entry->length == length &&
+            (length == 0 || memcmp(entry->text, text, length) == 0)) {
+            break;
+        }
+        index = entry->bucket_next;
+    }
+
+    if (index != LAYOUT_CACHE_NONE) {
+        ++cache->hits;
+    } else {
+        ++cache->misses;
+
+        // The tail is either unused or the least recently used line
+        index = cache->lru_tail;
+        layout_cache_entry *entry = &cache->entries[index];
+        if (entry->occupied) {
+            layout_cache_remove_from_bucket(cache, index);
+            ++cache->evictions;
+        } else {
+            ++cache->count;
+        }
+
+        if (length > entry->text_capacity) {
+            entry->text = (u8 *)realloc(entry->text, length);
+            if (!entry->text) LOG_FATAL("Could not allocate %u bytes of layout cache text.", length);
+            entry->text_capacity = length;
+        }
+        if (length > 0) memcpy(entry->text, text, length);
+        entry->key = key;
+        entry->settings = settings;
+        entry->length = length;
+        entry->occupied = true;
+        ++entry->generation;
+        if (entry->generation == 0) ++entry->generation;
+        entry->bucket_next = cache->buckets[key & cache->bucket_mask];
+        cache->buckets[key & cache->bucket_mask] = index;
+
+        layout_line_build(&entry->line, metrics, tab_width, text, length);
+    }
+
+    layout_cache_touch(cache, index);
+    ref->entry = index;
+    ref->generation = cache->entries[index].generation;
+    ref->settings = settings;
+    return &cache->entries[index].line;
+}
+
+void
+layout_cache_edit(layout_cache *cache, u64 first_line, u64 removed_lines, u64 inserted_lines)
+{
+    // Edits above the window only renumber it
+    u64 capacity = cache->line_capacity;
+    if (first_line + removed_lines <= cache->line_base) {
+        cache->line_base = cache->line_base - removed_lines + inserted_lines;
+        return;
+    }
+    if (first_line >= cache->line_base + capacity) return;
+    if (first_line < cache->line_base) {
+        memset(cache->lines, 0, capacity * sizeof(layout_line_ref));
+        return;
+    }
+
+    u64 start = first_line - cache->line_base;
+    u64 old_end = removed_lines < capacity - start ? start + removed_lines : capacity;
+    u64 new_end = inserted_lines < capacity - start ? start + inserted_lines : capacity;
+
+    // Renumber the lines after the edit. Those moved past the window are
+    // dropped.
+    u64 moved = capacity - (old_end > new_end ? old_end : new_end);
+    memmove(cache->lines + new_end, cache->lines + old_end, moved * sizeof(layout_line_ref));
+
+    // Forget the replaced lines, and the end of the window that removed lines
+    // left behind
+    memset(cache->lines + start, 0, (new_end - start) * sizeof(layout_line_ref));
+    memset(cache->lines + new_end + moved, 0, (capacity - new_end - moved) * sizeof(layout_line_ref));
+}
@@ -0,0 +1,291 @@
+#include "line_index.h"
+#include "log.h"
+#include "raster_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define LINE_INDEX_X86
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define LINE_INDEX_HAS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+static inline u64
+line_popcount(u64 mask)
+{
+#if defined(__GNUC__)
+    return (u64)__builtin_popcountll(mask);
+#else
+    u64 count = 0;
+    for (; mask; mask &= mask - 1) ++count;
+    return count;
+#endif
+}
+
+static inline u64
+line_lowest_bit(u64 mask)
+{
+#if defined(__GNUC__)
+    return (u64)__builtin_ctzll(mask);
+#else
+    u64 bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// Line breaks among up to 64 bytes, one bit per byte
+static inline u64
+line_mask_scalar(const u8 *data, u64 length)
+{
+    u64 mask = 0;
+    for (u64 i = 0; i < length; ++i) mask |= (u64)(data[i] == '\n') << i;
+    return mask;
+}
+
+// Takes the line breaks of the 64 bytes at offset i into account. Returns
+// true and the offset just past the line break if the *until-th one is among
+// them.
+static inline b32
+line_scan_mask(u64 mask, u64 i, u64 *until, u64 *line_breaks, u64 *offset)
+{
+    u64 count = line_popcount(mask);
+    if (count < *until) {
+        *until -= count;
+        *line_breaks += count;
+        return false;
+    }
+    *line_breaks += *until;
+    for (u64 k = 1; k < *until; ++k) mask &= mask - 1;
+    *offset = i + line_lowest_bit(mask) + 1;
+    return true;
+}
+
+// The kernels scan for the until-th line break and return the offset just
+// past it, or length if there are fewer. *line_breaks grows by the number of
+// line breaks passed.
+static u64
+line_scan_scalar(const u8 *data, u64 length, u64 until, u64 *line_breaks)
+{
+    u64 offset = length;
+    u64 i = 0;
+    for (; i + 64 <= length; i += 64) {
+        if (line_scan_mask(line_mask_scalar(data + i, 64), i, &until, line_breaks, &offset)) return offset;
+    }
+    line_scan_mask(line_mask_scalar(data + i, length - i), i, &until, line_breaks, &offset);
+    return offset;
+}
+
+#if defined(LINE_INDEX_X86)
+static u64
+line_scan_sse2(const u8 *data, u64 length, u64 until, u64 *line_breaks)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    u64 offset = length;
+    u64 i = 0;
+    for (; i + 64 <= length; i += 64) {
+        u64 mask = 0;
+        for (u32 v = 0; v < 4; ++v) {
+            __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i + v * 16));
+            mask |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)) << (v * 16);
+        }
+        if (mask && line_scan_mask(mask, i, &until, line_breaks, &offset)) return offset;
+    }
+    line_scan_mask(line_mask_scalar(data + i, length - i), i, &until, line_breaks, &offset);
+    return offset;
+}
+#endif
+
+#if defined(LINE_INDEX_HAS_AVX2)
+__attribute__((target("avx2,popcnt")))
+static u64
+line_scan_avx2(const u8 *data, u64 length, u64 until, u64 *line_breaks)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    u64 offset = length;
+    u64 i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m256i low = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i high = _mm256_loadu_si256((const __m256i *)(data + i + 32));
+        u64 mask = (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline))
+                 | (u64)(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)) << 32;
+        if (mask && line_scan_mask(mask, i, &until, line_breaks, &offset)) return offset;
+    }
+    line_scan_mask(line_mask_scalar(data + i, length - i), i, &until, line_breaks, &offset);
+    return offset;
+}
+#endif
+
+static u64
+line_scan(const u8 *data, u64 length, u64 until, u64 *line_breaks)
+{
+    switch (raster_simd_get_level()) {
+#if defined(LINE_INDEX_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        return line_scan_avx2(data, length, until, line_breaks);
+#endif
+#if defined(LINE_INDEX_X86)
+    case RASTER_SIMD_SSE2:
+        return line_scan_sse2(data, length, until, line_breaks);
+#endif
+    default:
+        return line_scan_scalar(data, length, until, line_breaks);
+    }
+}
+
+u64
+line_index_count_line_breaks(const u8 *data, u64 length)
+{
+    u64 line_breaks = 0;
+    line_scan(data, length, UINT64_MAX, &line_breaks);
+    return line_breaks;
+}
+
+u64
+line_index_find_line_break(const u8 *data, u64 length, u64 count)
+{
+    u64 line_breaks = 0;
+    return line_scan(data, length, count, &line_breaks);
+}
+
+static void
+line_index_add_sample(line_index *index, u64 offset)
+{
+    u64 sample = index->sample_count++;
+    if (sample == index->sample_capacity) {
+        index->sample_capacity = index->sample_capacity ? index->sample_capacity * 2 : 1024;
+        index->samples = (u32 *)realloc(index->samples, index->sample_capacity * sizeof(u32));
+        if (!index->samples) LOG_FATAL("Could not allocate %llu line index samples.",
+                                       (unsigned long long)index->sample_capacity);
+    }
+
+    u64 block = sample / LINE_INDEX_BLOCK_SAMPLES;
+    if (sample % LINE_INDEX_BLOCK_SAMPLES == 0) {
+        if (block == index->block_capacity) {
+            index->block_capacity = index->block_capacity ? index->block_capacity * 2 : 64;
+            index->blocks = (u64 *)realloc(index->blocks, index->block_capacity * sizeof(u64));
+            if (!index->blocks) LOG_FATAL("Could not allocate %llu line index blocks.",
+                                          (unsigned long long)index->block_capacity);
+        }
+        index->blocks[block] = offset;
+        index->samples[sample] = 0;
+        return;
+    }
+
+    u64 delta = offset - index->blocks[block];
+    if (delta < LINE_INDEX_OVERFLOW) {
+        index->samples[sample] = (u32)delta;
+        return;
+    }
+
+    // Only blocks whose lines average over a megabyte get here
+    if (index->overflow_count == index->overflow_capacity) {
+        index->overflow_capacity = index->overflow_capacity ? index->overflow_capacity * 2 : 16;
+        index->overflow = (line_index_overflow *)realloc(index->overflow,
+                                                         index->overflow_capacity * sizeof(line_index_overflow));
+        if (!index->overflow) LOG_FATAL("Could not allocate line index overflow table.");
+    }
+    index->overflow[index->overflow_count].sample = sample;
+    index->overflow[index->overflow_count].offset = offset;
+    ++index->overflow_count;
+    index->samples[sample] = LINE_INDEX_OVERFLOW;
+}
+
+static u64
+line_index_sample_start(const line_index *index, u64 sample)
+{
+    u32 delta = index->samples[sample];
+    if (delta != LINE_INDEX_OVERFLOW) return index->blocks[sample / LINE_INDEX_BLOCK_SAMPLES] + delta;
+
+    u64 low = 0, high = index->overflow_count - 1;
+    while (index->overflow[low].sample != sample) {
+        u64 middle = low + (high - low) / 2;
+        if (index->overflow[middle].sample < sample) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return index->overflow[low].offset;
+}
+
+void
+line_index_init(line_index *index)
+{
+    memset(index, 0, sizeof(*index));
+    // Line 0 starts at 0
+    line_index_add_sample(index, 0);
+}
+
+void
+line_index_free(line_index *index)
+{
+    free(index->blocks);
+    free(index->samples);
+    free(index->overflow);
+    memset(index, 0, sizeof(*index));
+}
+
+void
+line_index_append(line_index *index, const u8 *data, u64 length)
+{
+    u64 position = 0;
+    while (position < length) {
+        u64 until = LINE_INDEX_SAMPLE_LINES - index->line_breaks % LINE_INDEX_SAMPLE_LINES;
+        u64 line_breaks = index->line_breaks;
+        position += line_scan(data + position, length - position, until, &index->line_breaks);
+        if (index->line_breaks - line_breaks == until) line_index_add_sample(index, index->scanned + position);
+    }
+    index->scanned += length;
+}
+
+u64
+line_index_line_count(const line_index *index)
+{
+    return index->line_breaks + 1;
+}
+
+u64
+line_index_line_start(const line_index *index, const u8 *text, u64 line)
+{
+    if (line > index->line_breaks) return index->scanned;
+
+    u64 start = line_index_sample_start(index, line / LINE_INDEX_SAMPLE_LINES);
+    u64 remaining = line % LINE_INDEX_SAMPLE_LINES;
+    if (remaining == 0) return start;
+    return start + line_index_find_line_break(text + start, index->scanned - start, remaining);
+}
+
+u64
+line_index_line_of(const line_index *index, const u8 *text, u64 offset)
+{
+    if (offset > index->scanned) offset = index->scanned;
+
+    // Last sample at or before offset
+    u64 low = 0, high = index->sample_count - 1;
+    while (low < high) {
+        u64 middle = low + (high - low + 1) / 2;
+        if (line_index_sample_start(index, middle) <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    u64 start = line_index_sample_start(index, low);
+    return low * LINE_INDEX_SAMPLE_LINES + line_index_count_line_breaks(text + start, offset - start);
+}
+
+u64
+line_index_memory(const line_index *index)
+{
+    return index->block_capacity * sizeof(u64)
+         + index->sample_capacity * sizeof(u32)
+         + index->overflow_capacity * sizeof(line_index_overflow);
+}
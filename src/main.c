@@ -1,5 +1,17 @@
 #include "log.h"
 #include "core.h"
+#include "compositor.h"
+#include "file_index.h"
+#include "file_save.h"
+#include "frame_scheduler.h"
+#include "frame_stats.h"
+#include "font.h"
+#include "font_metrics.h"
+#include "glyph_cache.h"
+#include "headless.h"
+#include "layout.h"
+#include "sdf.h"
+#include "text_view.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,92 +25,303 @@
 
 #include <GLFW/glfw3.h>
 
+// Text colours of the window
+#define MAIN_FOREGROUND COMPOSITOR_RGBA(216, 216, 216, 255)
+#define MAIN_BACKGROUND COMPOSITOR_RGBA(30, 30, 30, 255)
+#define MAIN_OVERLAY     COMPOSITOR_RGBA(48, 48, 64, 255)
+#define MAIN_CURSOR      COMPOSITOR_RGBA(255, 196, 64, 255)
+
+// Frame time overlay, in pixels
+#define OVERLAY_MARGIN       8
+#define OVERLAY_NAME_WIDTH   64
+#define OVERLAY_COLUMN_WIDTH 56
+
+// Written when F12 is pressed
+#define FRAME_STATS_PATH "frame_stats.json"
+
 void glfw_error_callback(int error, const char* description)
 {
     UNUSED(error);
     LOG_ERROR("GLFW error: %s", description);
 }
 
-int main(int argc, const char * argv[])
+static b32 save_requested = false;
+static b32 overlay_toggled = false;
+static b32 stats_dump_requested = false;
+
+// When the first input since the last frame arrived, negative if none did
+static f64 input_since = -1.0;
+
+static void
+key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    UNUSED(argc);
-    UNUSED(argv);
+    UNUSED(scancode);
+    if (action == GLFW_RELEASE) return;
+    if (input_since < 0.0) input_since = frame_stats_now();
+    frame_scheduler_input((frame_scheduler *)glfwGetWindowUserPointer(window), glfwGetTime());
+    if (key == GLFW_KEY_S && action == GLFW_PRESS && (mods & GLFW_MOD_CONTROL)) save_requested = true;
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) overlay_toggled = true;
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) stats_dump_requested = true;
+}
 
-    LOG_TRACE("Starting application");
+static void
+framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+    UNUSED(width);
+    UNUSED(height);
+    frame_scheduler_mark_dirty((frame_scheduler *)glfwGetWindowUserPointer(window), FRAME_DIRTY_RESIZE);
+}
 
-    LOG_INFO("Testing truetype file loading");
-    const char *font_filename = "res/Roboto-Black.ttf";
+static void
+window_refresh_callback(GLFWwindow *window)
+{
+    frame_scheduler_mark_dirty((frame_scheduler *)glfwGetWindowUserPointer(window), FRAME_DIRTY_RESIZE);
+}
 
-    FILE* font_file = fopen(font_filename, "rb");
-    fseek(font_file, 0, SEEK_END);
-    size_t size = ftell(font_file);
-    fseek(font_file, 0, SEEK_SET);
+static void
+wake_main_loop(void *arg)
+{
+    UNUSED(arg);
+    glfwPostEmptyEvent();
+}
 
-    u32 *font_buffer = (u32 *)malloc(size);
+// Runs on workers as indexing and saving make progress
+static void
+job_progress(void *arg)
+{
+    frame_scheduler_mark_dirty((frame_scheduler *)arg, FRAME_DIRTY_JOB);
+}
 
-    fread(font_buffer, size, 1, font_file);
-    fclose(font_file);
+// What the window shows: the opened file, or a line of sample text
+typedef struct {
+    file_index *file;
+    const char *text;
+} screen_text;
 
-    LOG_SUCCESS("Font file %s loaded into memory.", font_filename);
+static b32
+screen_line(void *arg, u64 line, const u8 **text, u32 *length)
+{
+    screen_text *screen = (screen_text *)arg;
+    if (screen->file) return file_index_line_text(screen->file, line, text, length);
+    if (line > 0) return false;
+    *text = (const u8 *)screen->text;
+    *length = (u32)strlen(screen->text);
+    return true;
+}
 
-    /* prepare font */
-    stbtt_fontinfo font_info;
-    if (!stbtt_InitFont(&font_info, (unsigned char *)font_buffer, 0)) {
-        LOG_ERROR("Could not initialize font.");
+// Top right corner of the frame, one row per stage and one for glyph misses
+// under a header
+static damage_rect
+overlay_rect(const compositor_frame *frame, const font_metrics *metrics)
+{
+    f32 line_advance = metrics->ascent - metrics->descent + metrics->line_gap;
+    s32 width = OVERLAY_NAME_WIDTH + 4 * OVERLAY_COLUMN_WIDTH + 2 * OVERLAY_MARGIN;
+    s32 height = (s32)ceilf((FRAME_STAGE_COUNT + 2) * line_advance) + 2 * OVERLAY_MARGIN;
+    damage_rect rect = {frame->width - width, 0, frame->width, height};
+    return rect;
+}
+
+// Blends text into the frame with its left edge at x, or its right edge when
+// align_right is set
+static void
+overlay_text(compositor_frame *frame, const font_metrics *metrics, glyph_cache *cache, layout_line *line,
+             const char *text, s32 x, s32 baseline, b32 align_right)
+{
+    layout_line_build(line, metrics, TEXT_VIEW_TAB_WIDTH, (const u8 *)text, (u32)strlen(text));
+    f32 origin = align_right ? (f32)x - line->width : (f32)x;
+    for (u32 i = 0; i < line->glyph_count; ++i) {
+        f32 pen_x = origin + line->glyphs[i].x;
+        const cached_glyph *glyph = glyph_cache_get(cache, &metrics->font->info, line->glyphs[i].glyph_index,
+                                                    metrics->pixel_height, glyph_cache_subpixel_phase(pen_x));
+        compositor_blend_mask(frame, (s32)floorf(pen_x) + glyph->x_offset, baseline + glyph->y_offset,
+                              glyph->coverage, glyph->width, glyph->height, glyph->stride, MAIN_FOREGROUND);
+    }
+}
+
+// Percentiles of every stage over the last FRAME_STATS_HISTORY frames
+static void
+draw_overlay(compositor_frame *frame, damage_rect rect, const frame_stats *stats, const font_metrics *metrics,
+             glyph_cache *cache)
+{
+    compositor_fill(frame, rect.x0, rect.y0, rect.x1, rect.y1, MAIN_OVERLAY);
+    f32 line_advance = metrics->ascent - metrics->descent + metrics->line_gap;
+    s32 x = rect.x0 + OVERLAY_MARGIN;
+    layout_line line = {0};
+    char text[32];
+
+    const char *headers[] = {"ms", "p50", "p95", "p99", "max"};
+    for (s32 row = 0; row < FRAME_STAGE_COUNT + 2; ++row) {
+        s32 baseline = rect.y0 + OVERLAY_MARGIN + (s32)roundf(metrics->ascent + row * line_advance);
+        frame_stats_summary summary = {0};
+        const char *name = headers[0];
+        if (row > 0 && row <= FRAME_STAGE_COUNT) {
+            summary = frame_stats_summarize(stats, (frame_stage)(row - 1));
+            name = frame_stage_name((frame_stage)(row - 1));
+        } else if (row > FRAME_STAGE_COUNT) {
+            summary = frame_stats_summarize_glyph_misses(stats);
+            name = "misses";
+        }
+        overlay_text(frame, metrics, cache, &line, name, x, baseline, false);
+
+        // Glyph misses are counts, everything else is milliseconds
+        f64 scale = row > FRAME_STAGE_COUNT ? 1.0 : 1000.0;
+        f64 values[] = {summary.p50, summary.p95, summary.p99, summary.max};
+        for (s32 column = 0; column < 4; ++column) {
+            if (row == 0) {
+                snprintf(text, sizeof(text), "%s", headers[column + 1]);
+            } else if (summary.count == 0) {
+                snprintf(text, sizeof(text), "-");
+            } else {
+                snprintf(text, sizeof(text), scale == 1.0 ? "%.0f" : "%.2f", values[column] * scale);
+            }
+            overlay_text(frame, metrics, cache, &line, text, x + OVERLAY_NAME_WIDTH + (column + 1) * OVERLAY_COLUMN_WIDTH,
+                         baseline, true);
+        }
+    }
+    layout_line_free(&line);
+}
+
+int main(int argc, const char * argv[])
+{
+    LOG_TRACE("Starting application");
+
+    // Draw text from distance field glyphs, which are scaled instead of
+    // rasterized again for every size
+    b32 sdf_glyphs = false;
+    b32 headless = false;
+    const char *path = NULL;
+    const char *out_path = "build/out.png";
+    s32 headless_width = 1280;
+    s32 headless_height = 720;
+    for (s32 i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sdf") == 0) {
+            sdf_glyphs = true;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            ++i;
+            if (sscanf(argv[i], "%dx%d", &headless_width, &headless_height) != 2 ||
+                headless_width <= 0 || headless_height <= 0 ||
+                headless_width > HEADLESS_MAX_SIZE || headless_height > HEADLESS_MAX_SIZE) {
+                LOG_ERROR("Invalid size %s, expected WIDTHxHEIGHT.", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            path = argv[i];
+        }
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, thread_pool_default_thread_count());
+
+    // Where the time of each frame goes; F3 shows it over the text and F12
+    // writes it out
+    frame_stats stats;
+    frame_stats_init(&stats);
+    b32 overlay_visible = false;
+
+    // Renders one frame to a PNG without a window, for CI and machines
+    // without a display, and prints how long each stage took
+    if (headless) {
+        if (!path) {
+            LOG_ERROR("Usage: sparrow --headless --render FILE [--out PNG] [--size WIDTHxHEIGHT] [--sdf]");
+            thread_pool_free(&pool);
+            return EXIT_FAILURE;
+        }
+        headless_options options = {
+            .path = path,
+            .out_path = out_path,
+            .font_path = "res/Roboto-Black.ttf",
+            .width = headless_width,
+            .height = headless_height,
+            .pixel_height = 16.0f,
+            .sdf_glyphs = sdf_glyphs,
+            .foreground = MAIN_FOREGROUND,
+            .background = MAIN_BACKGROUND,
+            .cursor = MAIN_CURSOR,
+        };
+        headless_report report;
+        b32 rendered = headless_render(&options, &pool, &report);
+        thread_pool_free(&pool);
+        if (!rendered) return EXIT_FAILURE;
+
+        f64 total = 0.0;
+        for (s32 stage = 0; stage < HEADLESS_STAGE_COUNT; ++stage) {
+            printf("%-8s %9.3f ms\n", headless_stage_name((headless_stage)stage), report.seconds[stage] * 1000.0);
+            total += report.seconds[stage];
+        }
+        printf("%-8s %9.3f ms\n", "total", total * 1000.0);
+        printf("%llu lines, %llu glyphs, %llu glyph cache misses, %dx%d written to %s\n",
+               (unsigned long long)report.lines, (unsigned long long)report.glyphs,
+               (unsigned long long)report.glyph_misses, headless_width, headless_height, out_path);
+        return EXIT_SUCCESS;
+    }
+
+    // The file is indexed in the background, the first screen does not wait
+    // for it
+    file_index file;
+    b32 file_open = false;
+    if (path) {
+        file_open = file_index_open(&file, path, &pool);
+        if (!file_open) LOG_ERROR("Could not open file %s.", path);
+    }
+
+    LOG_INFO("Testing truetype file loading");
+    const char *font_filename = "res/Roboto-Black.ttf";
+
+    font main_font;
+    font_metrics metrics;
+    glyph_cache cache;
+    layout_cache layout;
+    screen_text screen = {file_open ? &file : NULL, "the quick brown fox"};
+    text_view view;
+    compositor_frame frame;
+    b32 view_ready = font_load(&main_font, font_filename, 0, MAPPED_FILE_WILLNEED);
+    if (!view_ready) {
+        LOG_ERROR("Could not load font %s.", font_filename);
     } else {
+        LOG_SUCCESS("Font file %s mapped into memory.", font_filename);
         LOG_TRACE("Font %s prepared", font_filename);
 
         u32 bitmap_width = 512;
         u32 bitmap_height = 128;
         u32 line_height = 64;
+        if (file_open) {
+            bitmap_width = 1280;
+            bitmap_height = 720;
+            line_height = 16;
+        }
         LOG_INFO("Setting up bitmap for text rendering width width = %u, height = %u and line height = %u",
                           bitmap_width, bitmap_height, line_height);
-        unsigned char* bitmap = (unsigned char *)calloc(bitmap_width * bitmap_height, sizeof(unsigned char));
-
-        f32 scale = stbtt_ScaleForPixelHeight(&font_info, line_height);
-
-        const char* text = "the quick brown fox";
-
-        u32 x = 0;
-
-        s32 ascent, descent, line_gap;
-        stbtt_GetFontVMetrics(&font_info, &ascent, &descent, &line_gap);
 
-        ascent = roundf(ascent * scale);
-        descent = roundf(descent * scale);
+        font_metrics_init(&metrics, &main_font, line_height);
+        glyph_cache_init(&cache, 256, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+        layout_cache_init(&layout, 1024);
+        text_view_init(&view, bitmap_width, bitmap_height, &metrics, &cache, &layout, &pool, sdf_glyphs,
+                       screen_line, &screen);
+        compositor_frame_init(&frame, bitmap_width, bitmap_height);
+        view.stats = &stats;
 
         LOG_SUCCESS("Font successfully ste up.");
 
         LOG_INFO("Rendering text to bitmap.");
-        for (size_t i = 0; i < strlen(text); ++i)
-        {
-            s32 ax;
-            s32 lsb;
-            stbtt_GetCodepointHMetrics(&font_info, text[i], &ax, &lsb);
-            s32 c_x1, c_y1, c_x2, c_y2;
-            stbtt_GetCodepointBitmapBox(&font_info, text[i], scale, scale, &c_x1, &c_y1, &c_x2, &c_y2);
-
-            s32 y = ascent + c_y1;
-
-            u32 byte_offset = x + roundf(lsb * scale) + (y * bitmap_width);
-            stbtt_MakeCodepointBitmap(&font_info, bitmap + byte_offset, c_x2 - c_x1, c_y2 - c_y1, bitmap_width, scale, scale, text[i]);
-
-            x += roundf(ax * scale);
-
-            s32 kerning;
-            kerning = stbtt_GetCodepointKernAdvance(&font_info, text[i], text[i + 1]);
-            x += roundf(kerning * scale);
+        text_view_render(&view, NULL);
+        if (file_open) {
+            LOG_INFO("First screen of %s drawn with %.0f%% of it indexed.", path, file_index_progress(&file) * 100.0f);
         }
+        LOG_TRACE("Glyph cache: %llu hits, %llu misses, %u glyphs cached.",
+                  (unsigned long long)cache.hits, (unsigned long long)cache.misses, cache.count);
         LOG_SUCCESS("Successfully rendered text.");
 
         const char *rendered_image_out_file = "build/out.png";
         LOG_INFO("Writing rendered bitmap to file %s.", rendered_image_out_file);
-        stbi_write_png("build/out.png", bitmap_width, bitmap_height, 1, bitmap, bitmap_width);
+        stbi_write_png("build/out.png", bitmap_width, bitmap_height, 1, view.pixels, bitmap_width);
         LOG_SUCCESS("Successfully wrote rendered bitmap to file %s.", rendered_image_out_file);
-
-        free(bitmap);
     }
-    free(font_buffer);
 
     uint32_t window_width = 1280;
     uint32_t window_height = 720;
@@ -111,6 +334,10 @@ int main(int argc, const char * argv[])
     LOG_INFO("Setting GLFW error callback function.");
     glfwSetErrorCallback(glfw_error_callback);
 
+    // Frames are composed on the CPU and only their damage is copied to the
+    // window, so what was presented before has to stay in the front buffer
+    glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_FALSE);
+
     LOG_INFO("Creating window.");
     GLFWwindow *window = glfwCreateWindow(window_width, window_height, "Sparrow", NULL, NULL);
     if (!window) LOG_FATAL("Could not create window.");
@@ -119,18 +346,193 @@ int main(int argc, const char * argv[])
     glfwMakeContextCurrent(window);
     LOG_SUCCESS("Set OpenGL context.");
 
+    // Frames are only drawn when something changed; otherwise the loop
+    // sleeps in the event queue until input, a timer or a worker wakes it
+    frame_scheduler scheduler;
+    frame_scheduler_init(&scheduler, wake_main_loop, NULL);
+    glfwSetWindowUserPointer(window, &scheduler);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    if (file_open) file_index_set_notify(&file, job_progress, &scheduler);
+
+    // Opening the document only maps it, its lines are counted when needed
+    piece_table document;
+    b32 document_open = false;
+    file_save save;
+    b32 saving = false;
+
+    // Parts of the view redrawn since the last present
+    damage_region presented;
+    damage_init(&presented, view_ready ? view.width : 0, view_ready ? view.height : 0);
+
+    s32 shown_progress = -1;
     while (!glfwWindowShouldClose(window)) {
-        // Render here
-        // glClear(GL_COLOR_BUFFER_BIT);
+        f64 timeout = frame_scheduler_timeout(&scheduler, glfwGetTime());
+        if (timeout < 0.0) {
+            glfwWaitEvents();
+        } else if (timeout > 0.0) {
+            glfwWaitEventsTimeout(timeout);
+        } else {
+            glfwPollEvents();
+        }
+        u32 dirty = frame_scheduler_begin_frame(&scheduler, glfwGetTime());
+        if (!dirty) continue;
+
+        frame_stats_begin_frame(&stats, frame_stats_now());
+        if (input_since >= 0.0) {
+            frame_stats_add(&stats, FRAME_STAGE_INPUT, stats.frame_start - input_since);
+            input_since = -1.0;
+        }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Only the cursor's cell is redrawn when it blinks
+        if (view_ready) {
+            if (scheduler.cursor_visible != view.cursor_visible) {
+                text_view_set_cursor(&view, view.cursor_line, view.cursor_column, scheduler.cursor_visible);
+            }
+            text_view_render(&view, &presented);
+        }
+
+        // The window has lost what was presented, and the view may not cover
+        // all of it
+        if (dirty & FRAME_DIRTY_RESIZE) {
+            s32 framebuffer_width, framebuffer_height;
+            glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+            glViewport(0, 0, framebuffer_width, framebuffer_height);
+            glMatrixMode(GL_PROJECTION);
+            glLoadIdentity();
+            glOrtho(0.0, framebuffer_width, framebuffer_height, 0.0, -1.0, 1.0);
+            glClearColor(30.0f / 255.0f, 30.0f / 255.0f, 30.0f / 255.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            damage_add_all(&presented);
+        }
+
+        if (save_requested && file_open && !saving) {
+            if (!document_open) document_open = piece_table_open(&document, path);
+            saving = document_open && file_save_start(&save, &document, path, &pool);
+            if (saving) file_save_set_notify(&save, job_progress, &scheduler);
+            shown_progress = -1;
+        }
+        save_requested = false;
+
+        if (saving) {
+            // Written in the background, the window keeps responding
+            file_save_state state = file_save_get_state(&save);
+            s32 progress = (s32)(file_save_progress(&save) * 100.0f);
+            if (state != FILE_SAVE_WRITING) {
+                if (state == FILE_SAVE_DONE) LOG_SUCCESS("Saved %s.", path);
+                file_save_close(&save);
+                saving = false;
+                shown_progress = -1;
+            } else if (progress != shown_progress) {
+                char title[512];
+                snprintf(title, sizeof(title), "Sparrow - %s (saving %d%%)", path, progress);
+                glfwSetWindowTitle(window, title);
+                shown_progress = progress;
+            }
+        } else if (file_open) {
+            // Line counts are estimates until the file is indexed
+            b32 exact;
+            u64 line_count = file_index_line_count(&file, &exact);
+            s32 progress = exact ? 100 : (s32)(file_index_progress(&file) * 100.0f);
+            if (progress != shown_progress) {
+                char title[512];
+                if (exact) {
+                    snprintf(title, sizeof(title), "Sparrow - %s (%llu lines)", path, (unsigned long long)line_count);
+                } else {
+                    snprintf(title, sizeof(title), "Sparrow - %s (indexing %d%%, ~%llu lines)",
+                             path, progress, (unsigned long long)line_count);
+                }
+                glfwSetWindowTitle(window, title);
+                shown_progress = progress;
+            }
+        }
+
+        // Only what was redrawn is coloured and copied to the window. The
+        // overlay is redrawn every frame it is shown, and once more to clear
+        // it away.
+        if (view_ready) {
+            f64 compose_start = frame_stats_now();
+            damage_rect overlay = overlay_rect(&frame, &metrics);
+            if (overlay_toggled) overlay_visible = !overlay_visible;
+            if (overlay_toggled || overlay_visible) damage_add(&presented, overlay.x0, overlay.y0, overlay.x1, overlay.y1);
+            for (u32 i = 0; i < presented.count; ++i) {
+                compositor_compose(&frame, view.pixels, view.width, presented.rects[i], MAIN_FOREGROUND, MAIN_BACKGROUND);
+            }
+            // The view damages the cursor's cell whenever it changes, so it
+            // is presented with it
+            damage_rect cursor;
+            if (text_view_cursor_rect(&view, &cursor)) {
+                compositor_fill(&frame, cursor.x0, cursor.y0, cursor.x1, cursor.y1, MAIN_CURSOR);
+            }
+            f64 overlay_start = frame_stats_now();
+            frame_stats_add(&stats, FRAME_STAGE_COMPOSE, overlay_start - compose_start);
+
+            // Drawn after compose is timed, so showing the stats does not
+            // inflate them. The overlay's glyphs are misses like any other.
+            if (overlay_visible) {
+                u64 misses = cache.misses;
+                draw_overlay(&frame, overlay, &stats, &metrics, &cache);
+                frame_stats_add_glyph_misses(&stats, cache.misses - misses);
+                frame_stats_add(&stats, FRAME_STAGE_OVERLAY, frame_stats_now() - overlay_start);
+            }
+            f64 present_start = frame_stats_now();
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.width);
+            glPixelZoom(1.0f, -1.0f);
+            for (u32 i = 0; i < presented.count; ++i) {
+                damage_rect rect = presented.rects[i];
+                glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x0);
+                glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y0);
+                glRasterPos2i(rect.x0, rect.y0);
+                glDrawPixels(rect.x1 - rect.x0, rect.y1 - rect.y0, GL_RGBA, GL_UNSIGNED_BYTE, frame.pixels);
+            }
+            glFlush();
+            frame_stats_add(&stats, FRAME_STAGE_PRESENT, frame_stats_now() - present_start);
+        } else {
+            glFlush();
+        }
+        overlay_toggled = false;
+        damage_clear(&presented);
+        frame_stats_end_frame(&stats, frame_stats_now());
+
+        if (stats_dump_requested && frame_stats_write_json(&stats, FRAME_STATS_PATH)) {
+            LOG_SUCCESS("Wrote frame times to %s.", FRAME_STATS_PATH);
+        }
+        stats_dump_requested = false;
     }
 
+    // Indexing is stopped and waited for before the scheduler and GLFW go, as
+    // a worker may already be on its way to wake them. A save in progress is
+    // finished rather than dropped.
+    if (file_open) file_index_close(&file);
+    if (saving) {
+        file_save_wait(&save);
+        file_save_close(&save);
+    }
+    if (document_open) piece_table_free(&document);
+    LOG_TRACE("Drew %llu frames, woken %llu times.",
+              (unsigned long long)scheduler.frames, (unsigned long long)scheduler.wakeups);
+    frame_stats_summary frame_times = frame_stats_summarize(&stats, FRAME_STAGE_FRAME);
+    LOG_TRACE("Frame times: p50 %.2f ms, p99 %.2f ms.", frame_times.p50 * 1000.0, frame_times.p99 * 1000.0);
+    if (view_ready) {
+        LOG_TRACE("Redrew %llu pixels of the view.", (unsigned long long)view.pixels_drawn);
+        compositor_frame_free(&frame);
+        text_view_free(&view);
+        glyph_cache_free(&cache);
+        layout_cache_free(&layout);
+        font_metrics_free(&metrics);
+        font_unload(&main_font);
+    }
+    frame_scheduler_free(&scheduler);
+
     LOG_INFO("Terminating GLFW.");
     glfwTerminate();
     LOG_SUCCESS("GLFW terminated.");
 
+    thread_pool_free(&pool);
+
     LOG_SUCCESS("Application terminating with EXIT_SUCCESS exit code.");
     return EXIT_SUCCESS;
 }
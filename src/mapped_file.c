@@ -0,0 +1,130 @@
+#include "mapped_file.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(linux)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+b32
+mapped_file_open(mapped_file *file, const char *path, u32 flags)
+{
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    file->mapped = true;
+    file->size = (size_t)st.st_size;
+    if (file->size == 0) {
+        close(fd);
+        return true;
+    }
+
+    int map_flags = MAP_PRIVATE;
+    if (flags & MAPPED_FILE_POPULATE) map_flags |= MAP_POPULATE;
+
+    void *data = mmap(NULL, file->size, PROT_READ, map_flags, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (data == MAP_FAILED) {
+        memset(file, 0, sizeof(*file));
+        return false;
+    }
+    file->data = (const u8 *)data;
+
+    mapped_file_advise(file, 0, file->size, flags);
+    return true;
+}
+
+void
+mapped_file_close(mapped_file *file)
+{
+    if (file->data) {
+        munmap((void *)file->data, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+void
+mapped_file_advise(const mapped_file *file, size_t offset, size_t size, u32 flags)
+{
+    if (!file->data || offset >= file->size) return;
+    if (size > file->size - offset) size = file->size - offset;
+
+    // madvise wants a page aligned start address
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset & ~(page_size - 1);
+    void *start = (void *)(file->data + aligned_offset);
+    size_t length = size + (offset - aligned_offset);
+
+    if (flags & MAPPED_FILE_RANDOM)     madvise(start, length, MADV_RANDOM);
+    if (flags & MAPPED_FILE_SEQUENTIAL) madvise(start, length, MADV_SEQUENTIAL);
+    if (flags & MAPPED_FILE_WILLNEED)   madvise(start, length, MADV_WILLNEED);
+}
+
+    // Todo: Use CreateFileMapping/MapViewOfFile on win32.
+#else
+b32
+mapped_file_open(mapped_file *file, const char *path, u32 flags)
+{
+    UNUSED(flags);
+    memset(file, 0, sizeof(*file));
+
+    FILE *handle = fopen(path, "rb");
+    if (!handle) {
+        return false;
+    }
+
+    fseek(handle, 0, SEEK_END);
+    long size = ftell(handle);
+    fseek(handle, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(handle);
+        return false;
+    }
+
+    file->size = (size_t)size;
+    if (file->size > 0) {
+        u8 *data = (u8 *)malloc(file->size);
+        if (!data || fread(data, file->size, 1, handle) != 1) {
+            free(data);
+            fclose(handle);
+            memset(file, 0, sizeof(*file));
+            return false;
+        }
+        file->data = data;
+    }
+    fclose(handle);
+    return true;
+}
+
+void
+mapped_file_close(mapped_file *file)
+{
+    free((void *)file->data);
+    memset(file, 0, sizeof(*file));
+}
+
+void
+mapped_file_advise(const mapped_file *file, size_t offset, size_t size, u32 flags)
+{
+    UNUSED(file);
+    UNUSED(offset);
+    UNUSED(size);
+    UNUSED(flags);
+}
+#endif
@@ -0,0 +1,721 @@
+#include "piece_table.h"
+#include "line_index.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+u64
+piece_count_line_breaks(const u8 *data, u64 length)
+{
+    return line_index_count_line_breaks(data, length);
+}
+
+static u32
+piece_table_random(piece_table *table)
+{
+    u32 x = table->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    table->random_state = x;
+    return x;
+}
+
+static u32
+piece_node_alloc(piece_table *table, piece p)
+{
+    u32 index;
+    if (table->free_node != PIECE_TABLE_NONE) {
+        index = table->free_node;
+        table->free_node = table->nodes[index].left;
+    } else {
+        if (table->node_count == table->node_capacity) {
+            table->node_capacity = table->node_capacity ? table->node_capacity * 2 : 64;
+            table->nodes = (piece_node *)realloc(table->nodes, table->node_capacity * sizeof(piece_node));
+            if (!table->nodes) LOG_FATAL("Could not allocate %u piece table nodes.", table->node_capacity);
+        }
+        index = table->node_count++;
+    }
+
+    piece_node *node = &table->nodes[index];
+    node->piece = p;
+    node->subtree_length = p.length;
+    node->subtree_line_breaks = p.line_breaks;
+    node->left = PIECE_TABLE_NONE;
+    node->right = PIECE_TABLE_NONE;
+    node->priority = piece_table_random(table);
+    ++table->piece_count;
+    return index;
+}
+
+static void
+piece_node_free(piece_table *table, u32 index)
+{
+    table->nodes[index].left = table->free_node;
+    table->free_node = index;
+    --table->piece_count;
+}
+
+static void
+piece_node_free_tree(piece_table *table, u32 index)
+{
+    if (index == PIECE_TABLE_NONE) return;
+    piece_node_free_tree(table, table->nodes[index].right);
+    u32 left = table->nodes[index].left;
+    piece_node_free(table, index);
+    piece_node_free_tree(table, left);
+}
+
+static u64
+piece_subtree_length(const piece_table *table, u32 index)
+{
+    return index != PIECE_TABLE_NONE ? table->nodes[index].subtree_length : 0;
+}
+
+static u64
+piece_subtree_line_breaks(const piece_table *table, u32 index)
+{
+    return index != PIECE_TABLE_NONE ? table->nodes[index].subtree_line_breaks : 0;
+}
+
+// Unknown if either count is
+static u64
+piece_add_line_breaks(u64 a, u64 b)
+{
+    return a == PIECE_LINE_BREAKS_UNKNOWN || b == PIECE_LINE_BREAKS_UNKNOWN ? PIECE_LINE_BREAKS_UNKNOWN : a + b;
+}
+
+static void
+piece_node_update(piece_table *table, u32 index)
+{
+    piece_node *node = &table->nodes[index];
+    node->subtree_length = node->piece.length
+                         + piece_subtree_length(table, node->left)
+                         + piece_subtree_length(table, node->right);
+    node->subtree_line_breaks = piece_add_line_breaks(node->piece.line_breaks,
+                                                      piece_add_line_breaks(piece_subtree_line_breaks(table, node->left),
+                                                                            piece_subtree_line_breaks(table, node->right)));
+}
+
+// Joins two trees, every piece of left coming before every piece of right
+static u32
+piece_table_merge(piece_table *table, u32 left, u32 right)
+{
+    if (left == PIECE_TABLE_NONE) return right;
+    if (right == PIECE_TABLE_NONE) return left;
+
+    if (table->nodes[left].priority > table->nodes[right].priority) {
+        u32 merged = piece_table_merge(table, table->nodes[left].right, right);
+        table->nodes[left].right = merged;
+        piece_node_update(table, left);
+        return left;
+    }
+    u32 merged = piece_table_merge(table, left, table->nodes[right].left);
+    table->nodes[right].left = merged;
+    piece_node_update(table, right);
+    return right;
+}
+
+// Cuts a piece after its first cut bytes, counting the line breaks of only the
+// shorter side. Both sides of a piece that was not counted stay uncounted.
+static void
+piece_cut(piece p, u64 cut, piece *head, piece *tail)
+{
+    *head = (piece){p.data, cut, 0};
+    *tail = (piece){p.data + cut, p.length - cut, 0};
+    if (p.line_breaks == PIECE_LINE_BREAKS_UNKNOWN) {
+        head->line_breaks = PIECE_LINE_BREAKS_UNKNOWN;
+        tail->line_breaks = PIECE_LINE_BREAKS_UNKNOWN;
+    } else if (head->length <= tail->length) {
+        head->line_breaks = piece_count_line_breaks(head->data, head->length);
+        tail->line_breaks = p.line_breaks - head->line_breaks;
+    } else {
+        tail->line_breaks = piece_count_line_breaks(tail->data, tail->length);
+        head->line_breaks = p.line_breaks - tail->line_breaks;
+    }
+}
+
+// Splits a tree into the first offset bytes and the rest, cutting the piece
+// that straddles offset in two.
+static void
+piece_table_split(piece_table *table, u32 index, u64 offset, u32 *left, u32 *right)
+{
+    if (index == PIECE_TABLE_NONE) {
+        *left = PIECE_TABLE_NONE;
+        *right = PIECE_TABLE_NONE;
+        return;
+    }
+
+    piece_node *node = &table->nodes[index];
+    u64 left_length = piece_subtree_length(table, node->left);
+    if (offset <= left_length) {
+        u32 rest;
+        piece_table_split(table, node->left, offset, left, &rest);
+        table->nodes[index].left = rest;
+        piece_node_update(table, index);
+        *right = index;
+    } else if (offset >= left_length + node->piece.length) {
+        u32 rest;
+        piece_table_split(table, node->right, offset - left_length - node->piece.length, &rest, right);
+        table->nodes[index].right = rest;
+        piece_node_update(table, index);
+        *left = index;
+    } else {
+        piece head, tail;
+        piece_cut(node->piece, offset - left_length, &head, &tail);
+
+        u32 old_right = node->right;
+        u32 tail_index = piece_node_alloc(table, tail);
+        node = &table->nodes[index];
+        node->piece = head;
+        node->right = PIECE_TABLE_NONE;
+        piece_node_update(table, index);
+        *left = index;
+        *right = piece_table_merge(table, tail_index, old_right);
+    }
+}
+
+// Grows the last piece of the tree by p when p directly follows it in memory,
+// which is the case when typing.
+static b32
+piece_table_extend_last(piece_table *table, u32 index, piece p)
+{
+    if (index == PIECE_TABLE_NONE) return false;
+
+    piece_node *node = &table->nodes[index];
+    if (node->right != PIECE_TABLE_NONE) {
+        if (!piece_table_extend_last(table, node->right, p)) return false;
+    } else {
+        piece *last = &node->piece;
+        if (last->data + last->length != p.data || last->length + p.length > PIECE_TABLE_MAX_PIECE_LENGTH) {
+            return false;
+        }
+        last->length += p.length;
+        last->line_breaks = piece_add_line_breaks(last->line_breaks, p.line_breaks);
+    }
+    piece_node_update(table, index);
+    return true;
+}
+
+// Appends pieces for the text at the end of the tree
+static u32
+piece_table_append_pieces(piece_table *table, u32 root, const u8 *data, u64 length)
+{
+    while (length > 0) {
+        u64 chunk = length < PIECE_TABLE_MAX_PIECE_LENGTH ? length : PIECE_TABLE_MAX_PIECE_LENGTH;
+        piece p = {data, chunk, piece_count_line_breaks(data, chunk)};
+        if (!piece_table_extend_last(table, root, p)) {
+            root = piece_table_merge(table, root, piece_node_alloc(table, p));
+        }
+        data += chunk;
+        length -= chunk;
+    }
+    return root;
+}
+
+static void
+piece_table_update_tree(piece_table *table, u32 index)
+{
+    if (index == PIECE_TABLE_NONE) return;
+    piece_table_update_tree(table, table->nodes[index].left);
+    piece_table_update_tree(table, table->nodes[index].right);
+    piece_node_update(table, index);
+}
+
+// Builds a tree of pieces in linear time. Nodes are added in order, keeping
+// the right spine on a stack; a node adopts the spine nodes of lower priority
+// as its left subtree.
+static u32
+piece_table_build(piece_table *table, const piece *pieces, u64 count)
+{
+    if (count == 0) return PIECE_TABLE_NONE;
+    u32 *spine = (u32 *)malloc(count * sizeof(u32));
+    if (!spine) LOG_FATAL("Could not allocate %llu piece table nodes.", (unsigned long long)count);
+
+    u64 top = 0;
+    for (u64 i = 0; i < count; ++i) {
+        u32 index = piece_node_alloc(table, pieces[i]);
+        u32 last = PIECE_TABLE_NONE;
+        while (top > 0 && table->nodes[spine[top - 1]].priority < table->nodes[index].priority) {
+            last = spine[--top];
+        }
+        table->nodes[index].left = last;
+        if (top > 0) table->nodes[spine[top - 1]].right = index;
+        spine[top++] = index;
+    }
+    u32 root = spine[0];
+    free(spine);
+    piece_table_update_tree(table, root);
+    return root;
+}
+
+const u8 *
+piece_table_add_text(piece_table *table, const u8 *text, u64 length)
+{
+    if (length == 0) return NULL;
+    piece_add_block *block = table->add_block_count ? &table->add_blocks[table->add_block_count - 1] : NULL;
+    if (!block || block->capacity - block->length < length) {
+        if (table->add_block_count == table->add_block_capacity) {
+            table->add_block_capacity = table->add_block_capacity ? table->add_block_capacity * 2 : 16;
+            table->add_blocks = (piece_add_block *)realloc(table->add_blocks,
+                                                           table->add_block_capacity * sizeof(piece_add_block));
+            if (!table->add_blocks) LOG_FATAL("Could not allocate %u piece table add blocks.", table->add_block_capacity);
+        }
+        block = &table->add_blocks[table->add_block_count++];
+        block->length = 0;
+        block->capacity = length > PIECE_TABLE_ADD_BLOCK_SIZE ? length : PIECE_TABLE_ADD_BLOCK_SIZE;
+        block->data = (u8 *)malloc(block->capacity);
+        if (!block->data) LOG_FATAL("Could not allocate %llu byte piece table add block.",
+                                    (unsigned long long)block->capacity);
+    }
+
+    u8 *data = block->data + block->length;
+    memcpy(data, text, length);
+    block->length += length;
+    return data;
+}
+
+static void
+piece_table_reset(piece_table *table)
+{
+    memset(table, 0, sizeof(*table));
+    table->free_node = PIECE_TABLE_NONE;
+    table->root = PIECE_TABLE_NONE;
+    table->random_state = 0x9E3779B9u;
+}
+
+b32
+piece_table_open(piece_table *table, const char *path)
+{
+    piece_table_reset(table);
+    if (!mapped_file_open(&table->file, path, 0)) {
+        LOG_ERROR("Could not open %s.", path);
+        return false;
+    }
+
+    // Pieces of at most the usual length, built in one pass, without
+    // counting their line breaks
+    u64 count = (table->file.size + PIECE_TABLE_MAX_PIECE_LENGTH - 1) / PIECE_TABLE_MAX_PIECE_LENGTH;
+    piece *pieces = (piece *)malloc((count ? count : 1) * sizeof(piece));
+    if (!pieces) LOG_FATAL("Could not allocate %llu pieces.", (unsigned long long)count);
+    for (u64 i = 0; i < count; ++i) {
+        u64 start = i * PIECE_TABLE_MAX_PIECE_LENGTH;
+        u64 end = start + PIECE_TABLE_MAX_PIECE_LENGTH < table->file.size ? start + PIECE_TABLE_MAX_PIECE_LENGTH
+                                                                          : table->file.size;
+        pieces[i] = (piece){table->file.data + start, end - start, PIECE_LINE_BREAKS_UNKNOWN};
+    }
+    table->root = piece_table_build(table, pieces, count);
+    free(pieces);
+    return true;
+}
+
+void
+piece_table_init(piece_table *table, const u8 *text, u64 length)
+{
+    piece_table_reset(table);
+    piece_table_insert(table, 0, text, length);
+}
+
+void
+piece_table_free(piece_table *table)
+{
+    for (u32 i = 0; i < table->add_block_count; ++i) {
+        free(table->add_blocks[i].data);
+    }
+    free(table->add_blocks);
+    free(table->nodes);
+    mapped_file_close(&table->file);
+    piece_table_reset(table);
+}
+
+u64
+piece_table_length(const piece_table *table)
+{
+    return piece_subtree_length(table, table->root);
+}
+
+// Counts the first uncounted piece of a subtree, if it has one
+static b32
+piece_table_count_first(piece_table *table, u32 index)
+{
+    if (piece_subtree_line_breaks(table, index) != PIECE_LINE_BREAKS_UNKNOWN) return false;
+    piece_node *node = &table->nodes[index];
+    if (!piece_table_count_first(table, node->left)) {
+        if (node->piece.line_breaks == PIECE_LINE_BREAKS_UNKNOWN) {
+            node->piece.line_breaks = piece_count_line_breaks(node->piece.data, node->piece.length);
+        } else {
+            piece_table_count_first(table, node->right);
+        }
+    }
+    piece_node_update(table, index);
+    return true;
+}
+
+// Counts every uncounted piece of a subtree that starts before end, base
+// being where the subtree starts
+static void
+piece_table_count_before(piece_table *table, u32 index, u64 base, u64 end)
+{
+    if (base >= end || piece_subtree_line_breaks(table, index) != PIECE_LINE_BREAKS_UNKNOWN) return;
+    piece_node *node = &table->nodes[index];
+    u64 piece_start = base + piece_subtree_length(table, node->left);
+    piece_table_count_before(table, node->left, base, end);
+    if (piece_start < end && node->piece.line_breaks == PIECE_LINE_BREAKS_UNKNOWN) {
+        node->piece.line_breaks = piece_count_line_breaks(node->piece.data, node->piece.length);
+    }
+    u64 piece_end = piece_start + node->piece.length;
+    if (piece_end < end) piece_table_count_before(table, node->right, piece_end, end);
+    piece_node_update(table, index);
+}
+
+// Line breaks before the first uncounted piece. Returns false if there is
+// none.
+static b32
+piece_table_counted_prefix(const piece_table *table, u64 *line_breaks)
+{
+    *line_breaks = 0;
+    u32 index = table->root;
+    if (piece_subtree_line_breaks(table, index) != PIECE_LINE_BREAKS_UNKNOWN) return false;
+    for (;;) {
+        const piece_node *node = &table->nodes[index];
+        if (piece_subtree_line_breaks(table, node->left) == PIECE_LINE_BREAKS_UNKNOWN) {
+            index = node->left;
+            continue;
+        }
+        *line_breaks += piece_subtree_line_breaks(table, node->left);
+        if (node->piece.line_breaks == PIECE_LINE_BREAKS_UNKNOWN) return true;
+        *line_breaks += node->piece.line_breaks;
+        index = node->right;
+    }
+}
+
+b32
+piece_table_count_lines(piece_table *table)
+{
+    piece_table_count_first(table, table->root);
+    return piece_subtree_line_breaks(table, table->root) == PIECE_LINE_BREAKS_UNKNOWN;
+}
+
+u64
+piece_table_line_count(piece_table *table)
+{
+    while (piece_table_count_lines(table)) {}
+    return piece_subtree_line_breaks(table, table->root) + 1;
+}
+
+const u8 *
+piece_table_insert(piece_table *table, u64 offset, const u8 *text, u64 length)
+{
+    if (length == 0) return NULL;
+    const u8 *data = piece_table_add_text(table, text, length);
+    piece_table_insert_shared(table, offset, data, length);
+    return data;
+}
+
+void
+piece_table_insert_shared(piece_table *table, u64 offset, const u8 *data, u64 length)
+{
+    if (length == 0) return;
+    u64 total = piece_table_length(table);
+    if (offset > total) offset = total;
+
+    u32 left, right;
+    piece_table_split(table, table->root, offset, &left, &right);
+    left = piece_table_append_pieces(table, left, data, length);
+    table->root = piece_table_merge(table, left, right);
+}
+
+void
+piece_table_erase(piece_table *table, u64 offset, u64 length)
+{
+    u64 total = piece_table_length(table);
+    if (offset >= total || length == 0) return;
+    if (length > total - offset) length = total - offset;
+
+    u32 left, middle, right;
+    piece_table_split(table, table->root, offset, &left, &right);
+    piece_table_split(table, right, length, &middle, &right);
+    piece_node_free_tree(table, middle);
+    table->root = piece_table_merge(table, left, right);
+}
+
+typedef struct {
+    piece *pieces;
+    u64 count;
+    u64 capacity;
+} piece_list;
+
+// Appends p, joining it to the last piece when it follows it in memory
+static void
+piece_list_push(piece_list *list, piece p)
+{
+    if (p.length == 0) return;
+    if (list->count > 0) {
+        piece *last = &list->pieces[list->count - 1];
+        if (last->data + last->length == p.data && last->length + p.length <= PIECE_TABLE_MAX_PIECE_LENGTH) {
+            last->length += p.length;
+            last->line_breaks = piece_add_line_breaks(last->line_breaks, p.line_breaks);
+            return;
+        }
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->pieces = (piece *)realloc(list->pieces, list->capacity * sizeof(piece));
+        if (!list->pieces) LOG_FATAL("Could not allocate %llu pieces.", (unsigned long long)list->capacity);
+    }
+    list->pieces[list->count++] = p;
+}
+
+// Moves the pieces of a tree to list in order and frees its nodes
+static void
+piece_table_collect(piece_table *table, u32 index, piece_list *list)
+{
+    if (index == PIECE_TABLE_NONE) return;
+    piece_table_collect(table, table->nodes[index].left, list);
+    piece_list_push(list, table->nodes[index].piece);
+    u32 right = table->nodes[index].right;
+    piece_node_free(table, index);
+    piece_table_collect(table, right, list);
+}
+
+static void
+piece_list_push_text(piece_list *list, const u8 *data, u64 length)
+{
+    while (length > 0) {
+        u64 chunk = length < PIECE_TABLE_MAX_PIECE_LENGTH ? length : PIECE_TABLE_MAX_PIECE_LENGTH;
+        piece_list_push(list, (piece){data, chunk, piece_count_line_breaks(data, chunk)});
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+// Old pieces of a batch, consumed from the front
+typedef struct {
+    const piece_list *pieces;
+    u64 next;
+    piece current;
+} piece_walk;
+
+// Moves length bytes of old text to out or, when out is NULL, reports them
+// as erased
+static void
+piece_walk_take(piece_walk *walk, u64 length, piece_list *out, piece_erased_fn fn, u64 edit, void *arg)
+{
+    while (length > 0) {
+        if (walk->current.length == 0) walk->current = walk->pieces->pieces[walk->next++];
+        piece taken = walk->current;
+        if (taken.length > length) {
+            piece_cut(walk->current, length, &taken, &walk->current);
+        } else {
+            walk->current.length = 0;
+        }
+        if (out) {
+            piece_list_push(out, taken);
+        } else if (fn) {
+            fn(edit, taken.data, taken.length, arg);
+        }
+        length -= taken.length;
+    }
+}
+
+static void
+piece_edit_clamp(const piece_edit *edit, u64 total, u64 *offset, u64 *length)
+{
+    *offset = edit->offset < total ? edit->offset : total;
+    *length = edit->length < total - *offset ? edit->length : total - *offset;
+}
+
+typedef struct {
+    piece_erased_fn fn;
+    u64 edit;
+    void *arg;
+} piece_erased_visit;
+
+static b32
+piece_table_report_erased(const u8 *data, u64 length, void *arg)
+{
+    piece_erased_visit *visit = (piece_erased_visit *)arg;
+    visit->fn(visit->edit, data, length, visit->arg);
+    return true;
+}
+
+// Applies a batch that is small next to the table, last edit first so the
+// offsets of earlier ones stay valid
+static void
+piece_table_apply_each(piece_table *table, const piece_edit *edits, u64 count, piece_erased_fn fn, void *arg)
+{
+    u64 total = piece_table_length(table);
+    for (u64 i = 0; fn && i < count; ++i) {
+        u64 offset, length;
+        piece_edit_clamp(&edits[i], total, &offset, &length);
+        piece_erased_visit visit = {fn, i, arg};
+        if (length > 0) piece_table_visit(table, offset, length, piece_table_report_erased, &visit);
+    }
+    for (u64 i = count; i-- > 0;) {
+        u64 offset, length;
+        piece_edit_clamp(&edits[i], total, &offset, &length);
+        u32 left, middle, right;
+        piece_table_split(table, table->root, offset, &left, &right);
+        piece_table_split(table, right, length, &middle, &right);
+        piece_node_free_tree(table, middle);
+        for (u32 k = 0; k < edits[i].span_count; ++k) {
+            left = piece_table_append_pieces(table, left, edits[i].spans[k].data, edits[i].spans[k].length);
+        }
+        table->root = piece_table_merge(table, left, right);
+    }
+}
+
+void
+piece_table_apply(piece_table *table, const piece_edit *edits, u64 count, piece_erased_fn fn, void *arg)
+{
+    if (count == 0) return;
+    if (count * PIECE_TABLE_BATCH_RATIO < table->piece_count) {
+        piece_table_apply_each(table, edits, count, fn, arg);
+        return;
+    }
+
+    u64 total = piece_table_length(table);
+    u64 start, end, length;
+    piece_edit_clamp(&edits[0], total, &start, &length);
+    piece_edit_clamp(&edits[count - 1], total, &end, &length);
+    end += length;
+
+    u32 left, middle, right;
+    piece_table_split(table, table->root, start, &left, &right);
+    piece_table_split(table, right, end - start, &middle, &right);
+    piece_list old = {0};
+    piece_table_collect(table, middle, &old);
+
+    piece_list out = {0};
+    piece_walk walk = {&old, 0, {0}};
+    u64 position = start;
+    for (u64 i = 0; i < count; ++i) {
+        u64 offset;
+        piece_edit_clamp(&edits[i], total, &offset, &length);
+        piece_walk_take(&walk, offset - position, &out, NULL, i, NULL);
+        piece_walk_take(&walk, length, NULL, fn, i, arg);
+        for (u32 k = 0; k < edits[i].span_count; ++k) {
+            piece_list_push_text(&out, edits[i].spans[k].data, edits[i].spans[k].length);
+        }
+        position = offset + length;
+    }
+    piece_walk_take(&walk, end - position, &out, NULL, count, NULL);
+
+    middle = piece_table_build(table, out.pieces, out.count);
+    table->root = piece_table_merge(table, piece_table_merge(table, left, middle), right);
+    free(old.pieces);
+    free(out.pieces);
+}
+
+u64
+piece_table_line_start(piece_table *table, u64 line)
+{
+    if (line == 0) return 0;
+
+    // Pieces are counted from the start until the line break is among them.
+    // The walk below then never has to go past the first uncounted piece.
+    u64 counted;
+    while (piece_table_counted_prefix(table, &counted) && counted < line) {
+        piece_table_count_first(table, table->root);
+    }
+    if (line > piece_subtree_line_breaks(table, table->root)) return piece_table_length(table);
+
+    // Find the line-th line break
+    u64 base = 0;
+    u32 index = table->root;
+    for (;;) {
+        const piece_node *node = &table->nodes[index];
+        u64 left_line_breaks = piece_subtree_line_breaks(table, node->left);
+        if (line <= left_line_breaks) {
+            index = node->left;
+            continue;
+        }
+        line -= left_line_breaks;
+        base += piece_subtree_length(table, node->left);
+        if (line <= node->piece.line_breaks) {
+            return base + line_index_find_line_break(node->piece.data, node->piece.length, line);
+        }
+        line -= node->piece.line_breaks;
+        base += node->piece.length;
+        index = node->right;
+    }
+}
+
+u64
+piece_table_line_of(piece_table *table, u64 offset)
+{
+    piece_table_count_before(table, table->root, 0, offset);
+    u64 line = 0;
+    u32 index = table->root;
+    while (index != PIECE_TABLE_NONE) {
+        const piece_node *node = &table->nodes[index];
+        u64 left_length = piece_subtree_length(table, node->left);
+        if (offset < left_length) {
+            index = node->left;
+            continue;
+        }
+        line += piece_subtree_line_breaks(table, node->left);
+        offset -= left_length;
+        if (offset < node->piece.length) {
+            return line + piece_count_line_breaks(node->piece.data, offset);
+        }
+        line += node->piece.line_breaks;
+        offset -= node->piece.length;
+        index = node->right;
+    }
+    return line;
+}
+
+static b32
+piece_table_visit_node(const piece_table *table, u32 index, u64 base, u64 start, u64 end,
+                       piece_table_visit_fn fn, void *arg)
+{
+    if (index == PIECE_TABLE_NONE) return true;
+
+    const piece_node *node = &table->nodes[index];
+    u64 piece_start = base + piece_subtree_length(table, node->left);
+    u64 piece_end = piece_start + node->piece.length;
+
+    if (start < piece_start && !piece_table_visit_node(table, node->left, base, start, end, fn, arg)) {
+        return false;
+    }
+    u64 from = start > piece_start ? start : piece_start;
+    u64 to = end < piece_end ? end : piece_end;
+    if (from < to && !fn(node->piece.data + (from - piece_start), to - from, arg)) {
+        return false;
+    }
+    if (end > piece_end) return piece_table_visit_node(table, node->right, piece_end, start, end, fn, arg);
+    return true;
+}
+
+void
+piece_table_visit(const piece_table *table, u64 offset, u64 length, piece_table_visit_fn fn, void *arg)
+{
+    u64 total = piece_table_length(table);
+    if (offset >= total) return;
+    if (length > total - offset) length = total - offset;
+    piece_table_visit_node(table, table->root, 0, offset, offset + length, fn, arg);
+}
+
+typedef struct {
+    u8 *out;
+    u64 copied;
+} piece_read_state;
+
+static b32
+piece_table_read_run(const u8 *data, u64 length, void *arg)
+{
+    piece_read_state *state = (piece_read_state *)arg;
+    memcpy(state->out + state->copied, data, length);
+    state->copied += length;
+    return true;
+}
+
+u64
+piece_table_read(const piece_table *table, u64 offset, u64 length, u8 *out)
+{
+    piece_read_state state = {out, 0};
+    piece_table_visit(table, offset, length, piece_table_read_run, &state);
+    return state.copied;
+}
@@ -0,0 +1,232 @@
+#include "raster_simd.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define RASTER_SIMD_X86
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define RASTER_SIMD_HAS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+// Read by kernels on pool workers while the main thread may change them
+static atomic_int selected_level = -1;
+static atomic_int bit_exact_mode = false;
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static raster_simd_level detected_level;
+
+static void
+raster_simd_detect_once(void)
+{
+    detected_level = RASTER_SIMD_SCALAR;
+#if defined(RASTER_SIMD_X86)
+    detected_level = RASTER_SIMD_SSE2;
+#endif
+#if defined(RASTER_SIMD_HAS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) detected_level = RASTER_SIMD_AVX2;
+#endif
+}
+
+raster_simd_level
+raster_simd_detect(void)
+{
+    pthread_once(&detect_once, raster_simd_detect_once);
+    return detected_level;
+}
+
+void
+raster_simd_set_level(raster_simd_level level)
+{
+    raster_simd_level supported = raster_simd_detect();
+    atomic_store_explicit(&selected_level, level < supported ? level : supported, memory_order_relaxed);
+}
+
+raster_simd_level
+raster_simd_get_level(void)
+{
+    s32 level = atomic_load_explicit(&selected_level, memory_order_relaxed);
+    if (level >= 0) return (raster_simd_level)level;
+    // Any thread that gets here first stores the same level
+    level = raster_simd_detect();
+    int unset = -1;
+    atomic_compare_exchange_strong_explicit(&selected_level, &unset, level, memory_order_relaxed,
+                                            memory_order_relaxed);
+    return (raster_simd_level)atomic_load_explicit(&selected_level, memory_order_relaxed);
+}
+
+void
+raster_simd_set_bit_exact(b32 bit_exact)
+{
+    atomic_store_explicit(&bit_exact_mode, bit_exact, memory_order_relaxed);
+}
+
+// Converts pixels [start, width) one at a time. running_sum is the sum of the
+// deltas before start, or NULL when deltas already holds the running sum.
+static void
+accumulate_tail(u8 *pixels, f32 *coverage, f32 *deltas, s32 start, s32 width, f32 *running_sum)
+{
+    f32 sum = running_sum ? *running_sum : 0.0f;
+    for (s32 i = start; i < width; ++i) {
+        if (running_sum) {
+            sum += deltas[i];
+        } else {
+            sum = deltas[i];
+        }
+        // Same operations, in the same order, as stb_truetype's loop
+        f32 k = coverage[i] + sum;
+        k = (f32)fabs(k) * 255 + 0.5f;
+        s32 m = (s32)k;
+        if (m > 255) m = 255;
+        pixels[i] = (u8)m;
+        coverage[i] = 0.0f;
+        deltas[i] = 0.0f;
+    }
+    deltas[width] = 0.0f;
+}
+
+void
+raster_accumulate_scanline_scalar(u8 *pixels, f32 *coverage, f32 *deltas, s32 width)
+{
+    f32 sum = 0.0f;
+    accumulate_tail(pixels, coverage, deltas, 0, width, &sum);
+}
+
+#if defined(RASTER_SIMD_X86)
+static void
+exact_running_sum(f32 *deltas, s32 width)
+{
+    f32 sum = 0.0f;
+    for (s32 i = 0; i < width; ++i) {
+        sum += deltas[i];
+        deltas[i] = sum;
+    }
+}
+
+static inline __m128
+sse2_coverage_to_bytes_input(__m128 coverage, __m128 sum)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 k = _mm_andnot_ps(sign, _mm_add_ps(coverage, sum));
+    return _mm_add_ps(_mm_mul_ps(k, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+}
+
+static void
+accumulate_sse2(u8 *pixels, f32 *coverage, f32 *deltas, s32 width, b32 exact)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 carry = zero;
+    s32 i = 0;
+
+    if (exact) exact_running_sum(deltas, width);
+
+    for (; i + 16 <= width; i += 16) {
+        __m128i m[4];
+        for (s32 v = 0; v < 4; ++v) {
+            __m128 d = _mm_loadu_ps(deltas + i + v * 4);
+            __m128 sum = d;
+            if (!exact) {
+                // In-register inclusive prefix sum, then add everything before
+                d = _mm_add_ps(d, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(d), 4)));
+                d = _mm_add_ps(d, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(d), 8)));
+                // The carry only waits on one add per vector; the broadcast
+                // of this vector's total is off the dependency chain.
+                sum = _mm_add_ps(d, carry);
+                carry = _mm_add_ps(carry, _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+            __m128 k = sse2_coverage_to_bytes_input(_mm_loadu_ps(coverage + i + v * 4), sum);
+            m[v] = _mm_cvttps_epi32(k);
+            _mm_storeu_ps(coverage + i + v * 4, zero);
+            _mm_storeu_ps(deltas + i + v * 4, zero);
+        }
+        // Saturating packs clamp to 0..255 like the scalar loop
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3]));
+        _mm_storeu_si128((__m128i *)(pixels + i), packed);
+    }
+
+    if (exact) {
+        accumulate_tail(pixels, coverage, deltas, i, width, NULL);
+    } else {
+        f32 sum = _mm_cvtss_f32(carry);
+        accumulate_tail(pixels, coverage, deltas, i, width, &sum);
+    }
+}
+#endif
+
+#if defined(RASTER_SIMD_HAS_AVX2)
+__attribute__((target("avx2")))
+static void
+accumulate_avx2(u8 *pixels, f32 *coverage, f32 *deltas, s32 width, b32 exact)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i byte_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256 carry = zero;
+    s32 i = 0;
+
+    if (exact) exact_running_sum(deltas, width);
+
+    for (; i + 32 <= width; i += 32) {
+        __m256i m[4];
+        for (s32 v = 0; v < 4; ++v) {
+            __m256 d = _mm256_loadu_ps(deltas + i + v * 8);
+            __m256 sum = d;
+            if (!exact) {
+                // Prefix sum within each 128-bit lane, then carry the low
+                // lane's total into the high lane
+                d = _mm256_add_ps(d, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(d), 4)));
+                d = _mm256_add_ps(d, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(d), 8)));
+                __m256 low_total = _mm256_permute_ps(d, _MM_SHUFFLE(3, 3, 3, 3));
+                d = _mm256_add_ps(d, _mm256_permute2f128_ps(low_total, low_total, 0x08));
+                sum = _mm256_add_ps(d, carry);
+                __m256 high = _mm256_permute2f128_ps(d, d, 0x11);
+                carry = _mm256_add_ps(carry, _mm256_permute_ps(high, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+            __m256 k = _mm256_andnot_ps(sign, _mm256_add_ps(_mm256_loadu_ps(coverage + i + v * 8), sum));
+            k = _mm256_add_ps(_mm256_mul_ps(k, scale), half);
+            m[v] = _mm256_cvttps_epi32(k);
+            _mm256_storeu_ps(coverage + i + v * 8, zero);
+            _mm256_storeu_ps(deltas + i + v * 8, zero);
+        }
+        // Packs work within 128-bit lanes, so the dwords come out interleaved
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(m[0], m[1]), _mm256_packs_epi32(m[2], m[3]));
+        packed = _mm256_permutevar8x32_epi32(packed, byte_order);
+        _mm256_storeu_si256((__m256i *)(pixels + i), packed);
+    }
+
+    if (exact) {
+        accumulate_tail(pixels, coverage, deltas, i, width, NULL);
+    } else {
+        f32 sum = _mm256_cvtss_f32(carry);
+        accumulate_tail(pixels, coverage, deltas, i, width, &sum);
+    }
+}
+#endif
+
+void
+raster_accumulate_scanline(u8 *pixels, f32 *coverage, f32 *deltas, s32 width)
+{
+    b32 exact = atomic_load_explicit(&bit_exact_mode, memory_order_relaxed);
+    switch (raster_simd_get_level()) {
+#if defined(RASTER_SIMD_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        accumulate_avx2(pixels, coverage, deltas, width, exact);
+        break;
+#endif
+#if defined(RASTER_SIMD_X86)
+    case RASTER_SIMD_SSE2:
+        accumulate_sse2(pixels, coverage, deltas, width, exact);
+        break;
+#endif
+    default:
+        raster_accumulate_scanline_scalar(pixels, coverage, deltas, width);
+        break;
+    }
+}
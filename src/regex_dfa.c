@@ -0,0 +1,1267 @@
+#include "regex_dfa.h"
+#include "log.h"
+#include "utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REGEX_NONE UINT32_MAX
+#define REGEX_INFINITE UINT32_MAX
+#define REGEX_MAX_DEPTH 1000
+#define REGEX_MAX_CODEPOINT 0x10FFFF
+
+// Flags of a DFA state, the first word of its key
+#define REGEX_DFA_LINE_START (1 << 0) // The byte that led here was a line break
+#define REGEX_DFA_MATCH      (1 << 1) // A match ended before that byte
+#define REGEX_DFA_DEAD       (1 << 2) // No thread is left
+
+// Transitions hold the row of the state they lead to, with this bit set if
+// that state matches or is dead, so searching tests one bit per byte
+#define REGEX_DFA_SPECIAL 0x80000000u
+
+// Bytes searched backwards at a time to find where a match starts
+#define REGEX_REVERSE_BLOCK 4096
+
+//
+// Parsing
+//
+
+typedef enum {
+    REGEX_NODE_EMPTY,
+    REGEX_NODE_CLASS,
+    REGEX_NODE_LINE_START,
+    REGEX_NODE_LINE_END,
+    REGEX_NODE_CONCAT,
+    REGEX_NODE_ALTERNATE,
+    REGEX_NODE_REPEAT,
+} regex_node_kind;
+
+typedef struct {
+    u32 low;
+    u32 high;
+} regex_range;
+
+typedef struct {
+    regex_range *items;
+    u32 count;
+    u32 capacity;
+} regex_ranges;
+
+typedef struct {
+    u8 kind;
+    b32 greedy;
+    u32 first; // First child, or first range of a class
+    u32 next;  // Next sibling
+    u32 count; // Ranges of a class
+    u32 min;
+    u32 max;
+} regex_node;
+
+typedef struct {
+    const u8 *pattern;
+    u64 length;
+    u64 offset;
+    b32 ignore_case;
+    u32 depth;
+
+    regex_node *nodes;
+    u32 node_count;
+    u32 node_capacity;
+    regex_ranges ranges; // Of every class, each a sorted run
+
+    const char *error;
+    u64 error_offset;
+} regex_parser;
+
+static void
+regex_ranges_push(regex_ranges *ranges, u32 low, u32 high)
+{
+    if (ranges->count == ranges->capacity) {
+        ranges->capacity = ranges->capacity ? ranges->capacity * 2 : 16;
+        ranges->items = (regex_range *)realloc(ranges->items, ranges->capacity * sizeof(regex_range));
+        if (!ranges->items) LOG_FATAL("Could not allocate %u regex ranges.", ranges->capacity);
+    }
+    ranges->items[ranges->count].low = low;
+    ranges->items[ranges->count].high = high;
+    ++ranges->count;
+}
+
+static int
+regex_range_compare(const void *a, const void *b)
+{
+    const regex_range *x = (const regex_range *)a, *y = (const regex_range *)b;
+    return x->low < y->low ? -1 : x->low > y->low;
+}
+
+// Sorts and merges overlapping or adjacent ranges
+static void
+regex_ranges_normalize(regex_ranges *ranges)
+{
+    if (ranges->count == 0) return;
+    qsort(ranges->items, ranges->count, sizeof(regex_range), regex_range_compare);
+    u32 count = 1;
+    for (u32 i = 1; i < ranges->count; ++i) {
+        regex_range *last = &ranges->items[count - 1];
+        if (ranges->items[i].low <= last->high + 1) {
+            if (ranges->items[i].high > last->high) last->high = ranges->items[i].high;
+        } else {
+            ranges->items[count++] = ranges->items[i];
+        }
+    }
+    ranges->count = count;
+}
+
+static void
+regex_ranges_negate(regex_ranges *ranges)
+{
+    regex_ranges negated = {0};
+    u32 low = 0;
+    for (u32 i = 0; i < ranges->count; ++i) {
+        if (ranges->items[i].low > low) regex_ranges_push(&negated, low, ranges->items[i].low - 1);
+        low = ranges->items[i].high + 1;
+    }
+    if (low <= REGEX_MAX_CODEPOINT) regex_ranges_push(&negated, low, REGEX_MAX_CODEPOINT);
+    free(ranges->items);
+    *ranges = negated;
+}
+
+// Adds the other case of every ASCII letter in the ranges
+static void
+regex_ranges_fold_case(regex_ranges *ranges)
+{
+    u32 count = ranges->count;
+    for (u32 i = 0; i < count; ++i) {
+        u32 low = ranges->items[i].low, high = ranges->items[i].high;
+        u32 lower_low = low > 'a' ? low : 'a', lower_high = high < 'z' ? high : 'z';
+        if (lower_low <= lower_high) regex_ranges_push(ranges, lower_low - 32, lower_high - 32);
+        u32 upper_low = low > 'A' ? low : 'A', upper_high = high < 'Z' ? high : 'Z';
+        if (upper_low <= upper_high) regex_ranges_push(ranges, upper_low + 32, upper_high + 32);
+    }
+}
+
+static b32
+regex_parse_fail(regex_parser *parser, const char *error)
+{
+    if (!parser->error) {
+        parser->error = error;
+        parser->error_offset = parser->offset;
+    }
+    return false;
+}
+
+static u32
+regex_node_add(regex_parser *parser, regex_node_kind kind)
+{
+    if (parser->node_count == parser->node_capacity) {
+        parser->node_capacity = parser->node_capacity ? parser->node_capacity * 2 : 64;
+        parser->nodes = (regex_node *)realloc(parser->nodes, parser->node_capacity * sizeof(regex_node));
+        if (!parser->nodes) LOG_FATAL("Could not allocate %u regex nodes.", parser->node_capacity);
+    }
+    regex_node *node = &parser->nodes[parser->node_count];
+    memset(node, 0, sizeof(*node));
+    node->kind = (u8)kind;
+    node->first = REGEX_NONE;
+    node->next = REGEX_NONE;
+    return parser->node_count++;
+}
+
+// Makes a class node of the ranges, which it takes
+static u32
+regex_class_add(regex_parser *parser, regex_ranges *ranges, b32 negate)
+{
+    if (parser->ignore_case) regex_ranges_fold_case(ranges);
+    regex_ranges_normalize(ranges);
+    if (negate) regex_ranges_negate(ranges);
+
+    u32 node = regex_node_add(parser, REGEX_NODE_CLASS);
+    parser->nodes[node].first = parser->ranges.count;
+    parser->nodes[node].count = ranges->count;
+    for (u32 i = 0; i < ranges->count; ++i) {
+        regex_ranges_push(&parser->ranges, ranges->items[i].low, ranges->items[i].high);
+    }
+    free(ranges->items);
+    memset(ranges, 0, sizeof(*ranges));
+    return node;
+}
+
+static b32
+regex_parse_codepoint(regex_parser *parser, u32 *codepoint)
+{
+    u64 offset = parser->offset;
+    *codepoint = utf8_decode(parser->pattern, parser->length, &offset);
+    if (*codepoint == UTF8_REPLACEMENT_CHARACTER &&
+        utf8_validate(parser->pattern + parser->offset, offset - parser->offset) != offset - parser->offset) {
+        return regex_parse_fail(parser, "invalid UTF-8");
+    }
+    parser->offset = offset;
+    return true;
+}
+
+static s32
+regex_hex_digit(u8 c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parses the escape after a backslash, either into *codepoint or, for the
+// class escapes, into ranges. Returns false on errors.
+static b32
+regex_parse_escape(regex_parser *parser, u32 *codepoint, regex_ranges *ranges, b32 *is_class)
+{
+    if (parser->offset >= parser->length) return regex_parse_fail(parser, "trailing backslash");
+    u8 c = parser->pattern[parser->offset++];
+    *is_class = false;
+    switch (c) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+        regex_ranges set = {0};
+        if (c == 'd' || c == 'D') {
+            regex_ranges_push(&set, '0', '9');
+        } else if (c == 'w' || c == 'W') {
+            regex_ranges_push(&set, '0', '9');
+            regex_ranges_push(&set, 'A', 'Z');
+            regex_ranges_push(&set, '_', '_');
+            regex_ranges_push(&set, 'a', 'z');
+        } else {
+            regex_ranges_push(&set, '\t', '\r');
+            regex_ranges_push(&set, ' ', ' ');
+        }
+        if (c == 'D' || c == 'W' || c == 'S') regex_ranges_negate(&set);
+        for (u32 i = 0; i < set.count; ++i) regex_ranges_push(ranges, set.items[i].low, set.items[i].high);
+        free(set.items);
+        *is_class = true;
+        return true;
+    }
+    case 'n': *codepoint = '\n'; return true;
+    case 't': *codepoint = '\t'; return true;
+    case 'r': *codepoint = '\r'; return true;
+    case 'f': *codepoint = '\f'; return true;
+    case 'v': *codepoint = '\v'; return true;
+    case 'x': {
+        u32 value = 0;
+        if (parser->offset < parser->length && parser->pattern[parser->offset] == '{') {
+            u32 digits = 0;
+            ++parser->offset;
+            while (parser->offset < parser->length && regex_hex_digit(parser->pattern[parser->offset]) >= 0) {
+                value = value * 16 + (u32)regex_hex_digit(parser->pattern[parser->offset++]);
+                if (++digits > 6) return regex_parse_fail(parser, "invalid hex escape");
+            }
+            if (digits == 0 || parser->offset >= parser->length || parser->pattern[parser->offset] != '}') {
+                return regex_parse_fail(parser, "invalid hex escape");
+            }
+            ++parser->offset;
+        } else {
+            for (u32 i = 0; i < 2; ++i) {
+                s32 digit = parser->offset < parser->length ? regex_hex_digit(parser->pattern[parser->offset]) : -1;
+                if (digit < 0) return regex_parse_fail(parser, "invalid hex escape");
+                value = value * 16 + (u32)digit;
+                ++parser->offset;
+            }
+        }
+        if (value > REGEX_MAX_CODEPOINT || (value >= 0xD800 && value <= 0xDFFF)) {
+            return regex_parse_fail(parser, "invalid codepoint");
+        }
+        *codepoint = value;
+        return true;
+    }
+    default:
+        // Any other punctuation stands for itself
+        if (c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+            --parser->offset;
+            return regex_parse_fail(parser, "unknown escape");
+        }
+        *codepoint = c;
+        return true;
+    }
+}
+
+// One codepoint or escape within brackets
+static b32
+regex_parse_class_item(regex_parser *parser, u32 *codepoint, regex_ranges *ranges, b32 *is_class)
+{
+    *is_class = false;
+    if (parser->pattern[parser->offset] == '\\') {
+        ++parser->offset;
+        return regex_parse_escape(parser, codepoint, ranges, is_class);
+    }
+    return regex_parse_codepoint(parser, codepoint);
+}
+
+static u32
+regex_parse_class(regex_parser *parser)
+{
+    ++parser->offset;
+    b32 negate = parser->offset < parser->length && parser->pattern[parser->offset] == '^';
+    if (negate) ++parser->offset;
+
+    regex_ranges ranges = {0};
+    b32 first = true;
+    for (;;) {
+        if (parser->offset >= parser->length) {
+            regex_parse_fail(parser, "missing ]");
+            break;
+        }
+        if (parser->pattern[parser->offset] == ']' && !first) {
+            ++parser->offset;
+            break;
+        }
+        first = false;
+
+        u32 low = 0;
+        b32 is_class;
+        if (!regex_parse_class_item(parser, &low, &ranges, &is_class)) break;
+        if (is_class) continue;
+
+        u32 high = low;
+        if (parser->offset + 1 < parser->length && parser->pattern[parser->offset] == '-' &&
+            parser->pattern[parser->offset + 1] != ']') {
+            ++parser->offset;
+            if (!regex_parse_class_item(parser, &high, &ranges, &is_class)) break;
+            if (is_class || high < low) {
+                regex_parse_fail(parser, "invalid class range");
+                break;
+            }
+        }
+        regex_ranges_push(&ranges, low, high);
+    }
+    return regex_class_add(parser, &ranges, negate);
+}
+
+static b32
+regex_parse_count(regex_parser *parser, u32 *count)
+{
+    u64 start = parser->offset;
+    *count = 0;
+    while (parser->offset < parser->length && parser->pattern[parser->offset] >= '0' &&
+           parser->pattern[parser->offset] <= '9') {
+        *count = *count * 10 + (u32)(parser->pattern[parser->offset++] - '0');
+        if (*count > REGEX_MAX_REPEAT) return regex_parse_fail(parser, "repetition count too large");
+    }
+    return parser->offset > start;
+}
+
+static u32 regex_parse_alternate(regex_parser *parser);
+
+static u32
+regex_parse_atom(regex_parser *parser)
+{
+    u8 c = parser->pattern[parser->offset];
+    switch (c) {
+    case '(': {
+        ++parser->offset;
+        if (parser->offset + 1 < parser->length && parser->pattern[parser->offset] == '?' &&
+            parser->pattern[parser->offset + 1] == ':') {
+            parser->offset += 2;
+        }
+        if (++parser->depth > REGEX_MAX_DEPTH) {
+            regex_parse_fail(parser, "groups nested too deeply");
+            return regex_node_add(parser, REGEX_NODE_EMPTY);
+        }
+        u32 inner = regex_parse_alternate(parser);
+        --parser->depth;
+        if (parser->offset >= parser->length || parser->pattern[parser->offset] != ')') {
+            regex_parse_fail(parser, "missing )");
+        } else {
+            ++parser->offset;
+        }
+        return inner;
+    }
+    case '*': case '+': case '?': case '{':
+        regex_parse_fail(parser, "nothing to repeat");
+        return regex_node_add(parser, REGEX_NODE_EMPTY);
+    case '^':
+        ++parser->offset;
+        return regex_node_add(parser, REGEX_NODE_LINE_START);
+    case '$':
+        ++parser->offset;
+        return regex_node_add(parser, REGEX_NODE_LINE_END);
+    case '[':
+        return regex_parse_class(parser);
+    case '.': {
+        ++parser->offset;
+        regex_ranges ranges = {0};
+        regex_ranges_push(&ranges, '\n', '\n');
+        return regex_class_add(parser, &ranges, true);
+    }
+    default: {
+        regex_ranges ranges = {0};
+        u32 codepoint = 0;
+        b32 is_class = false;
+        if (c == '\\') {
+            ++parser->offset;
+            regex_parse_escape(parser, &codepoint, &ranges, &is_class);
+        } else {
+            regex_parse_codepoint(parser, &codepoint);
+        }
+        if (!is_class) regex_ranges_push(&ranges, codepoint, codepoint);
+        return regex_class_add(parser, &ranges, false);
+    }
+    }
+}
+
+static u32
+regex_parse_repeat(regex_parser *parser)
+{
+    u32 atom = regex_parse_atom(parser);
+    while (!parser->error && parser->offset < parser->length) {
+        u8 c = parser->pattern[parser->offset];
+        u32 min = 0, max = REGEX_INFINITE;
+        if (c == '*') {
+            ++parser->offset;
+        } else if (c == '+') {
+            min = 1;
+            ++parser->offset;
+        } else if (c == '?') {
+            max = 1;
+            ++parser->offset;
+        } else if (c == '{') {
+            ++parser->offset;
+            if (!regex_parse_count(parser, &min)) {
+                regex_parse_fail(parser, "malformed repetition");
+                break;
+            }
+            max = min;
+            if (parser->offset < parser->length && parser->pattern[parser->offset] == ',') {
+                ++parser->offset;
+                if (!regex_parse_count(parser, &max)) max = REGEX_INFINITE;
+            }
+            if (parser->error) break;
+            if (parser->offset >= parser->length || parser->pattern[parser->offset] != '}') {
+                regex_parse_fail(parser, "malformed repetition");
+                break;
+            }
+            ++parser->offset;
+            if (max < min) {
+                regex_parse_fail(parser, "repetition range out of order");
+                break;
+            }
+        } else {
+            break;
+        }
+
+        b32 greedy = true;
+        if (parser->offset < parser->length && parser->pattern[parser->offset] == '?') {
+            greedy = false;
+            ++parser->offset;
+        }
+        u32 repeat = regex_node_add(parser, REGEX_NODE_REPEAT);
+        regex_node *node = &parser->nodes[repeat];
+        node->first = atom;
+        node->min = min;
+        node->max = max;
+        node->greedy = greedy;
+        atom = repeat;
+    }
+    return atom;
+}
+
+static u32
+regex_parse_concat(regex_parser *parser)
+{
+    u32 concat = regex_node_add(parser, REGEX_NODE_CONCAT);
+    u32 last = REGEX_NONE;
+    while (!parser->error && parser->offset < parser->length && parser->pattern[parser->offset] != '|' &&
+           parser->pattern[parser->offset] != ')') {
+        u32 child = regex_parse_repeat(parser);
+        if (last == REGEX_NONE) {
+            parser->nodes[concat].first = child;
+        } else {
+            parser->nodes[last].next = child;
+        }
+        last = child;
+    }
+    if (last == REGEX_NONE) parser->nodes[concat].kind = REGEX_NODE_EMPTY;
+    return concat;
+}
+
+static u32
+regex_parse_alternate(regex_parser *parser)
+{
+    u32 first = regex_parse_concat(parser);
+    if (parser->error || parser->offset >= parser->length || parser->pattern[parser->offset] != '|') return first;
+
+    u32 alternate = regex_node_add(parser, REGEX_NODE_ALTERNATE);
+    parser->nodes[alternate].first = first;
+    u32 last = first;
+    while (!parser->error && parser->offset < parser->length && parser->pattern[parser->offset] == '|') {
+        ++parser->offset;
+        u32 child = regex_parse_concat(parser);
+        parser->nodes[last].next = child;
+        last = child;
+    }
+    return alternate;
+}
+
+//
+// Compiling to an NFA
+//
+
+// Byte ranges of one UTF-8 encoded codepoint range
+typedef struct {
+    u8 low[4];
+    u8 high[4];
+    u32 length;
+} regex_sequence;
+
+typedef struct {
+    const regex_parser *parser;
+    regex_nfa *nfa;
+    b32 reverse;
+
+    regex_sequence *sequences;
+    u32 sequence_count;
+    u32 sequence_capacity;
+
+    const char *error;
+} regex_compiler;
+
+static u32
+regex_nfa_add(regex_compiler *compiler, regex_state_kind kind, u8 low, u8 high, u32 out, u32 out1)
+{
+    regex_nfa *nfa = compiler->nfa;
+    if (nfa->count >= REGEX_MAX_STATES) {
+        compiler->error = "pattern too large";
+        return 0;
+    }
+    if (nfa->count == nfa->capacity) {
+        nfa->capacity = nfa->capacity ? nfa->capacity * 2 : 64;
+        nfa->states = (regex_state *)realloc(nfa->states, nfa->capacity * sizeof(regex_state));
+        if (!nfa->states) LOG_FATAL("Could not allocate %u regex states.", nfa->capacity);
+    }
+    regex_state *state = &nfa->states[nfa->count];
+    state->kind = (u8)kind;
+    state->low = low;
+    state->high = high;
+    state->out = out;
+    state->out1 = out1;
+    return nfa->count++;
+}
+
+static u32
+regex_encode_utf8(u32 codepoint, u8 *bytes)
+{
+    if (codepoint < 0x80) {
+        bytes[0] = (u8)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        bytes[0] = (u8)(0xC0 | (codepoint >> 6));
+        bytes[1] = (u8)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        bytes[0] = (u8)(0xE0 | (codepoint >> 12));
+        bytes[1] = (u8)(0x80 | ((codepoint >> 6) & 0x3F));
+        bytes[2] = (u8)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    bytes[0] = (u8)(0xF0 | (codepoint >> 18));
+    bytes[1] = (u8)(0x80 | ((codepoint >> 12) & 0x3F));
+    bytes[2] = (u8)(0x80 | ((codepoint >> 6) & 0x3F));
+    bytes[3] = (u8)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+// Splits a codepoint range into runs whose encodings differ only in a range
+// of each byte, so every run is a chain of byte ranges
+static void
+regex_split_utf8(regex_compiler *compiler, u32 low, u32 high)
+{
+    // Encoded lengths change after these
+    static const u32 limits[] = {0x7F, 0x7FF, 0xFFFF};
+    for (u32 i = 0; i < 3; ++i) {
+        if (low <= limits[i] && high > limits[i]) {
+            regex_split_utf8(compiler, low, limits[i]);
+            regex_split_utf8(compiler, limits[i] + 1, high);
+            return;
+        }
+    }
+    for (u32 i = 1; i < 4 && high > 0x7F; ++i) {
+        u32 mask = (1u << (6 * i)) - 1;
+        if ((low & ~mask) != (high & ~mask)) {
+            if ((low & mask) != 0) {
+                regex_split_utf8(compiler, low, low | mask);
+                regex_split_utf8(compiler, (low | mask) + 1, high);
+                return;
+            }
+            if ((high & mask) != mask) {
+                regex_split_utf8(compiler, low, (high & ~mask) - 1);
+                regex_split_utf8(compiler, high & ~mask, high);
+                return;
+            }
+        }
+    }
+
+    if (compiler->sequence_count == compiler->sequence_capacity) {
+        compiler->sequence_capacity = compiler->sequence_capacity ? compiler->sequence_capacity * 2 : 16;
+        compiler->sequences = (regex_sequence *)realloc(compiler->sequences,
+                                                        compiler->sequence_capacity * sizeof(regex_sequence));
+        if (!compiler->sequences) LOG_FATAL("Could not allocate %u regex sequences.", compiler->sequence_capacity);
+    }
+    regex_sequence *sequence = &compiler->sequences[compiler->sequence_count++];
+    sequence->length = regex_encode_utf8(low, sequence->low);
+    regex_encode_utf8(high, sequence->high);
+}
+
+static u32
+regex_compile_class(regex_compiler *compiler, const regex_node *node, u32 next)
+{
+    compiler->sequence_count = 0;
+    for (u32 i = 0; i < node->count; ++i) {
+        regex_range range = compiler->parser->ranges.items[node->first + i];
+        // Surrogates are not codepoints UTF-8 can encode
+        if (range.low < 0xD800 && range.high >= 0xD800) {
+            regex_split_utf8(compiler, range.low, 0xD7FF);
+            range.low = 0xD800;
+        }
+        if (range.low <= 0xDFFF && range.high >= 0xD800) {
+            if (range.high <= 0xDFFF) continue;
+            range.low = 0xE000;
+        }
+        regex_split_utf8(compiler, range.low, range.high);
+    }
+    if (compiler->sequence_count == 0) {
+        // Nothing matches an empty class
+        return regex_nfa_add(compiler, REGEX_STATE_RANGE, 1, 0, next, 0);
+    }
+
+    u32 entry = REGEX_NONE;
+    for (u32 i = compiler->sequence_count; i-- > 0;) {
+        const regex_sequence *sequence = &compiler->sequences[i];
+        u32 chain = next;
+        for (u32 k = 0; k < sequence->length; ++k) {
+            // Built from the last byte consumed to the first
+            u32 byte = compiler->reverse ? k : sequence->length - 1 - k;
+            chain = regex_nfa_add(compiler, REGEX_STATE_RANGE, sequence->low[byte], sequence->high[byte], chain, 0);
+        }
+        entry = entry == REGEX_NONE ? chain : regex_nfa_add(compiler, REGEX_STATE_SPLIT, 0, 0, chain, entry);
+    }
+    return entry;
+}
+
+// Compiles node to states that continue to next, returning the entry state
+static u32
+regex_compile_node(regex_compiler *compiler, u32 index, u32 next)
+{
+    if (compiler->error) return next;
+    const regex_node *node = &compiler->parser->nodes[index];
+    switch ((regex_node_kind)node->kind) {
+    case REGEX_NODE_EMPTY:
+        return next;
+    case REGEX_NODE_CLASS:
+        return regex_compile_class(compiler, node, next);
+    case REGEX_NODE_LINE_START:
+    case REGEX_NODE_LINE_END: {
+        // Scanning backwards, the byte before becomes the byte after
+        b32 start = (node->kind == REGEX_NODE_LINE_START) != compiler->reverse;
+        return regex_nfa_add(compiler, start ? REGEX_STATE_LINE_START : REGEX_STATE_LINE_END, 0, 0, next, 0);
+    }
+    case REGEX_NODE_CONCAT: {
+        u32 count = 0;
+        for (u32 child = node->first; child != REGEX_NONE; child = compiler->parser->nodes[child].next) ++count;
+        u32 *children = (u32 *)malloc(count * sizeof(u32));
+        if (!children) LOG_FATAL("Could not allocate %u regex children.", count);
+        count = 0;
+        for (u32 child = node->first; child != REGEX_NONE; child = compiler->parser->nodes[child].next) {
+            children[count++] = child;
+        }
+        for (u32 i = 0; i < count; ++i) {
+            next = regex_compile_node(compiler, children[compiler->reverse ? i : count - 1 - i], next);
+        }
+        free(children);
+        return next;
+    }
+    case REGEX_NODE_ALTERNATE: {
+        // Splits in order of the alternatives, so earlier ones take priority
+        u32 entry = REGEX_NONE;
+        u32 last_split = REGEX_NONE;
+        for (u32 child = node->first; child != REGEX_NONE; child = compiler->parser->nodes[child].next) {
+            u32 branch = regex_compile_node(compiler, child, next);
+            if (compiler->error) return next;
+            if (compiler->parser->nodes[child].next == REGEX_NONE) {
+                if (last_split == REGEX_NONE) return branch;
+                compiler->nfa->states[last_split].out1 = branch;
+            } else {
+                u32 split = regex_nfa_add(compiler, REGEX_STATE_SPLIT, 0, 0, branch, REGEX_NONE);
+                if (compiler->error) return next;
+                if (last_split == REGEX_NONE) {
+                    entry = split;
+                } else {
+                    compiler->nfa->states[last_split].out1 = split;
+                }
+                last_split = split;
+            }
+        }
+        return entry;
+    }
+    case REGEX_NODE_REPEAT: {
+        u32 min = node->min, max = node->max;
+        b32 greedy = node->greedy;
+        u32 child = node->first;
+        u32 entry = next;
+        if (max == REGEX_INFINITE) {
+            u32 loop = regex_nfa_add(compiler, REGEX_STATE_SPLIT, 0, 0, 0, 0);
+            u32 body = regex_compile_node(compiler, child, loop);
+            if (compiler->error) return next;
+            compiler->nfa->states[loop].out = greedy ? body : next;
+            compiler->nfa->states[loop].out1 = greedy ? next : body;
+            entry = loop;
+        } else {
+            // x{0,3} as (x(x(x)?)?)?
+            for (u32 i = min; i < max && !compiler->error; ++i) {
+                u32 body = regex_compile_node(compiler, child, entry);
+                entry = regex_nfa_add(compiler, REGEX_STATE_SPLIT, 0, 0, greedy ? body : next, greedy ? next : body);
+            }
+        }
+        for (u32 i = 0; i < min && !compiler->error; ++i) entry = regex_compile_node(compiler, child, entry);
+        return entry;
+    }
+    }
+    return next;
+}
+
+static b32
+regex_compile_nfa(const regex_parser *parser, u32 root, b32 reverse, regex_nfa *nfa, const char **error)
+{
+    regex_compiler compiler = {0};
+    compiler.parser = parser;
+    compiler.nfa = nfa;
+    compiler.reverse = reverse;
+
+    u32 match = regex_nfa_add(&compiler, REGEX_STATE_MATCH, 0, 0, 0, 0);
+    nfa->start = regex_compile_node(&compiler, root, match);
+    if (!reverse) {
+        // Unanchored searches go through a lazy loop over any byte, so
+        // threads that start earlier keep priority over later ones
+        u32 loop = regex_nfa_add(&compiler, REGEX_STATE_SPLIT, 0, 0, nfa->start, 0);
+        u32 any = regex_nfa_add(&compiler, REGEX_STATE_RANGE, 0x00, 0xFF, loop, 0);
+        if (!compiler.error) nfa->states[loop].out1 = any;
+        nfa->start = loop;
+    }
+    free(compiler.sequences);
+    *error = compiler.error;
+    return !compiler.error;
+}
+
+//
+// Lazy DFA
+//
+
+static u64
+regex_dfa_memory(const regex_dfa *dfa)
+{
+    return (u64)dfa->state_count * (dfa->stride * sizeof(u32) + 3 * sizeof(u32) + 1) +
+           (u64)dfa->key_count * sizeof(u32) + (u64)dfa->bucket_count * sizeof(u32);
+}
+
+static void
+regex_dfa_clear(regex_dfa *dfa)
+{
+    dfa->state_count = 0;
+    dfa->key_count = 0;
+    for (u32 i = 0; i < dfa->bucket_count; ++i) dfa->buckets[i] = REGEX_NONE;
+    dfa->start[0] = REGEX_NONE;
+    dfa->start[1] = REGEX_NONE;
+}
+
+static void
+regex_dfa_init(regex_dfa *dfa, const regex_nfa *nfa, b32 leftmost_first, u64 budget)
+{
+    memset(dfa, 0, sizeof(*dfa));
+    dfa->leftmost_first = leftmost_first;
+    // Keeps rows below REGEX_DFA_SPECIAL
+    dfa->budget = budget < (1u << 30) ? budget : (1u << 30);
+
+    b32 boundary[257] = {0};
+    for (u32 i = 0; i < nfa->count; ++i) {
+        const regex_state *state = &nfa->states[i];
+        if (state->kind != REGEX_STATE_RANGE || state->low > state->high) continue;
+        boundary[state->low] = true;
+        boundary[state->high + 1] = true;
+    }
+    // Line breaks decide the line assertions
+    boundary['\n'] = true;
+    boundary['\n' + 1] = true;
+    u32 class = 0;
+    dfa->class_bytes[0] = 0;
+    for (u32 byte = 1; byte < 256; ++byte) {
+        if (boundary[byte]) dfa->class_bytes[++class] = (u8)byte;
+        dfa->classes[byte] = (u8)class;
+    }
+    dfa->class_count = class + 1;
+    dfa->stride = dfa->class_count + 1;
+
+    u64 count = nfa->count ? nfa->count : 1;
+    for (u32 i = 0; i < 2; ++i) {
+        dfa->sparse[i] = (u32 *)calloc(count, sizeof(u32));
+        dfa->dense[i] = (u32 *)calloc(count, sizeof(u32));
+        dfa->scratch[i] = (u32 *)calloc(count + 1, sizeof(u32));
+        if (!dfa->sparse[i] || !dfa->dense[i] || !dfa->scratch[i]) LOG_FATAL("Could not allocate regex scratch.");
+    }
+    dfa->stack = (u32 *)calloc(2 * count + 2, sizeof(u32));
+    dfa->bucket_count = 1024;
+    dfa->buckets = (u32 *)malloc(dfa->bucket_count * sizeof(u32));
+    if (!dfa->stack || !dfa->buckets) LOG_FATAL("Could not allocate regex scratch.");
+    regex_dfa_clear(dfa);
+}
+
+static void
+regex_dfa_free(regex_dfa *dfa)
+{
+    free(dfa->transitions);
+    free(dfa->keys);
+    free(dfa->key_offsets);
+    free(dfa->key_lengths);
+    free(dfa->flags);
+    free(dfa->buckets);
+    for (u32 i = 0; i < 2; ++i) {
+        free(dfa->sparse[i]);
+        free(dfa->dense[i]);
+        free(dfa->scratch[i]);
+    }
+    free(dfa->stack);
+    memset(dfa, 0, sizeof(*dfa));
+}
+
+static u32
+regex_hash(const u32 *key, u32 length)
+{
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < length; ++i) hash = (hash ^ key[i]) * 16777619u;
+    return hash;
+}
+
+static void
+regex_dfa_insert_bucket(regex_dfa *dfa, u32 index)
+{
+    u32 mask = dfa->bucket_count - 1;
+    u32 bucket = regex_hash(dfa->keys + dfa->key_offsets[index], dfa->key_lengths[index]) & mask;
+    while (dfa->buckets[bucket] != REGEX_NONE) bucket = (bucket + 1) & mask;
+    dfa->buckets[bucket] = index;
+}
+
+// Finds or adds the state with this key. Returns REGEX_NONE when adding it
+// would go over budget, unless forced.
+static u32
+regex_dfa_add(regex_dfa *dfa, const u32 *key, u32 length, b32 force)
+{
+    u32 mask = dfa->bucket_count - 1;
+    for (u32 bucket = regex_hash(key, length) & mask;; bucket = (bucket + 1) & mask) {
+        u32 index = dfa->buckets[bucket];
+        if (index == REGEX_NONE) break;
+        if (dfa->key_lengths[index] == length &&
+            memcmp(dfa->keys + dfa->key_offsets[index], key, length * sizeof(u32)) == 0) {
+            return index;
+        }
+    }
+
+    u64 cost = dfa->stride * sizeof(u32) + 3 * sizeof(u32) + 1 + length * sizeof(u32);
+    if (!force && regex_dfa_memory(dfa) + cost > dfa->budget) return REGEX_NONE;
+
+    if (dfa->state_count == dfa->state_capacity) {
+        dfa->state_capacity = dfa->state_capacity ? dfa->state_capacity * 2 : 64;
+        dfa->transitions = (u32 *)realloc(dfa->transitions, (u64)dfa->state_capacity * dfa->stride * sizeof(u32));
+        dfa->key_offsets = (u32 *)realloc(dfa->key_offsets, dfa->state_capacity * sizeof(u32));
+        dfa->key_lengths = (u32 *)realloc(dfa->key_lengths, dfa->state_capacity * sizeof(u32));
+        dfa->flags = (u8 *)realloc(dfa->flags, dfa->state_capacity);
+        if (!dfa->transitions || !dfa->key_offsets || !dfa->key_lengths || !dfa->flags) {
+            LOG_FATAL("Could not allocate %u regex DFA states.", dfa->state_capacity);
+        }
+    }
+    if (dfa->key_count + length > dfa->key_capacity) {
+        while (dfa->key_count + length > dfa->key_capacity) {
+            dfa->key_capacity = dfa->key_capacity ? dfa->key_capacity * 2 : 1024;
+        }
+        dfa->keys = (u32 *)realloc(dfa->keys, dfa->key_capacity * sizeof(u32));
+        if (!dfa->keys) LOG_FATAL("Could not allocate %u regex DFA keys.", dfa->key_capacity);
+    }
+
+    u32 index = dfa->state_count++;
+    memcpy(dfa->keys + dfa->key_count, key, length * sizeof(u32));
+    dfa->key_offsets[index] = dfa->key_count;
+    dfa->key_lengths[index] = length;
+    dfa->key_count += length;
+    dfa->flags[index] = (u8)key[0];
+    u32 *row = dfa->transitions + (u64)index * dfa->stride;
+    for (u32 i = 0; i < dfa->stride; ++i) row[i] = REGEX_NONE;
+
+    if (dfa->state_count * 2 > dfa->bucket_count) {
+        dfa->bucket_count *= 2;
+        dfa->buckets = (u32 *)realloc(dfa->buckets, dfa->bucket_count * sizeof(u32));
+        if (!dfa->buckets) LOG_FATAL("Could not allocate %u regex DFA buckets.", dfa->bucket_count);
+        for (u32 i = 0; i < dfa->bucket_count; ++i) dfa->buckets[i] = REGEX_NONE;
+        for (u32 i = 0; i < dfa->state_count; ++i) regex_dfa_insert_bucket(dfa, i);
+    } else {
+        regex_dfa_insert_bucket(dfa, index);
+    }
+    return index;
+}
+
+// Adds the states reachable from id without consuming a byte to set, in
+// priority order. line_end is -1 while the next byte is unknown, which keeps
+// line end assertions in the set to be decided on the next step. Returns
+// whether a match was reached; in leftmost-first mode nothing after it is
+// added, as lower priority threads can no longer win.
+static b32
+regex_dfa_close(regex_dfa *dfa, const regex_nfa *nfa, u32 set, u32 *size, u32 id, b32 line_start, s32 line_end)
+{
+    u32 *sparse = dfa->sparse[set];
+    u32 *dense = dfa->dense[set];
+    u32 *stack = dfa->stack;
+    u32 top = 0;
+    b32 matched = false;
+    stack[top++] = id;
+    while (top > 0) {
+        u32 current = stack[--top];
+        u32 slot = sparse[current];
+        if (slot < *size && dense[slot] == current) continue;
+        sparse[current] = *size;
+        dense[(*size)++] = current;
+
+        const regex_state *state = &nfa->states[current];
+        switch ((regex_state_kind)state->kind) {
+        case REGEX_STATE_EMPTY:
+            stack[top++] = state->out;
+            break;
+        case REGEX_STATE_SPLIT:
+            stack[top++] = state->out1;
+            stack[top++] = state->out;
+            break;
+        case REGEX_STATE_LINE_START:
+            if (line_start) stack[top++] = state->out;
+            break;
+        case REGEX_STATE_LINE_END:
+            if (line_end == 1) stack[top++] = state->out;
+            break;
+        case REGEX_STATE_MATCH:
+            matched = true;
+            if (dfa->leftmost_first) return true;
+            break;
+        case REGEX_STATE_RANGE:
+            break;
+        }
+    }
+    return matched;
+}
+
+// Writes the key of the state holding set 1 to key, returning its length
+static u32
+regex_dfa_key(const regex_dfa *dfa, const regex_nfa *nfa, u32 size, u32 flags, u32 *key)
+{
+    u32 length = 1;
+    for (u32 i = 0; i < size; ++i) {
+        u32 id = dfa->dense[1][i];
+        u8 kind = nfa->states[id].kind;
+        if (kind == REGEX_STATE_RANGE || kind == REGEX_STATE_MATCH || kind == REGEX_STATE_LINE_END) key[length++] = id;
+    }
+    key[0] = flags | (length == 1 ? REGEX_DFA_DEAD : 0);
+    return length;
+}
+
+static u32
+regex_dfa_start(regex_dfa *dfa, const regex_nfa *nfa, b32 line_start)
+{
+    if (dfa->start[line_start] != REGEX_NONE) return dfa->start[line_start];
+    u32 size = 0;
+    regex_dfa_close(dfa, nfa, 1, &size, nfa->start, line_start, -1);
+    u32 *key = dfa->scratch[0];
+    u32 length = regex_dfa_key(dfa, nfa, size, line_start ? REGEX_DFA_LINE_START : 0, key);
+    u32 state = regex_dfa_add(dfa, key, length, false);
+    if (state == REGEX_NONE) {
+        regex_dfa_clear(dfa);
+        ++dfa->clears;
+        state = regex_dfa_add(dfa, key, length, true);
+    }
+    dfa->start[line_start] = state;
+    return state;
+}
+
+// Computes and caches the transition of *state on a byte class, or on the
+// end of input for column class_count. When the cache is full it is cleared
+// first and *state moves to its new index.
+static u32
+regex_dfa_step(regex_dfa *dfa, const regex_nfa *nfa, u32 *state, u32 column)
+{
+    const u32 *current = dfa->keys + dfa->key_offsets[*state];
+    u32 current_length = dfa->key_lengths[*state];
+    b32 end_of_input = column == dfa->class_count;
+    u8 byte = end_of_input ? 0 : dfa->class_bytes[column];
+    b32 line_start = (current[0] & REGEX_DFA_LINE_START) != 0;
+    s32 line_end = end_of_input || byte == '\n';
+
+    // Line end assertions are decided now that the byte is known
+    u32 resolved = 0;
+    b32 matched = false;
+    for (u32 i = 1; i < current_length; ++i) {
+        if (regex_dfa_close(dfa, nfa, 0, &resolved, current[i], line_start, line_end)) {
+            matched = true;
+            if (dfa->leftmost_first) break;
+        }
+    }
+
+    u32 size = 0;
+    if (!end_of_input) {
+        for (u32 i = 0; i < resolved; ++i) {
+            const regex_state *s = &nfa->states[dfa->dense[0][i]];
+            if (s->kind != REGEX_STATE_RANGE || byte < s->low || byte > s->high) continue;
+            if (regex_dfa_close(dfa, nfa, 1, &size, s->out, byte == '\n', -1) && dfa->leftmost_first) break;
+        }
+    }
+    u32 flags = (!end_of_input && byte == '\n' ? REGEX_DFA_LINE_START : 0) | (matched ? REGEX_DFA_MATCH : 0);
+    u32 *key = dfa->scratch[0];
+    u32 length = regex_dfa_key(dfa, nfa, size, flags, key);
+
+    u32 next = regex_dfa_add(dfa, key, length, false);
+    if (next == REGEX_NONE) {
+        // Start over with just the state being searched from
+        u32 *saved = dfa->scratch[1];
+        memcpy(saved, current, current_length * sizeof(u32));
+        regex_dfa_clear(dfa);
+        ++dfa->clears;
+        *state = regex_dfa_add(dfa, saved, current_length, true);
+        next = regex_dfa_add(dfa, key, length, true);
+    }
+    b32 special = (dfa->flags[next] & (REGEX_DFA_MATCH | REGEX_DFA_DEAD)) != 0;
+    dfa->transitions[*state * dfa->stride + column] = next * dfa->stride | (special ? REGEX_DFA_SPECIAL : 0);
+    return next;
+}
+
+// Follows the transition from the state at row, which moves if the cache is
+// cleared. Returns the target's row with REGEX_DFA_SPECIAL.
+static inline u32
+regex_dfa_next(regex_dfa *dfa, const regex_nfa *nfa, u32 *row, u32 column)
+{
+    u32 next = dfa->transitions[*row + column];
+    if (next == REGEX_NONE) {
+        u32 state = *row / dfa->stride;
+        regex_dfa_step(dfa, nfa, &state, column);
+        *row = state * dfa->stride;
+        next = dfa->transitions[*row + column];
+    }
+    return next;
+}
+
+static inline u8
+regex_dfa_flags(const regex_dfa *dfa, u32 next)
+{
+    return dfa->flags[(next & ~REGEX_DFA_SPECIAL) / dfa->stride];
+}
+
+//
+// Searching
+//
+
+static b32
+regex_copy_chunk(const u8 *data, u64 length, void *arg)
+{
+    u8 **out = (u8 **)arg;
+    memcpy(*out, data, length);
+    *out += length;
+    return true;
+}
+
+static void
+regex_read(const find_source *source, u64 offset, u64 length, u8 *out)
+{
+    if (length > 0) source->visit(source->document, offset, length, regex_copy_chunk, &out);
+}
+
+static u8
+regex_byte_at(const find_source *source, u64 offset)
+{
+    u8 byte = 0;
+    regex_read(source, offset, 1, &byte);
+    return byte;
+}
+
+// Column for what follows a position, the byte there or the end of input
+static u32
+regex_column_at(const regex_dfa *dfa, const find_source *source, u64 offset, b32 at_end)
+{
+    return at_end ? dfa->class_count : dfa->classes[regex_byte_at(source, offset)];
+}
+
+typedef struct {
+    regex *re;
+    u32 row;
+    u64 position;  // Offset of the next byte
+    u64 match_end;
+    b32 dead;
+} regex_forward;
+
+static b32
+regex_forward_chunk(const u8 *data, u64 length, void *arg)
+{
+    regex_forward *forward = (regex_forward *)arg;
+    regex_dfa *dfa = &forward->re->forward_dfa;
+    const regex_nfa *nfa = &forward->re->forward;
+    u32 row = forward->row;
+    for (u64 i = 0; i < length; ++i) {
+        u32 next = regex_dfa_next(dfa, nfa, &row, dfa->classes[data[i]]);
+        row = next & ~REGEX_DFA_SPECIAL;
+        if (next & REGEX_DFA_SPECIAL) {
+            u8 flags = regex_dfa_flags(dfa, next);
+            if (flags & REGEX_DFA_MATCH) forward->match_end = forward->position + i;
+            if (flags & REGEX_DFA_DEAD) {
+                forward->dead = true;
+                return false;
+            }
+        }
+    }
+    forward->row = row;
+    forward->position += length;
+    return true;
+}
+
+// Finds where the leftmost-first match starting in [from, end) ends
+static u64
+regex_forward_search(regex *re, const find_source *source, u64 from, u64 end)
+{
+    regex_dfa *dfa = &re->forward_dfa;
+    b32 line_start = from == 0 || regex_byte_at(source, from - 1) == '\n';
+    regex_forward forward = {0};
+    forward.re = re;
+    forward.row = regex_dfa_start(dfa, &re->forward, line_start) * dfa->stride;
+    forward.position = from;
+    forward.match_end = UINT64_MAX;
+    if (end > from) source->visit(source->document, from, end - from, regex_forward_chunk, &forward);
+    if (!forward.dead) {
+        u32 column = regex_column_at(dfa, source, end, end == source->length);
+        u32 next = regex_dfa_next(dfa, &re->forward, &forward.row, column);
+        if (regex_dfa_flags(dfa, next) & REGEX_DFA_MATCH) forward.match_end = end;
+    }
+    return forward.match_end;
+}
+
+// Scans back from the end of a match to the furthest start in [from, end)
+static u64
+regex_reverse_search(regex *re, const find_source *source, u64 from, u64 end)
+{
+    regex_dfa *dfa = &re->reverse_dfa;
+    const regex_nfa *nfa = &re->reverse;
+    b32 line_start = end == source->length || regex_byte_at(source, end) == '\n';
+    u32 row = regex_dfa_start(dfa, nfa, line_start) * dfa->stride;
+    u64 start = UINT64_MAX;
+
+    u8 block[REGEX_REVERSE_BLOCK];
+    u64 position = end;
+    while (position > from) {
+        u64 length = position - from < sizeof(block) ? position - from : sizeof(block);
+        regex_read(source, position - length, length, block);
+        for (u64 i = length; i-- > 0;) {
+            u32 next = regex_dfa_next(dfa, nfa, &row, dfa->classes[block[i]]);
+            row = next & ~REGEX_DFA_SPECIAL;
+            if (next & REGEX_DFA_SPECIAL) {
+                u8 flags = regex_dfa_flags(dfa, next);
+                if (flags & REGEX_DFA_MATCH) start = position - length + i + 1;
+                if (flags & REGEX_DFA_DEAD) return start;
+            }
+        }
+        position -= length;
+    }
+    u32 column = regex_column_at(dfa, source, from - (from > 0), from == 0);
+    u32 next = regex_dfa_next(dfa, nfa, &row, column);
+    if (regex_dfa_flags(dfa, next) & REGEX_DFA_MATCH) start = from;
+    return start;
+}
+
+b32
+regex_compile(regex *re, const u8 *pattern, u64 length, u32 flags, u64 cache_size)
+{
+    memset(re, 0, sizeof(*re));
+    regex_parser parser = {0};
+    parser.pattern = pattern;
+    parser.length = length;
+    parser.ignore_case = (flags & REGEX_IGNORE_CASE) != 0;
+
+    u32 root = regex_parse_alternate(&parser);
+    if (!parser.error && parser.offset < parser.length) regex_parse_fail(&parser, "unmatched )");
+
+    const char *error = parser.error;
+    u64 error_offset = parser.error_offset;
+    if (!error && (!regex_compile_nfa(&parser, root, false, &re->forward, &error) ||
+                   !regex_compile_nfa(&parser, root, true, &re->reverse, &error))) {
+        error_offset = 0;
+    }
+    free(parser.nodes);
+    free(parser.ranges.items);
+
+    if (error) {
+        regex_free(re);
+        re->error = error;
+        re->error_offset = error_offset;
+        return false;
+    }
+    regex_dfa_init(&re->forward_dfa, &re->forward, true, cache_size);
+    regex_dfa_init(&re->reverse_dfa, &re->reverse, false, cache_size);
+    return true;
+}
+
+void
+regex_free(regex *re)
+{
+    free(re->forward.states);
+    free(re->reverse.states);
+    regex_dfa_free(&re->forward_dfa);
+    regex_dfa_free(&re->reverse_dfa);
+    memset(re, 0, sizeof(*re));
+}
+
+void
+regex_search(regex *re, const find_source *source, u64 offset, u64 length, regex_match_fn fn, void *arg)
+{
+    if (offset > source->length) offset = source->length;
+    if (length > source->length - offset) length = source->length - offset;
+    u64 end = offset + length;
+
+    u64 from = offset;
+    u64 previous_end = UINT64_MAX;
+    while (from <= end) {
+        u64 match_end = regex_forward_search(re, source, from, end);
+        if (match_end == UINT64_MAX) return;
+        u64 match_start = regex_reverse_search(re, source, from, match_end);
+        if (match_start == UINT64_MAX) {
+            LOG_ERROR("Regex match ending at %llu has no start.", (unsigned long long)match_end);
+            return;
+        }
+        if (match_start == match_end) {
+            from = match_end + 1;
+            if (match_end == previous_end) continue;
+        } else {
+            from = match_end;
+        }
+        previous_end = match_end;
+        if (!fn(match_start, match_end, arg)) return;
+    }
+}
+
+typedef struct {
+    u64 start;
+    u64 end;
+    b32 found;
+} regex_first;
+
+static b32
+regex_first_match(u64 start, u64 end, void *arg)
+{
+    regex_first *first = (regex_first *)arg;
+    first->start = start;
+    first->end = end;
+    first->found = true;
+    return false;
+}
+
+b32
+regex_find_next(regex *re, const find_source *source, u64 offset, u64 *start, u64 *end)
+{
+    if (offset > source->length) return false;
+    regex_first first = {0};
+    regex_search(re, source, offset, source->length - offset, regex_first_match, &first);
+    if (first.found) {
+        *start = first.start;
+        *end = first.end;
+    }
+    return first.found;
+}
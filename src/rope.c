@@ -0,0 +1,534 @@
+#include "rope.h"
+#include "line_index.h"
+#include "log.h"
+#include "utf8.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct rope_node {
+    atomic_uint references;
+    u32 height; // 0 for leaves
+    u32 count;  // Children of a branch, bytes of a leaf
+    rope_metrics metrics;
+    union {
+        // One spare slot, so a branch can overflow before it is split
+        rope_node *children[ROPE_MAX_CHILDREN + 1];
+        u8 bytes[ROPE_CHUNK_SIZE];
+    };
+};
+
+// Branches are allocated without room for bytes
+#define ROPE_LEAF_SIZE (offsetof(rope_node, bytes) + ROPE_CHUNK_SIZE)
+#define ROPE_BRANCH_SIZE (offsetof(rope_node, children) + (ROPE_MAX_CHILDREN + 1) * sizeof(rope_node *))
+
+static rope_metrics
+rope_measure(const u8 *bytes, u64 length)
+{
+    rope_metrics metrics = {length, line_index_count_line_breaks(bytes, length), utf8_count_codepoints(bytes, length)};
+    return metrics;
+}
+
+static void
+rope_metrics_add(rope_metrics *metrics, const rope_metrics *other)
+{
+    metrics->bytes += other->bytes;
+    metrics->line_breaks += other->line_breaks;
+    metrics->codepoints += other->codepoints;
+}
+
+static rope_node *
+rope_node_alloc(u32 height)
+{
+    rope_node *node = (rope_node *)malloc(height == 0 ? ROPE_LEAF_SIZE : ROPE_BRANCH_SIZE);
+    if (!node) LOG_FATAL("Could not allocate rope node.");
+    atomic_init(&node->references, 1);
+    node->height = height;
+    node->count = 0;
+    memset(&node->metrics, 0, sizeof(node->metrics));
+    return node;
+}
+
+static void
+rope_node_retain(rope_node *node)
+{
+    atomic_fetch_add_explicit(&node->references, 1, memory_order_relaxed);
+}
+
+static void
+rope_node_release(rope_node *node)
+{
+    if (atomic_fetch_sub_explicit(&node->references, 1, memory_order_acq_rel) != 1) return;
+    if (node->height > 0) {
+        for (u32 i = 0; i < node->count; ++i) rope_node_release(node->children[i]);
+    }
+    free(node);
+}
+
+static void
+rope_node_update(rope_node *node)
+{
+    if (node->height == 0) {
+        node->metrics = rope_measure(node->bytes, node->count);
+        return;
+    }
+    memset(&node->metrics, 0, sizeof(node->metrics));
+    for (u32 i = 0; i < node->count; ++i) rope_metrics_add(&node->metrics, &node->children[i]->metrics);
+}
+
+// Returns the node in slot, first replacing it with a private copy if it is
+// shared with a snapshot.
+static rope_node *
+rope_node_mutable(rope_node **slot)
+{
+    rope_node *node = *slot;
+    if (atomic_load_explicit(&node->references, memory_order_acquire) == 1) return node;
+
+    rope_node *copy = rope_node_alloc(node->height);
+    copy->count = node->count;
+    copy->metrics = node->metrics;
+    if (node->height == 0) {
+        memcpy(copy->bytes, node->bytes, node->count);
+    } else {
+        memcpy(copy->children, node->children, node->count * sizeof(rope_node *));
+        for (u32 i = 0; i < node->count; ++i) rope_node_retain(node->children[i]);
+    }
+    rope_node_release(node);
+    *slot = copy;
+    return copy;
+}
+
+static b32
+rope_node_underfull(const rope_node *node)
+{
+    return node->count < (node->height == 0 ? ROPE_CHUNK_SIZE : ROPE_MAX_CHILDREN) / 2;
+}
+
+// Start of the i-th of parts nearly equal parts of total items
+static u64
+rope_split_point(u64 total, u64 parts, u64 i)
+{
+    u64 remainder = total % parts;
+    return i * (total / parts) + (i < remainder ? i : remainder);
+}
+
+// Builds a tree bottom up, spreading bytes and children evenly over the
+// fewest nodes that hold them.
+static rope_node *
+rope_build(const u8 *text, u64 length)
+{
+    u64 count = (length + ROPE_CHUNK_SIZE - 1) / ROPE_CHUNK_SIZE;
+    if (count == 0) count = 1;
+    rope_node **nodes = (rope_node **)malloc(count * sizeof(rope_node *));
+    if (!nodes) LOG_FATAL("Could not allocate %llu rope leaves.", (unsigned long long)count);
+
+    for (u64 i = 0; i < count; ++i) {
+        u64 start = rope_split_point(length, count, i);
+        u64 end = rope_split_point(length, count, i + 1);
+        rope_node *leaf = rope_node_alloc(0);
+        leaf->count = (u32)(end - start);
+        if (leaf->count > 0) memcpy(leaf->bytes, text + start, leaf->count);
+        rope_node_update(leaf);
+        nodes[i] = leaf;
+    }
+
+    for (u32 height = 1; count > 1; ++height) {
+        u64 parent_count = (count + ROPE_MAX_CHILDREN - 1) / ROPE_MAX_CHILDREN;
+        for (u64 i = 0; i < parent_count; ++i) {
+            u64 start = rope_split_point(count, parent_count, i);
+            u64 end = rope_split_point(count, parent_count, i + 1);
+            rope_node *branch = rope_node_alloc(height);
+            branch->count = (u32)(end - start);
+            memcpy(branch->children, nodes + start, branch->count * sizeof(rope_node *));
+            rope_node_update(branch);
+            nodes[i] = branch;
+        }
+        count = parent_count;
+    }
+
+    rope_node *root = nodes[0];
+    free(nodes);
+    return root;
+}
+
+void
+rope_init(rope *rope, const u8 *text, u64 length)
+{
+    rope->root = rope_build(text, length);
+}
+
+void
+rope_free(rope *rope)
+{
+    if (rope->root) rope_node_release(rope->root);
+    rope->root = NULL;
+}
+
+void
+rope_snapshot(rope *snapshot, const rope *source)
+{
+    rope_node_retain(source->root);
+    snapshot->root = source->root;
+}
+
+rope_metrics
+rope_get_metrics(const rope *rope)
+{
+    return rope->root->metrics;
+}
+
+u64
+rope_length(const rope *rope)
+{
+    return rope->root->metrics.bytes;
+}
+
+u64
+rope_line_count(const rope *rope)
+{
+    return rope->root->metrics.line_breaks + 1;
+}
+
+rope_metrics
+rope_metrics_before(const rope *rope, u64 offset)
+{
+    rope_metrics metrics = {0, 0, 0};
+    const rope_node *node = rope->root;
+    if (offset > node->metrics.bytes) offset = node->metrics.bytes;
+
+    while (node->height > 0) {
+        u32 i = 0;
+        while (i + 1 < node->count && offset >= node->children[i]->metrics.bytes) {
+            rope_metrics_add(&metrics, &node->children[i]->metrics);
+            offset -= node->children[i]->metrics.bytes;
+            ++i;
+        }
+        node = node->children[i];
+    }
+    rope_metrics leaf = rope_measure(node->bytes, offset);
+    rope_metrics_add(&metrics, &leaf);
+    return metrics;
+}
+
+// Inserts at most ROPE_CHUNK_SIZE bytes. Returns the new right sibling of the
+// node when it had to be split, NULL otherwise.
+static rope_node *
+rope_insert_node(rope_node **slot, u64 offset, const u8 *text, u32 length)
+{
+    rope_node *node = rope_node_mutable(slot);
+    if (node->height == 0) {
+        u32 total = node->count + length;
+        if (total <= ROPE_CHUNK_SIZE) {
+            memmove(node->bytes + offset + length, node->bytes + offset, node->count - offset);
+            memcpy(node->bytes + offset, text, length);
+            node->count = total;
+            rope_metrics added = rope_measure(text, length);
+            rope_metrics_add(&node->metrics, &added);
+            return NULL;
+        }
+
+        u8 combined[2 * ROPE_CHUNK_SIZE];
+        memcpy(combined, node->bytes, offset);
+        memcpy(combined + offset, text, length);
+        memcpy(combined + offset + length, node->bytes + offset, node->count - offset);
+
+        rope_node *sibling = rope_node_alloc(0);
+        node->count = total / 2;
+        sibling->count = total - node->count;
+        memcpy(node->bytes, combined, node->count);
+        memcpy(sibling->bytes, combined + node->count, sibling->count);
+        rope_node_update(node);
+        rope_node_update(sibling);
+        return sibling;
+    }
+
+    // At a boundary between children, append to the earlier one
+    u32 i = 0;
+    while (i + 1 < node->count && offset > node->children[i]->metrics.bytes) {
+        offset -= node->children[i]->metrics.bytes;
+        ++i;
+    }
+    rope_node *split = rope_insert_node(&node->children[i], offset, text, length);
+    if (split) {
+        memmove(node->children + i + 2, node->children + i + 1, (node->count - i - 1) * sizeof(rope_node *));
+        node->children[i + 1] = split;
+        ++node->count;
+    }
+
+    if (node->count > ROPE_MAX_CHILDREN) {
+        rope_node *sibling = rope_node_alloc(node->height);
+        sibling->count = node->count - node->count / 2;
+        node->count /= 2;
+        memcpy(sibling->children, node->children + node->count, sibling->count * sizeof(rope_node *));
+        rope_node_update(node);
+        rope_node_update(sibling);
+        return sibling;
+    }
+    rope_node_update(node);
+    return NULL;
+}
+
+void
+rope_insert(rope *rope, u64 offset, const u8 *text, u64 length)
+{
+    u64 total = rope_length(rope);
+    if (offset > total) offset = total;
+
+    while (length > 0) {
+        u32 chunk = length < ROPE_CHUNK_SIZE ? (u32)length : ROPE_CHUNK_SIZE;
+        rope_node *split = rope_insert_node(&rope->root, offset, text, chunk);
+        if (split) {
+            rope_node *root = rope_node_alloc(split->height + 1);
+            root->children[0] = rope->root;
+            root->children[1] = split;
+            root->count = 2;
+            rope_node_update(root);
+            rope->root = root;
+        }
+        offset += chunk;
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+// Merges children i and i + 1 of a branch into one node, or evens them out
+// when they do not fit in one. Returns whether they were merged.
+static b32
+rope_merge_children(rope_node *node, u32 i)
+{
+    rope_node *left = rope_node_mutable(&node->children[i]);
+    rope_node *right = rope_node_mutable(&node->children[i + 1]);
+
+    b32 leaf = left->height == 0;
+    size_t item_size = leaf ? 1 : sizeof(rope_node *);
+    u8 *left_items = leaf ? left->bytes : (u8 *)left->children;
+    u8 *right_items = leaf ? right->bytes : (u8 *)right->children;
+    u32 total = left->count + right->count;
+
+    if (total <= (leaf ? ROPE_CHUNK_SIZE : ROPE_MAX_CHILDREN)) {
+        // The children of right move to left along with their references
+        memcpy(left_items + left->count * item_size, right_items, right->count * item_size);
+        left->count = total;
+        rope_node_update(left);
+        free(right);
+        memmove(node->children + i + 1, node->children + i + 2, (node->count - i - 2) * sizeof(rope_node *));
+        --node->count;
+        return true;
+    }
+
+    u32 half = total / 2;
+    if (left->count < half) {
+        u32 moved = half - left->count;
+        memcpy(left_items + left->count * item_size, right_items, moved * item_size);
+        memmove(right_items, right_items + moved * item_size, (right->count - moved) * item_size);
+        left->count += moved;
+        right->count -= moved;
+    } else {
+        u32 moved = left->count - half;
+        memmove(right_items + moved * item_size, right_items, right->count * item_size);
+        memcpy(right_items, left_items + half * item_size, moved * item_size);
+        left->count -= moved;
+        right->count += moved;
+    }
+    rope_node_update(left);
+    rope_node_update(right);
+    return false;
+}
+
+static void
+rope_rebalance_children(rope_node *node)
+{
+    u32 i = 0;
+    while (i < node->count && node->count > 1) {
+        if (!rope_node_underfull(node->children[i])) {
+            ++i;
+            continue;
+        }
+        u32 left = i > 0 ? i - 1 : 0;
+        i = rope_merge_children(node, left) ? left : left + 2;
+    }
+}
+
+static void
+rope_erase_node(rope_node **slot, u64 offset, u64 length)
+{
+    rope_node *node = rope_node_mutable(slot);
+    if (node->height == 0) {
+        memmove(node->bytes + offset, node->bytes + offset + length, node->count - offset - length);
+        node->count -= (u32)length;
+        rope_node_update(node);
+        return;
+    }
+
+    u64 end = offset + length;
+    u64 child_start = 0;
+    u32 kept = 0;
+    for (u32 i = 0; i < node->count; ++i) {
+        rope_node *child = node->children[i];
+        u64 child_end = child_start + child->metrics.bytes;
+        if (child_end <= offset || child_start >= end) {
+            node->children[kept++] = child;
+        } else if (offset <= child_start && end >= child_end) {
+            rope_node_release(child);
+        } else {
+            u64 from = offset > child_start ? offset : child_start;
+            u64 to = end < child_end ? end : child_end;
+            node->children[kept] = child;
+            rope_erase_node(&node->children[kept], from - child_start, to - from);
+            ++kept;
+        }
+        child_start = child_end;
+    }
+    node->count = kept;
+
+    rope_rebalance_children(node);
+    rope_node_update(node);
+}
+
+void
+rope_erase(rope *rope, u64 offset, u64 length)
+{
+    u64 total = rope_length(rope);
+    if (offset >= total || length == 0) return;
+    if (length > total - offset) length = total - offset;
+
+    rope_erase_node(&rope->root, offset, length);
+
+    // Drop roots that are left with a single child
+    while (rope->root->height > 0 && rope->root->count <= 1) {
+        rope_node *root = rope->root;
+        if (root->count == 0) {
+            rope->root = rope_build(NULL, 0);
+        } else {
+            rope->root = root->children[0];
+            rope_node_retain(rope->root);
+        }
+        rope_node_release(root);
+    }
+}
+
+u64
+rope_line_start(const rope *rope, u64 line)
+{
+    const rope_node *node = rope->root;
+    if (line == 0) return 0;
+    if (line > node->metrics.line_breaks) return node->metrics.bytes;
+
+    // Find the line-th line break
+    u64 base = 0;
+    while (node->height > 0) {
+        u32 i = 0;
+        while (line > node->children[i]->metrics.line_breaks) {
+            line -= node->children[i]->metrics.line_breaks;
+            base += node->children[i]->metrics.bytes;
+            ++i;
+        }
+        node = node->children[i];
+    }
+    u32 i = 0;
+    for (; i < node->count; ++i) {
+        if (node->bytes[i] == '\n' && --line == 0) break;
+    }
+    return base + i + 1;
+}
+
+u64
+rope_line_of(const rope *rope, u64 offset)
+{
+    return rope_metrics_before(rope, offset).line_breaks;
+}
+
+// Offset of the first byte of the codepoint-th codepoint
+static u64
+rope_codepoint_offset(const rope *rope, u64 codepoint)
+{
+    const rope_node *node = rope->root;
+    if (codepoint >= node->metrics.codepoints) return node->metrics.bytes;
+
+    u64 base = 0;
+    while (node->height > 0) {
+        u32 i = 0;
+        while (codepoint >= node->children[i]->metrics.codepoints) {
+            codepoint -= node->children[i]->metrics.codepoints;
+            base += node->children[i]->metrics.bytes;
+            ++i;
+        }
+        node = node->children[i];
+    }
+    u32 i = 0;
+    for (; i < node->count; ++i) {
+        if ((node->bytes[i] & 0xC0) != 0x80 && codepoint-- == 0) break;
+    }
+    return base + i;
+}
+
+void
+rope_line_column(const rope *rope, u64 offset, u64 *line, u64 *column)
+{
+    rope_metrics before = rope_metrics_before(rope, offset);
+    u64 line_start = rope_line_start(rope, before.line_breaks);
+    *line = before.line_breaks;
+    *column = before.codepoints - rope_metrics_before(rope, line_start).codepoints;
+}
+
+u64
+rope_offset_at(const rope *rope, u64 line, u64 column)
+{
+    u64 line_start = rope_line_start(rope, line);
+    u64 line_end = line < rope->root->metrics.line_breaks ? rope_line_start(rope, line + 1) - 1 : rope_length(rope);
+    u64 codepoint = rope_metrics_before(rope, line_start).codepoints + column;
+    u64 offset = rope_codepoint_offset(rope, codepoint);
+    return offset < line_end ? offset : line_end;
+}
+
+static b32
+rope_visit_node(const rope_node *node, u64 start, u64 end, rope_visit_fn fn, void *arg)
+{
+    if (node->height == 0) return fn(node->bytes + start, end - start, arg);
+
+    u64 child_start = 0;
+    for (u32 i = 0; i < node->count && child_start < end; ++i) {
+        const rope_node *child = node->children[i];
+        u64 child_end = child_start + child->metrics.bytes;
+        if (child_end > start) {
+            u64 from = start > child_start ? start : child_start;
+            u64 to = end < child_end ? end : child_end;
+            if (!rope_visit_node(child, from - child_start, to - child_start, fn, arg)) return false;
+        }
+        child_start = child_end;
+    }
+    return true;
+}
+
+void
+rope_visit(const rope *rope, u64 offset, u64 length, rope_visit_fn fn, void *arg)
+{
+    u64 total = rope_length(rope);
+    if (offset >= total || length == 0) return;
+    if (length > total - offset) length = total - offset;
+    rope_visit_node(rope->root, offset, offset + length, fn, arg);
+}
+
+typedef struct {
+    u8 *out;
+    u64 copied;
+} rope_read_state;
+
+static b32
+rope_read_run(const u8 *data, u64 length, void *arg)
+{
+    rope_read_state *state = (rope_read_state *)arg;
+    memcpy(state->out + state->copied, data, length);
+    state->copied += length;
+    return true;
+}
+
+u64
+rope_read(const rope *rope, u64 offset, u64 length, u8 *out)
+{
+    rope_read_state state = {out, 0};
+    rope_visit(rope, offset, length, rope_read_run, &state);
+    return state.copied;
+}
@@ -0,0 +1,441 @@
+#include "sdf.h"
+#include "log.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Side of a grid cell, in SDF pixels
+#define SDF_CELL_SIZE 4.0f
+#define SDF_MAX_CURVE_STEPS 256
+// Distance stb_truetype reports when an outline has no edges at all
+#define SDF_NO_EDGE_DISTANCE 999999.0f
+
+typedef struct {
+    f32 x0, y0;
+    f32 x1, y1;
+    f32 inverse_length_squared;
+} sdf_segment;
+
+typedef struct {
+    sdf_segment *segments;
+    u32 count;
+    u32 capacity;
+    f32 min_x, min_y;
+    f32 max_x, max_y;
+} sdf_outline;
+
+// Segments binned by the cells their bounding boxes overlap. The indices of
+// the segments of cell i are cell_segments[cell_start[i]..cell_start[i + 1]).
+typedef struct {
+    f32 origin_x;
+    f32 origin_y;
+    s32 columns;
+    s32 rows;
+    u32 *cell_start;
+    u32 *cell_segments;
+} sdf_grid;
+
+typedef struct {
+    f32 x;
+    s32 direction;
+} sdf_crossing;
+
+static inline f32
+sdf_min(f32 a, f32 b)
+{
+    return a < b ? a : b;
+}
+
+static inline f32
+sdf_max(f32 a, f32 b)
+{
+    return a > b ? a : b;
+}
+
+static void
+sdf_outline_push(sdf_outline *outline, f32 x0, f32 y0, f32 x1, f32 y1)
+{
+    f32 dx = x1 - x0;
+    f32 dy = y1 - y0;
+    f32 length_squared = dx * dx + dy * dy;
+    if (length_squared == 0.0f) return;
+
+    if (outline->count == outline->capacity) {
+        outline->capacity = outline->capacity ? outline->capacity * 2 : 256;
+        outline->segments = (sdf_segment *)realloc(outline->segments, outline->capacity * sizeof(sdf_segment));
+        if (!outline->segments) LOG_FATAL("Could not allocate %u SDF outline segments.", outline->capacity);
+    }
+
+    sdf_segment *segment = &outline->segments[outline->count++];
+    segment->x0 = x0;
+    segment->y0 = y0;
+    segment->x1 = x1;
+    segment->y1 = y1;
+    segment->inverse_length_squared = 1.0f / length_squared;
+
+    outline->min_x = sdf_min(outline->min_x, sdf_min(x0, x1));
+    outline->min_y = sdf_min(outline->min_y, sdf_min(y0, y1));
+    outline->max_x = sdf_max(outline->max_x, sdf_max(x0, x1));
+    outline->max_y = sdf_max(outline->max_y, sdf_max(y0, y1));
+}
+
+// Number of chords needed to keep a curve within SDF_FLATNESS, given the
+// length of its largest second difference
+static u32
+sdf_curve_steps(f32 second_difference)
+{
+    f32 steps = ceilf(sqrtf(second_difference / (4.0f * SDF_FLATNESS)));
+    if (steps < 1.0f) return 1;
+    if (steps > SDF_MAX_CURVE_STEPS) return SDF_MAX_CURVE_STEPS;
+    return (u32)steps;
+}
+
+// Flattens the glyph's outline into segments in the y-down pixel space of the
+// output, relative to (origin_x, origin_y).
+static void
+sdf_outline_build(sdf_outline *outline, const stbtt_vertex *vertices, s32 vertex_count,
+                  f32 scale, s32 origin_x, s32 origin_y)
+{
+    memset(outline, 0, sizeof(*outline));
+    outline->min_x = outline->min_y = FLT_MAX;
+    outline->max_x = outline->max_y = -FLT_MAX;
+
+#define SDF_X(v) ((f32)(v) * scale - (f32)origin_x)
+#define SDF_Y(v) ((f32)(v) * -scale - (f32)origin_y)
+
+    f32 start_x = 0.0f, start_y = 0.0f;
+    f32 x = 0.0f, y = 0.0f;
+    for (s32 i = 0; i < vertex_count; ++i) {
+        const stbtt_vertex *v = &vertices[i];
+        f32 to_x = SDF_X(v->x);
+        f32 to_y = SDF_Y(v->y);
+
+        switch (v->type) {
+        case STBTT_vmove:
+            // Close the previous contour for the winding sweep, in case the
+            // font left it open
+            sdf_outline_push(outline, x, y, start_x, start_y);
+            start_x = to_x;
+            start_y = to_y;
+            break;
+        case STBTT_vline:
+            sdf_outline_push(outline, x, y, to_x, to_y);
+            break;
+        case STBTT_vcurve: {
+            f32 cx = SDF_X(v->cx);
+            f32 cy = SDF_Y(v->cy);
+            u32 steps = sdf_curve_steps(hypotf(x - 2.0f * cx + to_x, y - 2.0f * cy + to_y));
+            f32 prev_x = x, prev_y = y;
+            for (u32 step = 1; step <= steps; ++step) {
+                f32 t = (f32)step / steps;
+                f32 it = 1.0f - t;
+                f32 px = step == steps ? to_x : it * it * x + 2.0f * t * it * cx + t * t * to_x;
+                f32 py = step == steps ? to_y : it * it * y + 2.0f * t * it * cy + t * t * to_y;
+                sdf_outline_push(outline, prev_x, prev_y, px, py);
+                prev_x = px;
+                prev_y = py;
+            }
+        } break;
+        case STBTT_vcubic: {
+            f32 cx0 = SDF_X(v->cx),  cy0 = SDF_Y(v->cy);
+            f32 cx1 = SDF_X(v->cx1), cy1 = SDF_Y(v->cy1);
+            f32 second_difference = sdf_max(hypotf(x - 2.0f * cx0 + cx1, y - 2.0f * cy0 + cy1),
+                                          hypotf(cx0 - 2.0f * cx1 + to_x, cy0 - 2.0f * cy1 + to_y));
+            u32 steps = sdf_curve_steps(3.0f * second_difference);
+            f32 prev_x = x, prev_y = y;
+            for (u32 step = 1; step <= steps; ++step) {
+                f32 t = (f32)step / steps;
+                f32 it = 1.0f - t;
+                f32 a = it * it * it, b = 3.0f * it * it * t, c = 3.0f * it * t * t, d = t * t * t;
+                f32 px = step == steps ? to_x : a * x + b * cx0 + c * cx1 + d * to_x;
+                f32 py = step == steps ? to_y : a * y + b * cy0 + c * cy1 + d * to_y;
+                sdf_outline_push(outline, prev_x, prev_y, px, py);
+                prev_x = px;
+                prev_y = py;
+            }
+        } break;
+        }
+        x = to_x;
+        y = to_y;
+    }
+    sdf_outline_push(outline, x, y, start_x, start_y);
+
+#undef SDF_X
+#undef SDF_Y
+}
+
+static s32
+sdf_clamp(s32 value, s32 min, s32 max)
+{
+    return value < min ? min : value > max ? max : value;
+}
+
+static void
+sdf_grid_cell_range(const sdf_grid *grid, const sdf_segment *segment,
+                    s32 *col0, s32 *row0, s32 *col1, s32 *row1)
+{
+    *col0 = sdf_clamp((s32)((sdf_min(segment->x0, segment->x1) - grid->origin_x) / SDF_CELL_SIZE), 0, grid->columns - 1);
+    *col1 = sdf_clamp((s32)((sdf_max(segment->x0, segment->x1) - grid->origin_x) / SDF_CELL_SIZE), 0, grid->columns - 1);
+    *row0 = sdf_clamp((s32)((sdf_min(segment->y0, segment->y1) - grid->origin_y) / SDF_CELL_SIZE), 0, grid->rows - 1);
+    *row1 = sdf_clamp((s32)((sdf_max(segment->y0, segment->y1) - grid->origin_y) / SDF_CELL_SIZE), 0, grid->rows - 1);
+}
+
+// The grid covers both the outline and the output, so the search around any
+// output pixel is bounded by the edges of the grid.
+static void
+sdf_grid_build(sdf_grid *grid, const sdf_outline *outline, s32 width, s32 height)
+{
+    f32 min_x = sdf_min(0.0f, outline->min_x);
+    f32 min_y = sdf_min(0.0f, outline->min_y);
+    f32 max_x = sdf_max((f32)width, outline->max_x);
+    f32 max_y = sdf_max((f32)height, outline->max_y);
+
+    grid->origin_x = floorf(min_x);
+    grid->origin_y = floorf(min_y);
+    grid->columns = (s32)((max_x - grid->origin_x) / SDF_CELL_SIZE) + 1;
+    grid->rows = (s32)((max_y - grid->origin_y) / SDF_CELL_SIZE) + 1;
+
+    u32 cell_count = (u32)(grid->columns * grid->rows);
+    grid->cell_start = (u32 *)calloc(cell_count + 1, sizeof(u32));
+    if (!grid->cell_start) LOG_FATAL("Could not allocate SDF grid of %u cells.", cell_count);
+
+    // Count the segments of every cell, turn the counts into offsets, then
+    // place each segment at the end of its cells' ranges.
+    s32 col0, row0, col1, row1;
+    for (u32 i = 0; i < outline->count; ++i) {
+        sdf_grid_cell_range(grid, &outline->segments[i], &col0, &row0, &col1, &row1);
+        for (s32 row = row0; row <= row1; ++row) {
+            for (s32 col = col0; col <= col1; ++col) {
+                ++grid->cell_start[row * grid->columns + col + 1];
+            }
+        }
+    }
+    for (u32 i = 0; i < cell_count; ++i) {
+        grid->cell_start[i + 1] += grid->cell_start[i];
+    }
+
+    grid->cell_segments = (u32 *)malloc((grid->cell_start[cell_count] + 1) * sizeof(u32));
+    u32 *fill = (u32 *)malloc(cell_count * sizeof(u32));
+    if (!grid->cell_segments || !fill) LOG_FATAL("Could not allocate SDF grid of %u cells.", cell_count);
+    memcpy(fill, grid->cell_start, cell_count * sizeof(u32));
+
+    for (u32 i = 0; i < outline->count; ++i) {
+        sdf_grid_cell_range(grid, &outline->segments[i], &col0, &row0, &col1, &row1);
+        for (s32 row = row0; row <= row1; ++row) {
+            for (s32 col = col0; col <= col1; ++col) {
+                grid->cell_segments[fill[row * grid->columns + col]++] = i;
+            }
+        }
+    }
+    free(fill);
+}
+
+static void
+sdf_grid_free(sdf_grid *grid)
+{
+    free(grid->cell_start);
+    free(grid->cell_segments);
+}
+
+static inline f32
+sdf_segment_distance_squared(const sdf_segment *segment, f32 px, f32 py)
+{
+    f32 dx = segment->x1 - segment->x0;
+    f32 dy = segment->y1 - segment->y0;
+    f32 t = ((px - segment->x0) * dx + (py - segment->y0) * dy) * segment->inverse_length_squared;
+    t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+    f32 ex = segment->x0 + t * dx - px;
+    f32 ey = segment->y0 + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+// Squared distance from (px, py) to the nearest segment. nearest holds the
+// nearest segment of a neighbouring pixel, which is at most a pixel or so
+// further away than the answer, so only the cells within that distance have
+// to be searched. It is updated on return.
+static f32
+sdf_grid_nearest(const sdf_grid *grid, const sdf_segment *segments, f32 px, f32 py, u32 *nearest)
+{
+    f32 best = sdf_segment_distance_squared(&segments[*nearest], px, py);
+    f32 radius = sqrtf(best);
+
+    f32 gx = px - grid->origin_x;
+    f32 gy = py - grid->origin_y;
+    s32 col0 = sdf_clamp((s32)((gx - radius) / SDF_CELL_SIZE), 0, grid->columns - 1);
+    s32 col1 = sdf_clamp((s32)((gx + radius) / SDF_CELL_SIZE), 0, grid->columns - 1);
+    s32 row0 = sdf_clamp((s32)((gy - radius) / SDF_CELL_SIZE), 0, grid->rows - 1);
+    s32 row1 = sdf_clamp((s32)((gy + radius) / SDF_CELL_SIZE), 0, grid->rows - 1);
+
+    for (s32 row = row0; row <= row1; ++row) {
+        const u32 *cell_start = grid->cell_start + row * grid->columns;
+        for (s32 col = col0; col <= col1; ++col) {
+            for (u32 i = cell_start[col]; i < cell_start[col + 1]; ++i) {
+                u32 segment = grid->cell_segments[i];
+                f32 distance = sdf_segment_distance_squared(&segments[segment], px, py);
+                if (distance < best) {
+                    best = distance;
+                    *nearest = segment;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+// Crossings of the horizontal line at y with the outline, sorted by x
+static u32
+sdf_row_crossings(const sdf_outline *outline, f32 y, sdf_crossing *crossings)
+{
+    u32 count = 0;
+    for (u32 i = 0; i < outline->count; ++i) {
+        const sdf_segment *segment = &outline->segments[i];
+        // Half-open in y, so a line through a vertex counts it once
+        if ((segment->y0 <= y) == (segment->y1 <= y)) continue;
+
+        sdf_crossing crossing;
+        crossing.x = segment->x0 + (y - segment->y0) * (segment->x1 - segment->x0) / (segment->y1 - segment->y0);
+        crossing.direction = segment->y1 > segment->y0 ? 1 : -1;
+
+        u32 j = count++;
+        while (j > 0 && crossings[j - 1].x > crossing.x) {
+            crossings[j] = crossings[j - 1];
+            --j;
+        }
+        crossings[j] = crossing;
+    }
+    return count;
+}
+
+void
+sdf_render_glyph(const stbtt_fontinfo *font, f32 scale, s32 glyph_index,
+                 u8 onedge_value, f32 pixel_dist_scale,
+                 s32 x0, s32 y0, s32 width, s32 height, u8 *output, s32 stride)
+{
+    if (width <= 0 || height <= 0) return;
+
+    stbtt_vertex *vertices;
+    s32 vertex_count = stbtt_GetGlyphShape(font, glyph_index, &vertices);
+
+    sdf_outline outline;
+    sdf_outline_build(&outline, vertices, vertex_count, scale, x0, y0);
+    stbtt_FreeShape(font, vertices);
+
+    sdf_grid grid;
+    sdf_grid_build(&grid, &outline, width, height);
+
+    sdf_crossing *crossings = (sdf_crossing *)malloc((outline.count + 1) * sizeof(sdf_crossing));
+    if (!crossings) LOG_FATAL("Could not allocate SDF crossings for %u segments.", outline.count);
+
+    u32 row_nearest = 0;
+    for (s32 row = 0; row < height; ++row) {
+        f32 py = (f32)row + 0.5f;
+        u32 crossing_count = sdf_row_crossings(&outline, py, crossings);
+        u32 next_crossing = 0;
+        s32 winding = 0;
+        u32 nearest = row_nearest;
+
+        u8 *out = output + (size_t)row * stride;
+        for (s32 col = 0; col < width; ++col) {
+            f32 px = (f32)col + 0.5f;
+            while (next_crossing < crossing_count && crossings[next_crossing].x < px) {
+                winding += crossings[next_crossing++].direction;
+            }
+
+            f32 distance = SDF_NO_EDGE_DISTANCE;
+            if (outline.count > 0) {
+                distance = sqrtf(sdf_grid_nearest(&grid, outline.segments, px, py, &nearest));
+                if (col == 0) row_nearest = nearest;
+            }
+            if (winding == 0) distance = -distance;
+
+            f32 value = onedge_value + pixel_dist_scale * distance;
+            if (value < 0.0f) value = 0.0f;
+            else if (value > 255.0f) value = 255.0f;
+            out[col] = (u8)value;
+        }
+    }
+
+    free(crossings);
+    sdf_grid_free(&grid);
+    free(outline.segments);
+}
+
+u8 *
+sdf_get_glyph(const stbtt_fontinfo *font, f32 scale, s32 glyph_index, s32 padding,
+              u8 onedge_value, f32 pixel_dist_scale,
+              s32 *width, s32 *height, s32 *x_offset, s32 *y_offset)
+{
+    if (scale == 0.0f) return NULL;
+
+    s32 x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(font, glyph_index, scale, scale, 0.0f, 0.0f, &x0, &y0, &x1, &y1);
+    if (x0 == x1 || y0 == y1) return NULL;
+
+    x0 -= padding;
+    y0 -= padding;
+    x1 += padding;
+    y1 += padding;
+
+    s32 w = x1 - x0;
+    s32 h = y1 - y0;
+    if (width) *width = w;
+    if (height) *height = h;
+    if (x_offset) *x_offset = x0;
+    if (y_offset) *y_offset = y0;
+
+    u8 *data = (u8 *)malloc((size_t)w * h);
+    if (!data) LOG_FATAL("Could not allocate %dx%d SDF.", w, h);
+    sdf_render_glyph(font, scale, glyph_index, onedge_value, pixel_dist_scale, x0, y0, w, h, data, w);
+    return data;
+}
+
+static f32
+sdf_sample(const u8 *sdf, s32 width, s32 height, s32 stride, f32 u, f32 v)
+{
+    f32 fu = floorf(u);
+    f32 fv = floorf(v);
+    f32 tu = u - fu;
+    f32 tv = v - fv;
+    s32 u0 = sdf_clamp((s32)fu, 0, width - 1);
+    s32 v0 = sdf_clamp((s32)fv, 0, height - 1);
+    s32 u1 = sdf_clamp((s32)fu + 1, 0, width - 1);
+    s32 v1 = sdf_clamp((s32)fv + 1, 0, height - 1);
+
+    const u8 *row0 = sdf + (size_t)v0 * stride;
+    const u8 *row1 = sdf + (size_t)v1 * stride;
+    f32 top = row0[u0] + (row0[u1] - row0[u0]) * tu;
+    f32 bottom = row1[u0] + (row1[u1] - row1[u0]) * tu;
+    return top + (bottom - top) * tv;
+}
+
+void
+sdf_draw(u8 *dest, s32 dest_width, s32 dest_height, s32 dest_stride, f32 x, f32 y, f32 scale,
+         const u8 *sdf, s32 width, s32 height, s32 stride,
+         u8 onedge_value, f32 pixel_dist_scale)
+{
+    if (width <= 0 || height <= 0 || scale <= 0.0f || pixel_dist_scale == 0.0f) return;
+
+    s32 col0 = sdf_clamp((s32)floorf(x), 0, dest_width);
+    s32 row0 = sdf_clamp((s32)floorf(y), 0, dest_height);
+    s32 col1 = sdf_clamp((s32)ceilf(x + width * scale), 0, dest_width);
+    s32 row1 = sdf_clamp((s32)ceilf(y + height * scale), 0, dest_height);
+
+    // Distance in destination pixels per SDF value step
+    f32 value_to_distance = scale / pixel_dist_scale;
+    for (s32 row = row0; row < row1; ++row) {
+        f32 v = ((f32)row + 0.5f - y) / scale - 0.5f;
+        u8 *out = dest + (size_t)row * dest_stride;
+        for (s32 col = col0; col < col1; ++col) {
+            f32 u = ((f32)col + 0.5f - x) / scale - 0.5f;
+            f32 distance = (sdf_sample(sdf, width, height, stride, u, v) - onedge_value) * value_to_distance;
+            f32 coverage = distance + 0.5f;
+            if (coverage <= 0.0f) continue;
+            if (coverage > 1.0f) coverage = 1.0f;
+            u8 value = (u8)(coverage * 255.0f + 0.5f);
+            if (value > out[col]) out[col] = value;
+        }
+    }
+}
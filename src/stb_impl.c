@@ -1,3 +1,7 @@
+#include "raster_simd.h"
+
+#define STBTT_accumulate_scanline(pixels, scanline, scanline2, w) \
+    raster_accumulate_scanline(pixels, scanline, scanline2, w)
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb/stb_truetype.h"
 
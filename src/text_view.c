@@ -0,0 +1,254 @@
+#include "text_view.h"
+#include "log.h"
+#include "sdf.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+text_view_init(text_view *view, s32 width, s32 height, const font_metrics *metrics, glyph_cache *glyphs,
+               layout_cache *layouts, thread_pool *pool, b32 sdf_glyphs, text_view_line_fn line_fn, void *arg)
+{
+    memset(view, 0, sizeof(*view));
+    view->pixels = (u8 *)calloc((size_t)width * (size_t)height, 1);
+    if (!view->pixels) LOG_FATAL("Could not allocate a %dx%d text view.", width, height);
+    view->width = width;
+    view->height = height;
+    view->metrics = metrics;
+    view->glyphs = glyphs;
+    view->layouts = layouts;
+    view->pool = pool;
+    view->sdf_glyphs = sdf_glyphs;
+    view->line_fn = line_fn;
+    view->line_arg = arg;
+    view->line_advance = metrics->ascent - metrics->descent + metrics->line_gap;
+    view->ascent = (s32)roundf(metrics->ascent);
+    damage_init(&view->damage, width, height);
+    damage_add_all(&view->damage);
+}
+
+void
+text_view_free(text_view *view)
+{
+    free(view->pixels);
+    free(view->glyph_indices);
+    free(view->subpixel_phases);
+    memset(view, 0, sizeof(*view));
+}
+
+// Top pixel row of a screen row of text
+static s32
+text_view_row_top(const text_view *view, u64 row)
+{
+    return (s32)roundf((f32)row * view->line_advance);
+}
+
+const layout_line *
+text_view_layout_line(text_view *view, u64 line)
+{
+    const u8 *text;
+    u32 length;
+    if (!view->line_fn(view->line_arg, line, &text, &length)) return NULL;
+    if (length > TEXT_VIEW_MAX_LINE_LENGTH) length = TEXT_VIEW_MAX_LINE_LENGTH;
+    return layout_cache_get(view->layouts, view->metrics, TEXT_VIEW_TAB_WIDTH, line, text, length);
+}
+
+void
+text_view_damage_lines(text_view *view, u64 first_line, u64 count)
+{
+    u64 end_line = first_line + count < first_line ? UINT64_MAX : first_line + count;
+    if (end_line <= view->top_line) return;
+    u64 first_row = first_line > view->top_line ? first_line - view->top_line : 0;
+    u64 end_row = end_line - view->top_line;
+    u64 visible_rows = (u64)ceilf((f32)view->height / view->line_advance);
+    if (first_row >= visible_rows) return;
+    if (end_row > visible_rows) end_row = visible_rows;
+    damage_add(&view->damage, 0, text_view_row_top(view, first_row), view->width, text_view_row_top(view, end_row));
+}
+
+void
+text_view_scroll(text_view *view, u64 top_line)
+{
+    if (top_line == view->top_line) return;
+    view->top_line = top_line;
+    damage_add_all(&view->damage);
+}
+
+static void
+text_view_damage_cursor(text_view *view)
+{
+    if (view->cursor_line < view->top_line) return;
+    u64 row = view->cursor_line - view->top_line;
+    damage_add(&view->damage, view->cursor_x, text_view_row_top(view, row),
+               view->cursor_x + TEXT_VIEW_CURSOR_WIDTH, text_view_row_top(view, row + 1));
+}
+
+void
+text_view_set_cursor(text_view *view, u64 line, u32 column, b32 visible)
+{
+    text_view_damage_cursor(view);
+    view->cursor_line = line;
+    view->cursor_column = column;
+    view->cursor_visible = visible;
+
+    // Left edge of the first glyph at or after the column, or the end of the
+    // line
+    f32 x = 0.0f;
+    const layout_line *layout = column > 0 ? text_view_layout_line(view, line) : NULL;
+    if (layout) {
+        x = layout->width;
+        for (u32 i = 0; i < layout->glyph_count; ++i) {
+            if (layout->glyphs[i].offset >= column) {
+                x = layout->glyphs[i].x;
+                break;
+            }
+        }
+    }
+    view->cursor_x = (s32)floorf(x);
+    text_view_damage_cursor(view);
+}
+
+b32
+text_view_cursor_rect(const text_view *view, damage_rect *rect)
+{
+    if (!view->cursor_visible || view->cursor_line < view->top_line) return false;
+    u64 row = view->cursor_line - view->top_line;
+    if ((f32)row * view->line_advance >= (f32)view->height) return false;
+    rect->x0 = view->cursor_x;
+    rect->y0 = text_view_row_top(view, row);
+    rect->x1 = view->cursor_x + TEXT_VIEW_CURSOR_WIDTH;
+    rect->y1 = text_view_row_top(view, row + 1);
+    return true;
+}
+
+u32
+text_view_collect_glyphs(text_view *view, const layout_line *line, s32 x1, u32 count)
+{
+    // Only glyphs up to x1 are drawn, or rasterized. Glyphs can overhang
+    // their pen position by a little.
+    u32 glyph_count = 0;
+    while (glyph_count < line->glyph_count && line->glyphs[glyph_count].x - view->metrics->pixel_height < x1) {
+        ++glyph_count;
+    }
+    if (count + glyph_count > view->glyph_capacity) {
+        u32 capacity = view->glyph_capacity ? view->glyph_capacity : 256;
+        while (capacity < count + glyph_count) capacity *= 2;
+        view->glyph_indices = (s32 *)realloc(view->glyph_indices, capacity * sizeof(s32));
+        view->subpixel_phases = (u32 *)realloc(view->subpixel_phases, capacity * sizeof(u32));
+        if (!view->glyph_indices || !view->subpixel_phases) LOG_FATAL("Could not allocate %u glyphs.", capacity);
+        view->glyph_capacity = capacity;
+    }
+    for (u32 i = 0; i < glyph_count; ++i) {
+        view->glyph_indices[count + i] = line->glyphs[i].glyph_index;
+        view->subpixel_phases[count + i] = glyph_cache_subpixel_phase(line->glyphs[i].x);
+    }
+    return count + glyph_count;
+}
+
+void
+text_view_warm_glyphs(text_view *view, u32 count)
+{
+    const stbtt_fontinfo *font_info = &view->metrics->font->info;
+    if (view->pool && view->sdf_glyphs) {
+        glyph_cache_warm_sdf(view->glyphs, view->pool, font_info, view->glyph_indices, count);
+    } else if (view->pool) {
+        glyph_cache_warm(view->glyphs, view->pool, font_info, view->metrics->pixel_height, view->glyph_indices,
+                         view->subpixel_phases, count);
+    } else {
+        for (u32 i = 0; i < count; ++i) {
+            if (view->sdf_glyphs) {
+                glyph_cache_get_sdf(view->glyphs, font_info, view->glyph_indices[i]);
+            } else {
+                glyph_cache_get(view->glyphs, font_info, view->glyph_indices[i], view->metrics->pixel_height,
+                                view->subpixel_phases[i]);
+            }
+        }
+    }
+}
+
+// Draws a line into the clip rectangle, with its baseline at baseline
+static void
+text_view_draw_line(text_view *view, const layout_line *line, s32 baseline, damage_rect clip)
+{
+    const stbtt_fontinfo *font_info = &view->metrics->font->info;
+
+    u32 glyph_count = text_view_collect_glyphs(view, line, clip.x1, 0);
+    text_view_warm_glyphs(view, glyph_count);
+    s32 *glyph_indices = view->glyph_indices;
+    u32 *subpixel_phases = view->subpixel_phases;
+
+    u8 *clipped = view->pixels + clip.y0 * view->width + clip.x0;
+    s32 clip_width = clip.x1 - clip.x0;
+    s32 clip_height = clip.y1 - clip.y0;
+    for (u32 i = 0; i < glyph_count; ++i) {
+        f32 pen_x = line->glyphs[i].x;
+        if (view->sdf_glyphs) {
+            const cached_glyph *glyph = glyph_cache_get_sdf(view->glyphs, font_info, glyph_indices[i]);
+            f32 factor = view->metrics->scale / glyph->scale;
+            sdf_draw(clipped, clip_width, clip_height, view->width,
+                     pen_x + glyph->x_offset * factor - clip.x0, baseline + glyph->y_offset * factor - clip.y0,
+                     factor, glyph->coverage, glyph->width, glyph->height, glyph->stride,
+                     GLYPH_CACHE_SDF_ONEDGE_VALUE, GLYPH_CACHE_SDF_PIXEL_DIST_SCALE);
+            continue;
+        }
+
+        const cached_glyph *glyph = glyph_cache_get(view->glyphs, font_info, glyph_indices[i],
+                                                    view->metrics->pixel_height, subpixel_phases[i]);
+        s32 glyph_x = (s32)floorf(pen_x) + glyph->x_offset;
+        s32 glyph_y = baseline + glyph->y_offset;
+        s32 row_start = clip.y0 - glyph_y > 0 ? clip.y0 - glyph_y : 0;
+        s32 row_end = clip.y1 - glyph_y < glyph->height ? clip.y1 - glyph_y : glyph->height;
+        s32 col_start = clip.x0 - glyph_x > 0 ? clip.x0 - glyph_x : 0;
+        s32 col_end = clip.x1 - glyph_x < glyph->width ? clip.x1 - glyph_x : glyph->width;
+        for (s32 row = row_start; row < row_end; ++row) {
+            const u8 *src = glyph->coverage + row * glyph->stride;
+            u8 *dest = view->pixels + (glyph_y + row) * view->width + glyph_x;
+            for (s32 col = col_start; col < col_end; ++col) {
+                // Neighbouring glyphs and lines can overlap
+                if (src[col] > dest[col]) dest[col] = src[col];
+            }
+        }
+    }
+}
+
+void
+text_view_render(text_view *view, damage_region *presented)
+{
+    f64 render_start = view->stats ? frame_stats_now() : 0.0;
+    f64 layout_seconds = 0.0;
+    u64 misses = view->glyphs->misses;
+    glyph_cache_begin_frame(view->glyphs);
+    for (u32 i = 0; i < view->damage.count; ++i) {
+        damage_rect rect = view->damage.rects[i];
+        for (s32 y = rect.y0; y < rect.y1; ++y) {
+            memset(view->pixels + y * view->width + rect.x0, 0, (size_t)(rect.x1 - rect.x0));
+        }
+
+        // Ascenders and descenders of the lines around reach into the
+        // rectangle too
+        u64 first_row = (u64)((f32)rect.y0 / view->line_advance);
+        u64 last_row = (u64)((f32)(rect.y1 - 1) / view->line_advance) + 1;
+        if (first_row > 0) --first_row;
+        for (u64 row = first_row; row <= last_row; ++row) {
+            f64 layout_start = view->stats ? frame_stats_now() : 0.0;
+            const layout_line *line = text_view_layout_line(view, view->top_line + row);
+            if (view->stats) layout_seconds += frame_stats_now() - layout_start;
+            if (!line) break;
+            text_view_draw_line(view, line, view->ascent + text_view_row_top(view, row), rect);
+        }
+
+    }
+
+    // Whatever was not layout went to rasterizing and drawing glyphs. Frames
+    // that redrew nothing ran neither stage.
+    if (view->stats && view->damage.count > 0) {
+        frame_stats_add(view->stats, FRAME_STAGE_LAYOUT, layout_seconds);
+        frame_stats_add(view->stats, FRAME_STAGE_RASTER, frame_stats_now() - render_start - layout_seconds);
+        frame_stats_add_glyph_misses(view->stats, view->glyphs->misses - misses);
+    }
+
+    view->pixels_drawn += damage_area(&view->damage);
+    if (presented) damage_add_region(presented, &view->damage);
+    damage_clear(&view->damage);
+}
@@ -0,0 +1,130 @@
+#include "thread_pool.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void *
+thread_pool_worker(void *arg)
+{
+    thread_pool *pool = (thread_pool *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->job_count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->job_available, &pool->mutex);
+        }
+        if (pool->job_count == 0 && pool->stopping) break;
+
+        thread_pool_job job = pool->jobs[pool->job_head];
+        pool->job_head = (pool->job_head + 1) % pool->job_capacity;
+        --pool->job_count;
+        ++pool->running;
+        pthread_mutex_unlock(&pool->mutex);
+
+        job.fn(job.arg);
+
+        pthread_mutex_lock(&pool->mutex);
+        --pool->running;
+        if (job.group) --job.group->pending;
+        pthread_cond_broadcast(&pool->job_finished);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+u32
+thread_pool_default_thread_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+void
+thread_pool_init(thread_pool *pool, u32 thread_count)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->thread_count = thread_count > 0 ? thread_count : 1;
+    pool->job_capacity = 64;
+    pool->jobs = (thread_pool_job *)calloc(pool->job_capacity, sizeof(thread_pool_job));
+    pool->threads = (pthread_t *)calloc(pool->thread_count, sizeof(pthread_t));
+    if (!pool->jobs || !pool->threads) LOG_FATAL("Could not allocate thread pool.");
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->job_finished, NULL);
+
+    for (u32 i = 0; i < pool->thread_count; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, thread_pool_worker, pool) != 0) {
+            LOG_FATAL("Could not start thread pool worker %u.", i);
+        }
+    }
+}
+
+void
+thread_pool_free(thread_pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (u32 i = 0; i < pool->thread_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_cond_destroy(&pool->job_finished);
+    free(pool->threads);
+    free(pool->jobs);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void
+thread_pool_submit(thread_pool *pool, thread_pool_group *group, thread_pool_fn fn, void *arg)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->job_count == pool->job_capacity) {
+        // Unroll the ring buffer into a larger one
+        u32 new_capacity = pool->job_capacity * 2;
+        thread_pool_job *jobs = (thread_pool_job *)calloc(new_capacity, sizeof(thread_pool_job));
+        if (!jobs) LOG_FATAL("Could not grow thread pool queue to %u jobs.", new_capacity);
+        for (u32 i = 0; i < pool->job_count; ++i) {
+            jobs[i] = pool->jobs[(pool->job_head + i) % pool->job_capacity];
+        }
+        free(pool->jobs);
+        pool->jobs = jobs;
+        pool->job_capacity = new_capacity;
+        pool->job_head = 0;
+    }
+
+    thread_pool_job *job = &pool->jobs[(pool->job_head + pool->job_count) % pool->job_capacity];
+    job->fn = fn;
+    job->arg = arg;
+    job->group = group;
+    ++pool->job_count;
+    if (group) ++group->pending;
+
+    pthread_cond_signal(&pool->job_available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+thread_pool_wait(thread_pool *pool, thread_pool_group *group)
+{
+    pthread_mutex_lock(&pool->mutex);
+    if (group) {
+        while (group->pending > 0) {
+            pthread_cond_wait(&pool->job_finished, &pool->mutex);
+        }
+    } else {
+        while (pool->job_count > 0 || pool->running > 0) {
+            pthread_cond_wait(&pool->job_finished, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
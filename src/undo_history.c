@@ -0,0 +1,597 @@
+#include "undo_history.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct undo_block {
+    undo_block *previous;
+    undo_block *next;
+    u8 *data;
+    u32 used;
+    u32 capacity;
+    u32 last; // Offset of the last record, UNDO_HISTORY_NONE while empty
+};
+
+// Followed by the spans of the erased text, then those of the inserted text
+typedef struct {
+    u64 offset;
+    u32 previous; // Offset of the record before this one in the block
+    u32 erased_count;
+    u32 inserted_count;
+} undo_delta;
+
+static undo_span *
+undo_delta_spans(undo_delta *delta)
+{
+    return (undo_span *)(delta + 1);
+}
+
+static u32
+undo_delta_size(const undo_delta *delta)
+{
+    return sizeof(undo_delta) + (delta->erased_count + delta->inserted_count) * sizeof(undo_span);
+}
+
+static u64
+undo_spans_length(const undo_span *spans, u32 count)
+{
+    u64 length = 0;
+    for (u32 i = 0; i < count; ++i) length += spans[i].length;
+    return length;
+}
+
+static undo_delta *
+undo_delta_at(undo_block *block, u32 record)
+{
+    return (undo_delta *)(block->data + record);
+}
+
+void
+undo_history_init(undo_history *history, piece_table *table, u64 budget)
+{
+    memset(history, 0, sizeof(*history));
+    history->table = table;
+    history->budget = budget ? budget : UNDO_HISTORY_DEFAULT_BUDGET;
+}
+
+void
+undo_history_free(undo_history *history)
+{
+    undo_block *block = history->first_block;
+    while (block) {
+        undo_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(history->transactions);
+    free(history->scratch);
+    free(history->edits);
+    free(history->edit_spans);
+    free(history->erased_first);
+    free(history->erased_counts);
+    memset(history, 0, sizeof(*history));
+}
+
+// Frees everything after the last undoable transaction
+static void
+undo_history_discard_redo(undo_history *history)
+{
+    if (history->applied == history->transaction_count) return;
+
+    undo_transaction *first = &history->transactions[history->applied];
+    undo_block *keep = first->first_block;
+    undo_block *block = keep->next;
+    if (first->first_record == 0) {
+        block = keep;
+        keep = keep->previous;
+    } else {
+        keep->last = undo_delta_at(keep, first->first_record)->previous;
+        keep->used = first->first_record;
+    }
+    while (block) {
+        undo_block *next = block->next;
+        history->memory -= sizeof(undo_block) + block->capacity;
+        free(block);
+        block = next;
+    }
+
+    history->last_block = keep;
+    if (keep) {
+        keep->next = NULL;
+    } else {
+        history->first_block = NULL;
+    }
+    history->transaction_count = history->applied;
+}
+
+static void
+undo_history_open_transaction(undo_history *history)
+{
+    if (history->transaction_count == history->transaction_capacity) {
+        if (history->transaction_first > 0 && history->transaction_first >= history->transaction_capacity / 2) {
+            // Reuse the slots of dropped transactions
+            u32 first = history->transaction_first;
+            memmove(history->transactions, history->transactions + first,
+                    (history->transaction_count - first) * sizeof(undo_transaction));
+            history->transaction_count -= first;
+            history->applied -= first;
+            history->transaction_first = 0;
+        } else {
+            history->transaction_capacity = history->transaction_capacity ? history->transaction_capacity * 2 : 64;
+            history->transactions = (undo_transaction *)realloc(history->transactions,
+                                                                history->transaction_capacity * sizeof(undo_transaction));
+            if (!history->transactions) LOG_FATAL("Could not allocate %u undo transactions.",
+                                                  history->transaction_capacity);
+        }
+    }
+    memset(&history->transactions[history->transaction_count], 0, sizeof(undo_transaction));
+    history->applied = ++history->transaction_count;
+}
+
+// Last delta of the last transaction, which new edits may extend
+static undo_delta *
+undo_history_last_delta(undo_history *history)
+{
+    if (history->transaction_count == history->transaction_first) return NULL;
+    undo_transaction *transaction = &history->transactions[history->transaction_count - 1];
+    if (transaction->delta_count == 0) return NULL;
+    return undo_delta_at(transaction->last_block, transaction->last_record);
+}
+
+// Appends a delta with room for span_count spans to the last transaction
+static undo_delta *
+undo_history_push_delta(undo_history *history, u64 offset, u32 span_count)
+{
+    u64 size = sizeof(undo_delta) + (u64)span_count * sizeof(undo_span);
+    undo_block *block = history->last_block;
+    if (!block || block->capacity - block->used < size) {
+        u64 capacity = size > UNDO_HISTORY_BLOCK_SIZE ? size : UNDO_HISTORY_BLOCK_SIZE;
+        undo_block *next = (undo_block *)malloc(sizeof(undo_block) + capacity);
+        if (!next) LOG_FATAL("Could not allocate %llu byte undo block.", (unsigned long long)capacity);
+        next->previous = block;
+        next->next = NULL;
+        next->data = (u8 *)(next + 1);
+        next->used = 0;
+        next->capacity = (u32)capacity;
+        next->last = UNDO_HISTORY_NONE;
+        if (block) {
+            block->next = next;
+        } else {
+            history->first_block = next;
+        }
+        history->last_block = next;
+        history->memory += sizeof(undo_block) + capacity;
+        block = next;
+    }
+
+    undo_delta *delta = undo_delta_at(block, block->used);
+    delta->offset = offset;
+    delta->previous = block->last;
+    delta->erased_count = 0;
+    delta->inserted_count = 0;
+    block->last = block->used;
+    block->used += (u32)size;
+
+    undo_transaction *transaction = &history->transactions[history->transaction_count - 1];
+    if (transaction->delta_count == 0) {
+        transaction->first_block = block;
+        transaction->first_record = block->last;
+    }
+    transaction->last_block = block;
+    transaction->last_record = block->last;
+    ++transaction->delta_count;
+    return delta;
+}
+
+// Makes room for one more span at the end of delta, when it is the last
+// record and its block has space left
+static b32
+undo_history_grow_delta(undo_history *history, undo_delta *delta)
+{
+    undo_block *block = history->last_block;
+    if ((u8 *)delta != block->data + block->last || block->capacity - block->used < sizeof(undo_span)) {
+        return false;
+    }
+    block->used += sizeof(undo_span);
+    return true;
+}
+
+static void
+undo_history_drop_oldest(undo_history *history)
+{
+    // The latest transaction is kept even when it is over budget on its own
+    while (history->memory > history->budget && history->applied - history->transaction_first > 1) {
+        ++history->transaction_first;
+        undo_block *keep = history->transactions[history->transaction_first].first_block;
+        while (history->first_block != keep) {
+            undo_block *block = history->first_block;
+            history->first_block = block->next;
+            history->first_block->previous = NULL;
+            history->memory -= sizeof(undo_block) + block->capacity;
+            free(block);
+        }
+    }
+}
+
+static void
+undo_history_recorded(undo_history *history, undo_history_run run)
+{
+    if (history->depth > 0) {
+        history->group_started = true;
+        return;
+    }
+    history->run = run;
+    undo_history_drop_oldest(history);
+}
+
+void
+undo_history_begin(undo_history *history)
+{
+    if (history->depth++ == 0) {
+        history->group_started = false;
+        history->run = UNDO_HISTORY_RUN_NONE;
+    }
+}
+
+void
+undo_history_end(undo_history *history)
+{
+    if (history->depth == 0 || --history->depth > 0) return;
+    history->group_started = false;
+    history->run = UNDO_HISTORY_RUN_NONE;
+    undo_history_drop_oldest(history);
+}
+
+void
+undo_history_break(undo_history *history)
+{
+    history->run = UNDO_HISTORY_RUN_NONE;
+}
+
+void
+undo_history_insert(undo_history *history, u64 offset, const u8 *text, u64 length)
+{
+    if (length == 0) return;
+    u64 total = piece_table_length(history->table);
+    if (offset > total) offset = total;
+
+    undo_history_discard_redo(history);
+    const u8 *data = piece_table_insert(history->table, offset, text, length);
+
+    undo_delta *last = undo_history_last_delta(history);
+    b32 join = history->depth > 0 ? history->group_started : history->run == UNDO_HISTORY_RUN_INSERT;
+    if (join && last) {
+        undo_span *spans = undo_delta_spans(last);
+        u32 span_count = last->erased_count + last->inserted_count;
+        b32 follows = last->inserted_count > 0 &&
+                      offset == last->offset + undo_spans_length(spans + last->erased_count, last->inserted_count);
+        if (follows && spans[span_count - 1].data + spans[span_count - 1].length == data) {
+            // Typing appends to the same add block, so a run stays one span
+            spans[span_count - 1].length += length;
+            undo_history_recorded(history, UNDO_HISTORY_RUN_INSERT);
+            return;
+        }
+        if (last->inserted_count == 0 && offset == last->offset && undo_history_grow_delta(history, last)) {
+            // Text inserted where text was just erased, as a replace does
+            spans[span_count] = (undo_span){data, length};
+            ++last->inserted_count;
+            undo_history_recorded(history, UNDO_HISTORY_RUN_INSERT);
+            return;
+        }
+        // Runs of typing only continue at the end of the text typed so far
+        if (history->depth == 0 && !follows) join = false;
+    }
+    if (!join || !last) undo_history_open_transaction(history);
+
+    undo_delta *delta = undo_history_push_delta(history, offset, 1);
+    undo_delta_spans(delta)[0] = (undo_span){data, length};
+    delta->inserted_count = 1;
+    undo_history_recorded(history, UNDO_HISTORY_RUN_INSERT);
+}
+
+static b32
+undo_history_gather(const u8 *data, u64 length, void *arg)
+{
+    undo_history *history = (undo_history *)arg;
+    if (history->scratch_count == history->scratch_capacity) {
+        history->scratch_capacity = history->scratch_capacity ? history->scratch_capacity * 2 : 64;
+        history->scratch = (undo_span *)realloc(history->scratch, history->scratch_capacity * sizeof(undo_span));
+        if (!history->scratch) LOG_FATAL("Could not allocate %u undo spans.", history->scratch_capacity);
+    }
+    history->scratch[history->scratch_count++] = (undo_span){data, length};
+    return true;
+}
+
+void
+undo_history_erase(undo_history *history, u64 offset, u64 length)
+{
+    u64 total = piece_table_length(history->table);
+    if (offset >= total || length == 0) return;
+    if (length > total - offset) length = total - offset;
+
+    undo_history_discard_redo(history);
+    history->scratch_count = 0;
+    piece_table_visit(history->table, offset, length, undo_history_gather, history);
+    piece_table_erase(history->table, offset, length);
+
+    undo_delta *last = undo_history_last_delta(history);
+    b32 join = history->depth > 0 ? history->group_started : history->run == UNDO_HISTORY_RUN_ERASE;
+    if (join && last) {
+        b32 backward = last->inserted_count == 0 && offset + length == last->offset;
+        b32 forward = last->inserted_count == 0 && offset == last->offset;
+        undo_span *spans = undo_delta_spans(last);
+        if (history->scratch_count == 1 && backward && history->scratch[0].data + length == spans[0].data) {
+            // Backspace over text that is contiguous in memory
+            spans[0].data -= length;
+            spans[0].length += length;
+            last->offset = offset;
+            undo_history_recorded(history, UNDO_HISTORY_RUN_ERASE);
+            return;
+        }
+        undo_span *end = &spans[last->erased_count > 0 ? last->erased_count - 1 : 0];
+        if (history->scratch_count == 1 && forward && end->data + end->length == history->scratch[0].data) {
+            // Delete at the same offset again
+            end->length += length;
+            undo_history_recorded(history, UNDO_HISTORY_RUN_ERASE);
+            return;
+        }
+        if (history->depth == 0 && !backward && !forward) join = false;
+    }
+    if (!join || !last) undo_history_open_transaction(history);
+
+    undo_delta *delta = undo_history_push_delta(history, offset, history->scratch_count);
+    memcpy(undo_delta_spans(delta), history->scratch, history->scratch_count * sizeof(undo_span));
+    delta->erased_count = history->scratch_count;
+    undo_history_recorded(history, UNDO_HISTORY_RUN_ERASE);
+}
+
+static void
+undo_history_reserve_edits(undo_history *history, u64 count)
+{
+    if (count <= history->edit_capacity) return;
+    while (history->edit_capacity < count) history->edit_capacity = history->edit_capacity ? history->edit_capacity * 2 : 256;
+    history->edits = (piece_edit *)realloc(history->edits, history->edit_capacity * sizeof(piece_edit));
+    history->edit_spans = (undo_span *)realloc(history->edit_spans, history->edit_capacity * sizeof(undo_span));
+    history->erased_first = (u64 *)realloc(history->erased_first, history->edit_capacity * sizeof(u64));
+    history->erased_counts = (u64 *)realloc(history->erased_counts, history->edit_capacity * sizeof(u64));
+    if (!history->edits || !history->edit_spans || !history->erased_first || !history->erased_counts) {
+        LOG_FATAL("Could not allocate %llu undo edits.", (unsigned long long)history->edit_capacity);
+    }
+}
+
+static void
+undo_history_gather_erased(u64 edit, const u8 *data, u64 length, void *arg)
+{
+    undo_history *history = (undo_history *)arg;
+    if (history->erased_counts[edit]++ == 0) history->erased_first[edit] = history->scratch_count;
+    undo_history_gather(data, length, history);
+}
+
+void
+undo_history_apply(undo_history *history, const undo_edit *edits, u64 count, u64 *positions, u64 position_count)
+{
+    undo_history_reserve_edits(history, count);
+    u64 total = piece_table_length(history->table);
+    b32 changes = false;
+    for (u64 i = 0; i < count; ++i) {
+        piece_edit *edit = &history->edits[i];
+        edit->offset = edits[i].offset < total ? edits[i].offset : total;
+        edit->length = edits[i].length < total - edit->offset ? edits[i].length : total - edit->offset;
+        changes |= edit->length > 0 || edits[i].text_length > 0;
+    }
+
+    if (changes) {
+        undo_history_discard_redo(history);
+        for (u64 i = 0; i < count; ++i) {
+            const u8 *data = piece_table_add_text(history->table, edits[i].text, edits[i].text_length);
+            history->edit_spans[i] = (undo_span){data, edits[i].text_length};
+            history->edits[i].spans = &history->edit_spans[i];
+            history->edits[i].span_count = edits[i].text_length > 0;
+            history->erased_counts[i] = 0;
+        }
+        history->scratch_count = 0;
+        piece_table_apply(history->table, history->edits, count, undo_history_gather_erased, history);
+
+        if (!(history->depth > 0 && history->group_started && undo_history_last_delta(history))) {
+            undo_history_open_transaction(history);
+        }
+        // Deltas are replayed one after another, so each offset counts the
+        // edits before it
+        s64 shift = 0;
+        for (u64 i = 0; i < count; ++i) {
+            const piece_edit *edit = &history->edits[i];
+            u32 erased = (u32)history->erased_counts[i];
+            if (erased + edit->span_count == 0) continue;
+            undo_delta *delta = undo_history_push_delta(history, (u64)((s64)edit->offset + shift),
+                                                        erased + edit->span_count);
+            undo_span *spans = undo_delta_spans(delta);
+            if (erased > 0) memcpy(spans, history->scratch + history->erased_first[i], erased * sizeof(undo_span));
+            if (edit->span_count > 0) spans[erased] = edit->spans[0];
+            delta->erased_count = erased;
+            delta->inserted_count = edit->span_count;
+            shift += (s64)edits[i].text_length - (s64)edit->length;
+        }
+        undo_history_recorded(history, UNDO_HISTORY_RUN_NONE);
+    }
+
+    // One pass over both sorted lists
+    u64 next = 0;
+    s64 shift = 0;
+    for (u64 i = 0; i < position_count; ++i) {
+        u64 position = positions[i];
+        while (next < count && history->edits[next].offset + history->edits[next].length < position) {
+            shift += (s64)edits[next].text_length - (s64)history->edits[next].length;
+            ++next;
+        }
+        if (next < count && position >= history->edits[next].offset) {
+            // Edits that insert where this one ends come after it
+            while (next + 1 < count && history->edits[next + 1].offset <= position) {
+                shift += (s64)edits[next].text_length - (s64)history->edits[next].length;
+                ++next;
+            }
+            positions[i] = (u64)((s64)history->edits[next].offset + shift) + edits[next].text_length;
+        } else {
+            positions[i] = (u64)((s64)position + shift);
+        }
+    }
+}
+
+// Undoes or redoes a transaction in one pass over the table. Only possible
+// when each delta starts past the text of the one before, or ends before its
+// offset, as with batches, replace-all and multi-cursor edits. Returns false
+// otherwise.
+static b32
+undo_history_apply_transaction(undo_history *history, const undo_transaction *transaction, b32 undo)
+{
+    u64 count = transaction->delta_count;
+    if (count < UNDO_HISTORY_BATCH_THRESHOLD) return false;
+    undo_history_reserve_edits(history, count);
+
+    // Each edit takes out the text the delta put in, or the reverse, at the
+    // offset the delta was made at
+    undo_block *block = transaction->first_block;
+    u32 record = transaction->first_record;
+    b32 ascending = true, descending = true;
+    for (u64 i = 0; i < count; ++i) {
+        undo_delta *delta = undo_delta_at(block, record);
+        undo_span *spans = undo_delta_spans(delta);
+        u64 erased = undo_spans_length(spans, delta->erased_count);
+        u64 inserted = undo_spans_length(spans + delta->erased_count, delta->inserted_count);
+        piece_edit *edit = &history->edits[i];
+        edit->offset = delta->offset;
+        edit->length = undo ? inserted : erased;
+        edit->spans = undo ? spans : spans + delta->erased_count;
+        edit->span_count = undo ? delta->erased_count : delta->inserted_count;
+        history->erased_counts[i] = undo ? erased : inserted;
+        if (i > 0) {
+            const piece_edit *previous = &history->edits[i - 1];
+            u64 previous_inserted = undo ? previous->length : history->erased_counts[i - 1];
+            ascending &= delta->offset >= previous->offset + previous_inserted;
+            descending &= delta->offset + erased <= previous->offset;
+        }
+
+        record += undo_delta_size(delta);
+        if (record == block->used && block->next) {
+            block = block->next;
+            record = 0;
+        }
+    }
+    if (!ascending && !descending) return false;
+
+    // Moves the offsets to the document the batch applies to. Going forward,
+    // a delta's offset already counts the deltas before it, which redo takes
+    // out again; undo works on the text after the last delta, where only
+    // deltas before an offset move it.
+    s64 shift = 0;
+    if (ascending && !undo) {
+        for (u64 i = 0; i < count; ++i) {
+            history->edits[i].offset = (u64)((s64)history->edits[i].offset - shift);
+            shift += (s64)history->erased_counts[i] - (s64)history->edits[i].length;
+        }
+    } else if (!ascending && undo) {
+        for (u64 i = count; i-- > 0;) {
+            history->edits[i].offset = (u64)((s64)history->edits[i].offset + shift);
+            shift += (s64)history->edits[i].length - (s64)history->erased_counts[i];
+        }
+    }
+    if (!ascending) {
+        for (u64 i = 0; i < count / 2; ++i) {
+            piece_edit swap = history->edits[i];
+            history->edits[i] = history->edits[count - 1 - i];
+            history->edits[count - 1 - i] = swap;
+        }
+    }
+    piece_table_apply(history->table, history->edits, count, NULL, NULL);
+    return true;
+}
+
+b32
+undo_history_undo(undo_history *history, u64 *cursor)
+{
+    history->run = UNDO_HISTORY_RUN_NONE;
+    history->group_started = false;
+    if (history->applied == history->transaction_first) return false;
+
+    // Deltas are undone newest first
+    undo_transaction *transaction = &history->transactions[--history->applied];
+    if (undo_history_apply_transaction(history, transaction, true)) {
+        undo_delta *first = undo_delta_at(transaction->first_block, transaction->first_record);
+        if (cursor) *cursor = first->offset + undo_spans_length(undo_delta_spans(first), first->erased_count);
+        return true;
+    }
+
+    undo_block *block = transaction->last_block;
+    u32 record = transaction->last_record;
+    u64 position = 0;
+    for (u64 i = 0; i < transaction->delta_count; ++i) {
+        undo_delta *delta = undo_delta_at(block, record);
+        undo_span *spans = undo_delta_spans(delta);
+        piece_table_erase(history->table, delta->offset,
+                          undo_spans_length(spans + delta->erased_count, delta->inserted_count));
+        position = delta->offset;
+        for (u32 j = 0; j < delta->erased_count; ++j) {
+            piece_table_insert_shared(history->table, position, spans[j].data, spans[j].length);
+            position += spans[j].length;
+        }
+
+        if (delta->previous != UNDO_HISTORY_NONE) {
+            record = delta->previous;
+        } else if (block->previous) {
+            block = block->previous;
+            record = block->last;
+        }
+    }
+    if (cursor) *cursor = position;
+    return true;
+}
+
+b32
+undo_history_redo(undo_history *history, u64 *cursor)
+{
+    history->run = UNDO_HISTORY_RUN_NONE;
+    history->group_started = false;
+    if (history->applied == history->transaction_count) return false;
+
+    undo_transaction *transaction = &history->transactions[history->applied++];
+    if (undo_history_apply_transaction(history, transaction, false)) {
+        undo_delta *last = undo_delta_at(transaction->last_block, transaction->last_record);
+        undo_span *spans = undo_delta_spans(last);
+        if (cursor) *cursor = last->offset + undo_spans_length(spans + last->erased_count, last->inserted_count);
+        return true;
+    }
+
+    undo_block *block = transaction->first_block;
+    u32 record = transaction->first_record;
+    u64 position = 0;
+    for (u64 i = 0; i < transaction->delta_count; ++i) {
+        undo_delta *delta = undo_delta_at(block, record);
+        undo_span *spans = undo_delta_spans(delta);
+        piece_table_erase(history->table, delta->offset, undo_spans_length(spans, delta->erased_count));
+        position = delta->offset;
+        for (u32 j = delta->erased_count; j < delta->erased_count + delta->inserted_count; ++j) {
+            piece_table_insert_shared(history->table, position, spans[j].data, spans[j].length);
+            position += spans[j].length;
+        }
+
+        record += undo_delta_size(delta);
+        if (record == block->used && block->next) {
+            block = block->next;
+            record = 0;
+        }
+    }
+    if (cursor) *cursor = position;
+    return true;
+}
+
+u32
+undo_history_undo_count(const undo_history *history)
+{
+    return history->applied - history->transaction_first;
+}
+
+u32
+undo_history_redo_count(const undo_history *history)
+{
+    return history->transaction_count - history->applied;
+}
@@ -0,0 +1,383 @@
+#include "utf8.h"
+#include "raster_simd.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define UTF8_X86
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define UTF8_HAS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#define UTF8_ASCII_MASK 0x8080808080808080ull
+
+static inline u64
+utf8_popcount(u32 mask)
+{
+#if defined(__GNUC__)
+    return (u64)__builtin_popcount(mask);
+#else
+    u64 count = 0;
+    for (; mask; mask &= mask - 1) ++count;
+    return count;
+#endif
+}
+
+static inline u64
+utf8_lowest_bit(u32 mask)
+{
+#if defined(__GNUC__)
+    return (u64)__builtin_ctz(mask);
+#else
+    u64 bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+u32
+utf8_decode_slow(const u8 *text, u64 length, u64 *offset)
+{
+    u64 i = *offset;
+    u8 lead = text[i];
+    u32 count, codepoint, min;
+    if ((lead & 0xE0) == 0xC0) {
+        count = 1; codepoint = lead & 0x1F; min = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        count = 2; codepoint = lead & 0x0F; min = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        count = 3; codepoint = lead & 0x07; min = 0x10000;
+    } else {
+        *offset = i + 1;
+        return UTF8_REPLACEMENT_CHARACTER;
+    }
+
+    if (i + count >= length) {
+        *offset = i + 1;
+        return UTF8_REPLACEMENT_CHARACTER;
+    }
+    for (u32 k = 1; k <= count; ++k) {
+        u8 byte = text[i + k];
+        if ((byte & 0xC0) != 0x80) {
+            *offset = i + 1;
+            return UTF8_REPLACEMENT_CHARACTER;
+        }
+        codepoint = (codepoint << 6) | (byte & 0x3F);
+    }
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        *offset = i + 1;
+        return UTF8_REPLACEMENT_CHARACTER;
+    }
+
+    *offset = i + count + 1;
+    return codepoint;
+}
+
+// Checks one sequence starting at *offset. U+FFFD is only an error when it
+// was not actually encoded in the text.
+static inline b32
+utf8_check_sequence(const u8 *data, u64 length, u64 *offset)
+{
+    u64 start = *offset;
+    return utf8_decode(data, length, offset) != UTF8_REPLACEMENT_CHARACTER || *offset != start + 1;
+}
+
+static u64
+utf8_validate_scalar(const u8 *data, u64 length)
+{
+    u64 i = 0;
+    while (i < length) {
+        if (i + 8 <= length) {
+            u64 word;
+            memcpy(&word, data + i, sizeof(word));
+            if (!(word & UTF8_ASCII_MASK)) {
+                i += 8;
+                continue;
+            }
+        }
+        if (data[i] < 0x80) {
+            ++i;
+            continue;
+        }
+        u64 start = i;
+        if (!utf8_check_sequence(data, length, &i)) return start;
+    }
+    return length;
+}
+
+// Start of the last sequence before i, which a valid prefix may have cut off
+static u64
+utf8_sequence_start(const u8 *data, u64 i)
+{
+    for (u64 k = 1; k <= 3 && k <= i; ++k) {
+        u8 byte = data[i - k];
+        if ((byte & 0xC0) != 0x80) return byte >= 0xC0 ? i - k : i;
+    }
+    return i;
+}
+
+static u64
+utf8_count_codepoints_scalar(const u8 *data, u64 length)
+{
+    u64 count = 0;
+    for (u64 i = 0; i < length; ++i) count += (data[i] & 0xC0) != 0x80;
+    return count;
+}
+
+static u64
+utf8_ascii_length_scalar(const u8 *data, u64 length)
+{
+    u64 i = 0;
+    for (; i + 8 <= length; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word & UTF8_ASCII_MASK) break;
+    }
+    while (i < length && data[i] < 0x80) ++i;
+    return i;
+}
+
+#if defined(UTF8_X86)
+// Skips ASCII 16 bytes at a time and checks the sequences of any other block
+// one by one
+static u64
+utf8_validate_sse2(const u8 *data, u64 length)
+{
+    u64 i = 0;
+    while (i + 16 <= length) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+        if (!_mm_movemask_epi8(bytes)) {
+            i += 16;
+            continue;
+        }
+        u64 end = i + 16;
+        while (i < end) {
+            if (data[i] < 0x80) {
+                ++i;
+                continue;
+            }
+            u64 start = i;
+            if (!utf8_check_sequence(data, length, &i)) return start;
+        }
+    }
+    return i + utf8_validate_scalar(data + i, length - i);
+}
+
+static u64
+utf8_count_codepoints_sse2(const u8 *data, u64 length)
+{
+    // Continuation bytes are the only ones below -64 as signed bytes
+    const __m128i continuation = _mm_set1_epi8(-65);
+    u64 count = 0;
+    u64 i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+        count += utf8_popcount((u32)_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, continuation)));
+    }
+    return count + utf8_count_codepoints_scalar(data + i, length - i);
+}
+
+static u64
+utf8_ascii_length_sse2(const u8 *data, u64 length)
+{
+    u64 i = 0;
+    for (; i + 16 <= length; i += 16) {
+        u32 mask = (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(data + i)));
+        if (mask) return i + utf8_lowest_bit(mask);
+    }
+    return i + utf8_ascii_length_scalar(data + i, length - i);
+}
+#endif
+
+#if defined(UTF8_HAS_AVX2)
+// Error bits of the lookup tables. A pair of bytes is ill-formed when the
+// tables for the high nibble of the first, the low nibble of the first and
+// the high nibble of the second byte have a bit in common.
+#define UTF8_TOO_SHORT (1 << 0)  // Lead byte followed by a lead or ASCII byte
+#define UTF8_TOO_LONG (1 << 1)   // ASCII byte followed by a continuation byte
+#define UTF8_OVERLONG_3 (1 << 2) // E0 followed by 80..9F
+#define UTF8_TOO_LARGE (1 << 3)  // Above U+10FFFF
+#define UTF8_SURROGATE (1 << 4)  // ED followed by A0..BF
+#define UTF8_OVERLONG_2 (1 << 5) // C0 or C1
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6) // F0 followed by 80..8F
+#define UTF8_TWO_CONTS (1 << 7)  // Continuation byte after a continuation byte
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+    _mm256_setr_epi8((char)(a), (char)(b), (char)(c), (char)(d), (char)(e), (char)(f), (char)(g), (char)(h), \
+                     (char)(i), (char)(j), (char)(k), (char)(l), (char)(m), (char)(n), (char)(o), (char)(p), \
+                     (char)(a), (char)(b), (char)(c), (char)(d), (char)(e), (char)(f), (char)(g), (char)(h), \
+                     (char)(i), (char)(j), (char)(k), (char)(l), (char)(m), (char)(n), (char)(o), (char)(p))
+
+// The n bytes before each byte of input, previous holding the block before it
+#define UTF8_PREVIOUS(input, previous, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static u64
+utf8_validate_avx2(const u8 *data, u64 length)
+{
+    const __m256i byte_1_high_table = UTF8_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low_table = UTF8_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high_table = UTF8_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    // A lead byte in one of the last three bytes needs bytes of the next block
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i third_byte = _mm256_set1_epi8((char)(0xE0 - 0x80));
+    const __m256i fourth_byte = _mm256_set1_epi8((char)(0xF0 - 0x80));
+    const __m256i high_bit = _mm256_set1_epi8((char)0x80);
+
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    u64 i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i error;
+        if (!_mm256_movemask_epi8(input)) {
+            error = previous_incomplete;
+            previous_incomplete = _mm256_setzero_si256();
+        } else {
+            __m256i previous_1 = UTF8_PREVIOUS(input, previous, 1);
+            __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+                                                      _mm256_and_si256(_mm256_srli_epi16(previous_1, 4), low_nibble));
+            __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(previous_1, low_nibble));
+            __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table,
+                                                      _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+            __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+            // Third and fourth bytes of a sequence must be continuation bytes,
+            // which the tables only see as two continuation bytes in a row
+            __m256i previous_2 = UTF8_PREVIOUS(input, previous, 2);
+            __m256i previous_3 = UTF8_PREVIOUS(input, previous, 3);
+            __m256i must_continue = _mm256_or_si256(_mm256_subs_epu8(previous_2, third_byte),
+                                                    _mm256_subs_epu8(previous_3, fourth_byte));
+            error = _mm256_xor_si256(_mm256_and_si256(must_continue, high_bit), special);
+            previous_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        }
+        if (!_mm256_testz_si256(error, error)) break;
+        previous = input;
+    }
+
+    // Everything before i is valid, apart from a sequence that may run past
+    // it. The scalar loop finds the exact offset of an error from there.
+    u64 start = utf8_sequence_start(data, i);
+    return start + utf8_validate_scalar(data + start, length - start);
+}
+
+__attribute__((target("avx2,popcnt")))
+static u64
+utf8_count_codepoints_avx2(const u8 *data, u64 length)
+{
+    const __m256i continuation = _mm256_set1_epi8(-65);
+    u64 count = 0;
+    u64 i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + i));
+        count += utf8_popcount((u32)_mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, continuation)));
+    }
+    return count + utf8_count_codepoints_scalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static u64
+utf8_ascii_length_avx2(const u8 *data, u64 length)
+{
+    u64 i = 0;
+    for (; i + 32 <= length; i += 32) {
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(data + i)));
+        if (mask) return i + utf8_lowest_bit(mask);
+    }
+    return i + utf8_ascii_length_scalar(data + i, length - i);
+}
+#endif
+
+u64
+utf8_validate(const u8 *data, u64 length)
+{
+    switch (raster_simd_get_level()) {
+#if defined(UTF8_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        return utf8_validate_avx2(data, length);
+#endif
+#if defined(UTF8_X86)
+    case RASTER_SIMD_SSE2:
+        return utf8_validate_sse2(data, length);
+#endif
+    default:
+        return utf8_validate_scalar(data, length);
+    }
+}
+
+u64
+utf8_count_codepoints(const u8 *data, u64 length)
+{
+    switch (raster_simd_get_level()) {
+#if defined(UTF8_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        return utf8_count_codepoints_avx2(data, length);
+#endif
+#if defined(UTF8_X86)
+    case RASTER_SIMD_SSE2:
+        return utf8_count_codepoints_sse2(data, length);
+#endif
+    default:
+        return utf8_count_codepoints_scalar(data, length);
+    }
+}
+
+u64
+utf8_ascii_length(const u8 *data, u64 length)
+{
+    switch (raster_simd_get_level()) {
+#if defined(UTF8_HAS_AVX2)
+    case RASTER_SIMD_AVX2:
+        return utf8_ascii_length_avx2(data, length);
+#endif
+#if defined(UTF8_X86)
+    case RASTER_SIMD_SSE2:
+        return utf8_ascii_length_sse2(data, length);
+#endif
+    default:
+        return utf8_ascii_length_scalar(data, length);
+    }
+}
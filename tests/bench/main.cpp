@@ -0,0 +1,585 @@
+// Text rendering benchmarks over fixed corpora with the bundled Roboto font.
+// Results are printed to stdout as JSON, everything else goes to stderr.
+// Run from the repository root:
+//
+//   ./build/sparrow_bench [--filter substring] [--min-time seconds] [--out file]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "compositor.h"
+#include "find.h"
+#include "font.h"
+#include "font_metrics.h"
+#include "glyph_cache.h"
+#include "layout.h"
+#include "line_index.h"
+#include "raster_simd.h"
+#include "regex_dfa.h"
+#include "thread_pool.h"
+#include "utf8.h"
+
+#ifndef SPARROW_VERSION
+#define SPARROW_VERSION "unknown"
+#endif
+
+#define BENCH_FONT "res/Roboto-Black.ttf"
+#define BENCH_TAB_WIDTH 4
+#define BENCH_FRAME_WIDTH 1280
+#define BENCH_FRAME_HEIGHT 720
+#define BENCH_FRAME_PIXEL_HEIGHT 16.0f
+#define BENCH_COMPOSE_WIDTH 1920
+#define BENCH_COMPOSE_HEIGHT 1080
+
+struct corpus {
+    const char *name;
+    std::string text;
+    std::vector<u32> line_starts; // One past the end of the text last
+};
+
+struct bench_result {
+    std::string name;
+    const char *unit;
+    u64 iterations;
+    f64 items;
+    f64 seconds;
+    std::vector<f64> samples; // Seconds per iteration
+};
+
+struct bench_options {
+    const char *filter;
+    f64 min_time;
+};
+
+static f64
+now_seconds(void)
+{
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<f64>(clock::now().time_since_epoch()).count();
+}
+
+// Runs body until min_time has passed, after one untimed warm-up run. body
+// returns the number of items it processed.
+template <typename F>
+static void
+run_bench(std::vector<bench_result> &results, const bench_options &options,
+          const std::string &name, const char *unit, F &&body)
+{
+    if (options.filter && name.find(options.filter) == std::string::npos) return;
+
+    bench_result result = {name, unit, 0, 0.0, 0.0, {}};
+    body();
+    while (result.seconds < options.min_time || result.iterations < 3) {
+        f64 start = now_seconds();
+        f64 items = body();
+        f64 elapsed = now_seconds() - start;
+        result.items += items;
+        result.seconds += elapsed;
+        result.samples.push_back(elapsed);
+        ++result.iterations;
+    }
+
+    fprintf(stderr, "%-32s %14.0f %s\n", name.c_str(), result.items / result.seconds, unit);
+    results.push_back(result);
+}
+
+static f64
+percentile(std::vector<f64> samples, f64 p)
+{
+    std::sort(samples.begin(), samples.end());
+    size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+static void
+split_lines(corpus *c)
+{
+    c->line_starts.clear();
+    u32 start = 0;
+    for (u32 i = 0; i < c->text.size(); ++i) {
+        if (c->text[i] == '\n') {
+            c->line_starts.push_back(start);
+            start = i + 1;
+        }
+    }
+    if (start < c->text.size()) c->line_starts.push_back(start);
+    c->line_starts.push_back((u32)c->text.size() + 1);
+}
+
+static u32
+line_count(const corpus *c)
+{
+    return (u32)c->line_starts.size() - 1;
+}
+
+static const u8 *
+line_text(const corpus *c, u32 line, u32 *length)
+{
+    u32 start = c->line_starts[line];
+    *length = c->line_starts[line + 1] - 1 - start;
+    return (const u8 *)c->text.data() + start;
+}
+
+static void
+append_utf8(std::string &text, u32 codepoint)
+{
+    if (codepoint < 0x80) {
+        text += (char)codepoint;
+    } else if (codepoint < 0x800) {
+        text += (char)(0xC0 | (codepoint >> 6));
+        text += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        text += (char)(0xE0 | (codepoint >> 12));
+        text += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        text += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static std::vector<corpus>
+make_corpora(void)
+{
+    std::vector<corpus> corpora;
+
+    // Real C source: the bundled stb_truetype.h
+    corpus source = {"ascii_source", {}, {}};
+    FILE *file = fopen("include/stb/stb_truetype.h", "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open include/stb/stb_truetype.h, run from the repository root.\n");
+        exit(EXIT_FAILURE);
+    }
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) source.text.append(buffer, read);
+    fclose(file);
+    corpora.push_back(source);
+
+    // CJK ideographs, 40 per line. Roboto has none, so this measures decoding
+    // and the lookup paths outside the dense range.
+    corpus cjk = {"cjk", {}, {}};
+    u32 state = 12345;
+    for (u32 line = 0; line < 4000; ++line) {
+        for (u32 i = 0; i < 40; ++i) {
+            state = state * 1664525u + 1013904223u;
+            append_utf8(cjk.text, 0x4E00 + (state >> 8) % (0x9FFF - 0x4E00));
+        }
+        cjk.text += '\n';
+    }
+    corpora.push_back(cjk);
+
+    // 16 KiB lines of words
+    corpus long_lines = {"long_lines", {}, {}};
+    const char *words[] = {"lorem", "ipsum", "dolor", "sit", "amet,", "consectetur", "adipiscing", "elit"};
+    for (u32 line = 0; line < 64; ++line) {
+        size_t start = long_lines.text.size();
+        for (u32 i = line; long_lines.text.size() - start < 16384; ++i) {
+            long_lines.text += words[i % 8];
+            long_lines.text += ' ';
+        }
+        long_lines.text += '\n';
+    }
+    corpora.push_back(long_lines);
+
+    for (corpus &c : corpora) split_lines(&c);
+    return corpora;
+}
+
+static std::vector<s32>
+printable_ascii_glyphs(const font *f)
+{
+    std::vector<s32> glyphs;
+    for (u32 codepoint = 33; codepoint < 127; ++codepoint) glyphs.push_back(font_glyph_index(f, codepoint));
+    return glyphs;
+}
+
+static void
+bench_raster(std::vector<bench_result> &results, const bench_options &options, const font *f, thread_pool *pool)
+{
+    std::vector<s32> glyphs = printable_ascii_glyphs(f);
+    const f32 pixel_heights[] = {16.0f, 32.0f, 64.0f};
+
+    glyph_cache cache;
+    glyph_cache_init(&cache, 1024, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    for (f32 pixel_height : pixel_heights) {
+        std::string suffix = "/" + std::to_string((s32)pixel_height) + "px";
+
+        run_bench(results, options, "raster" + suffix, "glyphs/s", [&]() {
+            glyph_cache_clear(&cache);
+            for (u32 phase = 0; phase < GLYPH_CACHE_SUBPIXEL_STEPS; ++phase) {
+                for (s32 glyph : glyphs) glyph_cache_get(&cache, &f->info, glyph, pixel_height, phase);
+            }
+            return (f64)glyphs.size() * GLYPH_CACHE_SUBPIXEL_STEPS;
+        });
+
+        std::vector<s32> indices;
+        std::vector<u32> phases;
+        for (u32 phase = 0; phase < GLYPH_CACHE_SUBPIXEL_STEPS; ++phase) {
+            for (s32 glyph : glyphs) {
+                indices.push_back(glyph);
+                phases.push_back(phase);
+            }
+        }
+        run_bench(results, options, "raster_parallel" + suffix, "glyphs/s", [&]() {
+            glyph_cache_clear(&cache);
+            glyph_cache_warm(&cache, pool, &f->info, pixel_height, indices.data(), phases.data(), (u32)indices.size());
+            return (f64)indices.size();
+        });
+    }
+
+    run_bench(results, options, "sdf", "glyphs/s", [&]() {
+        glyph_cache_clear(&cache);
+        for (s32 glyph : glyphs) glyph_cache_get_sdf(&cache, &f->info, glyph);
+        return (f64)glyphs.size();
+    });
+
+    glyph_cache_free(&cache);
+}
+
+// Indexing throughput over 64 MiB of each corpus, as when opening a file
+static void
+bench_line_index(std::vector<bench_result> &results, const bench_options &options,
+                 const std::vector<corpus> &corpora)
+{
+    for (const corpus &c : corpora) {
+        std::string text;
+        while (text.size() < 64 * 1024 * 1024) text += c.text;
+
+        run_bench(results, options, std::string("line_index/") + c.name, "MB/s", [&]() {
+            line_index index;
+            line_index_init(&index);
+            line_index_append(&index, (const u8 *)text.data(), text.size());
+            line_index_free(&index);
+            return text.size() / 1e6;
+        });
+    }
+}
+
+static void
+bench_utf8(std::vector<bench_result> &results, const bench_options &options, const std::vector<corpus> &corpora)
+{
+    for (const corpus &c : corpora) {
+        std::string text;
+        while (text.size() < 64 * 1024 * 1024) text += c.text;
+
+        run_bench(results, options, std::string("utf8_validate/") + c.name, "MB/s", [&]() {
+            if (utf8_validate((const u8 *)text.data(), text.size()) != text.size()) {
+                fprintf(stderr, "Corpus %s is not valid UTF-8\n", c.name);
+            }
+            return text.size() / 1e6;
+        });
+    }
+}
+
+// Searching 256 MiB of each corpus for a string it holds once per copy, both
+// in one pass and split across the pool
+static void
+bench_find(std::vector<bench_result> &results, const bench_options &options,
+           const std::vector<corpus> &corpora, thread_pool *pool)
+{
+    for (const corpus &c : corpora) {
+        std::string text;
+        while (text.size() < 256 * 1024 * 1024) text += c.text;
+        std::string needle = c.text.substr(c.text.size() / 2, 16);
+        find_pattern pattern;
+        find_pattern_init(&pattern, (const u8 *)needle.data(), needle.size());
+        find_source source = find_source_memory((const u8 *)text.data(), text.size());
+
+        run_bench(results, options, std::string("find/") + c.name, "MB/s", [&]() {
+            find_matches matches = {};
+            find_all(&pattern, &source, 0, text.size(), nullptr, &matches);
+            find_matches_free(&matches);
+            return text.size() / 1e6;
+        });
+        run_bench(results, options, std::string("find_parallel/") + c.name, "MB/s", [&]() {
+            find_matches matches = {};
+            find_all(&pattern, &source, 0, text.size(), pool, &matches);
+            find_matches_free(&matches);
+            return text.size() / 1e6;
+        });
+    }
+}
+
+// Regex search over 64 MiB of each corpus, with a pattern most lines get
+// some way into
+static void
+bench_regex(std::vector<bench_result> &results, const bench_options &options, const std::vector<corpus> &corpora)
+{
+    const char *pattern = "[a-z_]+\\([a-z_]*, [0-9]+\\)$";
+    for (const corpus &c : corpora) {
+        std::string text;
+        while (text.size() < 64 * 1024 * 1024) text += c.text;
+        find_source source = find_source_memory((const u8 *)text.data(), text.size());
+        regex re;
+        if (!regex_compile(&re, (const u8 *)pattern, strlen(pattern), 0, REGEX_DEFAULT_CACHE_SIZE)) {
+            fprintf(stderr, "Could not compile %s: %s\n", pattern, re.error);
+            return;
+        }
+        run_bench(results, options, std::string("regex/") + c.name, "MB/s", [&]() {
+            u64 count = 0;
+            regex_search(&re, &source, 0, text.size(), [](u64, u64, void *arg) -> b32 {
+                ++*(u64 *)arg;
+                return true;
+            }, &count);
+            return text.size() / 1e6;
+        });
+        regex_free(&re);
+    }
+}
+
+static void
+bench_layout(std::vector<bench_result> &results, const bench_options &options,
+             const font_metrics *metrics, const std::vector<corpus> &corpora)
+{
+    for (const corpus &c : corpora) {
+        layout_line line = {};
+        run_bench(results, options, std::string("layout/") + c.name, "lines/s", [&]() {
+            for (u32 i = 0; i < line_count(&c); ++i) {
+                u32 length;
+                const u8 *text = line_text(&c, i, &length);
+                layout_line_build(&line, metrics, BENCH_TAB_WIDTH, text, length);
+            }
+            return (f64)line_count(&c);
+        });
+        layout_line_free(&line);
+
+        // Every line stays cached, as when scrolling back over a file
+        layout_cache cache;
+        layout_cache_init(&cache, line_count(&c));
+        run_bench(results, options, std::string("layout_cached/") + c.name, "lines/s", [&]() {
+            for (u32 i = 0; i < line_count(&c); ++i) {
+                u32 length;
+                const u8 *text = line_text(&c, i, &length);
+                layout_cache_get(&cache, metrics, BENCH_TAB_WIDTH, i, text, length);
+            }
+            return (f64)line_count(&c);
+        });
+        layout_cache_free(&cache);
+    }
+}
+
+// Draws one screen of the corpus starting at first_line into an 8-bit frame
+static void
+render_frame(u8 *frame, const corpus *c, u32 first_line, const font_metrics *metrics,
+             layout_cache *layout, glyph_cache *glyphs)
+{
+    memset(frame, 0, BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT);
+    glyph_cache_begin_frame(glyphs);
+
+    f32 line_advance = metrics->ascent - metrics->descent + metrics->line_gap;
+    s32 visible_lines = (s32)(BENCH_FRAME_HEIGHT / line_advance);
+    for (s32 row = 0; row < visible_lines; ++row) {
+        u32 line_number = (first_line + row) % line_count(c);
+        u32 length;
+        const u8 *text = line_text(c, line_number, &length);
+        const layout_line *line = layout_cache_get(layout, metrics, BENCH_TAB_WIDTH, line_number, text, length);
+
+        s32 baseline = (s32)(row * line_advance + metrics->ascent);
+        for (u32 i = 0; i < line->glyph_count && line->glyphs[i].x < BENCH_FRAME_WIDTH; ++i) {
+            const layout_glyph *g = &line->glyphs[i];
+            const cached_glyph *glyph = glyph_cache_get(glyphs, &metrics->font->info, g->glyph_index,
+                                                        metrics->pixel_height, glyph_cache_subpixel_phase(g->x));
+            s32 x0 = (s32)g->x + glyph->x_offset;
+            s32 y0 = baseline + glyph->y_offset;
+            for (s32 y = std::max(0, -y0); y < glyph->height && y0 + y < BENCH_FRAME_HEIGHT; ++y) {
+                u8 *out = frame + (y0 + y) * BENCH_FRAME_WIDTH;
+                const u8 *coverage = glyph->coverage + y * glyph->stride;
+                for (s32 x = std::max(0, -x0); x < glyph->width && x0 + x < BENCH_FRAME_WIDTH; ++x) {
+                    out[x0 + x] = std::max(out[x0 + x], coverage[x]);
+                }
+            }
+        }
+    }
+}
+
+static void
+bench_frames(std::vector<bench_result> &results, const bench_options &options,
+             const font *f, const std::vector<corpus> &corpora)
+{
+    font_metrics metrics;
+    font_metrics_init(&metrics, f, BENCH_FRAME_PIXEL_HEIGHT);
+    std::vector<u8> frame(BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT);
+
+    for (const corpus &c : corpora) {
+        layout_cache layout;
+        glyph_cache glyphs;
+
+        // Every frame scrolls by one screen, starting from empty caches
+        u32 screen_lines = (u32)(BENCH_FRAME_HEIGHT / (metrics.ascent - metrics.descent + metrics.line_gap));
+        u32 screen_start = 0;
+        run_bench(results, options, std::string("frame_cold/") + c.name, "frames/s", [&]() {
+            layout_cache_init(&layout, 4096);
+            glyph_cache_init(&glyphs, 1024, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+            render_frame(frame.data(), &c, screen_start, &metrics, &layout, &glyphs);
+            screen_start = (screen_start + screen_lines) % line_count(&c);
+            glyph_cache_free(&glyphs);
+            layout_cache_free(&layout);
+            return 1.0;
+        });
+
+        // Redrawing an unchanged screen
+        layout_cache_init(&layout, 4096);
+        glyph_cache_init(&glyphs, 1024, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+        run_bench(results, options, std::string("frame_warm/") + c.name, "frames/s", [&]() {
+            render_frame(frame.data(), &c, 0, &metrics, &layout, &glyphs);
+            return 1.0;
+        });
+
+        // Scrolling one line per frame through the whole corpus
+        u32 first_line = 0;
+        run_bench(results, options, std::string("frame_scroll/") + c.name, "frames/s", [&]() {
+            render_frame(frame.data(), &c, first_line++, &metrics, &layout, &glyphs);
+            return 1.0;
+        });
+        glyph_cache_free(&glyphs);
+        layout_cache_free(&layout);
+    }
+
+    font_metrics_free(&metrics);
+}
+
+// Colouring a 1080p screen of text from its coverage, with a selection and
+// the cursor on top
+static void
+bench_compose(std::vector<bench_result> &results, const bench_options &options,
+              const font *f, const std::vector<corpus> &corpora)
+{
+    font_metrics metrics;
+    font_metrics_init(&metrics, f, BENCH_FRAME_PIXEL_HEIGHT);
+    layout_cache layout;
+    layout_cache_init(&layout, 4096);
+    glyph_cache glyphs;
+    glyph_cache_init(&glyphs, 1024, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    // Tiles a rendered screen over the larger one
+    std::vector<u8> screen(BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT);
+    render_frame(screen.data(), &corpora[0], 0, &metrics, &layout, &glyphs);
+    std::vector<u8> coverage(BENCH_COMPOSE_WIDTH * BENCH_COMPOSE_HEIGHT);
+    for (s32 y = 0; y < BENCH_COMPOSE_HEIGHT; ++y) {
+        for (s32 x = 0; x < BENCH_COMPOSE_WIDTH; ++x) {
+            coverage[y * BENCH_COMPOSE_WIDTH + x] =
+                screen[(y % BENCH_FRAME_HEIGHT) * BENCH_FRAME_WIDTH + x % BENCH_FRAME_WIDTH];
+        }
+    }
+
+    compositor_frame frame;
+    compositor_frame_init(&frame, BENCH_COMPOSE_WIDTH, BENCH_COMPOSE_HEIGHT);
+    damage_rect all = {0, 0, BENCH_COMPOSE_WIDTH, BENCH_COMPOSE_HEIGHT};
+    run_bench(results, options, "compose/1080p", "frames/s", [&]() {
+        compositor_compose(&frame, coverage.data(), BENCH_COMPOSE_WIDTH, all,
+                           COMPOSITOR_RGBA(216, 216, 216, 255), COMPOSITOR_RGBA(30, 30, 30, 255));
+        compositor_fill(&frame, 0, 100, BENCH_COMPOSE_WIDTH, 400, COMPOSITOR_RGBA(38, 79, 120, 255));
+        compositor_blend_mask(&frame, 0, 100, coverage.data() + 100 * BENCH_COMPOSE_WIDTH, BENCH_COMPOSE_WIDTH, 300,
+                              BENCH_COMPOSE_WIDTH, COMPOSITOR_RGBA(255, 255, 255, 255));
+        compositor_fill(&frame, 640, 500, 642, 520, COMPOSITOR_RGBA(255, 255, 255, 255));
+        return 1.0;
+    });
+
+    compositor_frame_free(&frame);
+    glyph_cache_free(&glyphs);
+    layout_cache_free(&layout);
+    font_metrics_free(&metrics);
+}
+
+static const char *
+simd_level_name(raster_simd_level level)
+{
+    switch (level) {
+    case RASTER_SIMD_AVX2: return "avx2";
+    case RASTER_SIMD_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+static void
+write_json(FILE *out, const std::vector<bench_result> &results, u32 thread_count)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": \"%s\",\n", SPARROW_VERSION);
+    fprintf(out, "  \"font\": \"%s\",\n", BENCH_FONT);
+    fprintf(out, "  \"simd\": \"%s\",\n", simd_level_name(raster_simd_get_level()));
+    fprintf(out, "  \"threads\": %u,\n", thread_count);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const bench_result &r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"rate\": %.3f, \"iterations\": %llu, "
+                "\"seconds\": %.6f, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p95_ms\": %.6f, \"p99_ms\": %.6f}%s\n",
+                r.name.c_str(), r.unit, r.items / r.seconds, (unsigned long long)r.iterations, r.seconds,
+                r.seconds * 1000.0 / r.iterations, percentile(r.samples, 0.50) * 1000.0,
+                percentile(r.samples, 0.95) * 1000.0, percentile(r.samples, 0.99) * 1000.0,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_options options = {NULL, 0.5};
+    const char *out_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--filter substring] [--min-time seconds] [--out file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Logging writes to stdout, so keep the real stdout for the results
+    FILE *json = stdout;
+    if (!out_path) {
+        int json_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        json = fdopen(json_fd, "w");
+    } else {
+        json = fopen(out_path, "w");
+    }
+    if (!json) {
+        fprintf(stderr, "Could not open benchmark output.\n");
+        return EXIT_FAILURE;
+    }
+
+    font roboto;
+    if (!font_load(&roboto, BENCH_FONT, 0, MAPPED_FILE_WILLNEED)) {
+        fprintf(stderr, "Could not load %s, run from the repository root.\n", BENCH_FONT);
+        return EXIT_FAILURE;
+    }
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, BENCH_FRAME_PIXEL_HEIGHT);
+    std::vector<corpus> corpora = make_corpora();
+
+    thread_pool pool;
+    u32 thread_count = thread_pool_default_thread_count();
+    thread_pool_init(&pool, thread_count);
+
+    std::vector<bench_result> results;
+    bench_raster(results, options, &roboto, &pool);
+    bench_line_index(results, options, corpora);
+    bench_utf8(results, options, corpora);
+    bench_find(results, options, corpora, &pool);
+    bench_regex(results, options, corpora);
+    bench_layout(results, options, &metrics, corpora);
+    bench_frames(results, options, &roboto, corpora);
+    bench_compose(results, options, &roboto, corpora);
+
+    write_json(json, results, thread_count);
+    fclose(json);
+
+    thread_pool_free(&pool);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#include "compositor.h"
+#include "raster_simd.h"
+#include "test_random.h"
+
+// Rounded (coverage * fg + (255 - coverage) * bg) / 255 for each channel
+static u32
+reference_lerp(u32 coverage, u32 fg, u32 bg)
+{
+    u32 result = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 x = coverage * ((fg >> shift) & 0xFF) + (255 - coverage) * ((bg >> shift) & 0xFF);
+        result |= ((x * 2 + 255) / 510) << shift;
+    }
+    return result;
+}
+
+// Mostly empty and fully covered runs, like text, with edges in between
+static std::vector<u8>
+make_coverage(s32 width, s32 height)
+{
+    std::vector<u8> coverage(width * height);
+    test_random random = {7};
+    for (u8 &value : coverage) {
+        u32 bits = random.step();
+        u32 kind = (bits >> 16) % 4;
+        value = kind == 0 ? 0 : kind == 1 ? 255 : (u8)(bits >> 8);
+    }
+    return coverage;
+}
+
+TEST_CASE("Compositor kernels agree on every byte", "[compositor]") {
+    const s32 width = 67;
+    const s32 height = 9;
+    const u32 fg = COMPOSITOR_RGBA(216, 200, 17, 255);
+    const u32 bg = COMPOSITOR_RGBA(30, 31, 250, 128);
+    std::vector<u8> coverage = make_coverage(width, height);
+
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+        compositor_frame frame;
+        compositor_frame_init(&frame, width, height);
+
+        // Composing only touches the rectangle
+        compositor_compose(&frame, coverage.data(), width, {3, 1, 60, 8}, fg, bg);
+        for (s32 y = 0; y < height; ++y) {
+            for (s32 x = 0; x < width; ++x) {
+                b32 inside = x >= 3 && x < 60 && y >= 1 && y < 8;
+                u32 expected = inside ? reference_lerp(coverage[y * width + x], fg, bg) : 0;
+                REQUIRE(frame.pixels[y * width + x] == expected);
+            }
+        }
+
+        // Masks blend over what is there, clipped to the frame
+        compositor_compose(&frame, coverage.data(), width, {0, 0, width, height}, fg, bg);
+        std::vector<u32> before(frame.pixels, frame.pixels + width * height);
+        const u8 *mask = coverage.data() + 5;
+        compositor_blend_mask(&frame, -2, 4, mask, 40, 7, width, COMPOSITOR_RGBA(255, 0, 0, 255));
+        for (s32 y = 0; y < height; ++y) {
+            for (s32 x = 0; x < width; ++x) {
+                u32 expected = before[y * width + x];
+                if (x < 38 && y >= 4) {
+                    expected = reference_lerp(mask[(y - 4) * width + x + 2], COMPOSITOR_RGBA(255, 0, 0, 255), expected);
+                }
+                REQUIRE(frame.pixels[y * width + x] == expected);
+            }
+        }
+        compositor_frame_free(&frame);
+    }
+    raster_simd_set_level(best);
+}
+
+TEST_CASE("Compositor fills are clipped to the frame", "[compositor]") {
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+        compositor_frame frame;
+        compositor_frame_init(&frame, 30, 20);
+        compositor_fill(&frame, -5, 15, 21, 40, 0xFFu);
+        compositor_fill(&frame, 10, 10, 5, 12, 0xFF00u);
+        for (s32 y = 0; y < 20; ++y) {
+            for (s32 x = 0; x < 30; ++x) REQUIRE(frame.pixels[y * 30 + x] == (x < 21 && y >= 15 ? 0xFFu : 0u));
+        }
+        compositor_frame_free(&frame);
+    }
+    raster_simd_set_level(best);
+}
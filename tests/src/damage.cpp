@@ -0,0 +1,80 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#include "damage.h"
+
+// Every pixel a region covers, to compare against the rectangles added
+static std::vector<u8>
+coverage(const damage_region *region)
+{
+    std::vector<u8> pixels(region->width * region->height);
+    for (u32 i = 0; i < region->count; ++i) {
+        const damage_rect &rect = region->rects[i];
+        for (s32 y = rect.y0; y < rect.y1; ++y) {
+            for (s32 x = rect.x0; x < rect.x1; ++x) ++pixels[y * region->width + x];
+        }
+    }
+    return pixels;
+}
+
+TEST_CASE("Damage keeps one rectangle per band of rows", "[damage]") {
+    damage_region region;
+    damage_init(&region, 100, 80);
+    REQUIRE(damage_area(&region) == 0);
+
+    // Clipped to the framebuffer, empty rectangles are dropped
+    damage_add(&region, -10, -10, 5, 5);
+    damage_add(&region, 50, 50, 50, 60);
+    damage_add(&region, 200, 0, 300, 10);
+    REQUIRE(region.count == 1);
+    REQUIRE(damage_area(&region) == 25);
+
+    // Rectangles sharing rows merge, rectangles in other rows stay apart
+    damage_add(&region, 90, 2, 92, 4);
+    damage_add(&region, 10, 40, 20, 50);
+    REQUIRE(region.count == 2);
+    REQUIRE(region.rects[0].x0 == 0);
+    REQUIRE(region.rects[0].x1 == 92);
+    REQUIRE(region.rects[1].y0 == 40);
+
+    // A tall rectangle joins every band it crosses
+    damage_add(&region, 0, 4, 1, 41);
+    REQUIRE(region.count == 1);
+    REQUIRE(region.rects[0].y0 == 0);
+    REQUIRE(region.rects[0].y1 == 50);
+
+    damage_clear(&region);
+    REQUIRE(region.count == 0);
+    damage_add_all(&region);
+    REQUIRE(damage_area(&region) == 100 * 80);
+}
+
+TEST_CASE("Damage merges the closest rectangles when it has too many", "[damage]") {
+    damage_region region;
+    damage_init(&region, 64, 4 * (DAMAGE_MAX_RECTS + 8));
+    damage_region other;
+    damage_init(&other, region.width, region.height);
+
+    for (s32 i = 0; i < DAMAGE_MAX_RECTS + 8; ++i) {
+        damage_add(&region, i % 8, 4 * i, i % 8 + 2, 4 * i + 3);
+        damage_add(&other, 0, 4 * i, 1, 4 * i + 1);
+        REQUIRE(region.count <= DAMAGE_MAX_RECTS);
+    }
+    REQUIRE(region.count == DAMAGE_MAX_RECTS);
+
+    // Sorted, with no rows shared and nothing lost
+    for (u32 i = 0; i + 1 < region.count; ++i) REQUIRE(region.rects[i].y1 <= region.rects[i + 1].y0);
+    std::vector<u8> pixels = coverage(&region);
+    for (s32 i = 0; i < DAMAGE_MAX_RECTS + 8; ++i) {
+        for (s32 y = 4 * i; y < 4 * i + 3; ++y) {
+            REQUIRE(pixels[y * region.width + i % 8] == 1);
+            REQUIRE(pixels[y * region.width + i % 8 + 1] == 1);
+        }
+    }
+    REQUIRE(damage_area(&region) < (u64)region.width * region.height / 4);
+
+    damage_add_region(&region, &other);
+    pixels = coverage(&region);
+    for (s32 i = 0; i < DAMAGE_MAX_RECTS + 8; ++i) REQUIRE(pixels[4 * i * region.width] == 1);
+}
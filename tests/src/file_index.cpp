@@ -0,0 +1,271 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "file_index.h"
+
+static std::vector<u64>
+write_test_file(const char *path, u32 lines)
+{
+    std::string text;
+    std::vector<u64> line_starts = {0};
+    for (u32 i = 0; i < lines; ++i) {
+        text += "log line " + std::to_string(i) + std::string(i % 40, '.') + "\n";
+        line_starts.push_back(text.size());
+    }
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+    return line_starts;
+}
+
+TEST_CASE("File index answers from a partial index", "[file_index]") {
+    const char *path = "tests/file_index_partial.txt";
+    std::vector<u64> line_starts = write_test_file(path, 200000);
+    u64 size = line_starts.back();
+    REQUIRE(size > 4 * FILE_INDEX_SLICE_SIZE);
+
+    // Without a pool, indexing only advances when asked to
+    file_index index;
+    REQUIRE(file_index_open(&index, path, NULL));
+    REQUIRE(file_index_progress(&index) == 0.0f);
+
+    // The first screen is exact before anything is indexed
+    b32 exact;
+    for (u64 line = 0; line < 100; ++line) {
+        REQUIRE(file_index_line_start(&index, line, &exact) == line_starts[line]);
+        REQUIRE(exact);
+    }
+
+    REQUIRE(file_index_slice(&index));
+    REQUIRE(file_index_slice(&index));
+    REQUIRE(!file_index_done(&index));
+    f32 progress = file_index_progress(&index);
+    REQUIRE(progress > 0.0f);
+    REQUIRE(progress < 1.0f);
+
+    // Far lines are estimates, but still land on a line start nearby
+    u64 far_line = 150000;
+    u64 estimate = file_index_line_start(&index, far_line, &exact);
+    REQUIRE(!exact);
+    REQUIRE(std::find(line_starts.begin(), line_starts.end(), estimate) != line_starts.end());
+    u64 estimated_line = std::find(line_starts.begin(), line_starts.end(), estimate) - line_starts.begin();
+    REQUIRE(estimated_line > far_line * 9 / 10);
+    REQUIRE(estimated_line < far_line * 11 / 10);
+
+    u64 line_count = file_index_line_count(&index, &exact);
+    REQUIRE(!exact);
+    REQUIRE(line_count > 180000);
+    REQUIRE(line_count < 220000);
+
+    file_index_line_of(&index, size - 1, &exact);
+    REQUIRE(!exact);
+    REQUIRE(file_index_line_of(&index, line_starts[1000] + 3, &exact) == 1000);
+    REQUIRE(exact);
+
+    file_index_wait(&index);
+    REQUIRE(file_index_done(&index));
+    REQUIRE(file_index_progress(&index) == 1.0f);
+    REQUIRE(file_index_line_count(&index, &exact) == line_starts.size());
+    REQUIRE(exact);
+    for (u64 line = 0; line < line_starts.size(); line += 97) {
+        REQUIRE(file_index_line_start(&index, line, &exact) == line_starts[line]);
+        REQUIRE(exact);
+        REQUIRE(file_index_line_of(&index, line_starts[line], NULL) == line);
+    }
+
+    file_index_close(&index);
+    remove(path);
+}
+
+TEST_CASE("File index finds lines past the indexed part from one window per slice", "[file_index]") {
+    const char *path = "tests/file_index_window.txt";
+    std::vector<u64> line_starts = write_test_file(path, 200000);
+
+    file_index index;
+    REQUIRE(file_index_open(&index, path, NULL));
+    REQUIRE(file_index_slice(&index));
+
+    // Every line in the window past the indexed part is exact, and all of
+    // them come from the same window
+    b32 exact;
+    u64 first = index.lines.line_breaks + 1;
+    u64 line = first;
+    for (;; ++line) {
+        u64 start = file_index_line_start(&index, line, &exact);
+        if (!exact) break;
+        REQUIRE(start == line_starts[line]);
+        REQUIRE(index.window_scanned == index.lines.scanned);
+    }
+    u64 window_line_breaks = index.window.line_breaks;
+    REQUIRE(line - first >= window_line_breaks);
+    REQUIRE(window_line_breaks > 1000);
+
+    // The next slice moves the window along
+    REQUIRE(file_index_slice(&index));
+    REQUIRE(index.window_scanned != index.lines.scanned);
+    line = index.lines.line_breaks + 1;
+    REQUIRE(file_index_line_start(&index, line, &exact) == line_starts[line]);
+    REQUIRE(exact);
+    REQUIRE(index.window_scanned == index.lines.scanned);
+
+    file_index_close(&index);
+    remove(path);
+}
+
+TEST_CASE("File index builds in the background and can be closed early", "[file_index]") {
+    const char *path = "tests/file_index_background.txt";
+    std::vector<u64> line_starts = write_test_file(path, 100000);
+
+    thread_pool pool;
+    thread_pool_init(&pool, 2);
+
+    file_index index;
+    REQUIRE(file_index_open(&index, path, &pool));
+    file_index_wait(&index);
+    b32 exact;
+    REQUIRE(file_index_line_count(&index, &exact) == line_starts.size());
+    REQUIRE(exact);
+    REQUIRE(file_index_line_start(&index, 54321, NULL) == line_starts[54321]);
+    file_index_close(&index);
+
+    // Closing cancels indexing that is still running
+    for (u32 i = 0; i < 10; ++i) {
+        REQUIRE(file_index_open(&index, path, &pool));
+        file_index_close(&index);
+    }
+
+    thread_pool_free(&pool);
+    remove(path);
+}
+
+static void
+hold_worker(void *arg)
+{
+    std::atomic<b32> *released = (std::atomic<b32> *)arg;
+    while (!*released) {}
+}
+
+struct progress_probe {
+    file_index *index;
+    f32 progress;
+};
+
+static void
+record_progress(void *arg)
+{
+    progress_probe *probe = (progress_probe *)arg;
+    probe->progress = file_index_progress(probe->index);
+}
+
+TEST_CASE("File index does not hold a worker for the whole file", "[file_index]") {
+    const char *path = "tests/file_index_fair.txt";
+    u64 size = write_test_file(path, 100000).back();
+    REQUIRE(size > 2 * FILE_INDEX_SLICE_SIZE);
+
+    // With the only worker held, indexing is queued before the probe, which
+    // then runs after the first slice
+    thread_pool pool;
+    thread_pool_init(&pool, 1);
+    std::atomic<b32> released{false};
+    thread_pool_submit(&pool, NULL, hold_worker, &released);
+    file_index index;
+    REQUIRE(file_index_open(&index, path, &pool));
+    progress_probe probe = {&index, -1.0f};
+    thread_pool_group group = {};
+    thread_pool_submit(&pool, &group, record_progress, &probe);
+    released = true;
+    thread_pool_wait(&pool, &group);
+    REQUIRE(probe.progress == (f32)((f64)FILE_INDEX_SLICE_SIZE / (f64)size));
+
+    file_index_wait(&index);
+    REQUIRE(file_index_done(&index));
+    file_index_close(&index);
+    thread_pool_free(&pool);
+    remove(path);
+}
+
+TEST_CASE("File index checks UTF-8 once while indexing", "[file_index]") {
+    const char *path = "tests/file_index_utf8.txt";
+    // A multibyte sequence is split by every slice boundary
+    std::string text;
+    while (text.size() < 3 * FILE_INDEX_SLICE_SIZE) text += "caf\xC3\xA9 \xE2\x82\xAC\xF0\x9F\x98\x80\n";
+    u64 codepoints = 0;
+    for (char c : text) codepoints += ((u8)c & 0xC0) != 0x80;
+
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    file_index index;
+    REQUIRE(file_index_open(&index, path, NULL));
+    file_index_wait(&index);
+    b32 exact;
+    REQUIRE(file_index_codepoint_count(&index, &exact) == codepoints);
+    REQUIRE(exact);
+    REQUIRE(file_index_invalid_offset(&index) == FILE_INDEX_NONE);
+    file_index_close(&index);
+
+    // A stray continuation byte past the first slice
+    u64 invalid = 2 * FILE_INDEX_SLICE_SIZE + 5;
+    while (((u8)text[invalid] & 0xC0) == 0x80) ++invalid;
+    text[invalid] = (char)0x80;
+    file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    REQUIRE(file_index_open(&index, path, NULL));
+    REQUIRE(file_index_slice(&index));
+    REQUIRE(file_index_invalid_offset(&index) == FILE_INDEX_NONE);
+    file_index_wait(&index);
+    REQUIRE(file_index_invalid_offset(&index) == invalid);
+    file_index_close(&index);
+    remove(path);
+}
+
+static void
+count_notify(void *arg)
+{
+    ++*(u32 *)arg;
+}
+
+TEST_CASE("File index notifies after every slice", "[file_index]") {
+    const char *path = "tests/file_index_notify.txt";
+    u64 size = write_test_file(path, 100000).back();
+
+    file_index index;
+    REQUIRE(file_index_open(&index, path, NULL));
+    u32 notified = 0;
+    file_index_set_notify(&index, count_notify, &notified);
+    file_index_wait(&index);
+    REQUIRE(notified == (size + FILE_INDEX_SLICE_SIZE - 1) / FILE_INDEX_SLICE_SIZE);
+    REQUIRE(!file_index_slice(&index));
+    REQUIRE(notified == (size + FILE_INDEX_SLICE_SIZE - 1) / FILE_INDEX_SLICE_SIZE);
+    file_index_close(&index);
+    remove(path);
+}
+
+TEST_CASE("File index hands out lines without their line breaks", "[file_index]") {
+    const char *path = "tests/file_index_lines.txt";
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fputs("first\r\n\nthird\nlast", file);
+    fclose(file);
+
+    file_index index;
+    REQUIRE(file_index_open(&index, path, NULL));
+    std::vector<std::string> lines;
+    const u8 *text;
+    u32 length;
+    while (file_index_line_text(&index, lines.size(), &text, &length)) lines.emplace_back((const char *)text, length);
+    REQUIRE(lines == std::vector<std::string>{"first", "", "third", "last"});
+    file_index_close(&index);
+    remove(path);
+}
@@ -0,0 +1,190 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+
+#include "file_save.h"
+#include "test_random.h"
+
+static std::string
+read_file(const char *path)
+{
+    std::string contents;
+    FILE *file = fopen(path, "rb");
+    REQUIRE(file);
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) contents.append(buffer, read);
+    fclose(file);
+    return contents;
+}
+
+static void
+write_file(const char *path, const std::string &contents)
+{
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+}
+
+// Temporary files are made next to the target
+static u32
+leftover_temp_files(void)
+{
+    u32 count = 0;
+    DIR *directory = opendir("tests");
+    REQUIRE(directory);
+    while (struct dirent *entry = readdir(directory)) {
+        if (strstr(entry->d_name, ".save-")) ++count;
+    }
+    closedir(directory);
+    return count;
+}
+
+TEST_CASE("Saving writes the edited document over the file it maps", "[file_save]") {
+    const char *path = "tests/file_save.txt";
+    std::string contents;
+    for (u32 i = 0; i < 400000; ++i) contents += "line " + std::to_string(i) + "\n";
+    write_file(path, contents);
+    chmod(path, 0640);
+
+    piece_table table;
+    REQUIRE(piece_table_open(&table, path));
+    test_random random = {3};
+    for (u32 i = 0; i < 2000; ++i) {
+        u64 offset = random.next() % (contents.size() + 1);
+        piece_table_insert(&table, offset, (const u8 *)"edit", 4);
+        contents.insert(offset, "edit");
+        piece_table_erase(&table, offset / 2, 3);
+        contents.erase(offset / 2, 3);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, 2);
+    file_save save;
+    REQUIRE(file_save_start(&save, &table, path, &pool));
+    file_save_wait(&save);
+    REQUIRE(file_save_get_state(&save) == FILE_SAVE_DONE);
+    REQUIRE(file_save_progress(&save) == 1.0f);
+    file_save_close(&save);
+    thread_pool_free(&pool);
+
+    REQUIRE(read_file(path) == contents);
+    struct stat st;
+    REQUIRE(stat(path, &st) == 0);
+    REQUIRE((st.st_mode & 0777) == 0640);
+    REQUIRE(leftover_temp_files() == 0);
+
+    // The table still reads the old mapping, which the save left alone
+    std::string text(piece_table_length(&table), '\0');
+    piece_table_read(&table, 0, text.size(), (u8 *)text.data());
+    REQUIRE(text == contents);
+
+    piece_table_free(&table);
+    remove(path);
+}
+
+TEST_CASE("Saving writes the snapshot taken when it started", "[file_save]") {
+    const char *path = "tests/file_save_snapshot.txt";
+    write_file(path, "old contents\n");
+
+    // Several slices, so the save can be stopped half way
+    std::string contents;
+    while (contents.size() < 5 * FILE_SAVE_SLICE_SIZE / 2) contents += "a line of the new document\n";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)contents.data(), contents.size());
+
+    file_save save;
+    REQUIRE(file_save_start(&save, &table, path, NULL));
+    u32 notified = 0;
+    file_save_set_notify(&save, [](void *arg) { ++*(u32 *)arg; }, &notified);
+    REQUIRE(file_save_slice(&save));
+    REQUIRE(notified == 1);
+    REQUIRE(file_save_progress(&save) > 0.0f);
+    REQUIRE(file_save_progress(&save) < 1.0f);
+
+    // Edits after the start do not reach the file
+    piece_table_erase(&table, 0, contents.size() / 2);
+    piece_table_insert(&table, 10, (const u8 *)"later", 5);
+    REQUIRE(read_file(path) == "old contents\n");
+    REQUIRE(leftover_temp_files() == 1);
+    file_save_wait(&save);
+    REQUIRE(file_save_get_state(&save) == FILE_SAVE_DONE);
+    REQUIRE(notified == 3);
+    file_save_close(&save);
+    REQUIRE(read_file(path) == contents);
+
+    // Stopping a save part way leaves the file as it was
+    REQUIRE(file_save_start(&save, &table, path, NULL));
+    REQUIRE(file_save_slice(&save));
+    file_save_close(&save);
+    REQUIRE(read_file(path) == contents);
+    REQUIRE(leftover_temp_files() == 0);
+
+    piece_table_free(&table);
+    remove(path);
+}
+
+struct progress_probe {
+    file_save *save;
+    f32 progress;
+};
+
+TEST_CASE("Saving does not hold a worker for the whole document", "[file_save]") {
+    const char *path = "tests/file_save_fair.txt";
+    write_file(path, "old contents\n");
+    std::string contents;
+    while (contents.size() < 5 * FILE_SAVE_SLICE_SIZE / 2) contents += "a line of the new document\n";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)contents.data(), contents.size());
+
+    // With the only worker held, the save is queued before the probe, which
+    // then runs after the first slice
+    thread_pool pool;
+    thread_pool_init(&pool, 1);
+    std::atomic<b32> released{false};
+    thread_pool_submit(&pool, NULL, [](void *arg) { while (!*(std::atomic<b32> *)arg) {} }, &released);
+    file_save save;
+    REQUIRE(file_save_start(&save, &table, path, &pool));
+    progress_probe probe = {&save, -1.0f};
+    thread_pool_group group = {};
+    thread_pool_submit(&pool, &group, [](void *arg) {
+        progress_probe *probe = (progress_probe *)arg;
+        probe->progress = file_save_progress(probe->save);
+    }, &probe);
+    released = true;
+    thread_pool_wait(&pool, &group);
+    REQUIRE(probe.progress == (f32)((f64)FILE_SAVE_SLICE_SIZE / (f64)contents.size()));
+
+    file_save_wait(&save);
+    REQUIRE(file_save_get_state(&save) == FILE_SAVE_DONE);
+    file_save_close(&save);
+    REQUIRE(read_file(path) == contents);
+    thread_pool_free(&pool);
+    piece_table_free(&table);
+    remove(path);
+}
+
+TEST_CASE("Saving fails without touching anything when the file cannot be made", "[file_save]") {
+    piece_table table;
+    piece_table_init(&table, (const u8 *)"text", 4);
+    file_save save;
+    REQUIRE_FALSE(file_save_start(&save, &table, "tests/does_not_exist/file.txt", NULL));
+
+    // An empty document saves as an empty file
+    const char *path = "tests/file_save_empty.txt";
+    piece_table_erase(&table, 0, 4);
+    REQUIRE(file_save_start(&save, &table, path, NULL));
+    file_save_wait(&save);
+    REQUIRE(file_save_get_state(&save) == FILE_SAVE_DONE);
+    file_save_close(&save);
+    REQUIRE(read_file(path).empty());
+
+    piece_table_free(&table);
+    remove(path);
+}
@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "find.h"
+#include "raster_simd.h"
+#include "test_random.h"
+
+// Greedy scan, as a single pass from the left picks matches
+static std::vector<u64>
+reference_find_all(const std::string &text, const std::string &needle, u64 offset, u64 length)
+{
+    std::vector<u64> offsets;
+    std::string range = text.substr(offset, length);
+    u64 position = range.find(needle);
+    while (position != std::string::npos) {
+        offsets.push_back(offset + position);
+        position = range.find(needle, position + needle.size());
+    }
+    return offsets;
+}
+
+static std::vector<u64>
+run_find_all(const std::string &needle, const find_source *source, u64 offset, u64 length, thread_pool *pool)
+{
+    find_pattern pattern;
+    find_pattern_init(&pattern, (const u8 *)needle.data(), needle.size());
+    find_matches matches = {};
+    find_all(&pattern, source, offset, length, pool, &matches);
+    std::vector<u64> offsets(matches.offsets, matches.offsets + matches.count);
+    find_matches_free(&matches);
+    return offsets;
+}
+
+TEST_CASE("Find matches a reference search across chunks with every kernel", "[find]") {
+    test_random random = {7};
+
+    // Small alphabet, so that needles match often and overlap
+    const char *fragments[] = {"ab", "a", "b", "\n", "abab", "xyz", "Q", "aab"};
+    piece_table table;
+    piece_table_init(&table, nullptr, 0);
+    std::string text;
+    for (u32 i = 0; i < 3000; ++i) {
+        const char *fragment = fragments[random.next() % 8];
+        u64 offset = random.next() % (text.size() + 1);
+        piece_table_insert(&table, offset, (const u8 *)fragment, strlen(fragment));
+        text.insert(offset, fragment);
+    }
+    rope r;
+    rope_init(&r, (const u8 *)text.data(), text.size());
+    for (u32 i = 0; i < 200; ++i) {
+        u64 offset = random.next() % (text.size() + 1);
+        rope_insert(&r, offset, (const u8 *)"ab", 2);
+        rope_erase(&r, offset, 2);
+    }
+
+    find_source sources[] = {find_source_memory((const u8 *)text.data(), text.size()),
+                             find_source_piece_table(&table), find_source_rope(&r)};
+    std::vector<std::string> needles = {"a", "b", "ab", "aa", "aba", "abab", "\na", "xyz", "Qab",
+                                        "ababababab", "nothere", "b\nab"};
+    for (u32 i = 0; i < 20; ++i) {
+        u64 start = random.next() % (text.size() - 40);
+        needles.push_back(text.substr(start, random.next() % 40 + 1));
+    }
+
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+        for (const std::string &needle : needles) {
+            std::vector<u64> expected = reference_find_all(text, needle, 0, text.size());
+            for (const find_source &source : sources) {
+                REQUIRE(run_find_all(needle, &source, 0, text.size(), nullptr) == expected);
+
+                u64 offset = random.next() % text.size();
+                u64 length = random.next() % (text.size() - offset + 1);
+                REQUIRE(run_find_all(needle, &source, offset, length, nullptr) ==
+                        reference_find_all(text, needle, offset, length));
+
+                find_pattern pattern;
+                find_pattern_init(&pattern, (const u8 *)needle.data(), needle.size());
+                u64 match = 0;
+                b32 found = find_next(&pattern, &source, offset, &match);
+                u64 position = text.find(needle, offset);
+                REQUIRE(found == (position != std::string::npos));
+                if (found) REQUIRE(match == position);
+            }
+        }
+    }
+    raster_simd_set_level(best);
+
+    rope_free(&r);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Find splits long documents across the pool", "[find]") {
+    std::string line = "2024-01-01 12:00:00 INFO request served in 12ms\n";
+    std::string text;
+    test_random random = {3};
+    while (text.size() < 3 * FIND_PARALLEL_THRESHOLD / 2) {
+        u32 value = random.step();
+        text += (value >> 8) % 100 == 0 ? "2024-01-01 12:00:01 ERROR request failed\n" : line;
+        // Periodic text, where parts can start in the middle of a match
+        if ((value >> 8) % 5000 == 0) text += std::string((value >> 16) % 64 + 1, 'a');
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, 4);
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+    for (const std::string needle : {"ERROR", "12:00", "\n", "aa", "aaa", "request failed\n2024"}) {
+        std::vector<u64> expected = reference_find_all(text, needle, 0, text.size());
+        REQUIRE(run_find_all(needle, &source, 0, text.size(), &pool) == expected);
+    }
+
+    // Every part boundary falls inside a run of the needle's only byte
+    std::string runs(2 * FIND_PARALLEL_THRESHOLD + 3, 'a');
+    find_source runs_source = find_source_memory((const u8 *)runs.data(), runs.size());
+    REQUIRE(run_find_all("aaa", &runs_source, 1, runs.size() - 1, &pool) ==
+            reference_find_all(runs, "aaa", 1, runs.size() - 1));
+
+    thread_pool_free(&pool);
+}
+
+TEST_CASE("Find handles empty and oversized needles", "[find]") {
+    std::string text = "short";
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+    REQUIRE(run_find_all("", &source, 0, text.size(), nullptr).empty());
+    REQUIRE(run_find_all("longer than text", &source, 0, text.size(), nullptr).empty());
+    REQUIRE(run_find_all("short", &source, 0, text.size(), nullptr) == std::vector<u64>{0});
+    REQUIRE(run_find_all("short", &source, 1, 4, nullptr).empty());
+}
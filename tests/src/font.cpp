@@ -0,0 +1,82 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "font.h"
+
+TEST_CASE("Fonts loaded from the same file share one mapping", "[font]") {
+    font first, second;
+    REQUIRE(font_load(&first, "res/Roboto-Black.ttf", 0, MAPPED_FILE_RANDOM));
+    REQUIRE(font_load(&second, "res/../res/Roboto-Black.ttf", 0, 0));
+
+    REQUIRE(first.file == second.file);
+    REQUIRE(first.file->references == 2);
+    REQUIRE(first.info.data == second.info.data);
+    REQUIRE(stbtt_FindGlyphIndex(&second.info, 'A') != 0);
+
+    font_unload(&first);
+    REQUIRE(second.file->references == 1);
+    REQUIRE(stbtt_FindGlyphIndex(&second.info, 'A') != 0);
+    font_unload(&second);
+}
+
+TEST_CASE("Loading a missing or invalid font fails cleanly", "[font]") {
+    font missing;
+    REQUIRE(!font_load(&missing, "res/does-not-exist.ttf", 0, 0));
+    REQUIRE(missing.file == NULL);
+
+    font invalid;
+    REQUIRE(!font_load(&invalid, "LICENSE", 0, 0));
+    REQUIRE(invalid.file == NULL);
+}
+
+TEST_CASE("Mapped files expose the file contents", "[mapped_file]") {
+    mapped_file file;
+    REQUIRE(mapped_file_open(&file, "LICENSE", MAPPED_FILE_SEQUENTIAL | MAPPED_FILE_POPULATE));
+    REQUIRE(file.size > 0);
+    REQUIRE(file.data[0] == 'C');
+    mapped_file_advise(&file, 100, file.size, MAPPED_FILE_WILLNEED);
+    mapped_file_close(&file);
+    REQUIRE(file.data == NULL);
+}
+
+TEST_CASE("Flattened cmap agrees with stbtt_FindGlyphIndex", "[font]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    REQUIRE(roboto.cmap.glyph_count > 0);
+
+    u32 mismatches = 0;
+    u32 covered = 0;
+    for (u32 codepoint = 0; codepoint <= FONT_MAX_CODEPOINT; ++codepoint) {
+        s32 expected = stbtt_FindGlyphIndex(&roboto.info, codepoint);
+        if (font_glyph_index(&roboto, codepoint) != expected) ++mismatches;
+        if (font_has_codepoint(&roboto, codepoint) != (expected != 0)) ++mismatches;
+        if (expected) ++covered;
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(covered == roboto.cmap.glyph_count);
+    REQUIRE(font_glyph_index(&roboto, FONT_MAX_CODEPOINT + 1) == 0);
+
+    // Latin is covered, CJK is not
+    u32 text[] = { 'a', 0xE9, 'b', 0x4E2D, 'c' };
+    REQUIRE(font_covered_prefix(&roboto, text, 5) == 3);
+
+    font_unload(&roboto);
+}
+
+TEST_CASE("Kerning pairs are read once per font, in font units", "[font]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    const font_kerning *kerning = &roboto.kerning;
+    REQUIRE(kerning->class_count > 1);
+
+    for (u32 left = 0; left < FONT_KERNING_RANGE; ++left) {
+        for (u32 right = 0; right < FONT_KERNING_RANGE; ++right) {
+            u32 row = kerning->class_of[left];
+            u32 column = kerning->class_of[right];
+            s32 expected = stbtt_GetCodepointKernAdvance(&roboto.info, left, right);
+            REQUIRE(kerning->pairs[row * kerning->class_count + column] == expected);
+        }
+    }
+
+    font_unload(&roboto);
+    REQUIRE(roboto.kerning.pairs == NULL);
+}
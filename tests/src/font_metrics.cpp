@@ -0,0 +1,37 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "font_metrics.h"
+
+TEST_CASE("Precomputed metrics match per-call stb_truetype lookups", "[font_metrics]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 32.0f);
+    REQUIRE(metrics.kerning_class_count > 1);
+
+    f32 scale = stbtt_ScaleForPixelHeight(&roboto.info, 32.0f);
+    for (u32 left = 0; left < 300; ++left) {
+        s32 advance, left_side_bearing;
+        stbtt_GetCodepointHMetrics(&roboto.info, left, &advance, &left_side_bearing);
+        REQUIRE(font_metrics_advance(&metrics, left) == advance * scale);
+        REQUIRE(font_metrics_glyph_index(&metrics, left) == stbtt_FindGlyphIndex(&roboto.info, left));
+
+        for (u32 right = 0; right < 300; ++right) {
+            f32 expected = stbtt_GetCodepointKernAdvance(&roboto.info, left, right) * scale;
+            REQUIRE(font_metrics_kerning(&metrics, left, right) == expected);
+        }
+    }
+
+    // Other sizes scale the same kerning pairs
+    font_metrics smaller;
+    font_metrics_init(&smaller, &roboto, 16.0f);
+    REQUIRE(smaller.kerning_class_count == metrics.kerning_class_count);
+    f32 smaller_scale = stbtt_ScaleForPixelHeight(&roboto.info, 16.0f);
+    REQUIRE(font_metrics_kerning(&smaller, 'A', 'V') == stbtt_GetCodepointKernAdvance(&roboto.info, 'A', 'V') * smaller_scale);
+    REQUIRE(font_metrics_kerning(&smaller, 'A', 'V') != 0.0f);
+
+    font_metrics_free(&smaller);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
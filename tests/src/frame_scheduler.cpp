@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+
+#include "frame_scheduler.h"
+#include "thread_pool.h"
+
+static void
+count_wake(void *arg)
+{
+    ++*(std::atomic<u32> *)arg;
+}
+
+TEST_CASE("Frame scheduler sleeps until something is dirty", "[frame_scheduler]") {
+    std::atomic<u32> wakes{0};
+    frame_scheduler scheduler;
+    frame_scheduler_init(&scheduler, count_wake, &wakes);
+
+    // The first frame is due right away, then there is nothing to wait for
+    REQUIRE(frame_scheduler_timeout(&scheduler, 0.0) == 0.0);
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 0.0) != 0);
+    REQUIRE(frame_scheduler_timeout(&scheduler, 0.0) < 0.0);
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 1.0) == 0);
+
+    // Only the first of several marks wakes the loop
+    frame_scheduler_mark_dirty(&scheduler, FRAME_DIRTY_JOB);
+    frame_scheduler_mark_dirty(&scheduler, FRAME_DIRTY_JOB);
+    frame_scheduler_mark_dirty(&scheduler, FRAME_DIRTY_RESIZE);
+    REQUIRE(wakes == 1);
+    REQUIRE(frame_scheduler_timeout(&scheduler, 1.0) == 0.0);
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 1.0) == (FRAME_DIRTY_JOB | FRAME_DIRTY_RESIZE));
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 1.0) == 0);
+    frame_scheduler_mark_dirty(&scheduler, FRAME_DIRTY_JOB);
+    REQUIRE(wakes == 2);
+
+    frame_scheduler_free(&scheduler);
+}
+
+TEST_CASE("Cursor blinks after input and stops when idle", "[frame_scheduler]") {
+    frame_scheduler scheduler;
+    frame_scheduler_init(&scheduler, NULL, NULL);
+    frame_scheduler_begin_frame(&scheduler, 0.0);
+
+    frame_scheduler_input(&scheduler, 1.0);
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 1.0) == FRAME_DIRTY_INPUT);
+    REQUIRE(scheduler.cursor_visible);
+
+    // Woken for each blink, and only then
+    f64 now = 1.0;
+    u32 blinks = 0;
+    while (true) {
+        f64 timeout = frame_scheduler_timeout(&scheduler, now);
+        if (timeout < 0.0) break;
+        REQUIRE(timeout > 0.0);
+        REQUIRE(frame_scheduler_begin_frame(&scheduler, now + timeout / 2) == 0);
+        now += timeout;
+        u32 dirty = frame_scheduler_begin_frame(&scheduler, now);
+        if (dirty == 0) continue;
+        REQUIRE(dirty == FRAME_DIRTY_BLINK);
+        ++blinks;
+    }
+    REQUIRE(scheduler.cursor_visible);
+    REQUIRE(now >= 1.0 + FRAME_BLINK_TIMEOUT);
+    REQUIRE(now < 1.0 + FRAME_BLINK_TIMEOUT + 2 * FRAME_BLINK_INTERVAL);
+    REQUIRE(blinks >= (u32)(FRAME_BLINK_TIMEOUT / FRAME_BLINK_INTERVAL) - 1);
+
+    // A late wakeup blinks once rather than catching up
+    frame_scheduler_input(&scheduler, 100.0);
+    frame_scheduler_begin_frame(&scheduler, 100.0);
+    REQUIRE(frame_scheduler_begin_frame(&scheduler, 105.0) == FRAME_DIRTY_BLINK);
+    f64 timeout = frame_scheduler_timeout(&scheduler, 105.0);
+    REQUIRE(timeout > FRAME_BLINK_INTERVAL - 1e-9);
+    REQUIRE(timeout < FRAME_BLINK_INTERVAL + 1e-9);
+
+    frame_scheduler_free(&scheduler);
+}
+
+struct marking_job {
+    frame_scheduler *scheduler;
+};
+
+static void
+mark_many(void *arg)
+{
+    marking_job *job = (marking_job *)arg;
+    for (u32 i = 0; i < 10000; ++i) frame_scheduler_mark_dirty(job->scheduler, FRAME_DIRTY_JOB);
+}
+
+TEST_CASE("Workers wake the loop at most once per frame", "[frame_scheduler]") {
+    std::atomic<u32> wakes{0};
+    frame_scheduler scheduler;
+    frame_scheduler_init(&scheduler, count_wake, &wakes);
+    frame_scheduler_begin_frame(&scheduler, 0.0);
+
+    thread_pool pool;
+    thread_pool_init(&pool, 4);
+    marking_job job = {&scheduler};
+    for (u32 i = 0; i < 4; ++i) thread_pool_submit(&pool, NULL, mark_many, &job);
+    u32 frames = 0;
+    for (u32 i = 0; i < 1000; ++i) {
+        if (frame_scheduler_begin_frame(&scheduler, 0.0)) ++frames;
+    }
+    thread_pool_wait(&pool, NULL);
+    if (frame_scheduler_begin_frame(&scheduler, 0.0)) ++frames;
+    thread_pool_free(&pool);
+
+    REQUIRE(wakes >= 1);
+    REQUIRE(wakes <= frames);
+    REQUIRE(scheduler.wakeups == wakes);
+    frame_scheduler_free(&scheduler);
+}
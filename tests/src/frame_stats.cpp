@@ -0,0 +1,81 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include "frame_stats.h"
+
+TEST_CASE("Frame stats keep percentiles of the most recent frames", "[frame_stats]") {
+    frame_stats stats;
+    frame_stats_init(&stats);
+    REQUIRE(frame_stats_summarize(&stats, FRAME_STAGE_FRAME).count == 0);
+
+    // Frames of 1 to 100 ms, input in every tenth of them
+    for (u32 i = 1; i <= 100; ++i) {
+        frame_stats_begin_frame(&stats, 10.0);
+        if (i % 10 == 0) frame_stats_add(&stats, FRAME_STAGE_INPUT, 0.5);
+        frame_stats_add(&stats, FRAME_STAGE_COMPOSE, 0.001);
+        frame_stats_add(&stats, FRAME_STAGE_COMPOSE, 0.002);
+        frame_stats_add_glyph_misses(&stats, i == 50 ? 7 : 0);
+        frame_stats_end_frame(&stats, 10.0 + i * 0.001);
+    }
+    REQUIRE(stats.frames == 100);
+
+    frame_stats_summary frame = frame_stats_summarize(&stats, FRAME_STAGE_FRAME);
+    REQUIRE(frame.count == 100);
+    REQUIRE(frame.p50 > 0.0495);
+    REQUIRE(frame.p50 < 0.0505);
+    REQUIRE(frame.p95 > 0.0945);
+    REQUIRE(frame.p95 < 0.0955);
+    REQUIRE(frame.p99 > 0.0985);
+    REQUIRE(frame.p99 < 0.0995);
+    REQUIRE(frame.max > 0.0995);
+
+    // Stages only count the frames that ran them, time added up per frame
+    REQUIRE(frame_stats_summarize(&stats, FRAME_STAGE_INPUT).count == 10);
+    REQUIRE(frame_stats_summarize(&stats, FRAME_STAGE_PRESENT).count == 0);
+    frame_stats_summary compose = frame_stats_summarize(&stats, FRAME_STAGE_COMPOSE);
+    REQUIRE(compose.max > 0.00299);
+    REQUIRE(compose.max < 0.00301);
+
+    frame_stats_summary misses = frame_stats_summarize_glyph_misses(&stats);
+    REQUIRE(misses.p99 == 0.0);
+    REQUIRE(misses.max == 7.0);
+    REQUIRE(stats.total_glyph_misses == 7);
+
+    // Old frames fall out of the history
+    for (u32 i = 0; i < FRAME_STATS_HISTORY; ++i) {
+        frame_stats_begin_frame(&stats, 20.0);
+        frame_stats_end_frame(&stats, 20.0005);
+    }
+    frame = frame_stats_summarize(&stats, FRAME_STAGE_FRAME);
+    REQUIRE(frame.count == FRAME_STATS_HISTORY);
+    REQUIRE(frame.max < 0.001);
+    REQUIRE(frame_stats_summarize(&stats, FRAME_STAGE_INPUT).count == 10);
+}
+
+TEST_CASE("Frame stats are written as JSON", "[frame_stats]") {
+    frame_stats stats;
+    frame_stats_init(&stats);
+    frame_stats_begin_frame(&stats, 1.0);
+    frame_stats_add(&stats, FRAME_STAGE_LAYOUT, 0.25);
+    frame_stats_end_frame(&stats, 1.5);
+
+    const char *path = "tests/frame_stats.json";
+    REQUIRE(frame_stats_write_json(&stats, path));
+    std::string json;
+    FILE *file = fopen(path, "rb");
+    REQUIRE(file);
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) json.append(buffer, read);
+    fclose(file);
+    remove(path);
+
+    REQUIRE(json.find("\"frames\": 1,") != std::string::npos);
+    REQUIRE(json.find("\"layout\": {\"samples\": 1, \"p50_ms\": 250.0000") != std::string::npos);
+    REQUIRE(json.find("\"frame\": {\"samples\": 1, \"p50_ms\": 500.0000") != std::string::npos);
+    REQUIRE(json.find("\"input\": {\"samples\": 0,") != std::string::npos);
+    REQUIRE(json.find("\"glyph_misses\": {\"samples\": 1,") != std::string::npos);
+    REQUIRE(!frame_stats_write_json(&stats, "tests/missing/frame_stats.json"));
+}
@@ -0,0 +1,226 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "glyph_cache.h"
+
+static std::vector<unsigned char>
+read_font_file(const char *path)
+{
+    std::vector<unsigned char> data;
+    FILE *file = fopen(path, "rb");
+    if (!file) return data;
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    if (fread(data.data(), data.size(), 1, file) != 1) data.clear();
+    fclose(file);
+    return data;
+}
+
+TEST_CASE("Glyph cache serves repeated glyphs without rasterizing again", "[glyph_cache]") {
+    std::vector<unsigned char> font_data = read_font_file("res/Roboto-Black.ttf");
+    REQUIRE(!font_data.empty());
+
+    stbtt_fontinfo font;
+    REQUIRE(stbtt_InitFont(&font, font_data.data(), 0));
+
+    glyph_cache cache;
+    glyph_cache_init(&cache, 0, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    s32 glyph_index = stbtt_FindGlyphIndex(&font, 'g');
+    const cached_glyph *first = glyph_cache_get(&cache, &font, glyph_index, 32.0f, 0);
+    u8 *first_coverage = first->coverage;
+    REQUIRE(cache.misses == 1);
+    REQUIRE(first->width > 0);
+    REQUIRE(first->height > 0);
+
+    const cached_glyph *second = glyph_cache_get(&cache, &font, glyph_index, 32.0f, 0);
+    REQUIRE(cache.hits == 1);
+    REQUIRE(cache.misses == 1);
+    REQUIRE(second->coverage == first_coverage);
+
+    // Different size or subpixel phase is a different entry
+    glyph_cache_get(&cache, &font, glyph_index, 48.0f, 0);
+    glyph_cache_get(&cache, &font, glyph_index, 32.0f, 1);
+    REQUIRE(cache.misses == 3);
+    REQUIRE(cache.count == 3);
+
+    glyph_cache_free(&cache);
+}
+
+TEST_CASE("Glyph cache coverage matches direct rasterization", "[glyph_cache]") {
+    std::vector<unsigned char> font_data = read_font_file("res/Roboto-Black.ttf");
+    REQUIRE(!font_data.empty());
+
+    stbtt_fontinfo font;
+    REQUIRE(stbtt_InitFont(&font, font_data.data(), 0));
+
+    glyph_cache cache;
+    glyph_cache_init(&cache, 0, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    // Insert enough glyphs to force the table to grow
+    for (int codepoint = 32; codepoint < 127; ++codepoint) {
+        glyph_cache_get(&cache, &font, stbtt_FindGlyphIndex(&font, codepoint), 24.0f, 2);
+    }
+    REQUIRE(cache.count == 95);
+
+    f32 scale = stbtt_ScaleForPixelHeight(&font, 24.0f);
+    for (int codepoint = 33; codepoint < 127; ++codepoint) {
+        s32 glyph_index = stbtt_FindGlyphIndex(&font, codepoint);
+        const cached_glyph *glyph = glyph_cache_get(&cache, &font, glyph_index, 24.0f, 2);
+
+        s32 width, height, x_offset, y_offset;
+        unsigned char *expected = stbtt_GetGlyphBitmapSubpixel(&font, scale, scale, 0.5f, 0.0f, glyph_index,
+                                                               &width, &height, &x_offset, &y_offset);
+        REQUIRE(glyph->width == width);
+        REQUIRE(glyph->height == height);
+        REQUIRE(glyph->x_offset == x_offset);
+        REQUIRE(glyph->y_offset == y_offset);
+        for (s32 row = 0; row < height; ++row) {
+            REQUIRE(memcmp(glyph->coverage + row * glyph->stride, expected + row * width, width) == 0);
+        }
+        stbtt_FreeBitmap(expected, NULL);
+    }
+    REQUIRE(cache.misses == 95);
+
+    glyph_cache_free(&cache);
+}
+
+TEST_CASE("Subpixel phase quantizes the fractional pen position", "[glyph_cache]") {
+    REQUIRE(glyph_cache_subpixel_phase(10.0f) == 0);
+    REQUIRE(glyph_cache_subpixel_phase(10.3f) == 1);
+    REQUIRE(glyph_cache_subpixel_phase(10.5f) == 2);
+    REQUIRE(glyph_cache_subpixel_phase(10.99f) == 3);
+}
+
+TEST_CASE("Glyph atlas packs regions into shelves without overlap", "[glyph_atlas]") {
+    glyph_atlas atlas;
+    glyph_atlas_init(&atlas, 64, 64, 1, 2);
+
+    atlas_region regions[100];
+    u32 count = 0;
+    while (count < 100 && glyph_atlas_alloc(&atlas, 9, 9, 1, &regions[count])) ++count;
+
+    // 64 / (9 + 1) = 6 regions per row and 6 rows per page, on two pages
+    REQUIRE(count == 72);
+    REQUIRE(atlas.page_count == 2);
+    for (u32 i = 0; i < count; ++i) {
+        for (u32 j = i + 1; j < count; ++j) {
+            if (regions[i].page != regions[j].page) continue;
+            bool separate = regions[i].x + 9 < regions[j].x + 1 || regions[j].x + 9 < regions[i].x + 1 ||
+                regions[i].y + 9 < regions[j].y + 1 || regions[j].y + 9 < regions[i].y + 1;
+            REQUIRE(separate);
+        }
+    }
+
+    atlas_region region;
+    REQUIRE(!glyph_atlas_alloc(&atlas, 30, 30, 1, &region));
+    REQUIRE(!glyph_atlas_fits(&atlas, 64, 10));
+
+    glyph_atlas_touch(&atlas, 0, 5);
+    REQUIRE(glyph_atlas_lru_page(&atlas) == 1);
+    glyph_atlas_reset_page(&atlas, 1);
+    REQUIRE(glyph_atlas_alloc(&atlas, 30, 30, 6, &region));
+    REQUIRE(region.page == 1);
+
+    glyph_atlas_free(&atlas);
+}
+
+TEST_CASE("Glyph cache evicts least recently used atlas pages", "[glyph_cache]") {
+    std::vector<unsigned char> font_data = read_font_file("res/Roboto-Black.ttf");
+    REQUIRE(!font_data.empty());
+
+    stbtt_fontinfo font;
+    REQUIRE(stbtt_InitFont(&font, font_data.data(), 0));
+
+    // Two small pages hold far fewer glyphs than the printable ASCII range
+    glyph_cache cache;
+    glyph_cache_init(&cache, 0, 128, 2);
+
+    s32 hot_glyph = stbtt_FindGlyphIndex(&font, 'W');
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int codepoint = 33; codepoint < 127; ++codepoint) {
+            glyph_cache_begin_frame(&cache);
+            glyph_cache_get(&cache, &font, hot_glyph, 32.0f, 0);
+            glyph_cache_get(&cache, &font, stbtt_FindGlyphIndex(&font, codepoint), 32.0f, 0);
+        }
+    }
+    REQUIRE(cache.evictions > 0);
+    REQUIRE(cache.atlas.page_count == 2);
+
+    // The glyph used every frame is never evicted, and what is resident is intact
+    f32 scale = stbtt_ScaleForPixelHeight(&font, 32.0f);
+    u64 misses = cache.misses;
+    const cached_glyph *glyph = glyph_cache_get(&cache, &font, hot_glyph, 32.0f, 0);
+    REQUIRE(cache.misses == misses);
+
+    s32 width, height;
+    unsigned char *expected = stbtt_GetGlyphBitmap(&font, scale, scale, hot_glyph, &width, &height, NULL, NULL);
+    REQUIRE(glyph->width == width);
+    for (s32 row = 0; row < height; ++row) {
+        REQUIRE(memcmp(glyph->coverage + row * glyph->stride, expected + row * width, width) == 0);
+    }
+    stbtt_FreeBitmap(expected, NULL);
+
+    // Glyphs that do not fit an atlas page are still served
+    const cached_glyph *huge = glyph_cache_get(&cache, &font, hot_glyph, 400.0f, 0);
+    REQUIRE(huge->width > 128);
+    REQUIRE(huge->coverage != NULL);
+
+    glyph_cache_free(&cache);
+}
+
+TEST_CASE("Parallel warm-up rasterizes the same coverage as on-demand lookups", "[glyph_cache]") {
+    std::vector<unsigned char> font_data = read_font_file("res/Roboto-Black.ttf");
+    REQUIRE(!font_data.empty());
+
+    stbtt_fontinfo font;
+    REQUIRE(stbtt_InitFont(&font, font_data.data(), 0));
+
+    std::vector<s32> glyphs;
+    std::vector<u32> phases;
+    for (int codepoint = 32; codepoint < 127; ++codepoint) {
+        for (u32 phase = 0; phase < GLYPH_CACHE_SUBPIXEL_STEPS; ++phase) {
+            glyphs.push_back(stbtt_FindGlyphIndex(&font, codepoint));
+            phases.push_back(phase);
+        }
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, 4);
+
+    // A small atlas forces the warm-up to flush and evict part way through
+    for (u32 page_size : { 1024u, 128u }) {
+        glyph_cache warmed, reference;
+        glyph_cache_init(&warmed, 0, page_size, 2);
+        glyph_cache_init(&reference, 0, page_size, 2);
+
+        glyph_cache_warm(&warmed, &pool, &font, 28.0f, glyphs.data(), phases.data(), (u32)glyphs.size());
+        REQUIRE(warmed.misses == glyphs.size());
+
+        // Everything the warm-up kept resident matches a single threaded raster
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            u64 misses = warmed.misses;
+            const cached_glyph *glyph = glyph_cache_get(&warmed, &font, glyphs[i], 28.0f, phases[i]);
+            if (warmed.misses != misses) continue;
+            cached_glyph copy = *glyph;
+
+            const cached_glyph *expected = glyph_cache_get(&reference, &font, glyphs[i], 28.0f, phases[i]);
+            REQUIRE(copy.width == expected->width);
+            REQUIRE(copy.height == expected->height);
+            for (s32 row = 0; row < copy.height; ++row) {
+                REQUIRE(memcmp(copy.coverage + row * copy.stride, expected->coverage + row * expected->stride,
+                               copy.width) == 0);
+            }
+        }
+
+        glyph_cache_free(&warmed);
+        glyph_cache_free(&reference);
+    }
+
+    thread_pool_free(&pool);
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <vector>
+
+#include "compositor.h"
+#include "headless.h"
+#include "text_view.h"
+#include "stb/stb_image.h"
+
+static std::vector<u32>
+read_png(const char *path, s32 *width, s32 *height)
+{
+    s32 channels;
+    u8 *data = stbi_load(path, width, height, &channels, 4);
+    REQUIRE(data);
+    std::vector<u32> pixels((const u32 *)data, (const u32 *)data + *width * *height);
+    stbi_image_free(data);
+    return pixels;
+}
+
+TEST_CASE("Headless rendering writes the first screen of a file", "[headless]") {
+    const char *path = "tests/headless_text.txt";
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fputs("the quick brown fox\r\n\tjumps over\n\nthe lazy dog\n", file);
+    fclose(file);
+
+    headless_options options = {};
+    options.path = path;
+    options.out_path = "tests/headless_frame.png";
+    options.font_path = "res/Roboto-Black.ttf";
+    options.width = 300;
+    options.height = 100;
+    options.pixel_height = 16.0f;
+    options.foreground = COMPOSITOR_RGBA(255, 255, 255, 255);
+    options.background = COMPOSITOR_RGBA(0, 0, 0, 255);
+
+    // Rasterizing on the calling thread draws the same frame
+    std::vector<u32> frames[2];
+    thread_pool pool;
+    thread_pool_init(&pool, 2);
+    for (s32 pooled = 0; pooled < 2; ++pooled) {
+        headless_report report;
+        REQUIRE(headless_render(&options, pooled ? &pool : NULL, &report));
+        REQUIRE(report.lines == 4);
+        REQUIRE(report.glyphs == 41); // Spaces are glyphs, tabs and line breaks are not
+        REQUIRE(report.glyph_misses > 0);
+        REQUIRE(report.glyph_misses <= report.glyphs);
+
+        s32 width, height;
+        frames[pooled] = read_png(options.out_path, &width, &height);
+        REQUIRE(width == 300);
+        REQUIRE(height == 100);
+    }
+    thread_pool_free(&pool);
+    REQUIRE(frames[0] == frames[1]);
+
+    // Grey text on black, opaque
+    u32 lit = 0;
+    for (u32 pixel : frames[0]) {
+        u8 r = pixel & 0xFF;
+        REQUIRE(pixel == COMPOSITOR_RGBA(r, r, r, 255));
+        if (r) ++lit;
+    }
+    REQUIRE(lit > 0);
+
+    // The cursor is drawn over the composed frame in its own colour
+    options.cursor = COMPOSITOR_RGBA(255, 0, 0, 255);
+    headless_report cursor_report;
+    REQUIRE(headless_render(&options, NULL, &cursor_report));
+    s32 width, height;
+    std::vector<u32> with_cursor = read_png(options.out_path, &width, &height);
+    u32 changed = 0;
+    for (size_t i = 0; i < with_cursor.size(); ++i) {
+        if (with_cursor[i] == frames[0][i]) continue;
+        REQUIRE(with_cursor[i] == options.cursor);
+        REQUIRE((s32)(i % width) < TEXT_VIEW_CURSOR_WIDTH);
+        ++changed;
+    }
+    REQUIRE(changed > 0);
+    options.cursor = 0;
+
+    options.path = "tests/headless_missing.txt";
+    headless_report report;
+    REQUIRE(!headless_render(&options, NULL, &report));
+
+    remove(path);
+    remove("tests/headless_frame.png");
+}
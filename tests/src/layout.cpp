@@ -0,0 +1,219 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "layout.h"
+
+static const layout_line *
+get_line(layout_cache *cache, const font_metrics *metrics, u32 line_number, const char *text)
+{
+    return layout_cache_get(cache, metrics, 4, line_number, (const u8 *)text, (u32)strlen(text));
+}
+
+TEST_CASE("Line layout accumulates advances and kerning", "[layout]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 32.0f);
+
+    const char *text = "AVAV To, \xC3\xA9t\xC3\xA9 \xE2\x82\xAC";
+    layout_line line = {};
+    layout_line_build(&line, &metrics, 4, (const u8 *)text, (u32)strlen(text));
+
+    const u32 codepoints[] = {'A', 'V', 'A', 'V', ' ', 'T', 'o', ',', ' ', 0xE9, 't', 0xE9, ' ', 0x20AC};
+    const u32 offsets[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 14, 15};
+    REQUIRE(line.glyph_count == sizeof(codepoints) / sizeof(codepoints[0]));
+
+    f32 x = 0.0f;
+    for (u32 i = 0; i < line.glyph_count; ++i) {
+        if (i > 0) x += font_metrics_kerning(&metrics, codepoints[i - 1], codepoints[i]);
+        REQUIRE(line.glyphs[i].glyph_index == font_glyph_index(&roboto, codepoints[i]));
+        REQUIRE(line.glyphs[i].offset == offsets[i]);
+        REQUIRE(line.glyphs[i].x == x);
+        x += font_metrics_advance(&metrics, codepoints[i]);
+    }
+    REQUIRE(line.width == x);
+
+    // Tabs advance to the next stop and produce no glyph
+    f32 space = font_metrics_advance(&metrics, ' ');
+    layout_line_build(&line, &metrics, 4, (const u8 *)"\tx\ty", 4);
+    REQUIRE(line.glyph_count == 2);
+    REQUIRE(line.glyphs[0].x == 4 * space);
+    REQUIRE(line.glyphs[1].x == 8 * space);
+    REQUIRE(line.glyphs[1].offset == 3);
+
+    // Malformed UTF-8 lays out as one replacement glyph per bad byte
+    layout_line_build(&line, &metrics, 4, (const u8 *)"\xC3(\xE2\x82", 4);
+    REQUIRE(line.glyph_count == 4);
+    REQUIRE(line.glyphs[0].glyph_index == font_glyph_index(&roboto, 0xFFFD));
+    REQUIRE(line.glyphs[1].glyph_index == font_glyph_index(&roboto, '('));
+
+    layout_line_free(&line);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
+
+TEST_CASE("Layout cache reuses unchanged lines and relays out edited ones", "[layout]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 32.0f);
+
+    layout_cache cache;
+    layout_cache_init(&cache, 64);
+
+    std::vector<std::string> lines;
+    for (u32 i = 0; i < 20; ++i) {
+        lines.push_back("line number " + std::to_string(i));
+    }
+
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, i, lines[i].c_str());
+    REQUIRE(cache.misses == 20);
+
+    // Scrolling back over the same lines does no layout and no hashing
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, i, lines[i].c_str());
+    REQUIRE(cache.misses == 20);
+    REQUIRE(cache.line_hits == 20);
+
+    // Editing line 5 only lays out line 5 again
+    lines[5] = "edited";
+    layout_cache_edit(&cache, 5, 1, 1);
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, i, lines[i].c_str());
+    REQUIRE(cache.misses == 21);
+    REQUIRE(cache.line_hits == 39);
+
+    // Splitting line 10 in two renumbers the lines below it; the second half
+    // is new text, every moved line is still found by number.
+    lines[10] = "line";
+    lines.insert(lines.begin() + 11, " number 10");
+    layout_cache_edit(&cache, 10, 1, 2);
+    u64 line_hits = cache.line_hits;
+    for (u32 i = 0; i < lines.size(); ++i) {
+        const layout_line *line = get_line(&cache, &metrics, i, lines[i].c_str());
+        layout_line expected = {};
+        layout_line_build(&expected, &metrics, 4, (const u8 *)lines[i].c_str(), (u32)lines[i].size());
+        REQUIRE(line->glyph_count == expected.glyph_count);
+        REQUIRE(line->width == expected.width);
+        layout_line_free(&expected);
+    }
+    REQUIRE(cache.misses == 23);
+    REQUIRE(cache.line_hits == line_hits + 19);
+
+    // Joining lines back up removes one line
+    lines[10] = "line number 10";
+    lines.erase(lines.begin() + 11);
+    layout_cache_edit(&cache, 10, 2, 1);
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, i, lines[i].c_str());
+    // The joined line is found again by its contents
+    REQUIRE(cache.misses == 23);
+    REQUIRE(cache.hits == 1);
+
+    // Identical lines share a layout
+    const layout_line *a = get_line(&cache, &metrics, 100, "same");
+    const layout_line *b = get_line(&cache, &metrics, 101, "same");
+    REQUIRE(a == b);
+
+    // A different size is a different layout
+    font_metrics larger;
+    font_metrics_init(&larger, &roboto, 48.0f);
+    const layout_line *scaled = get_line(&cache, &larger, 0, lines[0].c_str());
+    REQUIRE(scaled->width > get_line(&cache, &metrics, 0, lines[0].c_str())->width);
+    font_metrics_free(&larger);
+
+    layout_cache_free(&cache);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
+
+TEST_CASE("Layout cache reuses the least recently used entries when full", "[layout]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 16.0f);
+
+    layout_cache cache;
+    layout_cache_init(&cache, 8);
+
+    std::vector<std::string> lines;
+    for (u32 i = 0; i < 100; ++i) lines.push_back(std::to_string(i * 7919));
+
+    for (u32 i = 0; i < lines.size(); ++i) {
+        const layout_line *line = get_line(&cache, &metrics, i, lines[i].c_str());
+        REQUIRE(line->glyph_count == lines[i].size());
+        // Keep line 0 hot
+        get_line(&cache, &metrics, 0, lines[0].c_str());
+    }
+    REQUIRE(cache.count == 8);
+    REQUIRE(cache.evictions == 100 - 8);
+
+    u64 misses = cache.misses;
+    get_line(&cache, &metrics, 0, lines[0].c_str());
+    get_line(&cache, &metrics, 99, lines[99].c_str());
+    REQUIRE(cache.misses == misses);
+    get_line(&cache, &metrics, 1, lines[1].c_str());
+    REQUIRE(cache.misses == misses + 1);
+
+    layout_cache_free(&cache);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
+
+TEST_CASE("Layout cache compares the bytes of lines with the same hash", "[layout]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 16.0f);
+
+    layout_cache cache;
+    layout_cache_init(&cache, 8);
+    get_line(&cache, &metrics, 0, "same hash");
+
+    // Stands in for a different line whose hash and length collide
+    cache.entries[cache.lines[0].entry].text[0] = 'S';
+    u64 misses = cache.misses;
+    const layout_line *line = get_line(&cache, &metrics, 1, "same hash");
+    REQUIRE(cache.misses == misses + 1);
+    REQUIRE(line->glyph_count == 9);
+    get_line(&cache, &metrics, 2, "same hash");
+    REQUIRE(cache.hits == 1);
+
+    layout_cache_free(&cache);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
+
+TEST_CASE("Layout cache finds lines by number anywhere in a long document", "[layout]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    font_metrics metrics;
+    font_metrics_init(&metrics, &roboto, 16.0f);
+
+    layout_cache cache;
+    layout_cache_init(&cache, 64);
+
+    // Past what 32 bits can number, without a table of every line before
+    u64 first = 5000000000ull;
+    std::vector<std::string> lines;
+    for (u32 i = 0; i < 40; ++i) lines.push_back("line " + std::to_string(first + i));
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, first + i, lines[i].c_str());
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, first + i, lines[i].c_str());
+    REQUIRE(cache.line_hits == 40);
+    REQUIRE(cache.line_capacity < 1u << 16);
+
+    // An edit above the lines renumbers them
+    layout_cache_edit(&cache, 10, 1, 3);
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, first + 2 + i, lines[i].c_str());
+    REQUIRE(cache.line_hits == 80);
+
+    // Scrolling far away and back finds the lines by their contents
+    get_line(&cache, &metrics, 0, "top");
+    u64 misses = cache.misses;
+    for (u32 i = 0; i < lines.size(); ++i) get_line(&cache, &metrics, first + 2 + i, lines[i].c_str());
+    REQUIRE(cache.misses == misses);
+
+    layout_cache_free(&cache);
+    font_metrics_free(&metrics);
+    font_unload(&roboto);
+}
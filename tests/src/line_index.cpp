@@ -0,0 +1,94 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <vector>
+
+#include "line_index.h"
+#include "raster_simd.h"
+#include "test_random.h"
+
+static std::string
+make_text(u32 lines, u32 seed)
+{
+    std::string text;
+    test_random random = {seed};
+    for (u32 i = 0; i < lines; ++i) {
+        // Mostly short lines, some empty and some longer than a vector
+        u32 value = random.step();
+        u32 length = (value >> 8) % 8 == 0 ? 0 : (value >> 12) % 150;
+        text.append(length, 'a' + i % 26);
+        text += '\n';
+    }
+    text += "no line break at the end";
+    return text;
+}
+
+TEST_CASE("Line index finds every line start with every kernel", "[line_index]") {
+    std::string text = make_text(20000, 3);
+    const u8 *data = (const u8 *)text.data();
+    std::vector<u64> line_starts = {0};
+    for (u64 i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') line_starts.push_back(i + 1);
+    }
+
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+
+        REQUIRE(line_index_count_line_breaks(data, text.size()) == line_starts.size() - 1);
+        REQUIRE(line_index_find_line_break(data, text.size(), 1) == line_starts[1]);
+        REQUIRE(line_index_find_line_break(data, text.size(), 1000) == line_starts[1000]);
+        REQUIRE(line_index_find_line_break(data, text.size(), line_starts.size()) == text.size());
+
+        // Appending in odd sized parts gives the same index as a single pass
+        line_index index;
+        line_index_init(&index);
+        for (u64 offset = 0; offset < text.size(); offset += 997) {
+            u64 length = text.size() - offset < 997 ? text.size() - offset : 997;
+            line_index_append(&index, data + offset, length);
+        }
+        REQUIRE(index.scanned == text.size());
+        REQUIRE(line_index_line_count(&index) == line_starts.size());
+
+        for (u64 line = 0; line < line_starts.size(); ++line) {
+            REQUIRE(line_index_line_start(&index, data, line) == line_starts[line]);
+        }
+        REQUIRE(line_index_line_start(&index, data, line_starts.size()) == text.size());
+
+        u64 line = 0;
+        for (u64 offset = 0; offset <= text.size(); offset += 7) {
+            while (line + 1 < line_starts.size() && line_starts[line + 1] <= offset) ++line;
+            REQUIRE(line_index_line_of(&index, data, offset) == line);
+        }
+        line_index_free(&index);
+    }
+    raster_simd_set_level(best);
+}
+
+TEST_CASE("Line index stays under 1% of the text", "[line_index]") {
+    // About 40 bytes per line, like typical source code or logs
+    std::string line = "2024-01-01 12:00:00 INFO request served\n";
+    std::string text;
+    for (u32 i = 0; i < 200000; ++i) text += line;
+
+    line_index index;
+    line_index_init(&index);
+    line_index_append(&index, (const u8 *)text.data(), text.size());
+    REQUIRE(line_index_line_count(&index) == 200001);
+    REQUIRE(line_index_memory(&index) * 100 < text.size());
+    REQUIRE(line_index_line_start(&index, (const u8 *)text.data(), 123457) == 123457 * line.size());
+
+    line_index_free(&index);
+}
+
+TEST_CASE("Line index handles text without line breaks", "[line_index]") {
+    std::string text(1000, 'x');
+    line_index index;
+    line_index_init(&index);
+    line_index_append(&index, (const u8 *)text.data(), text.size());
+    REQUIRE(line_index_line_count(&index) == 1);
+    REQUIRE(line_index_line_start(&index, (const u8 *)text.data(), 0) == 0);
+    REQUIRE(line_index_line_start(&index, (const u8 *)text.data(), 1) == text.size());
+    REQUIRE(line_index_line_of(&index, (const u8 *)text.data(), 999) == 0);
+    line_index_free(&index);
+}
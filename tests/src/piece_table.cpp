@@ -0,0 +1,217 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "piece_table.h"
+#include "test_random.h"
+
+static std::string
+read_all(const piece_table *table)
+{
+    std::string text(piece_table_length(table), '\0');
+    REQUIRE(piece_table_read(table, 0, text.size(), (u8 *)text.data()) == text.size());
+    return text;
+}
+
+static void
+require_lines_match(piece_table *table, const std::string &expected)
+{
+    std::vector<u64> line_starts = {0};
+    for (u64 i = 0; i < expected.size(); ++i) {
+        if (expected[i] == '\n') line_starts.push_back(i + 1);
+    }
+    REQUIRE(piece_table_line_count(table) == line_starts.size());
+
+    for (u64 line = 0; line < line_starts.size(); ++line) {
+        REQUIRE(piece_table_line_start(table, line) == line_starts[line]);
+    }
+    REQUIRE(piece_table_line_start(table, line_starts.size()) == expected.size());
+
+    u64 line = 0;
+    for (u64 offset = 0; offset <= expected.size(); ++offset) {
+        while (line + 1 < line_starts.size() && line_starts[line + 1] <= offset) ++line;
+        REQUIRE(piece_table_line_of(table, offset) == line);
+    }
+}
+
+TEST_CASE("Piece table edits match a reference string", "[piece_table]") {
+    const char *initial = "first line\nsecond line\n\nfourth";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)initial, strlen(initial));
+    std::string expected = initial;
+    require_lines_match(&table, expected);
+
+    test_random random = {1};
+    const char *fragments[] = {"x", "\n", "ab\ncd", "\n\n", "hello world", "\xE2\x82\xAC"};
+    for (u32 step = 0; step < 2000; ++step) {
+        u64 offset = random.next() % (expected.size() + 1);
+        if (random.next() % 3 != 0 || expected.empty()) {
+            const char *fragment = fragments[random.next() % 6];
+            piece_table_insert(&table, offset, (const u8 *)fragment, strlen(fragment));
+            expected.insert(offset, fragment);
+        } else {
+            u64 length = random.next() % 16;
+            piece_table_erase(&table, offset, length);
+            expected.erase(offset, length);
+        }
+        REQUIRE(piece_table_length(&table) == expected.size());
+        if (step % 100 == 0) {
+            REQUIRE(read_all(&table) == expected);
+            require_lines_match(&table, expected);
+        }
+    }
+    REQUIRE(read_all(&table) == expected);
+    require_lines_match(&table, expected);
+
+    // Reading part of the document crosses piece boundaries
+    std::string middle(100, '\0');
+    u64 copied = piece_table_read(&table, expected.size() / 3, 100, (u8 *)middle.data());
+    REQUIRE(middle.substr(0, copied) == expected.substr(expected.size() / 3, 100));
+
+    // Offsets past the end are clamped
+    piece_table_insert(&table, expected.size() + 50, (const u8 *)"!", 1);
+    expected += "!";
+    piece_table_erase(&table, expected.size() + 10, 5);
+    REQUIRE(read_all(&table) == expected);
+
+    piece_table_free(&table);
+}
+
+struct erased_text {
+    std::vector<std::string> edits;
+};
+
+static void
+collect_erased(u64 edit, const u8 *data, u64 length, void *arg)
+{
+    ((erased_text *)arg)->edits[edit].append((const char *)data, length);
+}
+
+TEST_CASE("Batched edits match applying them one by one", "[piece_table]") {
+    test_random random = {5};
+    const char *fragments[] = {"", "x", "\n", "ab\ncd", "hello world"};
+
+    // A fresh table is rebuilt in one pass, a fragmented one is edited in
+    // place where the batch touches it
+    for (u32 fragmented = 0; fragmented < 2; ++fragmented) {
+        std::string expected;
+        for (u32 i = 0; i < 2000; ++i) expected += "line " + std::to_string(i) + "\n";
+        piece_table table;
+        piece_table_init(&table, (const u8 *)expected.data(), expected.size());
+        if (fragmented) {
+            for (u32 i = 0; i < 3000; ++i) {
+                u64 offset = random.next() % (expected.size() + 1);
+                piece_table_insert(&table, offset, (const u8 *)"y", 1);
+                expected.insert(offset, "y");
+            }
+        }
+
+        for (u32 round = 0; round < 20; ++round) {
+            u32 count = fragmented ? 1 + random.next() % 8 : 1 + random.next() % 500;
+            std::vector<piece_edit> edits;
+            std::vector<piece_span> spans(count);
+            std::vector<std::string> removed;
+            u64 offset = 0;
+            for (u32 i = 0; i < count && offset <= expected.size(); ++i) {
+                offset += random.next() % (2 * expected.size() / count + 1);
+                if (offset > expected.size()) break;
+                u64 length = random.next() % 4 == 0 ? 0 : random.next() % 12;
+                length = std::min<u64>(length, expected.size() - offset);
+                const char *fragment = fragments[random.next() % 5];
+                spans[i] = {piece_table_add_text(&table, (const u8 *)fragment, strlen(fragment)), strlen(fragment)};
+                edits.push_back({offset, length, &spans[i], strlen(fragment) > 0});
+                removed.push_back(expected.substr(offset, length));
+                offset += length;
+            }
+
+            erased_text erased;
+            erased.edits.resize(edits.size());
+            piece_table_apply(&table, edits.data(), edits.size(), collect_erased, &erased);
+            REQUIRE(erased.edits == removed);
+            for (u64 i = edits.size(); i-- > 0;) {
+                expected.replace(edits[i].offset, edits[i].length, (const char *)spans[i].data, spans[i].length);
+            }
+            REQUIRE(read_all(&table) == expected);
+        }
+        require_lines_match(&table, expected);
+        piece_table_free(&table);
+    }
+}
+
+TEST_CASE("Typing extends a single piece", "[piece_table]") {
+    piece_table table;
+    piece_table_init(&table, (const u8 *)"ab", 2);
+    u32 nodes = table.node_count;
+
+    const char *typed = "typing a run of text\n";
+    for (u64 i = 0; i < strlen(typed); ++i) {
+        piece_table_insert(&table, 1 + i, (const u8 *)&typed[i], 1);
+    }
+    REQUIRE(read_all(&table) == "atyping a run of text\nb");
+    // The first piece was split in two and the typed text became one more
+    REQUIRE(table.node_count == nodes + 2);
+    REQUIRE(piece_table_line_count(&table) == 2);
+
+    piece_table_free(&table);
+}
+
+TEST_CASE("Piece table opens a mapped file without copying it", "[piece_table]") {
+    const char *path = "tests/piece_table_open.txt";
+    std::string contents;
+    for (u32 i = 0; i < 20000; ++i) {
+        contents += "line " + std::to_string(i) + (i % 7 == 0 ? "\n\n" : "\n");
+    }
+    FILE *file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+
+    piece_table table;
+    REQUIRE(piece_table_open(&table, path));
+    REQUIRE(table.add_block_count == 0);
+    REQUIRE(piece_table_length(&table) == contents.size());
+    REQUIRE(table.piece_count > 1);
+
+    // Nothing is counted until a lookup needs it, and then only the pieces
+    // before the line
+    REQUIRE(table.nodes[table.root].subtree_line_breaks == PIECE_LINE_BREAKS_UNKNOWN);
+    REQUIRE(piece_table_line_start(&table, 3) == contents.find("line 2\n"));
+    REQUIRE(piece_table_line_of(&table, 10) == 2);
+    REQUIRE(table.nodes[table.root].subtree_line_breaks == PIECE_LINE_BREAKS_UNKNOWN);
+    require_lines_match(&table, contents);
+    REQUIRE(!piece_table_count_lines(&table));
+
+    // Edits cut pieces that were never counted
+    piece_table_free(&table);
+    REQUIRE(piece_table_open(&table, path));
+    std::string edited = contents;
+    piece_table_erase(&table, 70000, 1000);
+    edited.erase(70000, 1000);
+    piece_table_insert(&table, 140000, (const u8 *)"\n\n", 2);
+    edited.insert(140000, "\n\n");
+    u32 counted = 0;
+    while (piece_table_count_lines(&table)) ++counted;
+    REQUIRE(counted > 0);
+    require_lines_match(&table, edited);
+    piece_table_free(&table);
+    REQUIRE(piece_table_open(&table, path));
+
+    // Edits go to the add buffer, the mapping is untouched
+    std::string original = contents;
+    piece_table_erase(&table, 100, 200000);
+    contents.erase(100, 200000);
+    piece_table_insert(&table, 50, (const u8 *)"inserted\n", 9);
+    contents.insert(50, "inserted\n");
+    REQUIRE(read_all(&table) == contents);
+    require_lines_match(&table, contents);
+    REQUIRE(memcmp(table.file.data, original.data(), original.size()) == 0);
+
+    piece_table_free(&table);
+    remove(path);
+
+    REQUIRE_FALSE(piece_table_open(&table, "tests/does_not_exist.txt"));
+}
@@ -0,0 +1,85 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include "font.h"
+#include "raster_simd.h"
+#include "test_random.h"
+
+static void
+fill_scanline(std::vector<f32> &coverage, std::vector<f32> &deltas, u32 seed)
+{
+    test_random random = {seed};
+    for (size_t i = 0; i < coverage.size(); ++i) {
+        coverage[i] = ((s32)(random.next() % 2001) - 1000) / 4000.0f;
+    }
+    // Deltas that open and close spans, like the edges of a glyph do
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        deltas[i] = (random.next() % 8 == 0) ? ((s32)(random.next() % 2001) - 1000) / 1000.0f : 0.0f;
+    }
+}
+
+TEST_CASE("Vectorized scanline accumulation matches the scalar loop", "[raster_simd]") {
+    raster_simd_level best = raster_simd_detect();
+
+    for (s32 width = 1; width < 300; width += 7) {
+        std::vector<f32> coverage(width), deltas(width + 1);
+        fill_scanline(coverage, deltas, width);
+        std::vector<f32> reference_coverage = coverage, reference_deltas = deltas;
+        std::vector<u8> expected(width);
+        raster_accumulate_scanline_scalar(expected.data(), reference_coverage.data(), reference_deltas.data(), width);
+
+        for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+            raster_simd_set_level((raster_simd_level)level);
+            for (int exact = 0; exact < 2; ++exact) {
+                raster_simd_set_bit_exact(exact);
+
+                std::vector<f32> c = coverage, d = deltas;
+                std::vector<u8> pixels(width);
+                raster_accumulate_scanline(pixels.data(), c.data(), d.data(), width);
+
+                for (s32 i = 0; i < width; ++i) {
+                    s32 difference = abs((s32)pixels[i] - (s32)expected[i]);
+                    REQUIRE(difference <= (exact ? 0 : 1));
+                    REQUIRE(c[i] == 0.0f);
+                    REQUIRE(d[i] == 0.0f);
+                }
+                REQUIRE(d[width] == 0.0f);
+            }
+        }
+    }
+
+    raster_simd_set_level(best);
+    raster_simd_set_bit_exact(false);
+}
+
+TEST_CASE("Bit-exact mode rasterizes large glyphs identically to scalar", "[raster_simd]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+    raster_simd_level best = raster_simd_detect();
+    f32 scale = stbtt_ScaleForPixelHeight(&roboto.info, 144.0f);
+
+    for (u32 codepoint = 'A'; codepoint <= 'z'; ++codepoint) {
+        s32 glyph = font_glyph_index(&roboto, codepoint);
+
+        raster_simd_set_level(RASTER_SIMD_SCALAR);
+        s32 width, height;
+        unsigned char *expected = stbtt_GetGlyphBitmap(&roboto.info, scale, scale, glyph, &width, &height, NULL, NULL);
+
+        raster_simd_set_level(best);
+        raster_simd_set_bit_exact(true);
+        s32 simd_width, simd_height;
+        unsigned char *actual = stbtt_GetGlyphBitmap(&roboto.info, scale, scale, glyph, &simd_width, &simd_height, NULL, NULL);
+
+        REQUIRE(width == simd_width);
+        REQUIRE(height == simd_height);
+        REQUIRE(memcmp(expected, actual, (size_t)width * height) == 0);
+
+        stbtt_FreeBitmap(expected, NULL);
+        stbtt_FreeBitmap(actual, NULL);
+    }
+
+    raster_simd_set_bit_exact(false);
+    font_unload(&roboto);
+}
@@ -0,0 +1,176 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "regex_dfa.h"
+#include "test_random.h"
+
+typedef std::vector<std::pair<u64, u64>> match_list;
+
+static b32
+collect_match(u64 start, u64 end, void *arg)
+{
+    ((match_list *)arg)->push_back({start, end});
+    return true;
+}
+
+static match_list
+search_all(const char *pattern, const find_source *source, u32 flags = 0, u64 cache_size = REGEX_DEFAULT_CACHE_SIZE)
+{
+    regex re;
+    REQUIRE(regex_compile(&re, (const u8 *)pattern, strlen(pattern), flags, cache_size));
+    match_list matches;
+    regex_search(&re, source, 0, source->length, collect_match, &matches);
+    regex_free(&re);
+    return matches;
+}
+
+// std::regex backtracks, which is fine for short text and gives the same
+// leftmost-first matches for patterns that cannot match empty
+static match_list
+reference_search(const char *pattern, const std::string &text)
+{
+    std::regex re(pattern, std::regex::ECMAScript | std::regex::multiline);
+    match_list matches;
+    u64 position = 0;
+    std::smatch match;
+    while (position <= text.size() &&
+           std::regex_search(text.begin() + position, text.end(), match, re,
+                             position > 0 ? std::regex_constants::match_prev_avail
+                                          : std::regex_constants::match_default)) {
+        u64 start = position + match.position(0);
+        u64 end = start + match.length(0);
+        matches.push_back({start, end});
+        position = end;
+    }
+    return matches;
+}
+
+TEST_CASE("Regex matches agree with a backtracking engine across chunks", "[regex]") {
+    test_random random = {9};
+    const char *fragments[] = {"a", "b", "ab", "c", "x", "y", "\n", "  ", "42", "foo@bar", "aab", "_"};
+    piece_table table;
+    piece_table_init(&table, nullptr, 0);
+    std::string text;
+    for (u32 i = 0; i < 1500; ++i) {
+        const char *fragment = fragments[random.next() % 12];
+        u64 offset = random.next() % (text.size() + 1);
+        piece_table_insert(&table, offset, (const u8 *)fragment, strlen(fragment));
+        text.insert(offset, fragment);
+    }
+    find_source sources[] = {find_source_memory((const u8 *)text.data(), text.size()),
+                             find_source_piece_table(&table)};
+
+    const char *patterns[] = {"ab", "a|ab", "ab|a", "a+b", "(ab)+", "[a-c]+x", "^a", "b$", "^ab?$", "a.c",
+                              "\\d+", "\\w+@\\w+", "x(a|b)*?y", "x(a|b)*y", "a{2,3}", "(a|b){3}", "[^\\n]+$",
+                              "^[^a]*$\\n", "\\s+", "\\S+\\s\\S", "(?:ab|ba)+?b", "y|x\\n|\\n\\n", "a.*b",
+                              "a.*?b", "[xy][^xy]{4}[xy]", "(a+)+b", "_\\W", "b(a|$)"};
+    for (const char *pattern : patterns) {
+        match_list expected = reference_search(pattern, text);
+        for (const find_source &source : sources) {
+            INFO(pattern);
+            REQUIRE(search_all(pattern, &source) == expected);
+        }
+    }
+    piece_table_free(&table);
+}
+
+TEST_CASE("Regex matches whole UTF-8 codepoints", "[regex]") {
+    std::string text = "caf\xC3\xA9 \xCE\xB1\xCE\xB2\xCE\xB3 \xE2\x82\xAC" "5 \xF0\x9F\x98\x80!";
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+
+    REQUIRE(search_all("f.", &source) == match_list{{2, 5}});
+    REQUIRE(search_all("[\xCE\xB1-\xCF\x89]+", &source) == match_list{{6, 12}});
+    REQUIRE(search_all("\xE2\x82\xAC\\d", &source) == match_list{{13, 17}});
+    REQUIRE(search_all("[^ a-z!0-9]", &source) == match_list{{3, 5}, {6, 8}, {8, 10}, {10, 12}, {13, 16}, {18, 22}});
+    REQUIRE(search_all("\\x{1F600}", &source) == match_list{{18, 22}});
+    REQUIRE(search_all(" .!", &source) == match_list{{17, 23}});
+}
+
+TEST_CASE("Regex handles empty matches, case folding and early stops", "[regex]") {
+    std::string text = "ab\nAB\n";
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+    REQUIRE(search_all("a*", &source) == match_list{{0, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}, {6, 6}});
+    REQUIRE(search_all("^", &source) == match_list{{0, 0}, {3, 3}, {6, 6}});
+    REQUIRE(search_all("$", &source) == match_list{{2, 2}, {5, 5}, {6, 6}});
+    REQUIRE(search_all("ab", &source, REGEX_IGNORE_CASE) == match_list{{0, 2}, {3, 5}});
+    REQUIRE(search_all("[^a]b", &source, REGEX_IGNORE_CASE).empty());
+
+    regex re;
+    REQUIRE(regex_compile(&re, (const u8 *)"b", 1, 0, REGEX_DEFAULT_CACHE_SIZE));
+    u64 start = 0, end = 0;
+    REQUIRE(regex_find_next(&re, &source, 2, &start, &end) == false);
+    regex_free(&re);
+    REQUIRE(regex_compile(&re, (const u8 *)"b", 1, REGEX_IGNORE_CASE, REGEX_DEFAULT_CACHE_SIZE));
+    REQUIRE(regex_find_next(&re, &source, 2, &start, &end));
+    REQUIRE(start == 4);
+    REQUIRE(end == 5);
+    regex_free(&re);
+
+    // Matches are reported as found, and the search stops when asked to
+    std::string lines;
+    for (u32 i = 0; i < 1000; ++i) lines += "line " + std::to_string(i) + "\n";
+    find_source lines_source = find_source_memory((const u8 *)lines.data(), lines.size());
+    REQUIRE(regex_compile(&re, (const u8 *)"\\d+", 3, 0, REGEX_DEFAULT_CACHE_SIZE));
+    u32 calls = 0;
+    regex_search(&re, &lines_source, 0, lines.size(), [](u64, u64, void *arg) -> b32 {
+        return ++*(u32 *)arg < 3;
+    }, &calls);
+    REQUIRE(calls == 3);
+    regex_free(&re);
+}
+
+TEST_CASE("Regex state cache stays within its budget", "[regex]") {
+    // The n-th byte from the end decides a match, which needs 2^n DFA states
+    std::string text;
+    test_random random = {1};
+    for (u32 i = 0; i < 200000; ++i) {
+        text += (random.step() >> 16) & 1 ? 'a' : 'b';
+        if (i % 97 == 96) text += '\n';
+    }
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+    const char *pattern = "[ab]*a[ab]{12}$";
+    match_list expected;
+    u64 line_start = 0;
+    for (u64 i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && text[i] != '\n') continue;
+        if (i - line_start >= 13 && text[i - 13] == 'a') expected.push_back({line_start, i});
+        line_start = i + 1;
+    }
+    REQUIRE(search_all(pattern, &source) == expected);
+
+    regex re;
+    REQUIRE(regex_compile(&re, (const u8 *)pattern, strlen(pattern), 0, 64 * 1024));
+    match_list matches;
+    regex_search(&re, &source, 0, text.size(), collect_match, &matches);
+    REQUIRE(matches == expected);
+    REQUIRE(re.forward_dfa.clears > 0);
+    regex_free(&re);
+}
+
+TEST_CASE("Regex runs in linear time on patterns that make backtracking explode", "[regex]") {
+    std::string text(200000, 'a');
+    find_source source = find_source_memory((const u8 *)text.data(), text.size());
+    REQUIRE(search_all("(a*)*b", &source).empty());
+    REQUIRE(search_all("(a|aa)+$", &source) == match_list{{0, text.size()}});
+    REQUIRE(search_all("(x+x+)+y|a{1000}$", &source) == match_list{{text.size() - 1000, text.size()}});
+}
+
+TEST_CASE("Malformed patterns are rejected with a position", "[regex]") {
+    struct {
+        const char *pattern;
+        u64 offset;
+    } cases[] = {{"(ab", 3}, {"ab)", 2}, {"*a", 0}, {"[ab", 3}, {"a{3,2}", 6}, {"\\q", 1}, {"a{2000}", 6},
+                 {"[z-a]", 4}, {"\xFF", 0}, {"a\\", 2}};
+    for (const auto &c : cases) {
+        regex re;
+        INFO(c.pattern);
+        REQUIRE(!regex_compile(&re, (const u8 *)c.pattern, strlen(c.pattern), 0, REGEX_DEFAULT_CACHE_SIZE));
+        REQUIRE(re.error != nullptr);
+        REQUIRE(re.error_offset == c.offset);
+    }
+}
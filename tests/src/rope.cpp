@@ -0,0 +1,186 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "rope.h"
+#include "test_random.h"
+
+static std::string
+read_all(const rope *r)
+{
+    std::string text(rope_length(r), '\0');
+    REQUIRE(rope_read(r, 0, text.size(), (u8 *)text.data()) == text.size());
+    return text;
+}
+
+static u64
+count_codepoints(const std::string &text, u64 end)
+{
+    u64 count = 0;
+    for (u64 i = 0; i < end; ++i) count += ((u8)text[i] & 0xC0) != 0x80;
+    return count;
+}
+
+static void
+require_metrics_match(const rope *r, const std::string &expected)
+{
+    rope_metrics metrics = rope_get_metrics(r);
+    REQUIRE(metrics.bytes == expected.size());
+    REQUIRE(metrics.codepoints == count_codepoints(expected, expected.size()));
+
+    std::vector<u64> line_starts = {0};
+    for (u64 i = 0; i < expected.size(); ++i) {
+        if (expected[i] == '\n') line_starts.push_back(i + 1);
+    }
+    REQUIRE(rope_line_count(r) == line_starts.size());
+    for (u64 line = 0; line < line_starts.size(); ++line) {
+        REQUIRE(rope_line_start(r, line) == line_starts[line]);
+    }
+
+    // Sampled, every offset would make this quadratic
+    u64 step = expected.size() / 200 + 1;
+    for (u64 offset = 0; offset <= expected.size(); offset += step) {
+        u64 line = 0;
+        while (line + 1 < line_starts.size() && line_starts[line + 1] <= offset) ++line;
+        rope_metrics before = rope_metrics_before(r, offset);
+        REQUIRE(before.bytes == offset);
+        REQUIRE(before.line_breaks == line);
+        REQUIRE(before.codepoints == count_codepoints(expected, offset));
+    }
+}
+
+TEST_CASE("Rope edits match a reference string", "[rope]") {
+    std::string expected;
+    for (u32 i = 0; i < 3000; ++i) {
+        expected += "line " + std::to_string(i) + (i % 5 == 0 ? " \xC3\xA9t\xC3\xA9\n" : "\n");
+    }
+    rope r;
+    rope_init(&r, (const u8 *)expected.data(), expected.size());
+    REQUIRE(read_all(&r) == expected);
+    require_metrics_match(&r, expected);
+
+    test_random random = {7};
+    const char *fragments[] = {"x", "\n", "ab\ncd", "\xE2\x82\xAC", "hello world"};
+    for (u32 step = 0; step < 3000; ++step) {
+        u64 offset = random.next() % (expected.size() + 1);
+        u32 choice = random.next() % 8;
+        if (choice < 4) {
+            const char *fragment = fragments[random.next() % 5];
+            rope_insert(&r, offset, (const u8 *)fragment, strlen(fragment));
+            expected.insert(offset, fragment);
+        } else if (choice < 7) {
+            u64 length = random.next() % 64;
+            rope_erase(&r, offset, length);
+            expected.erase(offset, length);
+        } else {
+            // Large edits span many chunks and rebalance the tree
+            if (random.next() % 2) {
+                std::string block(random.next() % 5000, 'z');
+                for (u64 i = 0; i < block.size(); i += 37) block[i] = '\n';
+                rope_insert(&r, offset, (const u8 *)block.data(), block.size());
+                expected.insert(offset, block);
+            } else {
+                u64 length = random.next() % 5000;
+                rope_erase(&r, offset, length);
+                expected.erase(offset, length);
+            }
+        }
+        REQUIRE(rope_length(&r) == expected.size());
+        if (step % 250 == 0) {
+            REQUIRE(read_all(&r) == expected);
+            require_metrics_match(&r, expected);
+        }
+    }
+    REQUIRE(read_all(&r) == expected);
+    require_metrics_match(&r, expected);
+
+    // Erasing everything leaves an empty rope that can grow again
+    rope_erase(&r, 0, rope_length(&r));
+    REQUIRE(rope_length(&r) == 0);
+    REQUIRE(rope_line_count(&r) == 1);
+    rope_insert(&r, 10, (const u8 *)"again\n", 6);
+    REQUIRE(read_all(&r) == "again\n");
+
+    rope_free(&r);
+}
+
+TEST_CASE("Rope converts between offsets and lines with codepoint columns", "[rope]") {
+    const char *text = "ab\n\xC3\xA9\xE2\x82\xAC" "cd\n\nlast";
+    rope r;
+    rope_init(&r, (const u8 *)text, strlen(text));
+
+    u64 line, column;
+    rope_line_column(&r, 0, &line, &column);
+    REQUIRE((line == 0 && column == 0));
+    rope_line_column(&r, 2, &line, &column);
+    REQUIRE((line == 0 && column == 2));
+    rope_line_column(&r, 8, &line, &column);
+    REQUIRE((line == 1 && column == 2));
+    rope_line_column(&r, strlen(text), &line, &column);
+    REQUIRE((line == 3 && column == 4));
+
+    REQUIRE(rope_offset_at(&r, 1, 0) == 3);
+    REQUIRE(rope_offset_at(&r, 1, 1) == 5);
+    REQUIRE(rope_offset_at(&r, 1, 3) == 9);
+    // Columns past the end of a line stop at its line break
+    REQUIRE(rope_offset_at(&r, 1, 100) == 10);
+    REQUIRE(rope_offset_at(&r, 2, 5) == 11);
+    REQUIRE(rope_offset_at(&r, 3, 100) == strlen(text));
+
+    rope_free(&r);
+}
+
+TEST_CASE("Rope snapshots are unaffected by later edits", "[rope]") {
+    std::string original;
+    for (u32 i = 0; i < 10000; ++i) original += "snapshot line " + std::to_string(i) + "\n";
+    rope r;
+    rope_init(&r, (const u8 *)original.data(), original.size());
+
+    rope snapshot;
+    rope_snapshot(&snapshot, &r);
+    std::string edited = original;
+    for (u32 i = 0; i < 200; ++i) {
+        u64 offset = (i * 7919) % edited.size();
+        rope_insert(&r, offset, (const u8 *)"new\n", 4);
+        edited.insert(offset, "new\n");
+        rope_erase(&r, offset / 2, 3);
+        edited.erase(offset / 2, 3);
+    }
+    REQUIRE(read_all(&r) == edited);
+    REQUIRE(read_all(&snapshot) == original);
+    require_metrics_match(&snapshot, original);
+
+    // Snapshots are ropes of their own
+    rope_insert(&snapshot, 0, (const u8 *)"head\n", 5);
+    REQUIRE(read_all(&snapshot) == "head\n" + original);
+    REQUIRE(read_all(&r) == edited);
+
+    rope_free(&r);
+    REQUIRE(read_all(&snapshot) == "head\n" + original);
+    rope_free(&snapshot);
+}
+
+TEST_CASE("Rope visits text one chunk at a time", "[rope]") {
+    std::string text(10 * ROPE_CHUNK_SIZE, 'a');
+    rope r;
+    rope_init(&r, (const u8 *)text.data(), text.size());
+
+    struct visit_state {
+        u64 runs;
+        u64 bytes;
+    } state = {0, 0};
+    rope_visit(&r, 100, 3 * ROPE_CHUNK_SIZE, [](const u8 *data, u64 length, void *arg) -> b32 {
+        visit_state *s = (visit_state *)arg;
+        REQUIRE(length <= ROPE_CHUNK_SIZE);
+        REQUIRE(data[0] == 'a');
+        ++s->runs;
+        s->bytes += length;
+        return true;
+    }, &state);
+    REQUIRE(state.bytes == 3 * ROPE_CHUNK_SIZE);
+    REQUIRE(state.runs == 4);
+
+    rope_free(&r);
+}
@@ -0,0 +1,150 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "font.h"
+#include "glyph_cache.h"
+#include "sdf.h"
+
+TEST_CASE("Binned SDF generator matches stbtt_GetGlyphSDF", "[sdf]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+
+    const f32 pixel_heights[] = {16.0f, 48.0f, 96.0f};
+    for (f32 pixel_height : pixel_heights) {
+        f32 scale = stbtt_ScaleForPixelHeight(&roboto.info, pixel_height);
+        for (u32 codepoint = 33; codepoint < 127; ++codepoint) {
+            s32 glyph_index = font_glyph_index(&roboto, codepoint);
+
+            s32 w, h, x, y;
+            u8 *expected = stbtt_GetGlyphSDF(&roboto.info, scale, glyph_index, 5, 180, 36.0f, &w, &h, &x, &y);
+            REQUIRE(expected);
+
+            s32 width, height, x_offset, y_offset;
+            u8 *actual = sdf_get_glyph(&roboto.info, scale, glyph_index, 5, 180, 36.0f,
+                                       &width, &height, &x_offset, &y_offset);
+            REQUIRE(actual);
+            REQUIRE(width == w);
+            REQUIRE(height == h);
+            REQUIRE(x_offset == x);
+            REQUIRE(y_offset == y);
+
+            // Curves are flattened to within 1/64 of a pixel, which can move
+            // a value across a rounding boundary.
+            for (s32 i = 0; i < width * height; ++i) {
+                REQUIRE(abs((s32)actual[i] - (s32)expected[i]) <= 1);
+            }
+
+            stbtt_FreeSDF(expected, NULL);
+            free(actual);
+        }
+    }
+
+    // Empty glyphs have no field, like in stb_truetype
+    s32 width = 0, height = 0;
+    f32 scale = stbtt_ScaleForPixelHeight(&roboto.info, 32.0f);
+    REQUIRE(sdf_get_glyph(&roboto.info, scale, font_glyph_index(&roboto, ' '), 5, 180, 36.0f,
+                          &width, &height, NULL, NULL) == NULL);
+
+    font_unload(&roboto);
+}
+
+TEST_CASE("One SDF glyph cache entry serves every size", "[sdf][glyph_cache]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+
+    glyph_cache cache;
+    glyph_cache_init(&cache, 0, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    s32 glyph_index = font_glyph_index(&roboto, 'g');
+    const cached_glyph *glyph = glyph_cache_get_sdf(&cache, &roboto.info, glyph_index);
+    REQUIRE(cache.misses == 1);
+    REQUIRE(glyph_cache_get_sdf(&cache, &roboto.info, glyph_index) == glyph);
+    REQUIRE(cache.hits == 1);
+
+    // The cached field is the one the generator produces at the base size
+    s32 width, height, x_offset, y_offset;
+    f32 scale = stbtt_ScaleForPixelHeight(&roboto.info, GLYPH_CACHE_SDF_PIXEL_HEIGHT);
+    u8 *expected = sdf_get_glyph(&roboto.info, scale, glyph_index, GLYPH_CACHE_SDF_PADDING,
+                                 GLYPH_CACHE_SDF_ONEDGE_VALUE, GLYPH_CACHE_SDF_PIXEL_DIST_SCALE,
+                                 &width, &height, &x_offset, &y_offset);
+    REQUIRE(glyph->width == width);
+    REQUIRE(glyph->height == height);
+    REQUIRE(glyph->x_offset == x_offset);
+    REQUIRE(glyph->y_offset == y_offset);
+    for (s32 row = 0; row < height; ++row) {
+        REQUIRE(memcmp(glyph->coverage + row * glyph->stride, expected + row * width, width) == 0);
+    }
+    free(expected);
+
+    // Drawn at other sizes, the field reproduces the rasterized glyph closely
+    const f32 pixel_heights[] = {24.0f, 96.0f};
+    for (f32 pixel_height : pixel_heights) {
+        f32 draw_scale = stbtt_ScaleForPixelHeight(&roboto.info, pixel_height);
+        s32 raster_width, raster_height, raster_x, raster_y;
+        u8 *raster = stbtt_GetGlyphBitmap(&roboto.info, draw_scale, draw_scale, glyph_index,
+                                          &raster_width, &raster_height, &raster_x, &raster_y);
+        REQUIRE(raster);
+
+        std::vector<u8> drawn(raster_width * raster_height);
+        f32 factor = draw_scale / glyph->scale;
+        sdf_draw(drawn.data(), raster_width, raster_height, raster_width,
+                 glyph->x_offset * factor - raster_x, glyph->y_offset * factor - raster_y, factor,
+                 glyph->coverage, glyph->width, glyph->height, glyph->stride,
+                 GLYPH_CACHE_SDF_ONEDGE_VALUE, GLYPH_CACHE_SDF_PIXEL_DIST_SCALE);
+
+        s64 total_difference = 0;
+        for (s32 i = 0; i < raster_width * raster_height; ++i) {
+            total_difference += abs((s32)drawn[i] - (s32)raster[i]);
+        }
+        REQUIRE(total_difference < 12 * raster_width * raster_height);
+
+        stbtt_FreeBitmap(raster, NULL);
+    }
+    REQUIRE(cache.misses == 1);
+
+    // Coverage and distance field entries of a glyph are distinct
+    glyph_cache_get(&cache, &roboto.info, glyph_index, GLYPH_CACHE_SDF_PIXEL_HEIGHT, 0);
+    REQUIRE(cache.misses == 2);
+    REQUIRE(cache.count == 2);
+
+    glyph_cache_free(&cache);
+    font_unload(&roboto);
+}
+
+TEST_CASE("Parallel SDF warm-up produces the same fields as on-demand lookups", "[sdf][glyph_cache]") {
+    font roboto;
+    REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+
+    std::vector<s32> glyph_indices;
+    for (u32 codepoint = 32; codepoint < 127; ++codepoint) {
+        glyph_indices.push_back(font_glyph_index(&roboto, codepoint));
+    }
+
+    glyph_cache warmed, on_demand;
+    glyph_cache_init(&warmed, 0, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+    glyph_cache_init(&on_demand, 0, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+
+    thread_pool pool;
+    thread_pool_init(&pool, 4);
+    glyph_cache_warm_sdf(&warmed, &pool, &roboto.info, glyph_indices.data(), (u32)glyph_indices.size());
+    thread_pool_free(&pool);
+    REQUIRE(warmed.count == glyph_indices.size());
+
+    for (s32 glyph_index : glyph_indices) {
+        const cached_glyph *a = glyph_cache_get_sdf(&warmed, &roboto.info, glyph_index);
+        const cached_glyph *b = glyph_cache_get_sdf(&on_demand, &roboto.info, glyph_index);
+        REQUIRE(a->width == b->width);
+        REQUIRE(a->height == b->height);
+        for (s32 row = 0; row < a->height; ++row) {
+            REQUIRE(memcmp(a->coverage + row * a->stride, b->coverage + row * b->stride, a->width) == 0);
+        }
+    }
+    REQUIRE(warmed.hits == glyph_indices.size());
+
+    glyph_cache_free(&warmed);
+    glyph_cache_free(&on_demand);
+    font_unload(&roboto);
+}
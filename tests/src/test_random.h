@@ -0,0 +1,25 @@
+#ifndef TEST_RANDOM_H
+
+#include "core.h"
+
+// Linear congruential generator, so randomized tests draw the same cases on
+// every run and platform
+struct test_random {
+    u32 state;
+
+    // Every bit of the new state. The low bits repeat quickly.
+    u32 step()
+    {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+
+    // The better high bits
+    u32 next()
+    {
+        return step() >> 8;
+    }
+};
+
+#define TEST_RANDOM_H
+#endif
@@ -0,0 +1,173 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "text_view.h"
+
+struct test_document {
+    std::vector<std::string> lines;
+};
+
+static b32
+document_line(void *arg, u64 line, const u8 **text, u32 *length)
+{
+    test_document *document = (test_document *)arg;
+    if (line >= document->lines.size()) return false;
+    *text = (const u8 *)document->lines[line].data();
+    *length = (u32)document->lines[line].size();
+    return true;
+}
+
+struct test_view {
+    font roboto;
+    font_metrics metrics;
+    glyph_cache glyphs;
+    layout_cache layouts;
+    text_view view;
+
+    test_view(test_document *document, b32 sdf_glyphs)
+    {
+        REQUIRE(font_load(&roboto, "res/Roboto-Black.ttf", 0, 0));
+        font_metrics_init(&metrics, &roboto, 16.0f);
+        glyph_cache_init(&glyphs, 256, GLYPH_CACHE_DEFAULT_PAGE_SIZE, GLYPH_CACHE_DEFAULT_MAX_PAGES);
+        layout_cache_init(&layouts, 256);
+        text_view_init(&view, 320, 200, &metrics, &glyphs, &layouts, nullptr, sdf_glyphs, document_line, document);
+    }
+
+    ~test_view()
+    {
+        text_view_free(&view);
+        layout_cache_free(&layouts);
+        glyph_cache_free(&glyphs);
+        font_metrics_free(&metrics);
+        font_unload(&roboto);
+    }
+};
+
+static std::vector<u8>
+pixels_of(const text_view *view)
+{
+    return std::vector<u8>(view->pixels, view->pixels + view->width * view->height);
+}
+
+TEST_CASE("Text view redraws only the damage, to the same pixels as a full redraw", "[text_view]") {
+    for (b32 sdf_glyphs : {false, true}) {
+        test_document document;
+        for (u32 i = 0; i < 20; ++i) document.lines.push_back("line " + std::to_string(i) + " gjpqy ÅÉ|");
+        test_view editor(&document, sdf_glyphs);
+        test_view reference(&document, sdf_glyphs);
+        text_view *view = &editor.view;
+
+        damage_region presented;
+        damage_init(&presented, view->width, view->height);
+        text_view_set_cursor(view, 3, 4, true);
+        text_view_render(view, &presented);
+        REQUIRE(damage_area(&presented) == (u64)view->width * view->height);
+
+        // Typing into one line touches its row of the screen only
+        document.lines[3].insert(4, "X");
+        layout_cache_edit(&editor.layouts, 3, 1, 1);
+        text_view_damage_lines(view, 3, 1);
+        text_view_set_cursor(view, 3, 5, true);
+        u64 drawn = view->pixels_drawn;
+        damage_clear(&presented);
+        text_view_render(view, &presented);
+        REQUIRE(presented.count == 1);
+        REQUIRE(view->pixels_drawn - drawn == damage_area(&presented));
+        REQUIRE(damage_area(&presented) <= (u64)view->width * ((u64)view->line_advance + 2));
+
+        // A blink touches the cursor's cell
+        text_view_set_cursor(view, 3, 5, false);
+        damage_clear(&presented);
+        text_view_render(view, &presented);
+        REQUIRE(damage_area(&presented) <= TEXT_VIEW_CURSOR_WIDTH * ((u64)view->line_advance + 2));
+
+        // Lines past the end of the screen and the document cost nothing
+        text_view_damage_lines(view, 1000, 5);
+        REQUIRE(view->damage.count == 0);
+
+        text_view_set_cursor(&reference.view, 3, 5, false);
+        text_view_render(&reference.view, nullptr);
+        REQUIRE(pixels_of(view) == pixels_of(&reference.view));
+
+        // Scrolling redraws everything, a deleted last line leaves nothing behind
+        text_view_scroll(view, 2);
+        text_view_scroll(&reference.view, 2);
+        document.lines.pop_back();
+        text_view_damage_lines(view, document.lines.size(), 1);
+        text_view_render(view, nullptr);
+        text_view_render(&reference.view, nullptr);
+        REQUIRE(pixels_of(view) == pixels_of(&reference.view));
+    }
+}
+
+TEST_CASE("Text view reports its layout, raster and glyph misses", "[text_view]") {
+    test_document document;
+    for (u32 i = 0; i < 20; ++i) document.lines.push_back("line " + std::to_string(i));
+    test_view editor(&document, false);
+    frame_stats stats;
+    frame_stats_init(&stats);
+    editor.view.stats = &stats;
+
+    // Every glyph is new on the first frame, none on the next
+    for (u32 frame = 0; frame < 2; ++frame) {
+        frame_stats_begin_frame(&stats, frame_stats_now());
+        damage_add_all(&editor.view.damage);
+        text_view_render(&editor.view, nullptr);
+        frame_stats_end_frame(&stats, frame_stats_now());
+        REQUIRE((stats.glyph_misses.samples[frame] > 0) == (frame == 0));
+    }
+
+    // Nothing damaged, nothing laid out or rasterized
+    frame_stats_begin_frame(&stats, frame_stats_now());
+    text_view_render(&editor.view, nullptr);
+    frame_stats_end_frame(&stats, frame_stats_now());
+    REQUIRE(stats.stages[FRAME_STAGE_LAYOUT].count == 2);
+    REQUIRE(stats.stages[FRAME_STAGE_RASTER].count == 2);
+    REQUIRE(stats.stages[FRAME_STAGE_INPUT].count == 0);
+    REQUIRE(stats.total_glyph_misses == editor.glyphs.misses);
+}
+
+TEST_CASE("Text view only rasterizes glyphs up to the edge of the view", "[text_view]") {
+    test_document document;
+    std::string line;
+    for (char c = 'A'; c <= 'Z'; ++c) line += c;
+    for (char c = 'a'; c <= 'z'; ++c) line += c;
+    document.lines.push_back(line + line + line);
+    test_view editor(&document, false);
+
+    // The pool warms the glyphs of each line ahead of drawing them
+    thread_pool pool;
+    thread_pool_init(&pool, 2);
+    editor.view.pool = &pool;
+    text_view_render(&editor.view, nullptr);
+    REQUIRE(editor.glyphs.misses > 0);
+    REQUIRE(editor.glyphs.misses < 52);
+    thread_pool_free(&pool);
+}
+
+TEST_CASE("Text view leaves the cursor to whatever presents it", "[text_view]") {
+    test_document document;
+    document.lines = {"", "", ""};
+    test_view editor(&document, false);
+    text_view *view = &editor.view;
+
+    damage_rect rect;
+    REQUIRE(!text_view_cursor_rect(view, &rect));
+    text_view_set_cursor(view, 1, 0, true);
+    text_view_render(view, nullptr);
+    REQUIRE(text_view_cursor_rect(view, &rect));
+    REQUIRE(rect.x0 == 0);
+    REQUIRE(rect.x1 == TEXT_VIEW_CURSOR_WIDTH);
+    REQUIRE(rect.y0 == (s32)roundf(view->line_advance));
+    REQUIRE(rect.y1 == (s32)roundf(2.0f * view->line_advance));
+
+    // Empty lines, so any coverage would have been the cursor
+    REQUIRE(pixels_of(view) == std::vector<u8>(view->width * view->height, 0));
+
+    text_view_scroll(view, 2);
+    REQUIRE(!text_view_cursor_rect(view, &rect));
+}
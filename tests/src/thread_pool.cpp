@@ -0,0 +1,32 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+
+#include "thread_pool.h"
+
+static void
+increment(void *arg)
+{
+    ++*(std::atomic<u32> *)arg;
+}
+
+TEST_CASE("Thread pool runs every submitted job", "[thread_pool]") {
+    thread_pool pool;
+    thread_pool_init(&pool, 3);
+
+    std::atomic<u32> first{0}, second{0};
+    thread_pool_group first_group = {0}, second_group = {0};
+    // More jobs than the initial queue holds
+    for (int i = 0; i < 500; ++i) {
+        thread_pool_submit(&pool, &first_group, increment, &first);
+        thread_pool_submit(&pool, &second_group, increment, &second);
+    }
+    thread_pool_wait(&pool, &first_group);
+    REQUIRE(first == 500);
+    REQUIRE(first_group.pending == 0);
+
+    thread_pool_wait(&pool, NULL);
+    REQUIRE(second == 500);
+
+    thread_pool_free(&pool);
+}
@@ -0,0 +1,288 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "undo_history.h"
+#include "test_random.h"
+
+static std::string
+read_all(const piece_table *table)
+{
+    std::string text(piece_table_length(table), '\0');
+    piece_table_read(table, 0, text.size(), (u8 *)text.data());
+    return text;
+}
+
+TEST_CASE("Undo history restores every state of random edits", "[undo_history]") {
+    const char *initial = "first line\nsecond line\n";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)initial, strlen(initial));
+    undo_history history;
+    undo_history_init(&history, &table, 0);
+
+    test_random random = {7};
+    const char *fragments[] = {"x", "\n", "ab\ncd", "hello world"};
+    std::vector<std::string> states = {initial};
+    for (u32 step = 0; step < 500; ++step) {
+        std::string text = states.back();
+        // Some steps are groups of several edits
+        u32 edits = random.next() % 4 == 0 ? 1 + random.next() % 5 : 1;
+        undo_history_begin(&history);
+        for (u32 i = 0; i < edits; ++i) {
+            u64 offset = random.next() % (text.size() + 1);
+            if (random.next() % 3 != 0 || text.empty()) {
+                const char *fragment = fragments[random.next() % 4];
+                undo_history_insert(&history, offset, (const u8 *)fragment, strlen(fragment));
+                text.insert(offset, fragment);
+            } else {
+                u64 length = random.next() % 16;
+                undo_history_erase(&history, offset, length);
+                text.erase(offset, length);
+            }
+        }
+        undo_history_end(&history);
+        REQUIRE(read_all(&table) == text);
+        if (text != states.back()) states.push_back(text);
+    }
+    REQUIRE(undo_history_undo_count(&history) == states.size() - 1);
+
+    for (u64 i = states.size() - 1; i > 0; --i) {
+        REQUIRE(undo_history_undo(&history, NULL));
+        REQUIRE(read_all(&table) == states[i - 1]);
+    }
+    REQUIRE(!undo_history_undo(&history, NULL));
+    for (u64 i = 1; i < states.size(); ++i) {
+        REQUIRE(undo_history_redo(&history, NULL));
+        REQUIRE(read_all(&table) == states[i]);
+    }
+    REQUIRE(!undo_history_redo(&history, NULL));
+
+    // A new edit after undoing drops the steps that could have been redone
+    undo_history_undo(&history, NULL);
+    undo_history_undo(&history, NULL);
+    undo_history_insert(&history, 0, (const u8 *)"new", 3);
+    REQUIRE(undo_history_redo_count(&history) == 0);
+    REQUIRE(!undo_history_redo(&history, NULL));
+    REQUIRE(undo_history_undo(&history, NULL));
+    REQUIRE(read_all(&table) == states[states.size() - 3]);
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Undo history coalesces typing into one step", "[undo_history]") {
+    piece_table table;
+    piece_table_init(&table, (const u8 *)"hello", 5);
+    undo_history history;
+    undo_history_init(&history, &table, 0);
+
+    // The first key allocates the only block, the rest of the run takes no
+    // memory at all
+    const char *typed = " world, typed one key at a time";
+    u64 first_key_memory = 0;
+    for (u64 i = 0; i < strlen(typed); ++i) {
+        undo_history_insert(&history, 5 + i, (const u8 *)&typed[i], 1);
+        if (i == 0) first_key_memory = history.memory;
+    }
+    REQUIRE(undo_history_undo_count(&history) == 1);
+    REQUIRE(history.first_block == history.last_block);
+    REQUIRE(first_key_memory >= UNDO_HISTORY_BLOCK_SIZE);
+    REQUIRE(first_key_memory < 2 * UNDO_HISTORY_BLOCK_SIZE);
+    REQUIRE(history.memory == first_key_memory);
+
+    // Backspacing is a run of its own
+    for (u32 i = 0; i < 5; ++i) {
+        undo_history_erase(&history, piece_table_length(&table) - 1, 1);
+    }
+    REQUIRE(undo_history_undo_count(&history) == 2);
+    REQUIRE(read_all(&table) == "hello world, typed one key at a");
+
+    // Moving elsewhere ends the run
+    undo_history_break(&history);
+    undo_history_insert(&history, 0, (const u8 *)">", 1);
+    undo_history_insert(&history, 1, (const u8 *)" ", 1);
+    REQUIRE(undo_history_undo_count(&history) == 3);
+
+    u64 cursor;
+    REQUIRE(undo_history_undo(&history, &cursor));
+    REQUIRE(cursor == 0);
+    REQUIRE(undo_history_undo(&history, &cursor));
+    REQUIRE(read_all(&table) == "hello world, typed one key at a time");
+    REQUIRE(cursor == piece_table_length(&table));
+    REQUIRE(undo_history_undo(&history, &cursor));
+    REQUIRE(read_all(&table) == "hello");
+    REQUIRE(cursor == 5);
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Replacing every match is one compact step", "[undo_history]") {
+    u32 matches = 100000;
+    std::string line = "a cat\n";
+    std::string text;
+    for (u32 i = 0; i < matches; ++i) text += line;
+
+    piece_table table;
+    piece_table_init(&table, (const u8 *)text.data(), text.size());
+    undo_history history;
+    undo_history_init(&history, &table, 0);
+
+    // Back to front, so earlier offsets stay valid
+    undo_history_begin(&history);
+    for (u32 i = matches; i-- > 0;) {
+        undo_history_erase(&history, i * line.size() + 2, 3);
+        undo_history_insert(&history, i * line.size() + 2, (const u8 *)"dog", 3);
+    }
+    undo_history_end(&history);
+    REQUIRE(undo_history_undo_count(&history) == 1);
+    REQUIRE(piece_table_line_count(&table) == matches + 1);
+
+    // One delta per match, with no allocations besides the blocks
+    REQUIRE(history.memory < (u64)matches * 64);
+    REQUIRE(history.memory <= history.budget);
+
+    REQUIRE(undo_history_undo(&history, NULL));
+    REQUIRE(read_all(&table) == text);
+    REQUIRE(undo_history_redo(&history, NULL));
+    std::string replaced = read_all(&table);
+    REQUIRE(replaced.substr(0, 12) == "a dog\na dog\n");
+    REQUIRE(replaced.find("cat") == std::string::npos);
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Typing at many cursors is one batched step", "[undo_history]") {
+    u32 lines = 10000;
+    std::string text;
+    for (u32 i = 0; i < lines; ++i) text += "line\n";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)text.data(), text.size());
+    undo_history history;
+    undo_history_init(&history, &table, 0);
+
+    // A cursor at the start of every line, with a selection over each word
+    std::vector<undo_edit> edits;
+    std::vector<u64> positions;
+    for (u32 i = 0; i < lines; ++i) {
+        edits.push_back({i * 5ull, 0, (const u8 *)"#", 1});
+        positions.push_back(i * 5ull);
+        positions.push_back(i * 5ull + 4);
+    }
+    undo_history_apply(&history, edits.data(), edits.size(), positions.data(), positions.size());
+    std::string typed;
+    for (u32 i = 0; i < lines; ++i) typed += "#line\n";
+    REQUIRE(read_all(&table) == typed);
+    for (u32 i = 0; i < lines; ++i) {
+        REQUIRE(positions[2 * i] == i * 6ull + 1);
+        REQUIRE(positions[2 * i + 1] == i * 6ull + 5);
+    }
+    REQUIRE(undo_history_undo_count(&history) == 1);
+
+    // Replacing each word joins an open group
+    undo_history_begin(&history);
+    edits.clear();
+    for (u32 i = 0; i < lines; ++i) edits.push_back({i * 6ull + 1, 4, (const u8 *)"text", 4});
+    undo_history_apply(&history, edits.data(), edits.size(), NULL, 0);
+    undo_history_end(&history);
+    REQUIRE(undo_history_undo_count(&history) == 2);
+
+    u64 cursor = 0;
+    REQUIRE(undo_history_undo(&history, &cursor));
+    REQUIRE(read_all(&table) == typed);
+    REQUIRE(cursor == 5);
+    REQUIRE(undo_history_undo(&history, &cursor));
+    REQUIRE(read_all(&table) == text);
+    REQUIRE(cursor == 0);
+    REQUIRE(undo_history_redo(&history, &cursor));
+    REQUIRE(read_all(&table) == typed);
+    REQUIRE(cursor == (lines - 1) * 6ull + 1);
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Batched edits undo and redo like sequential ones", "[undo_history]") {
+    std::string text;
+    for (u32 i = 0; i < 500; ++i) text += "word " + std::to_string(i) + "\n";
+    piece_table table;
+    piece_table_init(&table, (const u8 *)text.data(), text.size());
+    undo_history history;
+    undo_history_init(&history, &table, 0);
+
+    test_random random = {11};
+    const char *fragments[] = {"", "x", "\n", "ab\ncd"};
+    std::vector<std::string> states = {text};
+    for (u32 step = 0; step < 40; ++step) {
+        // Batches of either size, some of them back to front through single edits
+        u32 count = random.next() % 2 ? 1 + random.next() % 8 : 16 + random.next() % 200;
+        std::vector<undo_edit> edits;
+        u64 offset = 0;
+        for (u32 i = 0; i < count; ++i) {
+            offset += random.next() % (2 * text.size() / count + 1);
+            if (offset > text.size()) break;
+            u64 length = std::min<u64>(random.next() % 6, text.size() - offset);
+            const char *fragment = fragments[random.next() % 4];
+            edits.push_back({offset, length, (const u8 *)fragment, strlen(fragment)});
+            offset += length;
+        }
+        if (random.next() % 3 == 0) {
+            undo_history_begin(&history);
+            for (u64 i = edits.size(); i-- > 0;) {
+                undo_history_erase(&history, edits[i].offset, edits[i].length);
+                undo_history_insert(&history, edits[i].offset, edits[i].text, edits[i].text_length);
+            }
+            undo_history_end(&history);
+        } else {
+            undo_history_break(&history);
+            undo_history_apply(&history, edits.data(), edits.size(), NULL, 0);
+        }
+        for (u64 i = edits.size(); i-- > 0;) {
+            text.replace(edits[i].offset, edits[i].length, (const char *)edits[i].text, edits[i].text_length);
+        }
+        REQUIRE(read_all(&table) == text);
+        if (text != states.back()) states.push_back(text);
+    }
+    REQUIRE(undo_history_undo_count(&history) == states.size() - 1);
+
+    for (u64 i = states.size() - 1; i > 0; --i) {
+        REQUIRE(undo_history_undo(&history, NULL));
+        REQUIRE(read_all(&table) == states[i - 1]);
+    }
+    for (u64 i = 1; i < states.size(); ++i) {
+        REQUIRE(undo_history_redo(&history, NULL));
+        REQUIRE(read_all(&table) == states[i]);
+    }
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
+
+TEST_CASE("Undo history drops the oldest steps past its budget", "[undo_history]") {
+    piece_table table;
+    piece_table_init(&table, NULL, 0);
+    undo_history history;
+    undo_history_init(&history, &table, 4 * UNDO_HISTORY_BLOCK_SIZE);
+
+    std::string text;
+    for (u32 i = 0; i < 20000; ++i) {
+        undo_history_break(&history);
+        undo_history_insert(&history, 0, (const u8 *)"ab", 2);
+        text.insert(0, "ab");
+    }
+    REQUIRE(history.memory <= history.budget);
+    u32 kept = undo_history_undo_count(&history);
+    REQUIRE(kept > 1000);
+    REQUIRE(kept < 20000);
+
+    while (undo_history_undo(&history, NULL)) {
+    }
+    REQUIRE(read_all(&table) == text.substr(2 * kept));
+
+    undo_history_free(&history);
+    piece_table_free(&table);
+}
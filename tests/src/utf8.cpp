@@ -0,0 +1,133 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <vector>
+
+#include "raster_simd.h"
+#include "test_random.h"
+#include "utf8.h"
+
+// Straightforward check of the well-formed byte sequences table of the
+// Unicode standard
+static u64
+reference_validate(const std::string &text)
+{
+    const u8 *data = (const u8 *)text.data();
+    u64 length = text.size();
+    u64 i = 0;
+    while (i < length) {
+        u8 lead = data[i];
+        u32 count = 0;
+        u8 low = 0x80, high = 0xBF;
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        } else if (lead >= 0xC2 && lead <= 0xDF) {
+            count = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            count = 2;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            count = 3;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        } else {
+            return i;
+        }
+        if (i + count >= length) return i;
+        if (data[i + 1] < low || data[i + 1] > high) return i;
+        for (u32 k = 2; k <= count; ++k) {
+            if (data[i + k] < 0x80 || data[i + k] > 0xBF) return i;
+        }
+        i += count + 1;
+    }
+    return length;
+}
+
+static std::string
+make_text(u32 codepoints, u32 seed)
+{
+    const char *samples[] = {"a", "z", " ", "\n", "\xC3\xA9", "\xE2\x82\xAC", "\xE6\x97\xA5", "\xF0\x9F\x98\x80",
+                             "\xEF\xBF\xBD", "\xF4\x8F\xBF\xBF", "\xED\x9F\xBF"};
+    std::string text;
+    test_random random = {seed};
+    for (u32 i = 0; i < codepoints; ++i) {
+        // Long runs of ASCII, as in most text, with multibyte runs between
+        u32 pick = random.next() % 64;
+        text += pick < 40 ? samples[pick % 4] : samples[pick % 11];
+    }
+    return text;
+}
+
+TEST_CASE("UTF-8 validation finds the first ill-formed sequence with every kernel", "[utf8]") {
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+
+        std::string text = make_text(4000, 11);
+        REQUIRE(reference_validate(text) == text.size());
+        REQUIRE(utf8_validate((const u8 *)text.data(), text.size()) == text.size());
+
+        // Every kind of error, at every position within a vector
+        const char *errors[] = {"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC3", "\xE2\x82", "\xE0\x80\x80",
+                                "\xE0\x9F\xBF", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80",
+                                "\xF5\x80\x80\x80", "\xFF", "\xF0\x9F\x98", "\xC3\xA9\xA9"};
+        test_random random = {5};
+        for (const char *error : errors) {
+            for (u32 trial = 0; trial < 80; ++trial) {
+                u32 value = random.step();
+                u64 position = (value >> 8) % 200 + 500;
+                std::string broken = make_text(400, value);
+                position = position < broken.size() ? position : broken.size();
+                broken.insert(position, error);
+                // Errors are also cut off by the end of the text
+                if (trial % 10 == 0) broken.resize(position + 1);
+                u64 expected = reference_validate(broken);
+                REQUIRE(expected < broken.size());
+                REQUIRE(utf8_validate((const u8 *)broken.data(), broken.size()) == expected);
+            }
+        }
+
+        // Random bytes, mostly ill-formed early on
+        for (u32 trial = 0; trial < 200; ++trial) {
+            std::string noise = make_text(100, trial);
+            for (u32 k = 0; k < 3; ++k) {
+                u32 value = random.step();
+                noise[(value >> 8) % noise.size()] = (char)(value >> 24);
+            }
+            REQUIRE(utf8_validate((const u8 *)noise.data(), noise.size()) == reference_validate(noise));
+        }
+    }
+    raster_simd_set_level(best);
+}
+
+TEST_CASE("UTF-8 codepoints and ASCII runs are counted with every kernel", "[utf8]") {
+    std::string text = make_text(5000, 3);
+    u64 codepoints = 0;
+    for (char c : text) codepoints += ((u8)c & 0xC0) != 0x80;
+    u64 ascii = 0;
+    while (ascii < text.size() && (u8)text[ascii] < 0x80) ++ascii;
+
+    raster_simd_level best = raster_simd_detect();
+    for (s32 level = RASTER_SIMD_SCALAR; level <= best; ++level) {
+        raster_simd_set_level((raster_simd_level)level);
+        REQUIRE(utf8_count_codepoints((const u8 *)text.data(), text.size()) == codepoints);
+        REQUIRE(utf8_ascii_length((const u8 *)text.data(), text.size()) == ascii);
+        for (u64 start = 0; start < 100; ++start) {
+            u64 expected = start;
+            while (expected < text.size() && (u8)text[expected] < 0x80) ++expected;
+            REQUIRE(start + utf8_ascii_length((const u8 *)text.data() + start, text.size() - start) == expected);
+        }
+    }
+    raster_simd_set_level(best);
+}
+
+TEST_CASE("UTF-8 decoding replaces each ill-formed byte", "[utf8]") {
+    std::string text = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xC0\xAF\xED\xA0\x80\xE2\x82";
+    std::vector<u32> expected = {'a', 0xE9, 0x20AC, 0x1F600, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD};
+    std::vector<u32> decoded;
+    u64 offset = 0;
+    while (offset < text.size()) decoded.push_back(utf8_decode((const u8 *)text.data(), text.size(), &offset));
+    REQUIRE(decoded == expected);
+}